@@ -720,6 +720,16 @@ rasqal_free_algebra_node(rasqal_algebra_node* node)
 
   /* node->triples is SHARED with the query - not freed here */
 
+  if(node->column_exprs) {
+    int i;
+
+    for(i = 0; i <= node->end_column - node->start_column; i++) {
+      if(node->column_exprs[i])
+        rasqal_free_expression(node->column_exprs[i]);
+    }
+    RASQAL_FREE(rasqal_expression**, node->column_exprs);
+  }
+
   if(node->node1)
     rasqal_free_algebra_node(node->node1);
 
@@ -875,6 +885,12 @@ rasqal_algebra_algebra_node_write_internal(rasqal_algebra_node *node,
         rasqal_algebra_write_indent(iostr, indent);
       }
       rasqal_triple_write(t, iostr);
+      if(node->column_exprs && node->column_exprs[i - node->start_column]) {
+        raptor_iostream_counted_string_write(" FILTER(", 8, iostr);
+        rasqal_expression_write(node->column_exprs[i - node->start_column],
+                                iostr);
+        raptor_iostream_write_byte(')', iostr);
+      }
       arg_count++;
     }
   }
@@ -1061,7 +1077,7 @@ rasqal_algebra_basic_graph_pattern_to_algebra(rasqal_query* query,
   rasqal_expression* fs = NULL;
   
   node = rasqal_new_triples_algebra_node(query, 
-                                         rasqal_query_get_triple_sequence(query),
+                                         rasqal_query_get_plan_triple_sequence(query),
                                          gp->start_column, gp->end_column);
   if(!node)
     goto fail;
@@ -1307,6 +1323,24 @@ rasqal_algebra_group_graph_pattern_to_algebra(rasqal_query* query,
           true_expr = NULL; /* now owned by gnode */
         }
       } /* end for all optional */
+    } else if(egp->op == RASQAL_GRAPH_PATTERN_OPERATOR_MINUS) {
+      /* If E is of the form MINUS{P} */
+      rasqal_algebra_node* anode;
+
+      /* Let A := Transform(P) */
+      anode = rasqal_algebra_group_graph_pattern_to_algebra(query, egp);
+      if(!anode) {
+        RASQAL_DEBUG1("rasqal_algebra_group_graph_pattern_to_algebra() failed\n");
+        goto fail;
+      }
+
+      /* G := Minus(G, A) */
+      gnode = rasqal_new_2op_algebra_node(query, RASQAL_ALGEBRA_OPERATOR_DIFF,
+                                          gnode, anode);
+      if(!gnode) {
+        RASQAL_DEBUG1("rasqal_new_2op_algebra_node() failed\n");
+        goto fail;
+      }
     } else {
       /* If E is any other form:*/
       rasqal_algebra_node* anode;
@@ -1716,6 +1750,266 @@ rasqal_algebra_remove_znodes(rasqal_query* query, rasqal_algebra_node* node,
 }
 
 
+/*
+ * rasqal_algebra_filter_column_data:
+ *
+ * INTERNAL - state for rasqal_algebra_filter_column_visit()
+ */
+typedef struct
+{
+  rasqal_query* query;
+
+  /* BGP node the filter is over */
+  rasqal_algebra_node* node;
+
+  /* earliest column where all variables seen so far are bound or -1 */
+  int column;
+} rasqal_algebra_filter_column_data;
+
+
+static int
+rasqal_algebra_filter_column_visit(void *user_data, rasqal_expression *e)
+{
+  rasqal_algebra_filter_column_data* fcd;
+  rasqal_variable* v;
+  int column;
+
+  fcd = (rasqal_algebra_filter_column_data*)user_data;
+
+  switch(e->op) {
+    case RASQAL_EXPR_RAND:
+    case RASQAL_EXPR_BNODE:
+    case RASQAL_EXPR_UUID:
+    case RASQAL_EXPR_STRUUID:
+      /* a new value every evaluation - must be once per result */
+    case RASQAL_EXPR_STR_MATCH:
+    case RASQAL_EXPR_STR_NMATCH:
+      /* arguments are not all visited */
+      fcd->column = -1;
+      return 1;
+
+    case RASQAL_EXPR_LITERAL:
+      break;
+
+    default:
+      return 0;
+  }
+
+  v = rasqal_literal_as_variable(e->literal);
+  if(!v)
+    return 0;
+
+  for(column = fcd->node->start_column;
+      column <= fcd->node->end_column;
+      column++) {
+    rasqal_triple_parts parts;
+
+    parts = rasqal_query_variable_bound_in_triple(fcd->query, v, column);
+    if(parts & RASQAL_TRIPLE_SPO)
+      break;
+  }
+
+  if(column > fcd->node->end_column) {
+    /* not bound by a triple pattern in this BGP */
+    fcd->column = -1;
+    return 1;
+  }
+
+  if(column > fcd->column)
+    fcd->column = column;
+
+  return 0;
+}
+
+
+/*
+ * rasqal_algebra_filter_column:
+ * @query: query
+ * @node: BGP algebra node
+ * @expr: filter expression
+ *
+ * INTERNAL - Find the earliest triple pattern in a BGP after which a
+ * filter expression can be evaluated
+ *
+ * Return value: column or <0 if the filter cannot be evaluated inside
+ * the BGP
+ */
+static int
+rasqal_algebra_filter_column(rasqal_query* query, rasqal_algebra_node* node,
+                             rasqal_expression* expr)
+{
+  rasqal_algebra_filter_column_data fcd;
+
+  fcd.query = query;
+  fcd.node = node;
+  fcd.column = -1;
+
+  /* constant expressions with no variables also stay as a filter */
+  if(rasqal_expression_visit(expr, rasqal_algebra_filter_column_visit, &fcd))
+    return -1;
+
+  return fcd.column;
+}
+
+
+/*
+ * rasqal_algebra_filter_conjuncts:
+ * @expr: expression
+ * @seq: sequence to add conjuncts to
+ *
+ * INTERNAL - Split an expression into a sequence of AND-ed conjuncts
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_algebra_filter_conjuncts(rasqal_expression* expr, raptor_sequence* seq)
+{
+  if(expr->op == RASQAL_EXPR_AND)
+    return rasqal_algebra_filter_conjuncts(expr->arg1, seq) ||
+           rasqal_algebra_filter_conjuncts(expr->arg2, seq);
+
+  expr = rasqal_new_expression_from_expression(expr);
+  if(!expr)
+    return 1;
+
+  return raptor_sequence_push(seq, expr);
+}
+
+
+/*
+ * rasqal_algebra_push_down_filters:
+ * @query: query
+ * @node: algebra node
+ * @data: pointer to modified flag
+ *
+ * INTERNAL - Move FILTER conjuncts over a BGP into the BGP
+ *
+ * For Filter(X, BGP), each conjunct of X that only uses variables
+ * bound by the BGP triple patterns is attached to the triple pattern
+ * where the last of them is bound, so that partial matches can be
+ * rejected before the following triple patterns are matched.  A
+ * filter passes only when every conjunct is true, so the result is
+ * the same.  Any remaining conjuncts stay in the filter; if there are
+ * none, the filter node is replaced by the BGP.
+ *
+ * Return value: 0 (never truncates the visit)
+ */
+static int
+rasqal_algebra_push_down_filters(rasqal_query* query, rasqal_algebra_node* node,
+                                 void* data)
+{
+  int* modified = (int*)data;
+  rasqal_algebra_node* bgp;
+  raptor_sequence* conjuncts = NULL;
+  rasqal_expression* remaining = NULL;
+  rasqal_expression** column_exprs = NULL;
+  int triples_count;
+  int pushed = 0;
+  int i;
+
+  if(node->op != RASQAL_ALGEBRA_OPERATOR_FILTER || !node->expr)
+    return 0;
+
+  bgp = node->node1;
+  if(!bgp || bgp->op != RASQAL_ALGEBRA_OPERATOR_BGP || !bgp->triples ||
+     !query->triples_use_map)
+    return 0;
+
+  triples_count = bgp->end_column - bgp->start_column + 1;
+
+  conjuncts = raptor_new_sequence((raptor_data_free_handler)rasqal_free_expression,
+                                  (raptor_data_print_handler)rasqal_expression_print);
+  if(!conjuncts)
+    return 0;
+
+  if(rasqal_algebra_filter_conjuncts(node->expr, conjuncts))
+    goto tidy;
+
+  column_exprs = RASQAL_CALLOC(rasqal_expression**,
+                               RASQAL_GOOD_CAST(size_t, triples_count),
+                               sizeof(rasqal_expression*));
+  if(!column_exprs)
+    goto tidy;
+
+  for(i = 0; i < raptor_sequence_size(conjuncts); i++) {
+    rasqal_expression* e;
+    int column;
+
+    e = (rasqal_expression*)raptor_sequence_get_at(conjuncts, i);
+    column = rasqal_algebra_filter_column(query, bgp, e);
+    if(column >= 0) {
+      rasqal_expression** e_p = &column_exprs[column - bgp->start_column];
+
+      pushed++;
+      e = rasqal_new_expression_from_expression(e);
+      *e_p = *e_p ? rasqal_new_2op_expression(query->world, RASQAL_EXPR_AND,
+                                              *e_p, e) : e;
+      if(!*e_p)
+        goto tidy;
+    } else {
+      e = rasqal_new_expression_from_expression(e);
+      remaining = remaining ? rasqal_new_2op_expression(query->world,
+                                                        RASQAL_EXPR_AND,
+                                                        remaining, e) : e;
+      if(!remaining)
+        goto tidy;
+    }
+  }
+
+  if(!pushed)
+    goto tidy;
+
+  /* merge with any filters already pushed into the BGP */
+  if(bgp->column_exprs) {
+    for(i = 0; i < triples_count; i++) {
+      rasqal_expression* e = bgp->column_exprs[i];
+
+      if(!e)
+        continue;
+      bgp->column_exprs[i] = NULL;
+
+      column_exprs[i] = column_exprs[i] ?
+        rasqal_new_2op_expression(query->world, RASQAL_EXPR_AND,
+                                  e, column_exprs[i]) : e;
+      if(!column_exprs[i])
+        goto tidy;
+    }
+    RASQAL_FREE(rasqal_expression**, bgp->column_exprs);
+  }
+
+  bgp->column_exprs = column_exprs;
+  column_exprs = NULL;
+
+  rasqal_free_expression(node->expr);
+  node->expr = remaining;
+  remaining = NULL;
+
+  if(!node->expr) {
+    /* Replace Filter(BGP) by BGP */
+    node->node1 = NULL;
+    memcpy(node, bgp, sizeof(rasqal_algebra_node));
+    /* free the node struct memory - contained pointers now owned by node */
+    RASQAL_FREE(rasqal_algebra_node, bgp);
+  }
+
+  *modified = 1;
+
+  tidy:
+  if(column_exprs) {
+    for(i = 0; i < triples_count; i++) {
+      if(column_exprs[i])
+        rasqal_free_expression(column_exprs[i]);
+    }
+    RASQAL_FREE(rasqal_expression**, column_exprs);
+  }
+  if(remaining)
+    rasqal_free_expression(remaining);
+  raptor_free_sequence(conjuncts);
+
+  return 0;
+}
+
+
 static raptor_sequence*
 rasqal_algebra_get_variables_mentioned_in(rasqal_query* query,
                                           int row_index)
@@ -2013,6 +2307,19 @@ rasqal_algebra_query_to_algebra(rasqal_query* query)
   fputs("\n", stderr);
 #endif
 
+  modified = 0;
+  rasqal_algebra_node_visit(query, node,
+                            rasqal_algebra_push_down_filters,
+                            &modified);
+
+#if defined(RASQAL_DEBUG) && RASQAL_DEBUG > 1
+  if(modified) {
+    RASQAL_DEBUG1("modified after filter push down, algebra node now:\n  ");
+    rasqal_algebra_node_print(node, stderr);
+    fputs("\n", stderr);
+  }
+#endif
+
 
   return node;
 }
@@ -2798,6 +3105,25 @@ main(int argc, char *argv[]) {
   fputc('\n', stderr);
 
 
+  /* The FILTER only uses $value which is bound by the only triple
+   * pattern so it is moved into the BGP */
+  node1 = rasqal_algebra_query_to_algebra(query);
+  if(!node1) {
+    fprintf(stderr, "%s: rasqal_algebra_query_to_algebra() failed\n", program);
+    FAIL;
+  }
+
+  fprintf(stderr, "%s: query algebra result: \n", program);
+  rasqal_algebra_node_print(node1, stderr);
+  fputc('\n', stderr);
+
+  if(node1->op != RASQAL_ALGEBRA_OPERATOR_BGP ||
+     !node1->column_exprs || !node1->column_exprs[0]) {
+    fprintf(stderr, "%s: FILTER was not moved into the BGP\n", program);
+    FAIL;
+  }
+
+
   tidy:
   if(lit1)
     rasqal_free_literal(lit1);
@@ -35,6 +35,10 @@
 #include <stdlib.h>
 #endif
 #include <stdarg.h>
+/* for INT_MAX */
+#ifdef HAVE_LIMITS_H
+#include <limits.h>
+#endif
 
 #include "rasqal.h"
 #include "rasqal_internal.h"
@@ -47,7 +51,7 @@ typedef struct {
   rasqal_query* query;
   rasqal_query_results* query_results;
 
-  /* query algebra representation of query */
+  /* query algebra representation of query; owned by the query */
   rasqal_algebra_node* algebra_node;
 
   /* number of nodes in #algebra_node tree */
@@ -57,12 +61,96 @@ typedef struct {
   rasqal_rowsource* rowsource;
 
   rasqal_triples_source* triples_source;
+
+  /* sequence of #rasqal_engine_service_prefetch for SERVICE requests
+   * started at execution init (or NULL) */
+  raptor_sequence* services;
 } rasqal_engine_algebra_data;
 
 
+/* a SERVICE node and its service object with the request running */
+typedef struct {
+  rasqal_algebra_node* node;
+  rasqal_service* svc;
+} rasqal_engine_service_prefetch;
+
+
+static void
+rasqal_free_engine_service_prefetch(rasqal_engine_service_prefetch* prefetch)
+{
+  /* cancels the request if the service was not used */
+  if(prefetch->svc)
+    rasqal_free_service(prefetch->svc);
+
+  RASQAL_FREE(rasqal_engine_service_prefetch, prefetch);
+}
+
+
 static rasqal_rowsource* rasqal_algebra_node_to_rowsource(rasqal_engine_algebra_data* execution_data, rasqal_algebra_node* node, rasqal_engine_error *error_p);
 
 
+/*
+ * rasqal_engine_algebra_start_service:
+ * @query: query
+ * @node: algebra node
+ * @data: execution data
+ *
+ * INTERNAL - Start the request of a SERVICE node in the background
+ *
+ * A SERVICE request only depends on its query string so every one in
+ * the algebra can be started before any rows are read.  At most the
+ * world service prefetch size requests are started per execution;
+ * the rest are made when their rowsource is created, as when
+ * prefetching is disabled.
+ *
+ * Return value: 0 to continue the visit
+ */
+static int
+rasqal_engine_algebra_start_service(rasqal_query* query,
+                                    rasqal_algebra_node* node,
+                                    void* data)
+{
+  rasqal_engine_algebra_data* execution_data;
+  rasqal_engine_service_prefetch* prefetch;
+  rasqal_service* svc;
+
+  execution_data = (rasqal_engine_algebra_data*)data;
+
+  if(node->op != RASQAL_ALGEBRA_OPERATOR_SERVICE || !node->query_string)
+    return 0;
+
+  if(raptor_sequence_size(execution_data->services) >=
+     query->world->service_prefetch_size)
+    return 1;
+
+  svc = rasqal_new_service(query->world, node->service_uri,
+                           node->query_string, node->data_graphs);
+  if(!svc)
+    return 0;
+
+  if(rasqal_service_start(svc)) {
+    rasqal_free_service(svc);
+    return 0;
+  }
+
+  prefetch = RASQAL_CALLOC(rasqal_engine_service_prefetch*, 1,
+                           sizeof(*prefetch));
+  if(!prefetch) {
+    rasqal_free_service(svc);
+    return 1;
+  }
+
+  prefetch->node = node;
+  prefetch->svc = svc;
+
+  /* after this, prefetch is owned by services */
+  if(raptor_sequence_push(execution_data->services, prefetch))
+    return 1;
+
+  return 0;
+}
+
+
 static int
 rasqal_engine_algebra_count_nodes(rasqal_query* query,
                                   rasqal_algebra_node* node,
@@ -85,7 +173,8 @@ rasqal_algebra_basic_algebra_node_to_rowsource(rasqal_engine_algebra_data* execu
   return rasqal_new_triples_rowsource(query->world, query,
                                       execution_data->triples_source,
                                       node->triples,
-                                      node->start_column, node->end_column);
+                                      node->start_column, node->end_column,
+                                      node->column_exprs);
 }
 
 
@@ -114,10 +203,23 @@ rasqal_algebra_filter_algebra_node_to_rowsource(rasqal_engine_algebra_data* exec
 }
 
 
+/*
+ * rasqal_algebra_orderby_algebra_node_to_rowsource_limit:
+ * @execution_data: execution data
+ * @node: ORDERBY algebra node
+ * @limit: number of rows needed from the start of the order or < 0 for all
+ * @error_p: pointer to store error
+ *
+ * INTERNAL - Create a sort rowsource for an ORDERBY node when only the
+ * first @limit rows of the order are going to be used.
+ *
+ * Return value: rowsource or NULL on failure
+ */
 static rasqal_rowsource*
-rasqal_algebra_orderby_algebra_node_to_rowsource(rasqal_engine_algebra_data* execution_data,
-                                                 rasqal_algebra_node* node,
-                                                 rasqal_engine_error *error_p)
+rasqal_algebra_orderby_algebra_node_to_rowsource_limit(rasqal_engine_algebra_data* execution_data,
+                                                       rasqal_algebra_node* node,
+                                                       int limit,
+                                                       rasqal_engine_error *error_p)
 {
   rasqal_query *query = execution_data->query;
   rasqal_rowsource *rs;
@@ -127,7 +229,43 @@ rasqal_algebra_orderby_algebra_node_to_rowsource(rasqal_engine_algebra_data* exe
     return NULL;
 
   return rasqal_new_sort_rowsource(query->world, query, rs,
-                                   node->seq, node->distinct);
+                                   node->seq, node->distinct, limit);
+}
+
+
+static rasqal_rowsource*
+rasqal_algebra_orderby_algebra_node_to_rowsource(rasqal_engine_algebra_data* execution_data,
+                                                 rasqal_algebra_node* node,
+                                                 rasqal_engine_error *error_p)
+{
+  return rasqal_algebra_orderby_algebra_node_to_rowsource_limit(execution_data,
+                                                                node, -1,
+                                                                error_p);
+}
+
+
+/*
+ * rasqal_algebra_slice_rows_limit:
+ * @limit: slice limit or < 0 for none
+ * @offset: slice offset or <= 0 for none
+ *
+ * INTERNAL - Get the number of rows a slice reads from its input
+ *
+ * Return value: number of rows or < 0 if all rows may be needed
+ */
+static int
+rasqal_algebra_slice_rows_limit(int limit, int offset)
+{
+  if(limit < 0)
+    return -1;
+
+  if(offset > 0) {
+    if(limit > INT_MAX - offset)
+      return -1;
+    limit += offset;
+  }
+
+  return limit;
 }
 
 
@@ -173,6 +311,137 @@ rasqal_algebra_project_algebra_node_to_rowsource(rasqal_engine_algebra_data* exe
 }
 
 
+/*
+ * rasqal_algebra_visitor_uses_variable:
+ *
+ * INTERNAL - algebra node visitor returning non-0 if the node reads
+ * the value of the variable in @user_data: in a triple pattern
+ * position it does not bind or in an expression.
+ */
+static int
+rasqal_algebra_visitor_uses_variable(rasqal_query* query,
+                                     rasqal_algebra_node* node,
+                                     void *user_data)
+{
+  rasqal_variable *v = (rasqal_variable*)user_data;
+  int i;
+
+  if(node->op == RASQAL_ALGEBRA_OPERATOR_BGP && query->triples_use_map) {
+    int width;
+
+    width = rasqal_variables_table_get_total_variables_count(query->vars_table);
+    for(i = node->start_column; i <= node->end_column; i++) {
+      if(query->triples_use_map[(i * width) + v->offset] &
+         RASQAL_TRIPLES_USE_MASK)
+        return 1;
+    }
+  }
+
+  if(node->expr && rasqal_expression_mentions_variable(node->expr, v))
+    return 1;
+
+  if(node->seq && (node->op == RASQAL_ALGEBRA_OPERATOR_ORDERBY ||
+                   node->op == RASQAL_ALGEBRA_OPERATOR_GROUP ||
+                   node->op == RASQAL_ALGEBRA_OPERATOR_AGGREGATION ||
+                   node->op == RASQAL_ALGEBRA_OPERATOR_HAVING)) {
+    for(i = 0; i < raptor_sequence_size(node->seq); i++) {
+      rasqal_expression* e;
+
+      e = (rasqal_expression*)raptor_sequence_get_at(node->seq, i);
+      if(rasqal_expression_mentions_variable(e, v))
+        return 1;
+    }
+  }
+
+  return 0;
+}
+
+
+/*
+ * rasqal_algebra_node_uses_rowsource_variables:
+ * @query: query
+ * @node: algebra node
+ * @node_rs: rowsource for @node
+ * @other_rs: another rowsource
+ *
+ * INTERNAL - Check if a node reads variables only @other_rs binds
+ *
+ * Such a node is evaluated with the bindings of the current row of
+ * @other_rs, such as the right side of a nested loop join using
+ * variables bound by the left side.
+ *
+ * Return value: non-0 if @node uses a variable bound by @other_rs
+ */
+static int
+rasqal_algebra_node_uses_rowsource_variables(rasqal_query* query,
+                                             rasqal_algebra_node* node,
+                                             rasqal_rowsource* node_rs,
+                                             rasqal_rowsource* other_rs)
+{
+  int size = rasqal_rowsource_get_size(other_rs);
+  int i;
+
+  for(i = 0; i < size; i++) {
+    rasqal_variable* v;
+
+    v = rasqal_rowsource_get_variable_by_offset(other_rs, i);
+    if(rasqal_rowsource_get_variable_offset_by_name(node_rs, v->name) >= 0)
+      continue;
+
+    if(rasqal_algebra_node_visit(query, node,
+                                 rasqal_algebra_visitor_uses_variable, v))
+      return 1;
+  }
+
+  return 0;
+}
+
+
+/*
+ * rasqal_algebra_join_can_hash:
+ * @query: query
+ * @node: JOIN algebra node
+ * @left_rs: rowsource for left node
+ * @right_rs: rowsource for right node
+ *
+ * INTERNAL - Check if a join can be executed as a hash join
+ *
+ * The inputs must share at least one variable to hash on and each
+ * must be evaluated independently of the other's bindings since a
+ * hash join reads each input once.
+ *
+ * Return value: non-0 if a hash join can be used
+ */
+static int
+rasqal_algebra_join_can_hash(rasqal_query* query,
+                             rasqal_algebra_node* node,
+                             rasqal_rowsource* left_rs,
+                             rasqal_rowsource* right_rs)
+{
+  int size = rasqal_rowsource_get_size(left_rs);
+  int shared = 0;
+  int i;
+
+  for(i = 0; i < size; i++) {
+    rasqal_variable* v = rasqal_rowsource_get_variable_by_offset(left_rs, i);
+
+    if(rasqal_rowsource_get_variable_offset_by_name(right_rs, v->name) >= 0)
+      shared++;
+  }
+
+  if(!shared)
+    return 0;
+
+  if(rasqal_algebra_node_uses_rowsource_variables(query, node->node2,
+                                                  right_rs, left_rs) ||
+     rasqal_algebra_node_uses_rowsource_variables(query, node->node1,
+                                                  left_rs, right_rs))
+    return 0;
+
+  return 1;
+}
+
+
 static rasqal_rowsource*
 rasqal_algebra_leftjoin_algebra_node_to_rowsource(rasqal_engine_algebra_data* execution_data,
                                                   rasqal_algebra_node* node,
@@ -194,6 +463,11 @@ rasqal_algebra_leftjoin_algebra_node_to_rowsource(rasqal_engine_algebra_data* ex
     return NULL;
   }
 
+  if(rasqal_algebra_join_can_hash(query, node, left_rs, right_rs)) {
+    RASQAL_DEBUG1("using hash left join\n");
+    return rasqal_new_hashjoin_rowsource(query->world, query, left_rs, right_rs, RASQAL_JOIN_TYPE_LEFT, node->expr);
+  }
+
   return rasqal_new_join_rowsource(query->world, query, left_rs, right_rs, RASQAL_JOIN_TYPE_LEFT, node->expr);
 }
 
@@ -219,10 +493,50 @@ rasqal_algebra_join_algebra_node_to_rowsource(rasqal_engine_algebra_data* execut
     return NULL;
   }
 
+  if(rasqal_algebra_join_can_hash(query, node, left_rs, right_rs)) {
+    RASQAL_DEBUG1("using hash join\n");
+    return rasqal_new_hashjoin_rowsource(query->world, query, left_rs, right_rs, RASQAL_JOIN_TYPE_NATURAL, node->expr);
+  }
+
   return rasqal_new_join_rowsource(query->world, query, left_rs, right_rs, RASQAL_JOIN_TYPE_NATURAL, node->expr);
 }
 
 
+static rasqal_rowsource*
+rasqal_algebra_diff_algebra_node_to_rowsource(rasqal_engine_algebra_data* execution_data,
+                                              rasqal_algebra_node* node,
+                                              rasqal_engine_error *error_p)
+{
+  rasqal_query *query = execution_data->query;
+  rasqal_rowsource *left_rs;
+  rasqal_rowsource *right_rs;
+
+  left_rs = rasqal_algebra_node_to_rowsource(execution_data, node->node1,
+                                             error_p);
+  if((error_p && *error_p) || !left_rs)
+    return NULL;
+
+  right_rs = rasqal_algebra_node_to_rowsource(execution_data, node->node2,
+                                              error_p);
+  if((error_p && *error_p) || !right_rs) {
+    rasqal_free_rowsource(left_rs);
+    return NULL;
+  }
+
+  /* The left side may be evaluated with outer bindings of variables
+   * that are not its columns, such as in a nested group; those are
+   * compared per left row by the nested loop minus */
+  if(rasqal_algebra_node_uses_rowsource_variables(query, node->node1,
+                                                  left_rs, right_rs) ||
+     rasqal_algebra_node_uses_rowsource_variables(query, node->node2,
+                                                  right_rs, left_rs))
+    return rasqal_new_join_rowsource(query->world, query, left_rs, right_rs, RASQAL_JOIN_TYPE_MINUS, NULL);
+
+  RASQAL_DEBUG1("using hash minus\n");
+  return rasqal_new_hashjoin_rowsource(query->world, query, left_rs, right_rs, RASQAL_JOIN_TYPE_MINUS, NULL);
+}
+
+
 static rasqal_rowsource*
 rasqal_algebra_assignment_algebra_node_to_rowsource(rasqal_engine_algebra_data* execution_data,
                                                     rasqal_algebra_node* node,
@@ -397,6 +711,23 @@ rasqal_algebra_aggregation_algebra_node_to_rowsource(rasqal_engine_algebra_data*
   rasqal_query *query = execution_data->query;
   rasqal_rowsource *rs;
 
+  /* Group and aggregate in one pass when the aggregates do not need
+   * the rows of a group all at once */
+  if(node->node1->op == RASQAL_ALGEBRA_OPERATOR_GROUP &&
+     rasqal_aggregation_expressions_can_stream(node->seq)) {
+    rasqal_algebra_node* group_node = node->node1;
+
+    rs = rasqal_algebra_node_to_rowsource(execution_data, group_node->node1,
+                                          error_p);
+    if((error_p && *error_p) || !rs)
+      return NULL;
+
+    return rasqal_new_streaming_aggregation_rowsource(query->world, query, rs,
+                                                      group_node->seq,
+                                                      node->seq,
+                                                      node->vars_seq);
+  }
+
   rs = rasqal_algebra_node_to_rowsource(execution_data, node->node1, error_p);
   if((error_p && *error_p) || !rs)
     return NULL;
@@ -430,8 +761,17 @@ rasqal_algebra_slice_algebra_node_to_rowsource(rasqal_engine_algebra_data* execu
 {
   rasqal_query *query = execution_data->query;
   rasqal_rowsource *rs;
-
-  rs = rasqal_algebra_node_to_rowsource(execution_data, node->node1, error_p);
+  rasqal_algebra_node *node1 = node->node1;
+  int limit;
+
+  limit = rasqal_algebra_slice_rows_limit(node->limit, node->offset);
+  if(node1->op == RASQAL_ALGEBRA_OPERATOR_ORDERBY && limit >= 0) {
+    /* only the first rows of the order are used so sort keeping those */
+    rs = rasqal_algebra_orderby_algebra_node_to_rowsource_limit(execution_data,
+                                                                node1, limit,
+                                                                error_p);
+  } else
+    rs = rasqal_algebra_node_to_rowsource(execution_data, node1, error_p);
   if((error_p && *error_p) || !rs)
     return NULL;
 
@@ -457,6 +797,22 @@ rasqal_algebra_service_algebra_node_to_rowsource(rasqal_engine_algebra_data* exe
 {
   rasqal_query *query = execution_data->query;
   unsigned int flags = (node->flags & RASQAL_ENGINE_BITFLAG_SILENT);
+  rasqal_engine_service_prefetch* prefetch;
+  int i;
+
+  /* use the request started at execution init */
+  for(i = 0;
+      execution_data->services &&
+        (prefetch = (rasqal_engine_service_prefetch*)raptor_sequence_get_at(execution_data->services, i));
+      i++) {
+    if(prefetch->node == node && prefetch->svc) {
+      rasqal_service* svc = prefetch->svc;
+
+      prefetch->svc = NULL;
+      return rasqal_new_service_rowsource_from_service(query->world, query,
+                                                       svc, flags);
+    }
+  }
 
   return rasqal_new_service_rowsource(query->world, query,
                                       node->service_uri,
@@ -554,8 +910,12 @@ rasqal_algebra_node_to_rowsource(rasqal_engine_algebra_data* execution_data,
                                                             node, error_p);
       break;
 
-    case RASQAL_ALGEBRA_OPERATOR_UNKNOWN:
     case RASQAL_ALGEBRA_OPERATOR_DIFF:
+      rs = rasqal_algebra_diff_algebra_node_to_rowsource(execution_data,
+                                                         node, error_p);
+      break;
+
+    case RASQAL_ALGEBRA_OPERATOR_UNKNOWN:
     case RASQAL_ALGEBRA_OPERATOR_TOLIST:
     case RASQAL_ALGEBRA_OPERATOR_REDUCED:
     default:
@@ -573,6 +933,218 @@ rasqal_algebra_node_to_rowsource(rasqal_engine_algebra_data* execution_data,
 
 
 
+/* Columns of the EXPLAIN result rows */
+static const char* const rasqal_engine_algebra_explain_columns[] = {
+  "id", "parent", "operator", "rows_in", "rows_out", "resets", "time"
+};
+
+#define RASQAL_ENGINE_EXPLAIN_COLUMNS_COUNT 7
+
+typedef struct {
+  rasqal_world* world;
+
+  /* sequence of explain rows in rowsource tree pre-order */
+  raptor_sequence* rows;
+
+  /* non-0 if the counters and timings are to be returned */
+  int analyze;
+} rasqal_engine_algebra_explain_data;
+
+
+static int
+rasqal_engine_algebra_explain_set_value(rasqal_row* row, int column,
+                                        rasqal_literal* l)
+{
+  if(!l)
+    return 1;
+
+  rasqal_row_set_value_at(row, column, l);
+  /* free our copy of literal, rasqal_row has a reference */
+  rasqal_free_literal(l);
+
+  return 0;
+}
+
+
+/*
+ * rasqal_engine_algebra_explain_operator:
+ * @user_data: explain data
+ * @profile: rowsource counters
+ *
+ * INTERNAL - Add an explain row for a rowsource in the query plan
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_engine_algebra_explain_operator(void* user_data,
+                                       rasqal_operator_profile* profile)
+{
+  rasqal_engine_algebra_explain_data* ed;
+  rasqal_world* world;
+  rasqal_row* row;
+  size_t name_len;
+  unsigned char* name;
+  int rc = 0;
+
+  ed = (rasqal_engine_algebra_explain_data*)user_data;
+  world = ed->world;
+
+  row = rasqal_new_row_for_size(world, RASQAL_ENGINE_EXPLAIN_COLUMNS_COUNT);
+  if(!row)
+    return 1;
+
+  row->offset = profile->id;
+  /* after this, row is owned by rows */
+  if(raptor_sequence_push(ed->rows, row))
+    return 1;
+
+  name_len = strlen(profile->name);
+  name = RASQAL_MALLOC(unsigned char*, name_len + 1);
+  if(!name)
+    return 1;
+  memcpy(name, profile->name, name_len + 1);
+
+  rc |= rasqal_engine_algebra_explain_set_value(row, 0,
+          rasqal_new_numeric_literal_from_long(world, RASQAL_LITERAL_INTEGER,
+                                               profile->id));
+  if(profile->parent >= 0)
+    rc |= rasqal_engine_algebra_explain_set_value(row, 1,
+            rasqal_new_numeric_literal_from_long(world, RASQAL_LITERAL_INTEGER,
+                                                 profile->parent));
+  rc |= rasqal_engine_algebra_explain_set_value(row, 2,
+          rasqal_new_string_literal_node(world, name, NULL, NULL));
+
+  if(ed->analyze) {
+    rc |= rasqal_engine_algebra_explain_set_value(row, 3,
+            rasqal_new_numeric_literal_from_long(world, RASQAL_LITERAL_INTEGER,
+                                                 profile->rows_in));
+    rc |= rasqal_engine_algebra_explain_set_value(row, 4,
+            rasqal_new_numeric_literal_from_long(world, RASQAL_LITERAL_INTEGER,
+                                                 profile->rows));
+    rc |= rasqal_engine_algebra_explain_set_value(row, 5,
+            rasqal_new_numeric_literal_from_long(world, RASQAL_LITERAL_INTEGER,
+                                                 profile->resets));
+    rc |= rasqal_engine_algebra_explain_set_value(row, 6,
+            rasqal_new_double_literal(world, profile->time));
+  }
+
+  return rc;
+}
+
+
+/*
+ * rasqal_engine_algebra_explain:
+ * @execution_data: execution data with the query plan rowsource
+ * @analyze: non-0 to execute the plan and return counters and timings
+ *
+ * INTERNAL - Replace the result rowsource with a description of the query plan
+ *
+ * Each result row describes one rowsource in the plan with columns
+ * id, parent (unbound for the root), operator (the rowsource name),
+ * and if @analyze is set, rows_in, rows_out, resets and time
+ * (seconds, including inner rowsources) from the rowsource counters;
+ * see rasqal_rowsource_visit_profile().
+ *
+ * When analyzing, the result rows are read and discarded, stopping
+ * after the rows LIMIT and OFFSET would return.
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_engine_algebra_explain(rasqal_engine_algebra_data* execution_data,
+                              int analyze)
+{
+  rasqal_query* query = execution_data->query;
+  rasqal_world* world = query->world;
+  rasqal_engine_algebra_explain_data ed;
+  rasqal_variables_table* vt = NULL;
+  raptor_sequence* vars_seq = NULL;
+  rasqal_rowsource* rs;
+  int i;
+
+  if(analyze) {
+    int limit;
+    int count;
+
+    rasqal_rowsource_set_profile(execution_data->rowsource, 1);
+
+    if(query->verb == RASQAL_QUERY_VERB_ASK)
+      limit = 1;
+    else
+      limit = rasqal_query_get_limit(query);
+    limit = rasqal_algebra_slice_rows_limit(limit,
+                                            rasqal_query_get_offset(query));
+
+    for(count = 0; limit < 0 || count < limit; count++) {
+      rasqal_row* row;
+
+      row = rasqal_rowsource_read_row(execution_data->rowsource);
+      if(!row)
+        break;
+      rasqal_free_row(row);
+    }
+  }
+
+  ed.world = world;
+  ed.analyze = analyze;
+  ed.rows = raptor_new_sequence((raptor_data_free_handler)rasqal_free_row,
+                                (raptor_data_print_handler)rasqal_row_print);
+  if(!ed.rows)
+    return 1;
+
+  if(rasqal_rowsource_visit_profile(execution_data->rowsource,
+                                    rasqal_engine_algebra_explain_operator,
+                                    &ed))
+    goto failed;
+
+  vt = rasqal_new_variables_table(world);
+  if(!vt)
+    goto failed;
+
+  vars_seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_variable,
+                                 (raptor_data_print_handler)rasqal_variable_print);
+  if(!vars_seq)
+    goto failed;
+
+  for(i = 0; i < RASQAL_ENGINE_EXPLAIN_COLUMNS_COUNT; i++) {
+    const char* var_name = rasqal_engine_algebra_explain_columns[i];
+    rasqal_variable* v;
+
+    v = rasqal_variables_table_add2(vt, RASQAL_VARIABLE_TYPE_NORMAL,
+                                    RASQAL_GOOD_CAST(const unsigned char*, var_name),
+                                    strlen(var_name), NULL);
+    if(!v)
+      goto failed;
+
+    raptor_sequence_push(vars_seq, v);
+    /* v is now owned by vars_seq */
+  }
+
+  /* ed.rows and vars_seq become owned by the rowsource */
+  rs = rasqal_new_rowsequence_rowsource(world, query, vt, ed.rows, vars_seq);
+  ed.rows = NULL;
+  vars_seq = NULL;
+  rasqal_free_variables_table(vt);
+  if(!rs)
+    return 1;
+
+  rasqal_free_rowsource(execution_data->rowsource);
+  execution_data->rowsource = rs;
+
+  return 0;
+
+  failed:
+  if(vars_seq)
+    raptor_free_sequence(vars_seq);
+  if(vt)
+    rasqal_free_variables_table(vt);
+  if(ed.rows)
+    raptor_free_sequence(ed.rows);
+
+  return 1;
+}
+
+
 static int
 rasqal_query_engine_algebra_execute_init(void* ex_data,
                                          rasqal_query* query,
@@ -587,6 +1159,7 @@ rasqal_query_engine_algebra_execute_init(void* ex_data,
   rasqal_solution_modifier* modifier;
   rasqal_algebra_node* node;
   rasqal_algebra_aggregate* ae;
+  int limit;
   
   execution_data = (rasqal_engine_algebra_data*)ex_data;
 
@@ -605,6 +1178,25 @@ rasqal_query_engine_algebra_execute_init(void* ex_data,
   projection = rasqal_query_get_projection(query);
   modifier = query->modifier;
 
+  /* Reuse the algebra from an earlier execution of this query.  It
+   * cannot be built again since preparing the aggregates rewrites
+   * the query expressions */
+  if(query->algebra_node) {
+    node = query->algebra_node;
+    goto have_algebra;
+  }
+
+  /* order BGP triple patterns by how many triples the data has for
+   * them.  This must come before the algebra is built since its BGP
+   * nodes and the FILTERs pushed into them refer to the triple
+   * patterns by position; a reused algebra keeps the order it was
+   * built with. */
+  if(rasqal_query_reorder_triple_patterns_by_statistics(query,
+                                                        execution_data->triples_source)) {
+    *error_p = RASQAL_ENGINE_FAILED;
+    return 1;
+  }
+
   node = rasqal_algebra_query_to_algebra(query);
   if(!node)
     return 1;
@@ -647,7 +1239,10 @@ rasqal_query_engine_algebra_execute_init(void* ex_data,
   if(!node)
     return 1;
 
+  /* node is now owned by the query */
+  query->algebra_node = node;
 
+  have_algebra:
   execution_data->algebra_node = node;
 
   /* count final number of nodes */
@@ -665,10 +1260,35 @@ rasqal_query_engine_algebra_execute_init(void* ex_data,
 #endif
   RASQAL_DEBUG2("algebra nodes: %d\n", execution_data->nodes_count);
 
+  /* start SERVICE requests so they run at the same time; a plan is
+   * returned without running the query so none are needed
+   */
+  if(query->world->service_prefetch_size > 0 &&
+     query->explain != RASQAL_QUERY_EXPLAIN_PLAN &&
+     !execution_data->services) {
+    execution_data->services = raptor_new_sequence((raptor_data_free_handler)rasqal_free_engine_service_prefetch, NULL);
+    if(execution_data->services)
+      rasqal_algebra_node_visit(query, execution_data->algebra_node,
+                                rasqal_engine_algebra_start_service,
+                                execution_data);
+  }
+
   error = RASQAL_ENGINE_OK;
-  execution_data->rowsource = rasqal_algebra_node_to_rowsource(execution_data,
-                                                               node,
-                                                               &error);
+  limit = -1;
+  if(query->verb == RASQAL_QUERY_VERB_SELECT &&
+     node->op == RASQAL_ALGEBRA_OPERATOR_ORDERBY)
+    /* the query results apply LIMIT and OFFSET to the sorted rows */
+    limit = rasqal_algebra_slice_rows_limit(rasqal_query_get_limit(query),
+                                            rasqal_query_get_offset(query));
+  if(limit >= 0)
+    execution_data->rowsource = rasqal_algebra_orderby_algebra_node_to_rowsource_limit(execution_data,
+                                                                                       node,
+                                                                                       limit,
+                                                                                       &error);
+  else
+    execution_data->rowsource = rasqal_algebra_node_to_rowsource(execution_data,
+                                                                 node,
+                                                                 &error);
 #ifdef RASQAL_DEBUG
   RASQAL_DEBUG1("rowsource (query plan) result: \n");
   if(execution_data->rowsource)
@@ -679,6 +1299,17 @@ rasqal_query_engine_algebra_execute_init(void* ex_data,
 #endif
   if(error != RASQAL_ENGINE_OK)
     rc = 1;
+
+  if(!rc && query->features[RASQAL_GOOD_CAST(int, RASQAL_FEATURE_PROFILE)])
+    rasqal_rowsource_set_profile(execution_data->rowsource, 1);
+
+  if(!rc && query->explain) {
+    if(rasqal_engine_algebra_explain(execution_data,
+                                     (query->explain == RASQAL_QUERY_EXPLAIN_ANALYZE))) {
+      *error_p = RASQAL_ENGINE_FAILED;
+      rc = 1;
+    }
+  }
   
   return rc;
 }
@@ -733,8 +1364,7 @@ rasqal_query_engine_algebra_execute_finish(void* ex_data,
   execution_data = (rasqal_engine_algebra_data*)ex_data;
 
   if(execution_data) {
-    if(execution_data->algebra_node)
-      rasqal_free_algebra_node(execution_data->algebra_node);
+    /* execution_data->algebra_node is owned by the query */
 
     if(execution_data->triples_source) {
       rasqal_free_triples_source(execution_data->triples_source);
@@ -743,12 +1373,28 @@ rasqal_query_engine_algebra_execute_finish(void* ex_data,
 
     if(execution_data->rowsource)
       rasqal_free_rowsource(execution_data->rowsource);
+
+    if(execution_data->services) {
+      raptor_free_sequence(execution_data->services);
+      execution_data->services = NULL;
+    }
   }
 
   return 0;
 }
 
 
+static rasqal_rowsource*
+rasqal_query_engine_algebra_get_rowsource(void* ex_data)
+{
+  rasqal_engine_algebra_data* execution_data;
+
+  execution_data = (rasqal_engine_algebra_data*)ex_data;
+
+  return execution_data->rowsource;
+}
+
+
 static void
 rasqal_query_engine_algebra_finish_factory(rasqal_query_execution_factory* factory)
 {
@@ -764,5 +1410,6 @@ const rasqal_query_execution_factory rasqal_query_engine_algebra =
   /* .get_all_rows=        */ rasqal_query_engine_algebra_get_all_rows,
   /* .get_row=             */ rasqal_query_engine_algebra_get_row,
   /* .execute_finish=      */ rasqal_query_engine_algebra_execute_finish,
-  /* .finish_factory=      */ rasqal_query_engine_algebra_finish_factory
+  /* .finish_factory=      */ rasqal_query_engine_algebra_finish_factory,
+  /* .get_rowsource=       */ rasqal_query_engine_algebra_get_rowsource
 };
@@ -36,11 +36,14 @@
 #include <stdlib.h>
 #endif
 #include <stdarg.h>
+#include <ctype.h>
 
 #include "rasqal.h"
 #include "rasqal_internal.h"
 
 
+#ifndef STANDALONE
+
 #define DEBUG_FH stderr
 
 
@@ -61,6 +64,376 @@ rasqal_engine_rowsort_free_compare_data(const void* user_data)
 }
 
 
+/*
+ * rasqal_engine_rowsort_compare_values:
+ * @row_a: first row
+ * @row_b: second row
+ *
+ * INTERNAL - compare the values of two rows as RDF terms
+ *
+ * Unbound values order first.  Used to order a distinct map so that
+ * duplicate rows compare equal wherever they are in the map: values
+ * compare equal exactly when rasqal_literal_array_equals() finds
+ * them equal, so no value promotion is done.  Values that are not RDF
+ * terms or cannot be compared are never equal and order by address.
+ *
+ * Return value: <0, 0 or >1 comparison
+ */
+static int
+rasqal_engine_rowsort_compare_values(rasqal_row* row_a, rasqal_row* row_b)
+{
+  int i;
+
+  for(i = 0; i < row_a->size; i++) {
+    rasqal_literal* literal_a = row_a->values[i];
+    rasqal_literal* literal_b = row_b->values[i];
+    int result;
+    int error = 0;
+
+    if(!literal_a || !literal_b) {
+      if(literal_a || literal_b)
+        return (!literal_a) ? -1 : 1;
+      continue;
+    }
+
+    if(literal_a == literal_b)
+      continue;
+
+    if(rasqal_literal_get_rdf_term_type(literal_a) != RASQAL_LITERAL_UNKNOWN &&
+       rasqal_literal_get_rdf_term_type(literal_b) != RASQAL_LITERAL_UNKNOWN) {
+      result = rasqal_literal_compare(literal_a, literal_b,
+                                      RASQAL_COMPARE_RDF | RASQAL_COMPARE_URI,
+                                      &error);
+      if(!error) {
+        if(result)
+          return result;
+        continue;
+      }
+    }
+
+    return (literal_a < literal_b) ? -1 : 1;
+  }
+
+  return 0;
+}
+
+
+/*
+ * Integers compare by subtraction so only values no further than this
+ * from 0 have keys; the difference of two of them cannot overflow.
+ */
+#define RASQAL_ORDER_KEY_INTEGER_MAX 0x3fffffff
+
+
+/*
+ * rasqal_engine_rowsort_keys_enabled:
+ * @compare_flags: comparison flags
+ *
+ * INTERNAL - check the sort keys agree with comparisons using @compare_flags
+ *
+ * Keys follow the SPARQL / XQuery same-type orderings, which are
+ * case sensitive.
+ *
+ * Return value: non-0 if sort keys can be used
+ */
+static int
+rasqal_engine_rowsort_keys_enabled(int compare_flags)
+{
+  return (compare_flags & RASQAL_COMPARE_XQUERY) &&
+         !(compare_flags & (RASQAL_COMPARE_RDF | RASQAL_COMPARE_NOCASE));
+}
+
+
+/*
+ * rasqal_engine_rowsort_literal_key:
+ * @l: literal value
+ * @buffer: buffer to write the key into (or NULL to size it)
+ *
+ * INTERNAL - make the binary-comparable sort key for a literal
+ *
+ * Numbers are written big-endian with the sign flipped so that they
+ * order as unsigned bytes.  Strings are terminated by a 0 byte, which
+ * they cannot contain, so that a prefix orders before longer strings
+ * as with strcmp().  Plain literals add their language tag in lower
+ * case after the string, with no language ordering first.
+ *
+ * Return value: key length or 0 if the literal has no key
+ */
+static size_t
+rasqal_engine_rowsort_literal_key(rasqal_literal* l, unsigned char* buffer)
+{
+  const unsigned char* string;
+  size_t len;
+  size_t lang_len = 0;
+  size_t i;
+
+  switch(l->type) {
+    case RASQAL_LITERAL_INTEGER:
+    case RASQAL_LITERAL_BOOLEAN:
+      if(l->value.integer < -RASQAL_ORDER_KEY_INTEGER_MAX ||
+         l->value.integer > RASQAL_ORDER_KEY_INTEGER_MAX)
+        return 0;
+
+      if(buffer) {
+        uint32_t u = RASQAL_GOOD_CAST(uint32_t, l->value.integer) ^ 0x80000000U;
+
+        for(i = 0; i < 4; i++)
+          buffer[i] = RASQAL_GOOD_CAST(unsigned char, u >> (24 - 8 * i));
+      }
+      return 4;
+
+    case RASQAL_LITERAL_DOUBLE:
+    case RASQAL_LITERAL_FLOAT:
+      /* NaN compares equal to everything so has no consistent key */
+      if(l->value.floating != l->value.floating)
+        return 0;
+
+      if(buffer) {
+        /* -0.0 and 0.0 compare equal */
+        double d = (l->value.floating == 0.0) ? 0.0 : l->value.floating;
+        uint64_t u;
+
+        memcpy(&u, &d, sizeof(u));
+        if(u & RASQAL_GOOD_CAST(uint64_t, 1) << 63)
+          u = ~u;
+        else
+          u ^= RASQAL_GOOD_CAST(uint64_t, 1) << 63;
+
+        for(i = 0; i < 8; i++)
+          buffer[i] = RASQAL_GOOD_CAST(unsigned char, u >> (56 - 8 * i));
+      }
+      return 8;
+
+    case RASQAL_LITERAL_STRING:
+      /* datatyped strings also order by datatype URI */
+      if(l->datatype)
+        return 0;
+
+      if(l->language) {
+        /* language tags compare case independently as ASCII */
+        for(i = 0; l->language[i]; i++) {
+          if(RASQAL_GOOD_CAST(unsigned char, l->language[i]) > 0x7f)
+            return 0;
+        }
+        lang_len = i + 1;
+      }
+
+      string = l->string;
+      len = strlen(RASQAL_GOOD_CAST(const char*, string));
+      if(buffer) {
+        memcpy(buffer, string, len);
+        buffer[len] = '\0';
+        if(l->language) {
+          buffer[len + 1] = 1;
+          for(i = 0; i < lang_len; i++)
+            buffer[len + 2 + i] = RASQAL_GOOD_CAST(unsigned char, tolower(RASQAL_GOOD_CAST(unsigned char, l->language[i])));
+        } else
+          buffer[len + 1] = '\0';
+      }
+      return len + 2 + lang_len;
+
+    case RASQAL_LITERAL_URI:
+      string = raptor_uri_as_counted_string(l->value.uri, &len);
+      break;
+
+    case RASQAL_LITERAL_BLANK:
+    case RASQAL_LITERAL_XSD_STRING:
+      string = l->string;
+      len = strlen(RASQAL_GOOD_CAST(const char*, string));
+      break;
+
+    case RASQAL_LITERAL_UNKNOWN:
+    case RASQAL_LITERAL_PATTERN:
+    case RASQAL_LITERAL_QNAME:
+    case RASQAL_LITERAL_DECIMAL:
+    case RASQAL_LITERAL_DATE:
+    case RASQAL_LITERAL_DATETIME:
+    case RASQAL_LITERAL_UDT:
+    case RASQAL_LITERAL_VARIABLE:
+    case RASQAL_LITERAL_INTEGER_SUBTYPE:
+    default:
+      return 0;
+  }
+
+  if(buffer) {
+    memcpy(buffer, string, len);
+    buffer[len] = '\0';
+  }
+  return len + 1;
+}
+
+
+/**
+ * rasqal_engine_rowsort_calculate_order_keys:
+ * @row: row with order values calculated
+ * @compare_flags: comparison flags the rows will be sorted with
+ *
+ * INTERNAL - Calculate the binary-comparable sort keys of a row's order values
+ *
+ * Replaces any existing keys.  Nothing is done if the keys cannot be
+ * used with @compare_flags.  The keys and their bytes are stored in
+ * one allocation.
+ *
+ * Return value: non-0 on failure
+ */
+int
+rasqal_engine_rowsort_calculate_order_keys(rasqal_row* row, int compare_flags)
+{
+  rasqal_order_key* keys;
+  unsigned char* buffer;
+  size_t size;
+  int i;
+
+  if(row->order_keys) {
+    RASQAL_FREE(rasqal_order_key*, row->order_keys);
+    row->order_keys = NULL;
+  }
+
+  if(row->order_size <= 0 || !rasqal_engine_rowsort_keys_enabled(compare_flags))
+    return 0;
+
+  size = sizeof(*keys) * RASQAL_GOOD_CAST(size_t, row->order_size);
+  for(i = 0; i < row->order_size; i++) {
+    if(row->order_values[i])
+      size += rasqal_engine_rowsort_literal_key(row->order_values[i], NULL);
+  }
+
+  keys = RASQAL_MALLOC(rasqal_order_key*, size);
+  if(!keys)
+    return 1;
+
+  buffer = RASQAL_GOOD_CAST(unsigned char*, &keys[row->order_size]);
+  for(i = 0; i < row->order_size; i++) {
+    rasqal_literal* l = row->order_values[i];
+    size_t len = 0;
+
+    if(l)
+      len = rasqal_engine_rowsort_literal_key(l, buffer);
+
+    keys[i].type = len ? l->type : RASQAL_LITERAL_UNKNOWN;
+    keys[i].len = len;
+    keys[i].bytes = buffer;
+    buffer += len;
+  }
+
+  row->order_keys = keys;
+
+  return 0;
+}
+
+
+/*
+ * rasqal_engine_rowsort_compare_keys:
+ * @row_a: first row
+ * @row_b: second row
+ * @order_seq: order conditions sequence
+ * @compare_flags: comparison flags
+ *
+ * INTERNAL - compare the order values of two rows using their sort keys
+ *
+ * Gives the same result as rasqal_literal_array_compare().  Order
+ * values that both have keys of the same type are compared with
+ * memcmp(); any others are compared as literals.
+ *
+ * Return value: <0, 0 or >0 comparison
+ */
+static int
+rasqal_engine_rowsort_compare_keys(rasqal_row* row_a, rasqal_row* row_b,
+                                   raptor_sequence* order_seq,
+                                   int compare_flags)
+{
+  int result = 0;
+  int i;
+
+  for(i = 0; i < row_a->order_size; i++) {
+    rasqal_literal* literal_a = row_a->order_values[i];
+    rasqal_literal* literal_b = row_b->order_values[i];
+    rasqal_order_key* key_a = &row_a->order_keys[i];
+    rasqal_order_key* key_b = &row_b->order_keys[i];
+    rasqal_expression* e;
+
+    /* NULLs order first */
+    if(!literal_a || !literal_b) {
+      if(literal_a || literal_b)
+        result = (!literal_a) ? -1 : 1;
+      break;
+    }
+
+    if(key_a->type != RASQAL_LITERAL_UNKNOWN && key_a->type == key_b->type) {
+      size_t len = (key_a->len < key_b->len) ? key_a->len : key_b->len;
+
+      result = memcmp(key_a->bytes, key_b->bytes, len);
+      if(!result && key_a->len != key_b->len)
+        result = (key_a->len < key_b->len) ? -1 : 1;
+    } else {
+      int error = 0;
+
+      result = rasqal_literal_compare(literal_a, literal_b,
+                                      compare_flags | RASQAL_COMPARE_URI,
+                                      &error);
+      if(error) {
+        result = 0;
+        break;
+      }
+    }
+
+    if(!result)
+      continue;
+
+    e = (rasqal_expression*)raptor_sequence_get_at(order_seq, i);
+    if(e && e->op == RASQAL_EXPR_ORDER_COND_DESC)
+      result = -result;
+    break;
+  }
+
+  return result;
+}
+
+
+/**
+ * rasqal_engine_rowsort_compare_rows:
+ * @row_a: first row
+ * @row_b: second row
+ * @order_seq: order conditions sequence (or NULL)
+ * @compare_flags: comparison flags
+ *
+ * INTERNAL - compare two rows by their order values then by offset
+ *
+ * The order values must have been calculated with
+ * rasqal_engine_rowsort_calculate_order_values().  Rows with equal
+ * order values are ordered by row offset so that the sort is stable.
+ *
+ * Return value: <0, 0 or >1 comparison
+ */
+int
+rasqal_engine_rowsort_compare_rows(rasqal_row* row_a, rasqal_row* row_b,
+                                   raptor_sequence* order_seq,
+                                   int compare_flags)
+{
+  int result = 0;
+
+  if(order_seq && row_a->order_keys && row_b->order_keys &&
+     rasqal_engine_rowsort_keys_enabled(compare_flags))
+    result = rasqal_engine_rowsort_compare_keys(row_a, row_b, order_seq,
+                                                compare_flags);
+  else if(order_seq)
+    result = rasqal_literal_array_compare(row_a->order_values,
+                                          row_b->order_values,
+                                          order_seq,
+                                          row_a->order_size,
+                                          compare_flags);
+
+  /* still equal?  make sort stable by using the original order */
+  if(!result) {
+    result = row_a->offset - row_b->offset;
+    RASQAL_DEBUG2("Got equality result so using offsets, returning %d\n",
+                  result);
+  }
+  
+  return result;
+}
+
+
 /**
  * rasqal_engine_rowsort_row_compare:
  * @user_data: comparison user data pointer
@@ -79,37 +452,458 @@ rasqal_engine_rowsort_row_compare(void* user_data, const void *a, const void *b)
   rasqal_row* row_a;
   rasqal_row* row_b;
   rowsort_compare_data* rcd;
-  int result = 0;
+  int result;
   rcd = (rowsort_compare_data*)user_data;
   row_a = (rasqal_row*)a;
   row_b = (rasqal_row*)b;
 
   if(rcd->is_distinct) {
-    result = !rasqal_literal_array_equals(row_a->values, row_b->values,
-                                          row_a->size);
-    
-    if(!result)
+    /* order by the row values first so that duplicates are found */
+    result = rasqal_engine_rowsort_compare_values(row_a, row_b);
+    if(result)
+      return result;
+
+    if(rasqal_literal_array_equals(row_a->values, row_b->values,
+                                   row_a->size))
       /* duplicate, so return that */
       return 0;
   }
   
   /* now order it */
-  if(rcd->order_conditions_sequence)
-    result = rasqal_literal_array_compare(row_a->order_values,
-                                          row_b->order_values,
+  return rasqal_engine_rowsort_compare_rows(row_a, row_b,
+                                            rcd->order_conditions_sequence,
+                                            rcd->compare_flags);
+}
+
+
+static int
+rasqal_engine_rowsort_row_compare_arg(const void *a, const void *b, void *arg)
+{
+  rasqal_row* row_a = *(rasqal_row**)a;
+  rasqal_row* row_b = *(rasqal_row**)b;
+  rowsort_compare_data* rcd = (rowsort_compare_data*)arg;
+
+  return rasqal_engine_rowsort_compare_rows(row_a, row_b,
+                                            rcd->order_conditions_sequence,
+                                            rcd->compare_flags);
+}
+
+
+#if RAPTOR_VERSION >= 20015
+/* The parallel sort sorts each part with raptor_sort_r() */
+
+/* fewest rows per thread worth sorting in parallel */
+#define RASQAL_PARALLEL_SORT_MIN_ROWS 4096
+
+
+/*
+ * A parallel sort task either sorts rows[start..end) in place or
+ * merges the sorted a[0..a_len) and b[0..b_len) into dest.
+ */
+typedef struct
+{
+  rowsort_compare_data* rcd;
+
+  rasqal_row** rows;
+  int start;
+  int end;
+
+  rasqal_row** a;
+  int a_len;
+  rasqal_row** b;
+  int b_len;
+  rasqal_row** dest;
+} rowsort_task;
+
+
+static void
+rasqal_engine_rowsort_sort_task(void* data)
+{
+  rowsort_task* task = (rowsort_task*)data;
+
+  raptor_sort_r(&task->rows[task->start],
+                RASQAL_GOOD_CAST(size_t, task->end - task->start),
+                sizeof(rasqal_row*),
+                rasqal_engine_rowsort_row_compare_arg, task->rcd);
+}
+
+
+static void
+rasqal_engine_rowsort_merge_task(void* data)
+{
+  rowsort_task* task = (rowsort_task*)data;
+  rowsort_compare_data* rcd = task->rcd;
+  rasqal_row** dest = task->dest;
+  int i = 0;
+  int j = 0;
+
+  while(i < task->a_len && j < task->b_len) {
+    if(rasqal_engine_rowsort_compare_rows(task->a[i], task->b[j],
                                           rcd->order_conditions_sequence,
-                                          row_a->order_size,
-                                          rcd->compare_flags);
+                                          rcd->compare_flags) <= 0)
+      *dest++ = task->a[i++];
+    else
+      *dest++ = task->b[j++];
+  }
 
+  while(i < task->a_len)
+    *dest++ = task->a[i++];
+  while(j < task->b_len)
+    *dest++ = task->b[j++];
+}
 
-  /* still equal?  make sort stable by using the original order */
-  if(!result) {
-    result = row_a->offset - row_b->offset;
-    RASQAL_DEBUG2("Got equality result so using offsets, returning %d\n",
-                  result);
+
+/*
+ * rasqal_engine_rowsort_merge_split:
+ * @a: first sorted rows
+ * @a_len: number of rows in @a
+ * @b: second sorted rows
+ * @b_len: number of rows in @b
+ * @count: number of merged rows
+ * @rcd: comparison data
+ *
+ * INTERNAL - Find how many of the first @count merged rows come from @a
+ *
+ * A binary search along the merge path, so that a merge can be split
+ * into parts that are merged independently.
+ *
+ * Return value: number of rows from @a
+ */
+static int
+rasqal_engine_rowsort_merge_split(rasqal_row** a, int a_len,
+                                  rasqal_row** b, int b_len,
+                                  int count, rowsort_compare_data* rcd)
+{
+  int low = (count > b_len) ? count - b_len : 0;
+  int high = (count < a_len) ? count : a_len;
+
+  while(low < high) {
+    int mid = low + ((high - low) >> 1);
+
+    if(rasqal_engine_rowsort_compare_rows(a[mid], b[count - mid - 1],
+                                          rcd->order_conditions_sequence,
+                                          rcd->compare_flags) <= 0)
+      low = mid + 1;
+    else
+      high = mid;
   }
-  
-  return result;
+
+  return low;
+}
+
+
+/*
+ * rasqal_engine_rowsort_keys_complete:
+ * @rows: array of rows
+ * @size: number of rows
+ * @compare_flags: comparison flags
+ *
+ * INTERNAL - check all the rows compare by their sort keys alone
+ *
+ * True when for every order condition, all the values that are not
+ * NULL have sort keys of the same type.  Comparing such rows never
+ * compares literals, which changes literal reference counts and may
+ * allocate literals, so it is safe to do in several threads.
+ *
+ * Return value: non-0 if the rows can be sorted in parallel
+ */
+static int
+rasqal_engine_rowsort_keys_complete(rasqal_row** rows, int size,
+                                    int compare_flags)
+{
+  int order_size = rows[0]->order_size;
+  int i;
+  int j;
+
+  if(order_size <= 0)
+    return 1;
+
+  if(!rasqal_engine_rowsort_keys_enabled(compare_flags))
+    return 0;
+
+  for(i = 0; i < order_size; i++) {
+    rasqal_literal_type type = RASQAL_LITERAL_UNKNOWN;
+
+    for(j = 0; j < size; j++) {
+      rasqal_row* row = rows[j];
+      rasqal_literal_type key_type;
+
+      if(!row->order_keys)
+        return 0;
+
+      if(!row->order_values[i])
+        continue;
+
+      key_type = row->order_keys[i].type;
+      if(key_type == RASQAL_LITERAL_UNKNOWN)
+        return 0;
+
+      if(type == RASQAL_LITERAL_UNKNOWN)
+        type = key_type;
+      else if(key_type != type)
+        return 0;
+    }
+  }
+
+  return 1;
+}
+
+
+/*
+ * rasqal_engine_rowsort_parallel_sort:
+ * @world: world
+ * @seq: sequence of #rasqal_row with order values calculated
+ * @rcd: comparison data
+ *
+ * INTERNAL - Sort a sequence of rows with the world thread pool
+ *
+ * The rows are split into one part per thread which are sorted at
+ * the same time, then pairs of sorted parts are merged in rounds
+ * until one remains.  Each round's merges are split along their merge
+ * paths so every thread has a share of the rows to merge.  The
+ * comparison is a total order with the row offsets, so the result is
+ * the same as a single sort.
+ *
+ * Nothing is done if there is no thread pool, the sequence is small
+ * or the rows cannot all be compared by their sort keys.
+ *
+ * Return value: 0 if sorted, >0 if not sorted or <0 on failure
+ */
+static int
+rasqal_engine_rowsort_parallel_sort(rasqal_world* world, raptor_sequence* seq,
+                                    rowsort_compare_data* rcd)
+{
+  int threads = world->thread_pool_size;
+  int size;
+  rasqal_row** rows;
+  rasqal_row** dest;
+  rowsort_task* tasks;
+  void** task_ptrs;
+  int* bounds;
+  int runs;
+  int rc = 0;
+  int i;
+
+  size = raptor_sequence_size(seq);
+  if(!world->thread_pool || threads < 2 ||
+     size < threads * RASQAL_PARALLEL_SORT_MIN_ROWS)
+    return 1;
+
+  rows = RASQAL_MALLOC(rasqal_row**,
+                       RASQAL_GOOD_CAST(size_t, size) * 2 * sizeof(rasqal_row*));
+  tasks = RASQAL_CALLOC(rowsort_task*, RASQAL_GOOD_CAST(size_t, threads),
+                        sizeof(*tasks));
+  task_ptrs = RASQAL_CALLOC(void**, RASQAL_GOOD_CAST(size_t, threads),
+                            sizeof(void*));
+  bounds = RASQAL_CALLOC(int*, RASQAL_GOOD_CAST(size_t, threads + 1),
+                         sizeof(int));
+  if(!rows || !tasks || !task_ptrs || !bounds)
+    goto failed;
+
+  for(i = 0; i < size; i++)
+    rows[i] = (rasqal_row*)raptor_sequence_get_at(seq, i);
+
+  if(!rasqal_engine_rowsort_keys_complete(rows, size, rcd->compare_flags))
+    goto failed;
+
+  /* sort one part per thread */
+  for(i = 0; i < threads; i++) {
+    bounds[i] = RASQAL_GOOD_CAST(int, (RASQAL_GOOD_CAST(long, size) * i) / threads);
+    tasks[i].rcd = rcd;
+    tasks[i].rows = rows;
+    tasks[i].start = bounds[i];
+    tasks[i].end = RASQAL_GOOD_CAST(int, (RASQAL_GOOD_CAST(long, size) * (i + 1)) / threads);
+    task_ptrs[i] = &tasks[i];
+  }
+  bounds[threads] = size;
+  rasqal_thread_pool_run(world, rasqal_engine_rowsort_sort_task, task_ptrs,
+                         threads);
+
+  /* merge pairs of sorted parts, alternating between the two halves
+   * of the rows array
+   */
+  dest = rows + size;
+  for(runs = threads; runs > 1; runs = (runs + 1) >> 1) {
+    int pairs = (runs + 1) >> 1;
+    int parts = threads / pairs;
+    int count = 0;
+    int pair;
+    rasqal_row** swap;
+
+    if(parts < 1)
+      parts = 1;
+
+    for(pair = 0; pair < pairs; pair++) {
+      int a_run = pair << 1;
+      int a_start = bounds[a_run];
+      /* the last run has no pair when the count is odd */
+      int b_start = bounds[(a_run + 1 < runs) ? a_run + 1 : runs];
+      int b_end = bounds[(a_run + 2 < runs) ? a_run + 2 : runs];
+      int a_len = b_start - a_start;
+      int b_len = b_end - b_start;
+      int prev_a = 0;
+      int prev_count = 0;
+      int part;
+
+      for(part = 1; part <= parts; part++) {
+        rowsort_task* task = &tasks[count];
+        int merged = RASQAL_GOOD_CAST(int, (RASQAL_GOOD_CAST(long, a_len + b_len) * part) / parts);
+        int from_a;
+
+        from_a = rasqal_engine_rowsort_merge_split(&rows[a_start], a_len,
+                                                   &rows[b_start], b_len,
+                                                   merged, rcd);
+
+        task->rcd = rcd;
+        task->a = &rows[a_start + prev_a];
+        task->a_len = from_a - prev_a;
+        task->b = &rows[b_start + prev_count - prev_a];
+        task->b_len = (merged - from_a) - (prev_count - prev_a);
+        task->dest = &dest[a_start + prev_count];
+        task_ptrs[count++] = task;
+
+        prev_a = from_a;
+        prev_count = merged;
+      }
+
+      bounds[pair] = a_start;
+    }
+    bounds[pairs] = size;
+
+    rasqal_thread_pool_run(world, rasqal_engine_rowsort_merge_task, task_ptrs,
+                           count);
+
+    swap = rows;
+    rows = dest;
+    dest = swap;
+  }
+
+  /* replace the rows in the sequence in sorted order; unshift does
+   * not free them
+   */
+  while(raptor_sequence_unshift(seq))
+    ;
+  for(i = 0; i < size; i++) {
+    /* a failed push frees the row it was given */
+    if(raptor_sequence_push(seq, rows[i])) {
+      for(i++; i < size; i++)
+        rasqal_free_row(rows[i]);
+      rc = -1;
+      break;
+    }
+  }
+
+  /* free whichever half the array started at */
+  if(dest < rows)
+    rows = dest;
+
+  RASQAL_FREE(rasqal_row**, rows);
+  RASQAL_FREE(rowsort_task*, tasks);
+  RASQAL_FREE(void**, task_ptrs);
+  RASQAL_FREE(int*, bounds);
+
+  return rc;
+
+  failed:
+  if(rows)
+    RASQAL_FREE(rasqal_row**, rows);
+  if(tasks)
+    RASQAL_FREE(rowsort_task*, tasks);
+  if(task_ptrs)
+    RASQAL_FREE(void**, task_ptrs);
+  if(bounds)
+    RASQAL_FREE(int*, bounds);
+
+  return 1;
+}
+#endif /* RAPTOR_VERSION >= 20015 */
+
+
+/**
+ * rasqal_engine_rowsort_sort_sequence:
+ * @world: world
+ * @seq: sequence of #rasqal_row with order values calculated
+ * @order_conditions_sequence: order conditions sequence
+ * @compare_flags: comparison flags
+ *
+ * INTERNAL - Sort a sequence of rows by order conditions
+ *
+ * Rows with equal order values stay in row offset order.  The rows
+ * are sorted in one go so it does not matter if they arrive already
+ * in order.
+ *
+ * Large sequences are sorted in parallel when the world has a thread
+ * pool and raptor has raptor_sort_r() (2.0.15 or later); see
+ * rasqal_world_set_thread_pool_size().
+ *
+ * The @seq may be replaced by a new sequence with the same rows; it
+ * is freed on failure.
+ *
+ * Return value: sorted sequence or NULL on failure
+ */
+raptor_sequence*
+rasqal_engine_rowsort_sort_sequence(rasqal_world* world,
+                                    raptor_sequence* seq,
+                                    raptor_sequence* order_conditions_sequence,
+                                    int compare_flags)
+{
+  rowsort_compare_data rcd;
+  int size;
+#if RAPTOR_VERSION < 20015
+  raptor_sequence* new_seq;
+  void** array;
+  int i;
+#else
+  int rc;
+#endif
+
+  size = raptor_sequence_size(seq);
+  if(size < 2)
+    return seq;
+
+  rcd.is_distinct = 0;
+  rcd.compare_flags = compare_flags;
+  rcd.order_conditions_sequence = order_conditions_sequence;
+
+#if RAPTOR_VERSION < 20015
+  /* no parallel sort without raptor_sort_r() */
+  (void)world;
+
+  array = rasqal_sequence_as_sorted(seq,
+                                    rasqal_engine_rowsort_row_compare_arg,
+                                    &rcd);
+  if(!array) {
+    raptor_free_sequence(seq);
+    return NULL;
+  }
+
+  new_seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_row,
+                                (raptor_data_print_handler)rasqal_row_print);
+  for(i = 0; new_seq && i < size; i++) {
+    rasqal_row* row = rasqal_new_row_from_row(RASQAL_GOOD_CAST(rasqal_row*, array[i]));
+    if(raptor_sequence_push(new_seq, row)) {
+      raptor_free_sequence(new_seq);
+      new_seq = NULL;
+    }
+  }
+
+  RASQAL_FREE(void*, array);
+  raptor_free_sequence(seq);
+  seq = new_seq;
+#else
+  rc = rasqal_engine_rowsort_parallel_sort(world, seq, &rcd);
+  if(rc <= 0) {
+    if(rc < 0) {
+      raptor_free_sequence(seq);
+      seq = NULL;
+    }
+    return seq;
+  }
+
+  raptor_sequence_sort_r(seq, rasqal_engine_rowsort_row_compare_arg, &rcd);
+#endif
+
+  return seq;
 }
 
 
@@ -130,6 +924,10 @@ rasqal_engine_rowsort_map_print_row(void *object, FILE *fh)
  *
  * INTERNAL - create a new map for sorting rows
  *
+ * A distinct map orders rows by their values before the order
+ * conditions, so it is only used for finding duplicates.  Sort
+ * rows with rasqal_engine_rowsort_sort_sequence().
+ *
  */
 rasqal_map*
 rasqal_engine_new_rowsort_map(int is_distinct, int compare_flags,
@@ -213,15 +1011,20 @@ rasqal_engine_rowsort_map_to_sequence(rasqal_map* map, raptor_sequence* seq)
  * rasqal_engine_rowsort_calculate_order_values:
  * @query: query object
  * @order_seq: order conditions sequence
+ * @programs: compiled order conditions array (or NULL)
  * @row: row
  *
  * INTERNAL - Calculate the order condition values for a row
  *
+ * Also calculates the sort keys of the values with
+ * rasqal_engine_rowsort_calculate_order_keys().
+ *
  * Return value: non-0 on failure 
  */
 int
 rasqal_engine_rowsort_calculate_order_values(rasqal_query* query,
                                              raptor_sequence* order_seq,
+                                             rasqal_expression_program** programs,
                                              rasqal_row* row)
 {
   int i;
@@ -234,8 +1037,13 @@ rasqal_engine_rowsort_calculate_order_values(rasqal_query* query,
     rasqal_literal *l;
     int error = 0;
     
-    e = (rasqal_expression*)raptor_sequence_get_at(order_seq, i);
-    l = rasqal_expression_evaluate2(e, query->eval_context, &error);
+    if(programs && programs[i])
+      l = rasqal_expression_program_evaluate(programs[i],
+                                             query->eval_context, &error);
+    else {
+      e = (rasqal_expression*)raptor_sequence_get_at(order_seq, i);
+      l = rasqal_expression_evaluate2(e, query->eval_context, &error);
+    }
 
     if(row->order_values[i])
       rasqal_free_literal(row->order_values[i]);
@@ -248,5 +1056,342 @@ rasqal_engine_rowsort_calculate_order_values(rasqal_query* query,
     }
   }
   
+  /* without keys the rows are compared as literals */
+  rasqal_engine_rowsort_calculate_order_keys(row, query->compare_flags);
+
   return 0;
 }
+
+
+#endif /* not STANDALONE */
+
+
+
+#ifdef STANDALONE
+
+/* one more prototype */
+int main(int argc, char *argv[]);
+
+
+/* ORDER BY values; a NULL lexical form is an unbound value */
+typedef struct {
+  rasqal_literal_type type;
+  const char* lexical;
+  const char* language;
+  /* non-0 if the value has a sort key */
+  int has_key;
+} order_key_data;
+
+static const order_key_data order_key_values[] = {
+  { RASQAL_LITERAL_UNKNOWN,    NULL,                    NULL,    0 },
+  /* integers past +/-(2^30 - 1) have no key; past 2^31 are decimals */
+  { RASQAL_LITERAL_INTEGER,    "-1073741824",           NULL,    0 },
+  { RASQAL_LITERAL_INTEGER,    "-1073741823",           NULL,    1 },
+  { RASQAL_LITERAL_INTEGER,    "-5",                    NULL,    1 },
+  { RASQAL_LITERAL_INTEGER,    "0",                     NULL,    1 },
+  { RASQAL_LITERAL_INTEGER,    "7",                     NULL,    1 },
+  { RASQAL_LITERAL_INTEGER,    "1073741823",            NULL,    1 },
+  { RASQAL_LITERAL_INTEGER,    "1073741824",            NULL,    0 },
+  { RASQAL_LITERAL_INTEGER,    "2147483647",            NULL,    0 },
+  { RASQAL_LITERAL_INTEGER,    "9223372036854775808",   NULL,    0 },
+  { RASQAL_LITERAL_BOOLEAN,    "false",                 NULL,    1 },
+  { RASQAL_LITERAL_BOOLEAN,    "true",                  NULL,    1 },
+  { RASQAL_LITERAL_DOUBLE,     "-INF",                  NULL,    1 },
+  { RASQAL_LITERAL_DOUBLE,     "-1E300",                NULL,    1 },
+  { RASQAL_LITERAL_DOUBLE,     "-1.5",                  NULL,    1 },
+  { RASQAL_LITERAL_DOUBLE,     "-0.0",                  NULL,    1 },
+  { RASQAL_LITERAL_DOUBLE,     "0.0",                   NULL,    1 },
+  { RASQAL_LITERAL_DOUBLE,     "1E-300",                NULL,    1 },
+  { RASQAL_LITERAL_DOUBLE,     "2.5",                   NULL,    1 },
+  { RASQAL_LITERAL_DOUBLE,     "1E300",                 NULL,    1 },
+  { RASQAL_LITERAL_DOUBLE,     "INF",                   NULL,    1 },
+  { RASQAL_LITERAL_DOUBLE,     "NaN",                   NULL,    0 },
+  { RASQAL_LITERAL_FLOAT,      "-2.5",                  NULL,    1 },
+  { RASQAL_LITERAL_FLOAT,      "-0.0",                  NULL,    1 },
+  { RASQAL_LITERAL_FLOAT,      "0.0",                   NULL,    1 },
+  { RASQAL_LITERAL_FLOAT,      "2.5",                   NULL,    1 },
+  { RASQAL_LITERAL_DECIMAL,    "1.5",                   NULL,    0 },
+  { RASQAL_LITERAL_STRING,     "",                      NULL,    1 },
+  { RASQAL_LITERAL_STRING,     "B",                     NULL,    1 },
+  { RASQAL_LITERAL_STRING,     "a",                     NULL,    1 },
+  { RASQAL_LITERAL_STRING,     "a",                     "en",    1 },
+  { RASQAL_LITERAL_STRING,     "a",                     "EN",    1 },
+  { RASQAL_LITERAL_STRING,     "a",                     "en-GB", 1 },
+  { RASQAL_LITERAL_STRING,     "a",                     "fr",    1 },
+  { RASQAL_LITERAL_STRING,     "a",                     "x-\xc3\xa9", 0 },
+  { RASQAL_LITERAL_STRING,     "ab",                    NULL,    1 },
+  { RASQAL_LITERAL_STRING,     "b",                     "en",    1 },
+  { RASQAL_LITERAL_STRING,     "\xc3\xa9",              NULL,    1 },
+  { RASQAL_LITERAL_XSD_STRING, "",                      NULL,    1 },
+  { RASQAL_LITERAL_XSD_STRING, "a",                     NULL,    1 },
+  { RASQAL_LITERAL_XSD_STRING, "ab",                    NULL,    1 },
+  { RASQAL_LITERAL_URI,        "http://example.org/a",  NULL,    1 },
+  { RASQAL_LITERAL_URI,        "http://example.org/ab", NULL,    1 },
+  { RASQAL_LITERAL_URI,        "http://example.org/b",  NULL,    1 },
+  { RASQAL_LITERAL_BLANK,      "b1",                    NULL,    1 },
+  { RASQAL_LITERAL_BLANK,      "b10",                   NULL,    1 },
+  { RASQAL_LITERAL_BLANK,      "b2",                    NULL,    1 }
+};
+
+#define ORDER_KEY_VALUES_COUNT \
+  RASQAL_GOOD_CAST(int, sizeof(order_key_values) / sizeof(order_key_values[0]))
+
+
+static unsigned char*
+copy_string(const char* string)
+{
+  size_t len = strlen(string);
+  unsigned char* copy;
+
+  copy = RASQAL_MALLOC(unsigned char*, len + 1);
+  if(copy)
+    memcpy(copy, string, len + 1);
+
+  return copy;
+}
+
+
+static rasqal_literal*
+make_order_key_literal(rasqal_world* world, const order_key_data* value)
+{
+  unsigned char* lexical;
+  char* language = NULL;
+  raptor_uri* uri;
+  rasqal_literal* l;
+
+  switch(value->type) {
+    case RASQAL_LITERAL_URI:
+      uri = raptor_new_uri(world->raptor_world_ptr,
+                           RASQAL_GOOD_CAST(const unsigned char*, value->lexical));
+      if(!uri)
+        return NULL;
+      l = rasqal_new_uri_literal(world, uri);
+      break;
+
+    case RASQAL_LITERAL_BLANK:
+      lexical = copy_string(value->lexical);
+      if(!lexical)
+        return NULL;
+      l = rasqal_new_simple_literal(world, RASQAL_LITERAL_BLANK, lexical);
+      break;
+
+    case RASQAL_LITERAL_STRING:
+      lexical = copy_string(value->lexical);
+      if(!lexical)
+        return NULL;
+      if(value->language) {
+        language = RASQAL_BAD_CAST(char*, copy_string(value->language));
+        if(!language) {
+          RASQAL_FREE(char*, lexical);
+          return NULL;
+        }
+      }
+      l = rasqal_new_string_literal(world, lexical, language, NULL, NULL);
+      break;
+
+    case RASQAL_LITERAL_UNKNOWN:
+    case RASQAL_LITERAL_PATTERN:
+    case RASQAL_LITERAL_QNAME:
+    case RASQAL_LITERAL_XSD_STRING:
+    case RASQAL_LITERAL_BOOLEAN:
+    case RASQAL_LITERAL_INTEGER:
+    case RASQAL_LITERAL_FLOAT:
+    case RASQAL_LITERAL_DOUBLE:
+    case RASQAL_LITERAL_DECIMAL:
+    case RASQAL_LITERAL_DATE:
+    case RASQAL_LITERAL_DATETIME:
+    case RASQAL_LITERAL_UDT:
+    case RASQAL_LITERAL_VARIABLE:
+    case RASQAL_LITERAL_INTEGER_SUBTYPE:
+    default:
+      l = rasqal_new_typed_literal(world, value->type,
+                                   RASQAL_GOOD_CAST(const unsigned char*, value->lexical));
+      break;
+  }
+
+  return l;
+}
+
+
+/* a row with one order value @l, which it takes ownership of */
+static rasqal_row*
+make_order_key_row(rasqal_world* world, rasqal_literal* l)
+{
+  rasqal_row* row;
+
+  row = rasqal_new_row_for_size(world, 0);
+  if(!row) {
+    if(l)
+      rasqal_free_literal(l);
+    return NULL;
+  }
+
+  if(rasqal_row_set_order_size(row, 1)) {
+    if(l)
+      rasqal_free_literal(l);
+    rasqal_free_row(row);
+    return NULL;
+  }
+  row->order_values[0] = l;
+
+  return row;
+}
+
+
+static int
+compare_sign(int result)
+{
+  return (result > 0) - (result < 0);
+}
+
+
+/*
+ * Compare every pair of order values in ascending and descending
+ * order with and without sort keys.  The results must agree with
+ * each other and, where the values compare, with
+ * rasqal_literal_compare().  Return the number of failures.
+ */
+static int
+test_order_keys(rasqal_world* world, const char* program)
+{
+  int compare_flags = RASQAL_COMPARE_XQUERY;
+  rasqal_row* rows[ORDER_KEY_VALUES_COUNT];
+  raptor_sequence* order_seqs[2] = { NULL, NULL };
+  int failures = 0;
+  int i;
+  int j;
+  int d;
+
+  memset(rows, '\0', sizeof(rows));
+
+  for(d = 0; d < 2; d++) {
+    rasqal_literal* l;
+    rasqal_expression* e = NULL;
+
+    order_seqs[d] = raptor_new_sequence((raptor_data_free_handler)rasqal_free_expression,
+                                        (raptor_data_print_handler)rasqal_expression_print);
+    l = rasqal_new_integer_literal(world, RASQAL_LITERAL_INTEGER, 1);
+    if(l)
+      e = rasqal_new_literal_expression(world, l);
+    if(e)
+      e = rasqal_new_1op_expression(world,
+                                    d ? RASQAL_EXPR_ORDER_COND_DESC :
+                                        RASQAL_EXPR_ORDER_COND_ASC, e);
+    if(!order_seqs[d] || !e || raptor_sequence_push(order_seqs[d], e)) {
+      fprintf(stderr, "%s: failed to make order condition %d\n", program, d);
+      failures++;
+      goto tidy;
+    }
+  }
+
+  for(i = 0; i < ORDER_KEY_VALUES_COUNT; i++) {
+    const order_key_data* value = &order_key_values[i];
+    rasqal_literal* l = NULL;
+    int has_key;
+
+    if(value->lexical) {
+      l = make_order_key_literal(world, value);
+      if(!l) {
+        fprintf(stderr, "%s: failed to make order value %d '%s'\n", program,
+                i, value->lexical);
+        failures++;
+        goto tidy;
+      }
+    }
+
+    rows[i] = make_order_key_row(world, l);
+    if(!rows[i] ||
+       rasqal_engine_rowsort_calculate_order_keys(rows[i], compare_flags)) {
+      fprintf(stderr, "%s: failed to make row for order value %d\n", program,
+              i);
+      failures++;
+      goto tidy;
+    }
+
+    has_key = (rows[i]->order_keys[0].type != RASQAL_LITERAL_UNKNOWN);
+    if(has_key != value->has_key) {
+      fprintf(stderr, "%s: order value %d '%s' %s a sort key, expected %s\n",
+              program, i, value->lexical ? value->lexical : "(unbound)",
+              has_key ? "has" : "has no", value->has_key ? "one" : "none");
+      failures++;
+    }
+  }
+
+  for(i = 0; i < ORDER_KEY_VALUES_COUNT; i++) {
+    for(j = 0; j < ORDER_KEY_VALUES_COUNT; j++) {
+      rasqal_row* row_a = rows[i];
+      rasqal_row* row_b = rows[j];
+      int literal_result = 0;
+      int error = 1;
+
+      if(row_a->order_values[0] && row_b->order_values[0])
+        literal_result = rasqal_literal_compare(row_a->order_values[0],
+                                                row_b->order_values[0],
+                                                compare_flags | RASQAL_COMPARE_URI,
+                                                &error);
+
+      for(d = 0; d < 2; d++) {
+        int key_result;
+        int value_result;
+
+        /* compare with the keys then without them */
+        rasqal_engine_rowsort_calculate_order_keys(row_a, compare_flags);
+        rasqal_engine_rowsort_calculate_order_keys(row_b, compare_flags);
+        key_result = rasqal_engine_rowsort_compare_rows(row_a, row_b,
+                                                        order_seqs[d],
+                                                        compare_flags);
+
+        rasqal_engine_rowsort_calculate_order_keys(row_a, 0);
+        rasqal_engine_rowsort_calculate_order_keys(row_b, 0);
+        value_result = rasqal_engine_rowsort_compare_rows(row_a, row_b,
+                                                          order_seqs[d],
+                                                          compare_flags);
+
+        if(compare_sign(key_result) != compare_sign(value_result) ||
+           (!error &&
+            compare_sign(key_result) != (d ? -1 : 1) * compare_sign(literal_result))) {
+          fprintf(stderr,
+                  "%s: %s order of values %d and %d gave %d with sort keys, %d without and %d from rasqal_literal_compare()\n",
+                  program, d ? "descending" : "ascending", i, j,
+                  key_result, value_result, literal_result);
+          failures++;
+        }
+      }
+    }
+  }
+
+  tidy:
+  for(i = 0; i < ORDER_KEY_VALUES_COUNT; i++) {
+    if(rows[i])
+      rasqal_free_row(rows[i]);
+  }
+  for(d = 0; d < 2; d++) {
+    if(order_seqs[d])
+      raptor_free_sequence(order_seqs[d]);
+  }
+
+  return failures;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+  const char *program = rasqal_basename(argv[0]);
+  rasqal_world* world;
+  int failures = 0;
+
+  world = rasqal_new_world();
+  if(!world || rasqal_world_open(world)) {
+    fprintf(stderr, "%s: rasqal_world init failed\n", program);
+    return(1);
+  }
+
+  failures += test_order_keys(world, program);
+
+  rasqal_free_world(world);
+
+  return failures;
+}
+
+#endif /* STANDALONE */
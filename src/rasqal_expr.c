@@ -2367,21 +2367,31 @@ rasqal_new_evaluation_context(rasqal_world* world,
                               raptor_locator* locator,
                               int flags)
 {
+  rasqal_evaluation_context_private* ecp;
   rasqal_evaluation_context* eval_context;
   
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(world, rasqal_world, NULL);
 
-  eval_context = RASQAL_CALLOC(rasqal_evaluation_context*, 1, sizeof(*eval_context));
-  if(!eval_context)
+  ecp = RASQAL_CALLOC(rasqal_evaluation_context_private*, 1, sizeof(*ecp));
+  if(!ecp)
     return NULL;
   
+  eval_context = &ecp->context;
   eval_context->world = world;
   eval_context->locator = locator;
   eval_context->flags = flags;
 
   eval_context->random = rasqal_new_random(world);
   if(!eval_context->random) {
-    RASQAL_FREE(rasqal_evaluation_context*, eval_context);
+    RASQAL_FREE(rasqal_evaluation_context_private*, ecp);
+    return NULL;
+  }
+  eval_context->random->owner = eval_context;
+
+  ecp->regex_cache = rasqal_new_regex_cache(world);
+  ecp->in_set_cache = rasqal_new_in_set_cache();
+  if(!ecp->regex_cache || !ecp->in_set_cache) {
+    rasqal_free_evaluation_context(eval_context);
     eval_context = NULL;
   }
 
@@ -2399,16 +2409,50 @@ rasqal_new_evaluation_context(rasqal_world* world,
 void
 rasqal_free_evaluation_context(rasqal_evaluation_context* eval_context)
 {
+  rasqal_evaluation_context_private* ecp;
+
   if(!eval_context)
     return;
 
+  ecp = (rasqal_evaluation_context_private*)eval_context;
+
   if(eval_context->base_uri)
     raptor_free_uri(eval_context->base_uri);
 
   if(eval_context->random)
     rasqal_free_random(eval_context->random);
 
-  RASQAL_FREE(rasqal_evaluation_context*, eval_context);
+  if(ecp->regex_cache)
+    rasqal_free_regex_cache(ecp->regex_cache);
+
+  if(ecp->in_set_cache)
+    rasqal_free_in_set_cache(ecp->in_set_cache);
+
+  RASQAL_FREE(rasqal_evaluation_context_private*, ecp);
+}
+
+
+/*
+ * rasqal_evaluation_context_get_private:
+ * @eval_context: #rasqal_evaluation_context object
+ *
+ * INTERNAL - Get the private part of an evaluation context
+ *
+ * Only a context made by rasqal_new_evaluation_context() has one.  Such
+ * a context owns its random object, which points back to it; a context
+ * allocated by the caller has no random object or a copied pointer to
+ * the random object of another context.
+ *
+ * Return value: private context or NULL if there is none
+ */
+rasqal_evaluation_context_private*
+rasqal_evaluation_context_get_private(rasqal_evaluation_context* eval_context)
+{
+  if(!eval_context || !eval_context->random ||
+     eval_context->random->owner != eval_context)
+    return NULL;
+
+  return (rasqal_evaluation_context_private*)eval_context;
 }
 
 
@@ -2471,6 +2515,316 @@ int main(int argc, char *argv[]);
 #define assert_match(function, result, string) do { if(strcmp(result, string)) { fprintf(stderr, #function " failed - returned %s, expected %s\n", result, string); exit(1); } } while(0)
 
 
+/* IN / NOT IN lists long enough to be evaluated with a hash set.
+ * Terms are <uri>, an integer, "string" with optional @lang or
+ * ^^xsd-local-name, or ?v for a variable.
+ */
+static const char* const in_integer_members[] = {
+  "2", "3", "4", "5", "6", "7", "8", "1", NULL
+};
+static const char* const in_numeric_members[] = {
+  "\"1.0\"^^decimal", "2", "3", "4", "5", "6", "7", "8", NULL
+};
+static const char* const in_string_members[] = {
+  "\"a\"@en", "\"b\"", "\"c\"", "\"d\"", "\"e\"", "\"f\"", "\"g\"", "\"h\"",
+  NULL
+};
+static const char* const in_uri_members[] = {
+  "<http://example.org/0>", "<http://example.org/1>",
+  "<http://example.org/2>", "<http://example.org/3>",
+  "<http://example.org/4>", "<http://example.org/5>",
+  "<http://example.org/6>", "<http://example.org/7>", NULL
+};
+/* comparing a string with the integer is a type error */
+static const char* const in_mixed_members[] = {
+  "\"a\"", "1", "\"c\"", "\"d\"", "\"e\"", "\"f\"", "\"g\"", "\"h\"", NULL
+};
+static const char* const in_variable_members[] = {
+  "\"b\"", "\"c\"", "\"d\"", "\"e\"", "\"f\"", "\"g\"", "\"h\"", "?v", NULL
+};
+
+/* expected result: 1 true, 0 false or IN_SAME to only require the
+ * same result (or error) as comparing members one at a time */
+#define IN_SAME -2
+
+static const struct {
+  rasqal_op op;
+  const char* probe;
+  const char* const* members;
+  int expected;
+} in_tests[] = {
+  /* numerics compare by value */
+  { RASQAL_EXPR_IN,     "1",                 in_integer_members, 1 },
+  { RASQAL_EXPR_IN,     "\"01\"^^integer",   in_integer_members, 1 },
+  { RASQAL_EXPR_IN,     "\"1.0\"^^decimal",  in_integer_members, 1 },
+  { RASQAL_EXPR_IN,     "\"1\"^^decimal",    in_integer_members, 1 },
+  { RASQAL_EXPR_IN,     "\"1.5\"^^decimal",  in_integer_members, 0 },
+  { RASQAL_EXPR_IN,     "9",                 in_integer_members, 0 },
+  { RASQAL_EXPR_IN,     "1",                 in_numeric_members, 1 },
+  { RASQAL_EXPR_IN,     "\"1\"^^decimal",    in_numeric_members, 1 },
+  { RASQAL_EXPR_IN,     "9",                 in_numeric_members, 0 },
+  { RASQAL_EXPR_NOT_IN, "1",                 in_integer_members, 0 },
+  { RASQAL_EXPR_NOT_IN, "\"1.0\"^^decimal",  in_integer_members, 0 },
+  { RASQAL_EXPR_NOT_IN, "9",                 in_integer_members, 1 },
+  { RASQAL_EXPR_NOT_IN, "\"1.0\"^^decimal",  in_numeric_members, 0 },
+  /* strings with and without language tags */
+  { RASQAL_EXPR_IN,     "\"a\"@en",          in_string_members,  1 },
+  { RASQAL_EXPR_IN,     "\"a\"@EN",          in_string_members,  1 },
+  { RASQAL_EXPR_IN,     "\"b\"",             in_string_members,  1 },
+  { RASQAL_EXPR_IN,     "\"b\"^^string",     in_string_members,  IN_SAME },
+  { RASQAL_EXPR_IN,     "\"a\"",             in_string_members,  IN_SAME },
+  { RASQAL_EXPR_IN,     "\"b\"@en",          in_string_members,  IN_SAME },
+  { RASQAL_EXPR_IN,     "\"z\"",             in_string_members,  IN_SAME },
+  { RASQAL_EXPR_NOT_IN, "\"a\"@en",          in_string_members,  0 },
+  { RASQAL_EXPR_NOT_IN, "\"a\"",             in_string_members,  IN_SAME },
+  /* URIs */
+  { RASQAL_EXPR_IN,     "<http://example.org/3>", in_uri_members, 1 },
+  { RASQAL_EXPR_IN,     "<http://example.org/9>", in_uri_members, 0 },
+  { RASQAL_EXPR_IN,     "\"http://example.org/3\"", in_uri_members, IN_SAME },
+  { RASQAL_EXPR_NOT_IN, "<http://example.org/3>", in_uri_members, 0 },
+  { RASQAL_EXPR_NOT_IN, "<http://example.org/9>", in_uri_members, 1 },
+  /* type errors are raised in list order */
+  { RASQAL_EXPR_IN,     "\"a\"",             in_mixed_members,   IN_SAME },
+  { RASQAL_EXPR_IN,     "\"z\"",             in_mixed_members,   IN_SAME },
+  { RASQAL_EXPR_NOT_IN, "\"z\"",             in_mixed_members,   IN_SAME },
+  { RASQAL_EXPR_IN,     "5",                 in_string_members,  IN_SAME },
+  { RASQAL_EXPR_IN,     "\"a\"",             in_integer_members, IN_SAME },
+  { RASQAL_EXPR_NOT_IN, "\"a\"",             in_integer_members, IN_SAME },
+  { RASQAL_EXPR_UNKNOWN, NULL,               NULL,               0 }
+};
+
+
+static rasqal_literal*
+in_test_literal(rasqal_world* world, const char* term, rasqal_variable* v)
+{
+  const char* end;
+  size_t len;
+  unsigned char* string;
+  char* language = NULL;
+  raptor_uri* datatype = NULL;
+
+  if(*term == '?')
+    return rasqal_new_variable_literal(world,
+                                       rasqal_new_variable_from_variable(v));
+
+  if(*term == '<') {
+    raptor_uri* uri;
+
+    len = strlen(term) - 2;
+    string = RASQAL_MALLOC(unsigned char*, len + 1);
+    if(!string)
+      return NULL;
+    memcpy(string, term + 1, len);
+    string[len] = '\0';
+    uri = raptor_new_uri(world->raptor_world_ptr, string);
+    RASQAL_FREE(char*, string);
+
+    return uri ? rasqal_new_uri_literal(world, uri) : NULL;
+  }
+
+  if(*term != '"')
+    return rasqal_new_integer_literal(world, RASQAL_LITERAL_INTEGER,
+                                      atoi(term));
+
+  end = strchr(term + 1, '"');
+  len = RASQAL_GOOD_CAST(size_t, end - (term + 1));
+  string = RASQAL_MALLOC(unsigned char*, len + 1);
+  if(!string)
+    return NULL;
+  memcpy(string, term + 1, len);
+  string[len] = '\0';
+
+  if(end[1] == '@') {
+    len = strlen(end + 2);
+    language = RASQAL_MALLOC(char*, len + 1);
+    if(language)
+      memcpy(language, end + 2, len + 1);
+  } else if(end[1] == '^') {
+    unsigned char* uri_string;
+
+    len = strlen(end + 3);
+    uri_string = RASQAL_MALLOC(unsigned char*, len + 34);
+    if(uri_string) {
+      memcpy(uri_string, "http://www.w3.org/2001/XMLSchema#", 33);
+      memcpy(uri_string + 33, end + 3, len + 1);
+      datatype = raptor_new_uri(world->raptor_world_ptr, uri_string);
+      RASQAL_FREE(char*, uri_string);
+    }
+  }
+
+  return rasqal_new_string_literal(world, string, language, datatype, NULL);
+}
+
+
+static rasqal_expression*
+in_test_expression(rasqal_world* world, rasqal_op op, const char* probe,
+                   const char* const* members, rasqal_variable* v)
+{
+  raptor_sequence* args;
+  rasqal_literal* l;
+  rasqal_expression* arg1;
+  int i;
+
+  args = raptor_new_sequence((raptor_data_free_handler)rasqal_free_expression,
+                             (raptor_data_print_handler)rasqal_expression_print);
+  if(!args)
+    return NULL;
+
+  for(i = 0; members[i]; i++) {
+    rasqal_expression* arg_e = NULL;
+
+    l = in_test_literal(world, members[i], v);
+    if(l)
+      arg_e = rasqal_new_literal_expression(world, l);
+    if(!arg_e || raptor_sequence_push(args, arg_e)) {
+      raptor_free_sequence(args);
+      return NULL;
+    }
+  }
+
+  l = in_test_literal(world, probe, v);
+  arg1 = l ? rasqal_new_literal_expression(world, l) : NULL;
+  if(!arg1) {
+    raptor_free_sequence(args);
+    return NULL;
+  }
+
+  return rasqal_new_set_expression(world, op, arg1, args);
+}
+
+
+/* Return 1 true, 0 false or -1 on error */
+static int
+in_test_evaluate(rasqal_expression* e, rasqal_evaluation_context* eval_context)
+{
+  rasqal_literal* result;
+  int error = 0;
+  int b;
+
+  result = rasqal_expression_evaluate2(e, eval_context, &error);
+  if(error || !result) {
+    if(result)
+      rasqal_free_literal(result);
+    return -1;
+  }
+
+  b = rasqal_literal_as_boolean(result, &error);
+  rasqal_free_literal(result);
+
+  return error ? -1 : b;
+}
+
+
+/*
+ * Evaluate IN and NOT IN with an evaluation context that caches the
+ * list as a hash set and with one that does not, which compares the
+ * members one at a time.  Return the number of failures.
+ */
+static int
+test_in_sets(const char* program, rasqal_world* world)
+{
+  rasqal_evaluation_context* eval_context;
+  rasqal_evaluation_context linear_context;
+  rasqal_variables_table* vt;
+  rasqal_variable* v = NULL;
+  rasqal_expression* e;
+  int failures = 0;
+  int i;
+
+  eval_context = rasqal_new_evaluation_context(world, NULL,
+                                               RASQAL_COMPARE_XQUERY);
+  /* as rasqal_expression_evaluate() */
+  memset(&linear_context, '\0', sizeof(linear_context));
+  linear_context.world = world;
+  linear_context.flags = RASQAL_COMPARE_XQUERY;
+
+  vt = rasqal_new_variables_table(world);
+  if(vt)
+    v = rasqal_variables_table_add2(vt, RASQAL_VARIABLE_TYPE_NORMAL,
+                                    RASQAL_GOOD_CAST(const unsigned char*, "v"),
+                                    1, NULL);
+  if(!eval_context || !v) {
+    fprintf(stderr, "%s: IN test setup FAILED\n", program);
+    failures++;
+    goto tidy;
+  }
+
+  for(i = 0; in_tests[i].probe; i++) {
+    int expected = in_tests[i].expected;
+    int hashed;
+    int hashed_again;
+    int linear;
+
+    e = in_test_expression(world, in_tests[i].op, in_tests[i].probe,
+                           in_tests[i].members, v);
+    if(!e) {
+      fprintf(stderr, "%s: IN test %d expression FAILED\n", program, i);
+      failures++;
+      continue;
+    }
+
+    /* the second evaluation uses the set made by the first */
+    hashed = in_test_evaluate(e, eval_context);
+    hashed_again = in_test_evaluate(e, eval_context);
+    linear = in_test_evaluate(e, &linear_context);
+
+    if(hashed != linear || hashed_again != linear ||
+       (expected != IN_SAME && linear != expected)) {
+      fprintf(stderr, "%s: IN test %d FAILED - ", program, i);
+      rasqal_expression_print(e, stderr);
+      fprintf(stderr, " returned %d then %d with a set and %d without, expected %d\n",
+              hashed, hashed_again, linear,
+              (expected == IN_SAME) ? linear : expected);
+      failures++;
+    }
+
+    rasqal_free_expression(e);
+  }
+
+  /* A list with a variable member is evaluated per row so it sees
+   * the current value */
+  e = in_test_expression(world, RASQAL_EXPR_IN, "\"a\"",
+                         in_variable_members, v);
+  if(!e) {
+    fprintf(stderr, "%s: IN variable test expression FAILED\n", program);
+    failures++;
+    goto tidy;
+  }
+
+  for(i = 0; i < 2; i++) {
+    const char* value = i ? "z" : "a";
+    unsigned char* string;
+    int result;
+
+    string = RASQAL_MALLOC(unsigned char*, 2);
+    if(!string)
+      break;
+    memcpy(string, value, 2);
+    rasqal_variable_set_value(v, rasqal_new_string_literal(world, string,
+                                                           NULL, NULL, NULL));
+
+    result = in_test_evaluate(e, eval_context);
+    if(result != !i) {
+      fprintf(stderr, "%s: IN variable test with ?v \"%s\" FAILED - returned %d expected %d\n",
+              program, value, result, !i);
+      failures++;
+    }
+  }
+
+  rasqal_free_expression(e);
+
+  tidy:
+  if(v)
+    rasqal_free_variable(v);
+  if(vt)
+    rasqal_free_variables_table(vt);
+  if(eval_context)
+    rasqal_free_evaluation_context(eval_context);
+
+  return failures;
+}
+
+
 int
 main(int argc, char *argv[]) 
 {
@@ -2532,6 +2886,9 @@ main(int argc, char *argv[])
   if(result)
     rasqal_free_literal(result);
 
+  if(test_in_sets(program, world))
+    error = 1;
+
   rasqal_xsd_finish(world);
 
   rasqal_uri_finish(world);
@@ -0,0 +1,1043 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * rasqal_expr_compile.c - Rasqal expression compiler
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <rasqal_config.h>
+#endif
+
+#ifdef WIN32
+#include <win32_rasqal_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#include "rasqal.h"
+#include "rasqal_internal.h"
+
+
+#define DEBUG_FH stderr
+
+
+#ifndef STANDALONE
+
+/*
+ * An expression program is a linear sequence of instructions made
+ * from an expression tree in post-order.  Instruction N writes its
+ * value into slot N so arguments are always earlier slots.
+ *
+ * The logical operators, comparisons, BOUND and integer arithmetic
+ * are run here with booleans and integers held in the slots; no
+ * literals are allocated for them.  Every other operator is an
+ * EVALUATE instruction that calls rasqal_expression_evaluate2() on
+ * the subtree.
+ */
+typedef enum {
+  /* value of a constant or variable literal; not copied */
+  RASQAL_EXPR_INSN_LOAD,
+  /* interpreted subexpression */
+  RASQAL_EXPR_INSN_EVALUATE,
+  RASQAL_EXPR_INSN_BOUND,
+  RASQAL_EXPR_INSN_AND,
+  RASQAL_EXPR_INSN_OR,
+  RASQAL_EXPR_INSN_NOT,
+  /* EQ, NEQ, LT, GT, LE, GE */
+  RASQAL_EXPR_INSN_COMPARE,
+  /* PLUS, MINUS, STAR */
+  RASQAL_EXPR_INSN_ARITHMETIC,
+  /* short circuit AND / OR: set slot dest and go to jump */
+  RASQAL_EXPR_INSN_JUMP_IF_FALSE,
+  RASQAL_EXPR_INSN_JUMP_IF_TRUE
+} rasqal_expr_insn_type;
+
+
+typedef struct {
+  rasqal_expr_insn_type type;
+
+  /* operator for COMPARE and ARITHMETIC */
+  rasqal_op op;
+
+  /* argument slots */
+  int arg1;
+  int arg2;
+
+  /* jumps: slot to set and instruction to continue at */
+  int dest;
+  int jump;
+
+  /* expression for LOAD and EVALUATE */
+  rasqal_expression* expr;
+
+  /* variable for BOUND */
+  rasqal_variable* variable;
+} rasqal_expr_insn;
+
+
+typedef enum {
+  RASQAL_EXPR_SLOT_BOOLEAN,
+  RASQAL_EXPR_SLOT_INTEGER,
+  RASQAL_EXPR_SLOT_LITERAL
+} rasqal_expr_slot_type;
+
+
+typedef struct {
+  rasqal_expr_slot_type type;
+
+  /* non-0 if the value is a type error */
+  int error;
+
+  /* non-0 if literal is owned by the slot */
+  int owned;
+
+  union {
+    /* BOOLEAN and INTEGER slots */
+    int integer;
+    /* LITERAL slot; NULL for an unbound variable */
+    rasqal_literal* literal;
+  } value;
+} rasqal_expr_slot;
+
+
+struct rasqal_expression_program_s {
+  rasqal_world* world;
+
+  /* reference to the compiled expression */
+  rasqal_expression* expr;
+
+  rasqal_expr_insn* insns;
+  int size;
+  int capacity;
+
+  /* one slot per instruction */
+  rasqal_expr_slot* slots;
+};
+
+
+static int
+rasqal_expression_count_visit(void *user_data, rasqal_expression *e)
+{
+  (*(int*)user_data)++;
+  return 0;
+}
+
+
+/*
+ * Operators whose evaluation has side effects, so they must be
+ * evaluated even when a short circuit would not need their value.
+ */
+static int
+rasqal_expression_volatile_visit(void *user_data, rasqal_expression *e)
+{
+  switch(e->op) {
+    case RASQAL_EXPR_RAND:
+    case RASQAL_EXPR_BNODE:
+    case RASQAL_EXPR_UUID:
+    case RASQAL_EXPR_STRUUID:
+      return 1;
+
+    default:
+      return 0;
+  }
+}
+
+
+static int
+rasqal_expression_program_add(rasqal_expression_program* program,
+                              rasqal_expr_insn_type type,
+                              rasqal_expression* e, int arg1, int arg2)
+{
+  rasqal_expr_insn* insn;
+
+  if(program->size == program->capacity)
+    return -1;
+
+  insn = &program->insns[program->size];
+  insn->type = type;
+  insn->op = e ? e->op : RASQAL_EXPR_UNKNOWN;
+  insn->arg1 = arg1;
+  insn->arg2 = arg2;
+  insn->dest = -1;
+  insn->jump = -1;
+  insn->expr = e;
+  insn->variable = NULL;
+
+  return program->size++;
+}
+
+
+/*
+ * rasqal_expression_program_compile:
+ * @program: program
+ * @e: expression
+ *
+ * INTERNAL - Add instructions to calculate @e
+ *
+ * Return value: slot holding the value of @e or <0 on failure
+ */
+static int
+rasqal_expression_program_compile(rasqal_expression_program* program,
+                                  rasqal_expression* e)
+{
+  int arg1;
+  int arg2;
+  int jump;
+  int i;
+
+  switch(e->op) {
+    case RASQAL_EXPR_LITERAL:
+      return rasqal_expression_program_add(program, RASQAL_EXPR_INSN_LOAD,
+                                           e, -1, -1);
+
+    case RASQAL_EXPR_BOUND:
+      if(e->arg1 && e->arg1->op == RASQAL_EXPR_LITERAL &&
+         e->arg1->literal &&
+         e->arg1->literal->type == RASQAL_LITERAL_VARIABLE) {
+        i = rasqal_expression_program_add(program, RASQAL_EXPR_INSN_BOUND,
+                                          e, -1, -1);
+        if(i >= 0)
+          program->insns[i].variable = rasqal_literal_as_variable(e->arg1->literal);
+        return i;
+      }
+      break;
+
+    case RASQAL_EXPR_AND:
+    case RASQAL_EXPR_OR:
+      arg1 = rasqal_expression_program_compile(program, e->arg1);
+      if(arg1 < 0)
+        return -1;
+
+      jump = -1;
+      if(!rasqal_expression_visit(e->arg2, rasqal_expression_volatile_visit,
+                                  NULL)) {
+        jump = rasqal_expression_program_add(program,
+                                             (e->op == RASQAL_EXPR_AND) ?
+                                               RASQAL_EXPR_INSN_JUMP_IF_FALSE :
+                                               RASQAL_EXPR_INSN_JUMP_IF_TRUE,
+                                             NULL, arg1, -1);
+        if(jump < 0)
+          return -1;
+      }
+
+      arg2 = rasqal_expression_program_compile(program, e->arg2);
+      if(arg2 < 0)
+        return -1;
+
+      i = rasqal_expression_program_add(program,
+                                        (e->op == RASQAL_EXPR_AND) ?
+                                          RASQAL_EXPR_INSN_AND :
+                                          RASQAL_EXPR_INSN_OR,
+                                        e, arg1, arg2);
+      if(i >= 0 && jump >= 0) {
+        program->insns[jump].dest = i;
+        program->insns[jump].jump = i + 1;
+      }
+      return i;
+
+    case RASQAL_EXPR_ORDER_COND_ASC:
+    case RASQAL_EXPR_ORDER_COND_DESC:
+    case RASQAL_EXPR_GROUP_COND_ASC:
+    case RASQAL_EXPR_GROUP_COND_DESC:
+      /* the value is the value of the condition expression */
+      return rasqal_expression_program_compile(program, e->arg1);
+
+    case RASQAL_EXPR_BANG:
+      arg1 = rasqal_expression_program_compile(program, e->arg1);
+      if(arg1 < 0)
+        return -1;
+      return rasqal_expression_program_add(program, RASQAL_EXPR_INSN_NOT,
+                                           e, arg1, -1);
+
+    case RASQAL_EXPR_EQ:
+    case RASQAL_EXPR_NEQ:
+    case RASQAL_EXPR_LT:
+    case RASQAL_EXPR_GT:
+    case RASQAL_EXPR_LE:
+    case RASQAL_EXPR_GE:
+    case RASQAL_EXPR_PLUS:
+    case RASQAL_EXPR_MINUS:
+    case RASQAL_EXPR_STAR:
+      arg1 = rasqal_expression_program_compile(program, e->arg1);
+      if(arg1 < 0)
+        return -1;
+      arg2 = rasqal_expression_program_compile(program, e->arg2);
+      if(arg2 < 0)
+        return -1;
+      return rasqal_expression_program_add(program,
+                                           (e->op == RASQAL_EXPR_PLUS ||
+                                            e->op == RASQAL_EXPR_MINUS ||
+                                            e->op == RASQAL_EXPR_STAR) ?
+                                             RASQAL_EXPR_INSN_ARITHMETIC :
+                                             RASQAL_EXPR_INSN_COMPARE,
+                                           e, arg1, arg2);
+
+    default:
+      break;
+  }
+
+  return rasqal_expression_program_add(program, RASQAL_EXPR_INSN_EVALUATE,
+                                       e, -1, -1);
+}
+
+
+/**
+ * rasqal_new_expression_program:
+ * @world: world
+ * @e: expression
+ *
+ * INTERNAL - Constructor - compile an expression to a program
+ *
+ * The program holds a reference to @e.  A program is evaluated by
+ * one caller at a time.
+ *
+ * Return value: new program or NULL on failure
+ */
+rasqal_expression_program*
+rasqal_new_expression_program(rasqal_world* world, rasqal_expression* e)
+{
+  rasqal_expression_program* program;
+  int count = 0;
+
+  RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(e, rasqal_expression, NULL);
+
+  program = RASQAL_CALLOC(rasqal_expression_program*, 1, sizeof(*program));
+  if(!program)
+    return NULL;
+
+  program->world = world;
+  program->expr = rasqal_new_expression_from_expression(e);
+
+  /* at most two instructions (AND / OR with a jump) per expression */
+  rasqal_expression_visit(e, rasqal_expression_count_visit, &count);
+  program->capacity = count << 1;
+
+  program->insns = RASQAL_CALLOC(rasqal_expr_insn*,
+                                 RASQAL_GOOD_CAST(size_t, program->capacity),
+                                 sizeof(rasqal_expr_insn));
+  program->slots = RASQAL_CALLOC(rasqal_expr_slot*,
+                                 RASQAL_GOOD_CAST(size_t, program->capacity),
+                                 sizeof(rasqal_expr_slot));
+  if(!program->insns || !program->slots)
+    goto failed;
+
+  if(rasqal_expression_program_compile(program, e) < 0)
+    goto failed;
+
+#if defined(RASQAL_DEBUG) && RASQAL_DEBUG > 1
+  RASQAL_DEBUG3("compiled expression %p to %d instructions: ", e,
+                program->size);
+  rasqal_expression_print(e, DEBUG_FH);
+  fputc('\n', DEBUG_FH);
+#endif
+
+  return program;
+
+  failed:
+  rasqal_free_expression_program(program);
+  return NULL;
+}
+
+
+/**
+ * rasqal_free_expression_program:
+ * @program: program
+ *
+ * INTERNAL - Destructor - destroy an expression program
+ */
+void
+rasqal_free_expression_program(rasqal_expression_program* program)
+{
+  if(!program)
+    return;
+
+  if(program->insns)
+    RASQAL_FREE(rasqal_expr_insn*, program->insns);
+
+  if(program->slots)
+    RASQAL_FREE(rasqal_expr_slot*, program->slots);
+
+  if(program->expr)
+    rasqal_free_expression(program->expr);
+
+  RASQAL_FREE(rasqal_expression_program, program);
+}
+
+
+static void
+rasqal_expr_slot_set_literal(rasqal_expr_slot* slot, rasqal_literal* l,
+                             int owned)
+{
+  slot->type = RASQAL_EXPR_SLOT_LITERAL;
+  slot->owned = owned;
+  slot->value.literal = l;
+}
+
+
+static void
+rasqal_expr_slot_set_boolean(rasqal_expr_slot* slot, int b)
+{
+  slot->type = RASQAL_EXPR_SLOT_BOOLEAN;
+  slot->value.integer = b;
+}
+
+
+/*
+ * Get the xsd:integer value of a slot.  Returns non-0 if the slot
+ * is a native integer or an xsd:integer literal.
+ */
+static int
+rasqal_expr_slot_get_integer(rasqal_expr_slot* slot, int* integer_p)
+{
+  if(slot->type == RASQAL_EXPR_SLOT_INTEGER) {
+    *integer_p = slot->value.integer;
+    return 1;
+  }
+
+  if(slot->type == RASQAL_EXPR_SLOT_LITERAL && slot->value.literal &&
+     slot->value.literal->type == RASQAL_LITERAL_INTEGER) {
+    *integer_p = slot->value.literal->value.integer;
+    return 1;
+  }
+
+  return 0;
+}
+
+
+/*
+ * Get the literal value of a slot, making a literal for a native
+ * value.  The literal is owned by the slot.
+ */
+static rasqal_literal*
+rasqal_expr_slot_get_literal(rasqal_expression_program* program,
+                             rasqal_expr_slot* slot)
+{
+  rasqal_literal* l;
+
+  if(slot->type == RASQAL_EXPR_SLOT_LITERAL)
+    return slot->value.literal;
+
+  if(slot->type == RASQAL_EXPR_SLOT_BOOLEAN)
+    l = rasqal_new_boolean_literal(program->world, slot->value.integer);
+  else
+    l = rasqal_new_integer_literal(program->world, RASQAL_LITERAL_INTEGER,
+                                   slot->value.integer);
+  if(l)
+    rasqal_expr_slot_set_literal(slot, l, 1);
+
+  return l;
+}
+
+
+/* Effective boolean value of a slot, as rasqal_literal_as_boolean() */
+static int
+rasqal_expr_slot_as_boolean(rasqal_expr_slot* slot, int* error_p)
+{
+  if(slot->type != RASQAL_EXPR_SLOT_LITERAL)
+    return slot->value.integer != 0;
+
+  return rasqal_literal_as_boolean(slot->value.literal, error_p);
+}
+
+
+static void
+rasqal_expression_program_clear(rasqal_expression_program* program)
+{
+  int i;
+
+  for(i = 0; i < program->size; i++) {
+    rasqal_expr_slot* slot = &program->slots[i];
+
+    if(slot->owned && slot->value.literal)
+      rasqal_free_literal(slot->value.literal);
+    slot->owned = 0;
+    slot->value.literal = NULL;
+  }
+}
+
+
+static void
+rasqal_expression_program_compare(rasqal_expression_program* program,
+                                  rasqal_evaluation_context* eval_context,
+                                  rasqal_expr_insn* insn,
+                                  rasqal_expr_slot* slot)
+{
+  rasqal_expr_slot* s1 = &program->slots[insn->arg1];
+  rasqal_expr_slot* s2 = &program->slots[insn->arg2];
+  int flags = eval_context->flags;
+  rasqal_literal* l1;
+  rasqal_literal* l2;
+  int i1;
+  int i2;
+  int b = 0;
+  int error = 0;
+
+  if(s1->error || s2->error) {
+    slot->error = 1;
+    return;
+  }
+
+  if((flags & RASQAL_COMPARE_XQUERY) && !(flags & RASQAL_COMPARE_RDF) &&
+     rasqal_expr_slot_get_integer(s1, &i1) &&
+     rasqal_expr_slot_get_integer(s2, &i2)) {
+    /* both xsd:integer: no promotion needed */
+    if(insn->op == RASQAL_EXPR_EQ) {
+      if((s1->type == RASQAL_EXPR_SLOT_LITERAL &&
+          !rasqal_xsd_datatype_check(s1->value.literal->type,
+                                     s1->value.literal->string, flags)) ||
+         (s2->type == RASQAL_EXPR_SLOT_LITERAL &&
+          !rasqal_xsd_datatype_check(s2->value.literal->type,
+                                     s2->value.literal->string, flags))) {
+        slot->error = 1;
+        return;
+      }
+    }
+
+    switch(insn->op) {
+      case RASQAL_EXPR_EQ:  b = (i1 == i2); break;
+      case RASQAL_EXPR_NEQ: b = (i1 != i2); break;
+      case RASQAL_EXPR_LT:  b = (i1 < i2); break;
+      case RASQAL_EXPR_GT:  b = (i1 > i2); break;
+      case RASQAL_EXPR_LE:  b = (i1 <= i2); break;
+      case RASQAL_EXPR_GE:  b = (i1 >= i2); break;
+      default: break;
+    }
+
+    rasqal_expr_slot_set_boolean(slot, b);
+    return;
+  }
+
+  l1 = rasqal_expr_slot_get_literal(program, s1);
+  l2 = rasqal_expr_slot_get_literal(program, s2);
+  if(!l1 || !l2) {
+    slot->error = 1;
+    return;
+  }
+
+  switch(insn->op) {
+    case RASQAL_EXPR_EQ:
+      if(!rasqal_xsd_datatype_check(l1->type, l1->string, flags) ||
+         !rasqal_xsd_datatype_check(l2->type, l2->string, flags)) {
+        error = 1;
+        break;
+      }
+      b = (rasqal_literal_equals_flags(l1, l2, flags, &error) != 0);
+      break;
+
+    case RASQAL_EXPR_NEQ:
+      b = (rasqal_literal_not_equals_flags(l1, l2, flags, &error) != 0);
+      break;
+
+    case RASQAL_EXPR_LT:
+      b = (rasqal_literal_compare(l1, l2, flags, &error) < 0);
+      break;
+
+    case RASQAL_EXPR_GT:
+      b = (rasqal_literal_compare(l1, l2, flags, &error) > 0);
+      break;
+
+    case RASQAL_EXPR_LE:
+      b = (rasqal_literal_compare(l1, l2, flags, &error) <= 0);
+      break;
+
+    case RASQAL_EXPR_GE:
+      b = (rasqal_literal_compare(l1, l2, flags, &error) >= 0);
+      break;
+
+    default:
+      break;
+  }
+
+  if(error)
+    slot->error = 1;
+  else
+    rasqal_expr_slot_set_boolean(slot, b);
+}
+
+
+static void
+rasqal_expression_program_arithmetic(rasqal_expression_program* program,
+                                     rasqal_expr_insn* insn,
+                                     rasqal_expr_slot* slot)
+{
+  rasqal_expr_slot* s1 = &program->slots[insn->arg1];
+  rasqal_expr_slot* s2 = &program->slots[insn->arg2];
+  rasqal_literal* l1;
+  rasqal_literal* l2;
+  rasqal_literal* result = NULL;
+  int i1;
+  int i2;
+  int error = 0;
+
+  if(s1->error || s2->error) {
+    slot->error = 1;
+    return;
+  }
+
+  if(rasqal_expr_slot_get_integer(s1, &i1) &&
+     rasqal_expr_slot_get_integer(s2, &i2)) {
+    /* same int arithmetic as rasqal_literal_add() and friends */
+    slot->type = RASQAL_EXPR_SLOT_INTEGER;
+    if(insn->op == RASQAL_EXPR_PLUS)
+      slot->value.integer = i1 + i2;
+    else if(insn->op == RASQAL_EXPR_MINUS)
+      slot->value.integer = i1 - i2;
+    else
+      slot->value.integer = i1 * i2;
+    return;
+  }
+
+  l1 = rasqal_expr_slot_get_literal(program, s1);
+  l2 = rasqal_expr_slot_get_literal(program, s2);
+  if(!l1 || !l2) {
+    slot->error = 1;
+    return;
+  }
+
+  if(insn->op == RASQAL_EXPR_PLUS)
+    result = rasqal_literal_add(l1, l2, &error);
+  else if(insn->op == RASQAL_EXPR_MINUS)
+    result = rasqal_literal_subtract(l1, l2, &error);
+  else
+    result = rasqal_literal_multiply(l1, l2, &error);
+
+  if(error) {
+    if(result)
+      rasqal_free_literal(result);
+    slot->error = 1;
+    return;
+  }
+
+  rasqal_expr_slot_set_literal(slot, result, 1);
+}
+
+
+/*
+ * rasqal_expression_program_run:
+ * @program: program
+ * @eval_context: evaluation context
+ *
+ * INTERNAL - Run a program
+ *
+ * Return value: result slot
+ */
+static rasqal_expr_slot*
+rasqal_expression_program_run(rasqal_expression_program* program,
+                              rasqal_evaluation_context* eval_context)
+{
+  int pc = 0;
+
+  while(pc < program->size) {
+    rasqal_expr_insn* insn = &program->insns[pc];
+    rasqal_expr_slot* slot = &program->slots[pc];
+    int b1;
+    int b2;
+    int e1 = 0;
+    int e2 = 0;
+
+    slot->error = 0;
+    pc++;
+
+    switch(insn->type) {
+      case RASQAL_EXPR_INSN_LOAD:
+        /* like (FLATTEN_LITERAL) in rasqal_expression_evaluate2() */
+        rasqal_expr_slot_set_literal(slot,
+                                     rasqal_literal_value(insn->expr->literal),
+                                     0);
+        break;
+
+      case RASQAL_EXPR_INSN_EVALUATE:
+        rasqal_expr_slot_set_literal(slot,
+                                     rasqal_expression_evaluate2(insn->expr,
+                                                                 eval_context,
+                                                                 &e1),
+                                     1);
+        if(e1)
+          slot->error = 1;
+        break;
+
+      case RASQAL_EXPR_INSN_BOUND:
+        rasqal_expr_slot_set_boolean(slot, (insn->variable->value != NULL));
+        break;
+
+      case RASQAL_EXPR_INSN_AND:
+      case RASQAL_EXPR_INSN_OR:
+        if(program->slots[insn->arg1].error) {
+          e1 = 1; b1 = 0;
+        } else
+          b1 = rasqal_expr_slot_as_boolean(&program->slots[insn->arg1], &e1);
+
+        if(program->slots[insn->arg2].error) {
+          e2 = 1; b2 = 0;
+        } else
+          b2 = rasqal_expr_slot_as_boolean(&program->slots[insn->arg2], &e2);
+
+        /* Same truth table as rasqal_expression_evaluate2() */
+        if(!e1 && !e2)
+          rasqal_expr_slot_set_boolean(slot,
+                                       (insn->type == RASQAL_EXPR_INSN_AND) ?
+                                         (b1 && b2) : (b1 || b2));
+        else if(insn->type == RASQAL_EXPR_INSN_AND &&
+                ((!b1 && e2) || (e1 && b2)))
+          /* F && E => F.   E && F => F. */
+          rasqal_expr_slot_set_boolean(slot, 0);
+        else if(insn->type == RASQAL_EXPR_INSN_OR &&
+                ((b1 && e2) || (e1 && b2)))
+          /* T || E => T.   E || T => T */
+          rasqal_expr_slot_set_boolean(slot, 1);
+        else
+          slot->error = 1;
+        break;
+
+      case RASQAL_EXPR_INSN_NOT:
+        if(program->slots[insn->arg1].error ||
+           (program->slots[insn->arg1].type == RASQAL_EXPR_SLOT_LITERAL &&
+            !program->slots[insn->arg1].value.literal)) {
+          slot->error = 1;
+          break;
+        }
+        b1 = rasqal_expr_slot_as_boolean(&program->slots[insn->arg1], &e1);
+        if(e1)
+          slot->error = 1;
+        else
+          rasqal_expr_slot_set_boolean(slot, !b1);
+        break;
+
+      case RASQAL_EXPR_INSN_COMPARE:
+        rasqal_expression_program_compare(program, eval_context, insn, slot);
+        break;
+
+      case RASQAL_EXPR_INSN_ARITHMETIC:
+        rasqal_expression_program_arithmetic(program, insn, slot);
+        break;
+
+      case RASQAL_EXPR_INSN_JUMP_IF_FALSE:
+      case RASQAL_EXPR_INSN_JUMP_IF_TRUE:
+        if(program->slots[insn->arg1].error)
+          break;
+        b1 = rasqal_expr_slot_as_boolean(&program->slots[insn->arg1], &e1);
+        if(e1 || b1 != (insn->type == RASQAL_EXPR_INSN_JUMP_IF_TRUE))
+          break;
+
+        /* F && X => F.   T || X => T */
+        program->slots[insn->dest].error = 0;
+        rasqal_expr_slot_set_boolean(&program->slots[insn->dest], b1);
+        pc = insn->jump;
+        break;
+
+      default:
+        RASQAL_FATAL2("Unknown expression instruction %u", insn->type);
+    }
+  }
+
+  return &program->slots[program->size - 1];
+}
+
+
+/**
+ * rasqal_expression_program_evaluate:
+ * @program: program
+ * @eval_context: evaluation context
+ * @error_p: pointer to error return flag
+ *
+ * INTERNAL - Evaluate an expression program
+ *
+ * Gives the same result as rasqal_expression_evaluate2() on the
+ * compiled expression.
+ *
+ * Return value: a #rasqal_literal value or NULL (a valid value).  @error_p is set to non-0 on failure.
+ */
+rasqal_literal*
+rasqal_expression_program_evaluate(rasqal_expression_program* program,
+                                   rasqal_evaluation_context* eval_context,
+                                   int* error_p)
+{
+  rasqal_expr_slot* slot;
+  rasqal_literal* result = NULL;
+
+  slot = rasqal_expression_program_run(program, eval_context);
+  if(slot->error)
+    *error_p = 1;
+  else if(slot->type != RASQAL_EXPR_SLOT_LITERAL) {
+    result = rasqal_expr_slot_get_literal(program, slot);
+    if(!result)
+      *error_p = 1;
+    slot->owned = 0;
+  } else if(slot->owned) {
+    result = slot->value.literal;
+    slot->owned = 0;
+  } else
+    result = rasqal_new_literal_from_literal(slot->value.literal);
+
+  rasqal_expression_program_clear(program);
+
+  return result;
+}
+
+
+/**
+ * rasqal_expression_program_evaluate_boolean:
+ * @program: program
+ * @eval_context: evaluation context
+ * @error_p: pointer to error return flag
+ *
+ * INTERNAL - Evaluate an expression program to an effective boolean value
+ *
+ * Gives the same result as rasqal_literal_as_boolean() on the value
+ * from rasqal_expression_evaluate2() without making a literal for a
+ * boolean result such as a FILTER comparison.
+ *
+ * Return value: boolean value; @error_p is set to non-0 on failure.
+ */
+int
+rasqal_expression_program_evaluate_boolean(rasqal_expression_program* program,
+                                           rasqal_evaluation_context* eval_context,
+                                           int* error_p)
+{
+  rasqal_expr_slot* slot;
+  int b = 0;
+
+  slot = rasqal_expression_program_run(program, eval_context);
+  if(slot->error)
+    *error_p = 1;
+  else
+    b = rasqal_expr_slot_as_boolean(slot, error_p);
+
+  rasqal_expression_program_clear(program);
+
+  return b;
+}
+
+
+#endif /* not STANDALONE */
+
+
+
+#ifdef STANDALONE
+
+/* one more prototype */
+int main(int argc, char *argv[]);
+
+
+static rasqal_expression*
+make_variable_expression(rasqal_world* world, rasqal_variable* v)
+{
+  return rasqal_new_literal_expression(world,
+                                       rasqal_new_variable_literal(world, rasqal_new_variable_from_variable(v)));
+}
+
+
+static rasqal_expression*
+make_integer_expression(rasqal_world* world, int i)
+{
+  return rasqal_new_literal_expression(world,
+                                       rasqal_new_integer_literal(world, RASQAL_LITERAL_INTEGER, i));
+}
+
+
+#define EXPR_TESTS_COUNT 8
+
+int
+main(int argc, char *argv[])
+{
+  const char *program = rasqal_basename(argv[0]);
+  rasqal_world* world = NULL;
+  rasqal_variables_table* vt = NULL;
+  rasqal_evaluation_context *eval_context = NULL;
+  rasqal_variable* x = NULL;
+  rasqal_variable* y = NULL;
+  rasqal_variable* s = NULL;
+  rasqal_expression* exprs[EXPR_TESTS_COUNT];
+  rasqal_literal* value;
+  unsigned char* string;
+  int failures = 0;
+  int i;
+
+  memset(exprs, '\0', sizeof(exprs));
+
+  world = rasqal_new_world();
+  if(!world || rasqal_world_open(world)) {
+    fprintf(stderr, "%s: rasqal_world init failed\n", program);
+    return(1);
+  }
+
+  eval_context = rasqal_new_evaluation_context(world, NULL /* locator */,
+                                               RASQAL_COMPARE_XQUERY);
+  vt = rasqal_new_variables_table(world);
+  if(!eval_context || !vt) {
+    failures++;
+    goto tidy;
+  }
+
+  /* ?x = 5, ?y unbound, ?s = "a" */
+  value = rasqal_new_integer_literal(world, RASQAL_LITERAL_INTEGER, 5);
+  x = rasqal_variables_table_add2(vt, RASQAL_VARIABLE_TYPE_NORMAL,
+                                  (const unsigned char*)"x", 0, value);
+  rasqal_free_literal(value);
+  y = rasqal_variables_table_add2(vt, RASQAL_VARIABLE_TYPE_NORMAL,
+                                  (const unsigned char*)"y", 0, NULL);
+  string = RASQAL_MALLOC(unsigned char*, 2);
+  memcpy(string, "a", 2);
+  value = rasqal_new_string_literal(world, string, NULL, NULL, NULL);
+  s = rasqal_variables_table_add2(vt, RASQAL_VARIABLE_TYPE_NORMAL,
+                                  (const unsigned char*)"s", 0, value);
+  rasqal_free_literal(value);
+  if(!x || !y || !s) {
+    failures++;
+    goto tidy;
+  }
+
+  /* ?x < 10 && BOUND(?y) */
+  exprs[0] = rasqal_new_2op_expression(world, RASQAL_EXPR_AND,
+                                       rasqal_new_2op_expression(world, RASQAL_EXPR_LT,
+                                                                 make_variable_expression(world, x),
+                                                                 make_integer_expression(world, 10)),
+                                       rasqal_new_1op_expression(world, RASQAL_EXPR_BOUND,
+                                                                 make_variable_expression(world, y)));
+  /* ?x + 2 = 7 */
+  exprs[1] = rasqal_new_2op_expression(world, RASQAL_EXPR_EQ,
+                                       rasqal_new_2op_expression(world, RASQAL_EXPR_PLUS,
+                                                                 make_variable_expression(world, x),
+                                                                 make_integer_expression(world, 2)),
+                                       make_integer_expression(world, 7));
+  /* !(?x > 3) || ?s */
+  exprs[2] = rasqal_new_2op_expression(world, RASQAL_EXPR_OR,
+                                       rasqal_new_1op_expression(world, RASQAL_EXPR_BANG,
+                                                                 rasqal_new_2op_expression(world, RASQAL_EXPR_GT,
+                                                                                           make_variable_expression(world, x),
+                                                                                           make_integer_expression(world, 3))),
+                                       make_variable_expression(world, s));
+  /* ?y = 1 */
+  exprs[3] = rasqal_new_2op_expression(world, RASQAL_EXPR_EQ,
+                                       make_variable_expression(world, y),
+                                       make_integer_expression(world, 1));
+  /* ?x * 2.5 > 12 */
+  exprs[4] = rasqal_new_2op_expression(world, RASQAL_EXPR_GT,
+                                       rasqal_new_2op_expression(world, RASQAL_EXPR_STAR,
+                                                                 make_variable_expression(world, x),
+                                                                 rasqal_new_literal_expression(world, rasqal_new_double_literal(world, 2.5))),
+                                       make_integer_expression(world, 12));
+  /* ?y || ?x >= 5 */
+  exprs[5] = rasqal_new_2op_expression(world, RASQAL_EXPR_OR,
+                                       make_variable_expression(world, y),
+                                       rasqal_new_2op_expression(world, RASQAL_EXPR_GE,
+                                                                 make_variable_expression(world, x),
+                                                                 make_integer_expression(world, 5)));
+  /* ?y && ?x != 5 */
+  exprs[6] = rasqal_new_2op_expression(world, RASQAL_EXPR_AND,
+                                       make_variable_expression(world, y),
+                                       rasqal_new_2op_expression(world, RASQAL_EXPR_NEQ,
+                                                                 make_variable_expression(world, x),
+                                                                 make_integer_expression(world, 5)));
+  /* -?x - 1 : interpreted UMINUS inside compiled MINUS */
+  exprs[7] = rasqal_new_2op_expression(world, RASQAL_EXPR_MINUS,
+                                       rasqal_new_1op_expression(world, RASQAL_EXPR_UMINUS,
+                                                                 make_variable_expression(world, x)),
+                                       make_integer_expression(world, 1));
+
+  for(i = 0; i < EXPR_TESTS_COUNT; i++) {
+    rasqal_expression_program* prog;
+    rasqal_literal* expected;
+    rasqal_literal* result;
+    int expected_error = 0;
+    int error = 0;
+    int expected_b;
+    int b;
+
+    if(!exprs[i]) {
+      fprintf(stderr, "%s: failed to make expression %d\n", program, i);
+      failures++;
+      continue;
+    }
+
+    prog = rasqal_new_expression_program(world, exprs[i]);
+    if(!prog) {
+      fprintf(stderr, "%s: failed to compile expression %d\n", program, i);
+      failures++;
+      continue;
+    }
+
+    expected = rasqal_expression_evaluate2(exprs[i], eval_context,
+                                           &expected_error);
+    result = rasqal_expression_program_evaluate(prog, eval_context, &error);
+    if(error != expected_error ||
+       (!error && (!result || !expected || result->type != expected->type ||
+                   !rasqal_literal_equals_flags(result, expected,
+                                                RASQAL_COMPARE_XQUERY,
+                                                &error)))) {
+      fprintf(stderr, "%s: expression %d returned ", program, i);
+      if(error)
+        fputs("error", stderr);
+      else
+        rasqal_literal_print(result, stderr);
+      fputs(" expected ", stderr);
+      if(expected_error)
+        fputs("error", stderr);
+      else
+        rasqal_literal_print(expected, stderr);
+      fputc('\n', stderr);
+      failures++;
+    }
+
+    /* boolean evaluation agrees with the literal value */
+    expected_b = 0;
+    if(!expected_error)
+      expected_b = rasqal_literal_as_boolean(expected, &expected_error);
+    error = 0;
+    b = rasqal_expression_program_evaluate_boolean(prog, eval_context, &error);
+    if(error != expected_error || (!error && b != expected_b)) {
+      fprintf(stderr,
+              "%s: expression %d boolean returned %d (error %d) expected %d (error %d)\n",
+              program, i, b, error, expected_b, expected_error);
+      failures++;
+    }
+
+    if(expected)
+      rasqal_free_literal(expected);
+    if(result)
+      rasqal_free_literal(result);
+    rasqal_free_expression_program(prog);
+  }
+
+  tidy:
+  for(i = 0; i < EXPR_TESTS_COUNT; i++) {
+    if(exprs[i])
+      rasqal_free_expression(exprs[i]);
+  }
+
+  if(x)
+    rasqal_free_variable(x);
+  if(y)
+    rasqal_free_variable(y);
+  if(s)
+    rasqal_free_variable(s);
+  if(vt)
+    rasqal_free_variables_table(vt);
+  if(eval_context)
+    rasqal_free_evaluation_context(eval_context);
+  if(world)
+    rasqal_free_world(world);
+
+  return failures;
+}
+
+#endif /* STANDALONE */
@@ -478,6 +478,335 @@ rasqal_expression_evaluate_sameterm(rasqal_expression *e,
 }
 
 
+/* IN lists shorter than this are compared one member at a time */
+#define RASQAL_IN_SET_MIN_SIZE 8
+
+/*
+ * rasqal_in_set:
+ *
+ * INTERNAL - The constant members of an IN / NOT IN list with a hash table
+ *
+ * URI, blank node, string and integer members are hashed with
+ * rasqal_literal_xquery_hash(); any other members are only in
+ * @literals.
+ */
+typedef struct rasqal_in_set_s
+{
+  /* IN or NOT IN expression; a reference is held so that no other
+   * expression can have the same address while the set is cached */
+  rasqal_expression* expr;
+
+  /* comparison flags the set was built for */
+  int flags;
+
+  /* non-0 if every member is a constant and the set can be used */
+  int constant;
+
+  /* member values in list order */
+  rasqal_literal** literals;
+  int size;
+
+  /* per member hash and hash chain */
+  unsigned int* hashes;
+  int* next;
+
+  /* hash table of chain heads (index into literals or -1) */
+  int* buckets;
+  unsigned int buckets_mask;
+
+  /* non-0 if all members that are not URIs or blank nodes are in the
+   * string (or integer) class of rasqal_literal_xquery_hash() */
+  int strings_only;
+  int integers_only;
+
+  struct rasqal_in_set_s* next_set;
+} rasqal_in_set;
+
+
+struct rasqal_in_set_cache_s
+{
+  rasqal_in_set* sets;
+};
+
+
+static void
+rasqal_free_in_set(rasqal_in_set* set)
+{
+  int i;
+
+  if(set->literals) {
+    for(i = 0; i < set->size; i++) {
+      if(set->literals[i])
+        rasqal_free_literal(set->literals[i]);
+    }
+    RASQAL_FREE(rasqal_literal**, set->literals);
+  }
+
+  if(set->hashes)
+    RASQAL_FREE(intarray, set->hashes);
+  if(set->next)
+    RASQAL_FREE(intarray, set->next);
+  if(set->buckets)
+    RASQAL_FREE(intarray, set->buckets);
+
+  if(set->expr)
+    rasqal_free_expression(set->expr);
+
+  RASQAL_FREE(rasqal_in_set, set);
+}
+
+
+/*
+ * rasqal_new_in_set_cache:
+ *
+ * INTERNAL - Constructor - create an empty cache of IN / NOT IN list sets
+ *
+ * Return value: new cache or NULL on failure
+ */
+rasqal_in_set_cache*
+rasqal_new_in_set_cache(void)
+{
+  return RASQAL_CALLOC(rasqal_in_set_cache*, 1, sizeof(rasqal_in_set_cache));
+}
+
+
+/*
+ * rasqal_free_in_set_cache:
+ * @cache: cache
+ *
+ * INTERNAL - Destructor - destroy a cache of IN / NOT IN list sets
+ */
+void
+rasqal_free_in_set_cache(rasqal_in_set_cache* cache)
+{
+  rasqal_in_set* set;
+  rasqal_in_set* next_set;
+
+  if(!cache)
+    return;
+
+  for(set = cache->sets; set; set = next_set) {
+    next_set = set->next_set;
+    rasqal_free_in_set(set);
+  }
+
+  RASQAL_FREE(rasqal_in_set_cache, cache);
+}
+
+
+/*
+ * rasqal_in_set_build:
+ * @set: set with expression and flags
+ * @eval_context: evaluation context
+ *
+ * INTERNAL - Evaluate the list members once and hash them
+ *
+ * Leaves @set->constant 0 if any member is not a constant or cannot
+ * be evaluated, so that the list is evaluated per row as before.
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_in_set_build(rasqal_in_set* set,
+                    rasqal_evaluation_context *eval_context)
+{
+  rasqal_expression* e = set->expr;
+  int size = raptor_sequence_size(e->args);
+  size_t buckets_count = 8;
+  int i;
+
+  for(i = 0; i < size; i++) {
+    rasqal_expression* arg_e;
+
+    arg_e = (rasqal_expression*)raptor_sequence_get_at(e->args, i);
+    if(arg_e->op != RASQAL_EXPR_LITERAL ||
+       arg_e->literal->type == RASQAL_LITERAL_VARIABLE)
+      return 0;
+  }
+
+  while(buckets_count < RASQAL_GOOD_CAST(size_t, size))
+    buckets_count <<= 1;
+
+  set->literals = RASQAL_CALLOC(rasqal_literal**, RASQAL_GOOD_CAST(size_t, size),
+                                sizeof(rasqal_literal*));
+  set->hashes = RASQAL_CALLOC(unsigned int*, RASQAL_GOOD_CAST(size_t, size),
+                              sizeof(unsigned int));
+  set->next = RASQAL_CALLOC(int*, RASQAL_GOOD_CAST(size_t, size), sizeof(int));
+  set->buckets = RASQAL_MALLOC(int*, buckets_count * sizeof(int));
+  if(!set->literals || !set->hashes || !set->next || !set->buckets)
+    return 1;
+
+  set->size = size;
+  set->buckets_mask = RASQAL_GOOD_CAST(unsigned int, buckets_count - 1);
+  for(i = 0; RASQAL_GOOD_CAST(size_t, i) < buckets_count; i++)
+    set->buckets[i] = -1;
+
+  set->strings_only = 1;
+  set->integers_only = 1;
+
+  for(i = 0; i < size; i++) {
+    rasqal_expression* arg_e;
+    rasqal_literal* l;
+    rasqal_literal_type type;
+    unsigned int hash = RASQAL_LITERAL_HASH_INIT;
+    int error = 0;
+
+    arg_e = (rasqal_expression*)raptor_sequence_get_at(e->args, i);
+    l = rasqal_expression_evaluate2(arg_e, eval_context, &error);
+    if(error || !l) {
+      if(l)
+        rasqal_free_literal(l);
+      return 0;
+    }
+
+    /* as rasqal_literal_equals_flags() would when comparing */
+    rasqal_literal_string_to_native(l, 0);
+    set->literals[i] = l;
+
+    type = rasqal_literal_xquery_hash(l, &hash);
+    if(type != RASQAL_LITERAL_STRING)
+      set->strings_only = set->strings_only && (type == RASQAL_LITERAL_URI ||
+                                                type == RASQAL_LITERAL_BLANK);
+    if(type != RASQAL_LITERAL_INTEGER)
+      set->integers_only = set->integers_only && (type == RASQAL_LITERAL_URI ||
+                                                  type == RASQAL_LITERAL_BLANK);
+
+    set->next[i] = -1;
+    if(type != RASQAL_LITERAL_UNKNOWN) {
+      unsigned int bucket = hash & set->buckets_mask;
+
+      set->hashes[i] = hash;
+      set->next[i] = set->buckets[bucket];
+      set->buckets[bucket] = i;
+    }
+  }
+
+  set->constant = 1;
+
+  return 0;
+}
+
+
+/*
+ * rasqal_in_set_get:
+ * @e: IN or NOT IN expression
+ * @eval_context: evaluation context
+ *
+ * INTERNAL - Get the cached set of the constant members of an IN list
+ *
+ * The set is built the first time the expression is evaluated with
+ * @eval_context.  Only XQuery value comparisons can use a set.
+ *
+ * Return value: set or NULL if the list must be evaluated per row
+ */
+static rasqal_in_set*
+rasqal_in_set_get(rasqal_expression *e,
+                  rasqal_evaluation_context *eval_context)
+{
+  rasqal_evaluation_context_private* ecp;
+  rasqal_in_set_cache* cache;
+  rasqal_in_set* set;
+  int flags = eval_context->flags;
+
+  ecp = rasqal_evaluation_context_get_private(eval_context);
+  cache = ecp ? ecp->in_set_cache : NULL;
+  if(!cache || raptor_sequence_size(e->args) < RASQAL_IN_SET_MIN_SIZE)
+    return NULL;
+
+  if((flags & (RASQAL_COMPARE_XQUERY | RASQAL_COMPARE_RDF |
+               RASQAL_COMPARE_NOCASE)) != RASQAL_COMPARE_XQUERY)
+    return NULL;
+
+  for(set = cache->sets; set; set = set->next_set) {
+    if(set->expr == e && set->flags == flags)
+      return set->constant ? set : NULL;
+  }
+
+  set = RASQAL_CALLOC(rasqal_in_set*, 1, sizeof(*set));
+  if(!set)
+    return NULL;
+
+  set->expr = rasqal_new_expression_from_expression(e);
+  set->flags = flags;
+
+  if(rasqal_in_set_build(set, eval_context)) {
+    rasqal_free_in_set(set);
+    return NULL;
+  }
+
+  if(!set->constant) {
+    /* remember that this list cannot be a set; values are not needed */
+    int i;
+
+    for(i = 0; i < set->size; i++) {
+      if(set->literals[i]) {
+        rasqal_free_literal(set->literals[i]);
+        set->literals[i] = NULL;
+      }
+    }
+  }
+
+  set->next_set = cache->sets;
+  cache->sets = set;
+
+  return set->constant ? set : NULL;
+}
+
+
+/*
+ * rasqal_in_set_contains:
+ * @set: set
+ * @l1: value to look for
+ * @error_p: pointer to error flag
+ *
+ * INTERNAL - Check if a value equals a member of an IN list set
+ *
+ * Gives the same result and errors as comparing @l1 with each member
+ * in turn.  URIs and blank nodes never compare with an error against
+ * other terms, nor strings with strings or integers with integers,
+ * so for those the hash table can be used.  Other values are
+ * compared with every member in order.
+ *
+ * Return value: non-0 if found
+ */
+static int
+rasqal_in_set_contains(rasqal_in_set* set, rasqal_literal* l1, int *error_p)
+{
+  rasqal_literal_type type;
+  unsigned int hash = RASQAL_LITERAL_HASH_INIT;
+  int found = 0;
+  int i;
+
+  rasqal_literal_string_to_native(l1, 0);
+
+  type = rasqal_literal_xquery_hash(l1, &hash);
+  if(type == RASQAL_LITERAL_URI || type == RASQAL_LITERAL_BLANK ||
+     (type == RASQAL_LITERAL_STRING && set->strings_only) ||
+     (type == RASQAL_LITERAL_INTEGER && set->integers_only)) {
+    for(i = set->buckets[hash & set->buckets_mask]; i >= 0; i = set->next[i]) {
+      if(set->hashes[i] != hash)
+        continue;
+
+      found = (rasqal_literal_equals_flags(l1, set->literals[i],
+                                           set->flags, error_p) != 0);
+      if((error_p && *error_p) || found)
+        break;
+    }
+
+    return found;
+  }
+
+  for(i = 0; i < set->size; i++) {
+    found = (rasqal_literal_equals_flags(l1, set->literals[i],
+                                         set->flags, error_p) != 0);
+    if((error_p && *error_p) || found)
+      break;
+  }
+
+  return found;
+}
+
+
 /* 
  * rasqal_expression_evaluate_in_set:
  * @e: The expression to evaluate.
@@ -497,11 +826,22 @@ rasqal_expression_evaluate_in_set(rasqal_expression *e,
   int size = raptor_sequence_size(e->args);
   int i;
   rasqal_literal* l1;
+  rasqal_in_set* set;
   int found = 0;
 
   l1 = rasqal_expression_evaluate2(e->arg1, eval_context, error_p);
   if((error_p && *error_p) || !l1)
     goto failed;
+
+  set = rasqal_in_set_get(e, eval_context);
+  if(set) {
+    found = rasqal_in_set_contains(set, l1, error_p);
+    if(error_p && *error_p)
+      goto failed;
+
+    /* skip the per-member loop */
+    size = 0;
+  }
   
   for(i = 0; i < size; i++) {
     rasqal_expression* arg_e;
@@ -779,6 +779,7 @@ rasqal_expression_evaluate_strmatch(rasqal_expression *e,
                                     int *error_p)
 {
   rasqal_world* world = eval_context->world;
+  rasqal_evaluation_context_private* ecp;
   int b = 0;
   const unsigned char *l1_str;
   const char *match_string;
@@ -825,9 +826,23 @@ rasqal_expression_evaluate_strmatch(rasqal_expression *e,
   }
   pattern = RASQAL_GOOD_CAST(const char*, l2->string);
 
-  rc = rasqal_regex_match(world, eval_context->locator,
-                          pattern, regex_flags,
-                          match_string, match_len);
+  ecp = rasqal_evaluation_context_get_private(eval_context);
+  if(ecp && ecp->regex_cache) {
+    /* compile each pattern once per evaluation context */
+    rasqal_regex* regex;
+
+    regex = rasqal_regex_cache_get(ecp->regex_cache,
+                                   eval_context->locator,
+                                   pattern, regex_flags);
+    if(regex)
+      rc = rasqal_regex_exec(regex, eval_context->locator,
+                             match_string, match_len);
+    else
+      rc = -1;
+  } else
+    rc = rasqal_regex_match(world, eval_context->locator,
+                            pattern, regex_flags,
+                            match_string, match_len);
 
 #ifdef RASQAL_DEBUG
   if(rc >= 0)
@@ -1117,6 +1132,7 @@ rasqal_expression_evaluate_replace(rasqal_expression *e,
                                    int *error_p)
 {
   rasqal_world* world = eval_context->world;
+  rasqal_evaluation_context_private* ecp;
   const unsigned char *tmp_str;
   const char *match;
   const char *pattern;
@@ -1170,12 +1186,26 @@ rasqal_expression_evaluate_replace(rasqal_expression *e,
     regex_flags = RASQAL_GOOD_CAST(const char*, l4->string);
   }
 
-  result_s = rasqal_regex_replace(world, eval_context->locator,
-                                  pattern,
-                                  regex_flags,
-                                  match, match_len,
-                                  replace, replace_len,
-                                  &result_len);
+  ecp = rasqal_evaluation_context_get_private(eval_context);
+  if(ecp && ecp->regex_cache) {
+    /* compile each pattern once per evaluation context */
+    rasqal_regex* regex;
+
+    regex = rasqal_regex_cache_get(ecp->regex_cache,
+                                   eval_context->locator,
+                                   pattern, regex_flags);
+    if(regex)
+      result_s = rasqal_regex_substitute(regex, eval_context->locator,
+                                         match, match_len,
+                                         replace, replace_len,
+                                         &result_len);
+  } else
+    result_s = rasqal_regex_replace(world, eval_context->locator,
+                                    pattern,
+                                    regex_flags,
+                                    match, match_len,
+                                    replace, replace_len,
+                                    &result_len);
   
   RASQAL_DEBUG6("regex replace returned %s for '%s' from '%s' to '%s' (flags=%s)\n", result_s ? result_s : "NULL", match, pattern, replace, regex_flags ? RASQAL_GOOD_CAST(char*, regex_flags) : "");
   
@@ -57,7 +57,9 @@ static const struct
   const char *label;
 } rasqal_features_list [RASQAL_FEATURE_LAST + 1]= {
   { RASQAL_FEATURE_NO_NET,    1,  "noNet",    "Deny network requests." } ,
-  { RASQAL_FEATURE_RAND_SEED, 1,  "randSeed", "Set rand() seed." }
+  { RASQAL_FEATURE_RAND_SEED, 1,  "randSeed", "Set rand() seed." },
+  { RASQAL_FEATURE_PROFILE,   1,  "profile",  "Record operator times and row memory." },
+  { RASQAL_FEATURE_SORT_MEMORY_LIMIT, 1, "sortMemoryLimit", "Kilobytes of rows to sort in memory before spilling to temporary files." }
 };
 
 
@@ -505,11 +505,15 @@ rasqal_rowsource_sv_process(rasqal_rowsource_sv_context* con)
   /* do some parsing - need some results */
   while(!raptor_iostream_read_eof(con->iostr)) {
     size_t read_len;
+    int rc;
 
-    read_len = RASQAL_BAD_CAST(size_t,
-                               raptor_iostream_read_bytes(RASQAL_GOOD_CAST(char*, con->buffer), 1,
-                                                          FILE_READ_BUF_SIZE,
-                                                          con->iostr));
+    rc = raptor_iostream_read_bytes(RASQAL_GOOD_CAST(char*, con->buffer), 1,
+                                    FILE_READ_BUF_SIZE, con->iostr);
+    if(rc < 0) {
+      con->failed++;
+      break;
+    }
+    read_len = RASQAL_GOOD_CAST(size_t, rc);
     if(read_len > 0) {
       sv_status_t status;
 
@@ -230,6 +230,14 @@ rasqal_free_world(rasqal_world* world)
   if(!world)
     return;
   
+  /* cached queries refer to the query language factories */
+  rasqal_world_finish_query_cache(world);
+
+  rasqal_world_finish_thread_pool(world);
+
+  /* abandoned SERVICE fetches use the raptor WWW initialisation */
+  rasqal_world_finish_service_fetches(world);
+
   rasqal_finish_result_formats(world);
   rasqal_finish_query_results();
 
@@ -243,6 +251,9 @@ rasqal_free_world(rasqal_world* world)
 
   rasqal_uri_finish(world);
 
+  /* after everything that may free literals or rows */
+  rasqal_world_finish_pools(world);
+
   if(world->raptor_world_ptr && world->raptor_world_allocated_here)
     raptor_free_world(world->raptor_world_ptr);
 
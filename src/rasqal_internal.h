@@ -593,6 +593,23 @@ struct rasqal_query_s {
 
   /* Variable projection (or NULL when invalid such as for ASK) */
   rasqal_projection* projection;
+
+  /* INTERNAL variables given values by rasqal_query_set_variable2()
+   * and their values in the same order; the values are restored at
+   * the start of each execution */
+  raptor_sequence* parameters;
+  raptor_sequence* parameter_values;
+
+  /* INTERNAL query algebra built by the first execution and reused
+   * by later executions (or NULL) */
+  struct rasqal_algebra_node_s* algebra_node;
+
+  /* INTERNAL sequence of the @triples pointers in the order they are
+   * matched, with the triple patterns of each BGP reordered by
+   * estimated selectivity (or NULL if not reordered).  Shares the
+   * triples with @triples, which keeps the order the query was written
+   * in.  See rasqal_query_get_plan_triple_sequence() */
+  raptor_sequence* plan_triples;
 };
 
 
@@ -636,6 +653,18 @@ typedef struct rasqal_rowsource_s rasqal_rowsource;
 
 #define RASQAL_ROW_FLAG_WEAK_ROWSOURCE 0x01
 
+/*
+ * A binary-comparable sort key for one ORDER BY value.  Two keys made
+ * for values of the same @type order with memcmp() exactly as the
+ * values do with rasqal_literal_compare().  @type is
+ * RASQAL_LITERAL_UNKNOWN when the value has no key.
+ */
+typedef struct {
+  rasqal_literal_type type;
+  size_t len;
+  const unsigned char* bytes;
+} rasqal_order_key;
+
 /*
  * A row of values from a query result, usually generated by a rowsource
  */
@@ -658,34 +687,48 @@ struct rasqal_row_s {
   int order_size;
   rasqal_literal** order_values;
 
+  /* sort keys for the order values (or NULL if not calculated) */
+  rasqal_order_key* order_keys;
+
   /* Group ID */
   int group_id;
 
   /* Bit mask of flags: bit 0 = WEAK ROWSOURCE */
   unsigned int flags;
+
+  /* world owning the row and values storage */
+  rasqal_world* world;
 };
 
 
 typedef struct rasqal_map_s rasqal_map;
 
+typedef struct rasqal_thread_pool_s rasqal_thread_pool;
+
+typedef struct rasqal_service_fetches_s rasqal_service_fetches;
+
 /**
  * rasqal_join_type:
  * @RASQAL_JOIN_TYPE_UNKNOWN: unknown join type
  * @RASQAL_JOIN_TYPE_NATURAL: natural join.  returns compatible rows and no NULLs
  * @RASQAL_JOIN_TYPE_LEFT: left join.  returns compatible rows plus rows from left rowsource that are not compatible or fail filter condition
+ * @RASQAL_JOIN_TYPE_MINUS: minus (anti) join.  returns rows from left rowsource that have no compatible right row sharing a bound variable
  *
  * Rowsource join type.
  */
 typedef enum {
   RASQAL_JOIN_TYPE_UNKNOWN,
   RASQAL_JOIN_TYPE_NATURAL,
-  RASQAL_JOIN_TYPE_LEFT
+  RASQAL_JOIN_TYPE_LEFT,
+  RASQAL_JOIN_TYPE_MINUS
 } rasqal_join_type;
 
 
 
 /* rasqal_rowsource_aggregation.c */
 rasqal_rowsource* rasqal_new_aggregation_rowsource(rasqal_world *world, rasqal_query* query, rasqal_rowsource* rowsource, raptor_sequence* exprs_seq, raptor_sequence* vars_seq);
+int rasqal_aggregation_expressions_can_stream(raptor_sequence* exprs_seq);
+rasqal_rowsource* rasqal_new_streaming_aggregation_rowsource(rasqal_world *world, rasqal_query* query, rasqal_rowsource* rowsource, raptor_sequence* group_exprs_seq, raptor_sequence* exprs_seq, raptor_sequence* vars_seq);
 
 /* rasqal_rowsource_empty.c */
 rasqal_rowsource* rasqal_new_empty_rowsource(rasqal_world *world, rasqal_query* query);
@@ -717,6 +760,9 @@ rasqal_rowsource* rasqal_new_having_rowsource(rasqal_world *world, rasqal_query
 /* rasqal_rowsource_join.c */
 rasqal_rowsource* rasqal_new_join_rowsource(rasqal_world *world, rasqal_query* query, rasqal_rowsource* left, rasqal_rowsource* right, rasqal_join_type join_type, rasqal_expression *expr);
 
+/* rasqal_rowsource_hashjoin.c */
+rasqal_rowsource* rasqal_new_hashjoin_rowsource(rasqal_world *world, rasqal_query* query, rasqal_rowsource* left, rasqal_rowsource* right, rasqal_join_type join_type, rasqal_expression *expr);
+
 /* rasqal_rowsource_project.c */
 rasqal_rowsource* rasqal_new_project_rowsource(rasqal_world *world, rasqal_query *query, rasqal_rowsource* rowsource, raptor_sequence* projection_variables);
 
@@ -728,12 +774,13 @@ rasqal_rowsource* rasqal_new_slice_rowsource(rasqal_world *world, rasqal_query *
 
 /* rasqal_rowsource_service.c */
 rasqal_rowsource* rasqal_new_service_rowsource(rasqal_world *world, rasqal_query* query, raptor_uri* service_uri, const unsigned char* query_string, raptor_sequence* data_graphs, unsigned int rs_flags);
+rasqal_rowsource* rasqal_new_service_rowsource_from_service(rasqal_world *world, rasqal_query* query, rasqal_service* svc, unsigned int rs_flags);
   
 /* rasqal_rowsource_sort.c */
-rasqal_rowsource* rasqal_new_sort_rowsource(rasqal_world *world, rasqal_query *query, rasqal_rowsource *rowsource, raptor_sequence* order_seq, int distinct);
+rasqal_rowsource* rasqal_new_sort_rowsource(rasqal_world *world, rasqal_query *query, rasqal_rowsource *rowsource, raptor_sequence* order_seq, int distinct, int limit);
 
 /* rasqal_rowsource_triples.c */
-rasqal_rowsource* rasqal_new_triples_rowsource(rasqal_world *world, rasqal_query* query, rasqal_triples_source* triples_source, raptor_sequence* triples, int start_column, int end_column);
+rasqal_rowsource* rasqal_new_triples_rowsource(rasqal_world *world, rasqal_query* query, rasqal_triples_source* triples_source, raptor_sequence* triples, int start_column, int end_column, rasqal_expression** column_exprs);
 
 /* rasqal_rowsource_union.c */
 rasqal_rowsource* rasqal_new_union_rowsource(rasqal_world *world, rasqal_query* query, rasqal_rowsource* left, rasqal_rowsource* right);
@@ -909,9 +956,14 @@ typedef struct rasqal_results_compare_s rasqal_results_compare;
  * @rows_sequence for reset operation
  *
  * RASQAL_ROWSOURCE_FLAGS_SAVED_ROWS: have saved rows ready for reply
+ *
+ * RASQAL_ROWSOURCE_FLAGS_PROFILE: record wall clock time spent in
+ * the handler read methods in @elapsed and the size of rows held in
+ * @held_bytes
  */
 #define RASQAL_ROWSOURCE_FLAGS_SAVE_ROWS  0x01
 #define RASQAL_ROWSOURCE_FLAGS_SAVED_ROWS 0x02
+#define RASQAL_ROWSOURCE_FLAGS_PROFILE    0x04
 
 /**
  * rasqal_rowsource:
@@ -930,6 +982,12 @@ typedef struct rasqal_results_compare_s rasqal_results_compare;
  * @offset: size of @rows_sequence
  * @generate_group: non-0 to generate a group (ID 0) around all the returned rows, if there is no grouping returned.
  * @usage: reference count
+ * @rows_produced: number of rows returned by the handler over all resets
+ * @resets: number of times rasqal_rowsource_reset() has been called
+ * @elapsed: seconds spent in handler read methods (including inner rowsources) if flag RASQAL_ROWSOURCE_FLAGS_PROFILE is set
+ * @calls: number of calls to the handler read methods
+ * @held_bytes: estimated bytes of rows held since the last reset if flag RASQAL_ROWSOURCE_FLAGS_PROFILE is set
+ * @held_bytes_peak: largest value of @held_bytes
  *
  * Rasqal Row Source class providing a sequence of rows of values similar to a SQL table.
  *
@@ -993,6 +1051,18 @@ struct rasqal_rowsource_s
   unsigned int generate_group : 1;
 
   int usage;
+
+  int rows_produced;
+
+  int resets;
+
+  double elapsed;
+
+  int calls;
+
+  size_t held_bytes;
+
+  size_t held_bytes_peak;
 };
 
 
@@ -1019,6 +1089,10 @@ int rasqal_rowsource_ensure_variables(rasqal_rowsource *rowsource);
 int rasqal_rowsource_set_origin(rasqal_rowsource* rowsource, rasqal_literal *literal);
 int rasqal_rowsource_request_grouping(rasqal_rowsource* rowsource);
 void rasqal_rowsource_remove_all_variables(rasqal_rowsource *rowsource);
+int rasqal_rowsource_set_profile(rasqal_rowsource* rowsource, int profile);
+void rasqal_rowsource_hold_row(rasqal_rowsource* rowsource, rasqal_row* row);
+void rasqal_rowsource_hold_rows(rasqal_rowsource* rowsource, raptor_sequence* seq);
+int rasqal_rowsource_visit_profile(rasqal_rowsource* rowsource, rasqal_operator_profile_handler handler, void* user_data);
 
 typedef struct rasqal_query_results_format_factory_s rasqal_query_results_format_factory;
 
@@ -1126,6 +1200,23 @@ unsigned char* rasqal_world_generate_bnodeid(rasqal_world* world, unsigned char
 int rasqal_world_reset_now(rasqal_world* world);
 struct timeval* rasqal_world_get_now_timeval(rasqal_world* world);
 
+/* rasqal_query_cache.c */
+void rasqal_world_finish_query_cache(rasqal_world* world);
+
+/* rasqal_thread_pool.c */
+typedef void (*rasqal_thread_task_handler)(void* task);
+void rasqal_thread_pool_run(rasqal_world* world, rasqal_thread_task_handler handler, void** tasks, int count);
+void rasqal_world_finish_thread_pool(rasqal_world* world);
+
+/* rasqal_pool.c */
+rasqal_literal* rasqal_pool_alloc_literal(rasqal_world* world);
+void rasqal_pool_free_literal(rasqal_world* world, rasqal_literal* l);
+rasqal_row* rasqal_pool_alloc_row(rasqal_world* world);
+void rasqal_pool_free_row(rasqal_world* world, rasqal_row* row);
+rasqal_literal** rasqal_pool_alloc_values(rasqal_world* world, int size);
+void rasqal_pool_free_values(rasqal_world* world, rasqal_literal** values, int size);
+void rasqal_world_finish_pools(rasqal_world* world);
+
 
 typedef enum {
   /* Warnings in 0..100 range.  Warn if LEVEL < world->warning_level */
@@ -1206,6 +1297,7 @@ int rasqal_query_build_anonymous_variables(rasqal_query* rq);
 int rasqal_query_expand_wildcards(rasqal_query* rq, rasqal_projection* projection);
 int rasqal_query_remove_duplicate_select_vars(rasqal_query* rq, rasqal_projection* projection);
 int rasqal_query_build_variables_use(rasqal_query* query, rasqal_projection* projection);
+int rasqal_query_reorder_triple_patterns_by_statistics(rasqal_query* query, rasqal_triples_source* triples_source);
 int rasqal_query_prepare_common(rasqal_query *query);
 int rasqal_query_merge_graph_patterns(rasqal_query* query, rasqal_graph_pattern* gp, void* data);
 int rasqal_graph_patterns_join(rasqal_graph_pattern *dest_gp, rasqal_graph_pattern *src_gp);
@@ -1217,6 +1309,30 @@ int rasqal_double_approximately_compare(double a, double b);
 int rasqal_double_approximately_equal(double a, double b);
 
 /* rasqal_expr.c */
+
+typedef struct rasqal_regex_cache_s rasqal_regex_cache;
+typedef struct rasqal_in_set_cache_s rasqal_in_set_cache;
+
+/*
+ * rasqal_evaluation_context_private:
+ * @context: public evaluation context; must be first
+ * @regex_cache: compiled regex cache
+ * @in_set_cache: IN / NOT IN list set cache
+ *
+ * INTERNAL - An evaluation context made by rasqal_new_evaluation_context()
+ *
+ * The caches are kept here rather than in the public
+ * #rasqal_evaluation_context so that its size does not change.
+ * Contexts allocated by callers have no caches.
+ */
+typedef struct {
+  rasqal_evaluation_context context;
+  rasqal_regex_cache* regex_cache;
+  rasqal_in_set_cache* in_set_cache;
+} rasqal_evaluation_context_private;
+
+rasqal_evaluation_context_private* rasqal_evaluation_context_get_private(rasqal_evaluation_context* eval_context);
+
 rasqal_literal* rasqal_new_string_literal_node(rasqal_world*, const unsigned char *string, const char *language, raptor_uri *datatype);
 int rasqal_literal_as_boolean(rasqal_literal* literal, int* error_p);
 int rasqal_literal_as_integer(rasqal_literal* l, int* error_p);
@@ -1247,6 +1363,15 @@ int rasqal_literal_sequence_equals(raptor_sequence* values_a, raptor_sequence* v
 
 /* rasqal_expr_evaluate.c */
 int rasqal_language_matches(const unsigned char* lang_tag, const unsigned char* lang_range);
+rasqal_in_set_cache* rasqal_new_in_set_cache(void);
+void rasqal_free_in_set_cache(rasqal_in_set_cache* cache);
+
+/* rasqal_expr_compile.c */
+typedef struct rasqal_expression_program_s rasqal_expression_program;
+rasqal_expression_program* rasqal_new_expression_program(rasqal_world* world, rasqal_expression* e);
+void rasqal_free_expression_program(rasqal_expression_program* program);
+rasqal_literal* rasqal_expression_program_evaluate(rasqal_expression_program* program, rasqal_evaluation_context* eval_context, int* error_p);
+int rasqal_expression_program_evaluate_boolean(rasqal_expression_program* program, rasqal_evaluation_context* eval_context, int* error_p);
 
 /* rasqal_expr_datetimes.c */
 rasqal_literal* rasqal_expression_evaluate_now(rasqal_expression *e, rasqal_evaluation_context *eval_context, int *error_p);
@@ -1363,6 +1488,11 @@ void rasqal_expression_write_op(rasqal_expression* e, raptor_iostream* iostr);
 void rasqal_expression_write(rasqal_expression* e, raptor_iostream* iostr);
 int rasqal_literal_write_turtle(rasqal_literal* l, raptor_iostream* iostr);
 int rasqal_literal_array_equals(rasqal_literal** values_a, rasqal_literal** values_b, int size);
+/* FNV-1a 32 bit offset basis */
+#define RASQAL_LITERAL_HASH_INIT 2166136261U
+unsigned int rasqal_literal_rdf_term_hash(rasqal_literal* l, unsigned int hash);
+int rasqal_literal_value_hash(rasqal_literal* l, unsigned int* hash_p);
+rasqal_literal_type rasqal_literal_xquery_hash(rasqal_literal* l, unsigned int* hash_p);
 int rasqal_literal_array_compare(rasqal_literal** values_a, rasqal_literal** values_b, raptor_sequence* exprs_seq, int size, int compare_flags);
 int rasqal_literal_array_compare_by_order(rasqal_literal** values_a, rasqal_literal** values_b, int* order, int size, int compare_flags);
 rasqal_map* rasqal_new_literal_sequence_sort_map(int is_distinct, int compare_flags);
@@ -1372,6 +1502,8 @@ rasqal_literal* rasqal_new_literal_from_term(rasqal_world* world, raptor_term* t
 int rasqal_literal_string_datatypes_compare(rasqal_literal* l1, rasqal_literal* l2);
 int rasqal_literal_string_languages_compare(rasqal_literal* l1, rasqal_literal* l2);
 int rasqal_literal_is_string(rasqal_literal* l1);
+int rasqal_literal_write_binary(rasqal_literal* l, FILE* fh);
+rasqal_literal* rasqal_new_literal_from_binary(rasqal_world* world, FILE* fh, int* error_p);
 
 /* rasqal_map.c */
 typedef void (*rasqal_map_visit_fn)(void *key, void *value, void *user_data);
@@ -1394,12 +1526,16 @@ void rasqal_query_set_base_uri(rasqal_query* rq, raptor_uri* base_uri);
 rasqal_variable* rasqal_query_get_variable_by_offset(rasqal_query* query, int idx);
 const rasqal_query_execution_factory* rasqal_query_get_engine_by_name(const char* name);
 int rasqal_query_variable_is_bound(rasqal_query* query, rasqal_variable* v);
+int rasqal_query_variable_is_parameter(rasqal_query* query, rasqal_variable* v);
+rasqal_literal* rasqal_query_get_parameter_value(rasqal_query* query, rasqal_variable* v);
+int rasqal_query_reset_variables(rasqal_query* query);
 rasqal_triple_parts rasqal_query_variable_bound_in_triple(rasqal_query* query, rasqal_variable* v, int column);
 int rasqal_query_store_select_query(rasqal_query* query, rasqal_projection* projection, raptor_sequence* data_graphs, rasqal_graph_pattern* where_gp, rasqal_solution_modifier* modifier);
 int rasqal_query_reset_select_query(rasqal_query* query);
 rasqal_projection* rasqal_query_get_projection(rasqal_query* query);
 int rasqal_query_set_projection(rasqal_query* query, rasqal_projection* projection);
 int rasqal_query_set_modifier(rasqal_query* query, rasqal_solution_modifier* modifier);
+raptor_sequence* rasqal_query_get_plan_triple_sequence(rasqal_query* query);
 
 /* rasqal_query_results.c */
 int rasqal_init_query_results(void);
@@ -1455,10 +1591,13 @@ rasqal_row* rasqal_new_row_from_row_deep(rasqal_row* row);
 int rasqal_row_print(rasqal_row* row, FILE* fh);
 int rasqal_row_write(rasqal_row* row, raptor_iostream* iostr);
 raptor_sequence* rasqal_new_row_sequence(rasqal_world* world, rasqal_variables_table* vt, const char* const row_data[], int vars_count, raptor_sequence** vars_seq_p);
+rasqal_rowsource* rasqal_new_row_sequence_rowsource(rasqal_world* world, rasqal_query* query, const char* const row_data[], int vars_count);
 int rasqal_row_to_nodes(rasqal_row* row);
 void rasqal_row_set_values_from_variables_table(rasqal_row* row, rasqal_variables_table* vars_table);
 int rasqal_row_set_order_size(rasqal_row *row, int order_size);
 int rasqal_row_expand_size(rasqal_row *row, int size);
+int rasqal_row_write_binary(rasqal_row* row, FILE* fh);
+rasqal_row* rasqal_new_row_from_binary(rasqal_rowsource* rowsource, FILE* fh);
 int rasqal_row_bind_variables(rasqal_row* row, rasqal_variables_table* vars_table);
 raptor_sequence* rasqal_row_sequence_copy(raptor_sequence *seq);
 void rasqal_row_set_rowsource(rasqal_row* row, rasqal_rowsource* rowsource);
@@ -1477,6 +1616,7 @@ int rasqal_reset_triple_meta(rasqal_triple_meta* m);
 void rasqal_free_triples_source(rasqal_triples_source *rts);
 int rasqal_triples_source_triple_present(rasqal_triples_source *rts, rasqal_triple *t);
 int rasqal_triples_source_support_feature(rasqal_triples_source *rts, rasqal_triples_source_feature feature);
+int rasqal_triples_source_get_statistic(rasqal_triples_source *rts, rasqal_triples_source_statistic statistic, rasqal_triple *t, long *count_p, int *exact_p);
 
 rasqal_triples_match* rasqal_new_triples_match(rasqal_query* query, rasqal_triples_source* triples_source, rasqal_triple_meta *m, rasqal_triple *t);
 rasqal_triple_parts rasqal_triples_match_bind_match(struct rasqal_triples_match_s* rtm, rasqal_variable *bindings[4],rasqal_triple_parts parts);
@@ -1504,6 +1644,28 @@ int rasqal_xsd_boolean_value_from_string(const unsigned char* string);
 
 typedef struct rasqal_graph_factory_s rasqal_graph_factory;
 
+/* largest row values array width kept in a pool */
+#define RASQAL_POOL_VALUES_SIZES 16
+
+/* most free objects kept in one pool */
+#define RASQAL_POOL_MAX_FREE 4096
+
+/*
+ * rasqal_pool:
+ *
+ * Free list of equal sized objects owned by a #rasqal_world
+ */
+typedef struct {
+  /* first free object; each holds the pointer to the next */
+  void* free_list;
+  int count;
+#ifdef RASQAL_POOL_STATS
+  /* allocations served from the free list / from malloc */
+  unsigned long hits;
+  unsigned long misses;
+#endif
+} rasqal_pool;
+
 /* rasqal_world structure */
 struct rasqal_world_s {
   /* opened flag */
@@ -1558,6 +1720,38 @@ struct rasqal_world_s {
 
   /* generated counter - increments at every generation */
   int genid_counter;
+
+  /* prepared query cache: sequence of entries, most recently used
+   * first, holding at most query_cache_size queries.  NULL when the
+   * cache is disabled
+   */
+  raptor_sequence* query_cache;
+  int query_cache_size;
+
+  /* prepared query cache lookups found / not found */
+  unsigned long query_cache_hits;
+  unsigned long query_cache_misses;
+
+  /* free lists of literal and row storage and of row values arrays
+   * (values_pools[i] holds arrays of i + 1 entries)
+   */
+  rasqal_pool literal_pool;
+  rasqal_pool row_pool;
+  rasqal_pool values_pools[RASQAL_POOL_VALUES_SIZES];
+
+  /* threads used for parallel work including the calling thread and
+   * the pool of worker threads; NULL when only the calling thread is
+   * used
+   */
+  int thread_pool_size;
+  rasqal_thread_pool* thread_pool;
+
+  /* SERVICE requests of a query execution fetched in the background;
+   * 0 when disabled
+   */
+  int service_prefetch_size;
+  /* background SERVICE fetch threads still running (or NULL) */
+  rasqal_service_fetches* service_fetches;
 };
 
 
@@ -1615,6 +1809,12 @@ struct rasqal_algebra_node_s {
   raptor_sequence* triples;
   int start_column;
   int end_column;
+
+  /* type BGP: array of FILTER expressions, one per triple pattern
+   * (index column - start_column) or NULL, to evaluate as soon as that
+   * triple pattern is matched.  The array may be NULL.
+   */
+  rasqal_expression** column_exprs;
   
   /* types JOIN, DIFF, LEFTJOIN, UNION, ORDERBY: node1 and node2 ALWAYS present
    * types FILTER, TOLIST: node1 ALWAYS present, node2 ALWAYS NULL
@@ -1840,6 +2040,13 @@ struct rasqal_query_execution_factory_s {
   /* finish the query execution factory */
   void (*finish_factory)(rasqal_query_execution_factory* factory);
 
+  /*
+   * @ex_data: execution data
+   *
+   * Get the rowsource tree executing the query (or NULL) for
+   * reading the runtime counters.  May be NULL.
+   */
+  rasqal_rowsource* (*get_rowsource)(void* ex_data);
 };
 
 
@@ -1854,7 +2061,10 @@ const char* rasqal_engine_error_as_string(rasqal_engine_error error);
 rasqal_map* rasqal_engine_new_rowsort_map(int is_distinct, int compare_flags, raptor_sequence* order_conditions_sequence);
 int rasqal_engine_rowsort_map_add_row(rasqal_map* map, rasqal_row* row);
 raptor_sequence* rasqal_engine_rowsort_map_to_sequence(rasqal_map* map, raptor_sequence* seq);
-int rasqal_engine_rowsort_calculate_order_values(rasqal_query* query, raptor_sequence* order_seq, rasqal_row* row);
+int rasqal_engine_rowsort_calculate_order_values(rasqal_query* query, raptor_sequence* order_seq, rasqal_expression_program** programs, rasqal_row* row);
+int rasqal_engine_rowsort_calculate_order_keys(rasqal_row* row, int compare_flags);
+int rasqal_engine_rowsort_compare_rows(rasqal_row* row_a, rasqal_row* row_b, raptor_sequence* order_seq, int compare_flags);
+raptor_sequence* rasqal_engine_rowsort_sort_sequence(rasqal_world* world, raptor_sequence* seq, raptor_sequence* order_conditions_sequence, int compare_flags);
 
 
 /* rasqal_engine_algebra.c */
@@ -1867,6 +2077,8 @@ raptor_iostream* rasqal_new_iostream_from_stringbuffer(raptor_world *raptor_worl
 
 /* rasqal_service.c */
 rasqal_rowsource* rasqal_service_execute_as_rowsource(rasqal_service* svc, rasqal_variables_table* vars_table);
+int rasqal_service_start(rasqal_service* svc);
+void rasqal_world_finish_service_fetches(rasqal_world* world);
 
 /* rasqal_triples_source.c */
 void rasqal_triples_source_error_handler(rasqal_query* rdf_query, raptor_locator* locator, const char* message);
@@ -1898,7 +2110,16 @@ raptor_sequence* rasqal_projection_get_variables_sequence(rasqal_projection* pro
 int rasqal_projection_add_variable(rasqal_projection* projection, rasqal_variable* var);
 
 /* rasqal_regex.c */
+typedef struct rasqal_regex_s rasqal_regex;
+
+rasqal_regex* rasqal_new_regex(rasqal_world* world, raptor_locator* locator, const char* pattern, const char* regex_flags);
+void rasqal_free_regex(rasqal_regex* regex);
+int rasqal_regex_exec(rasqal_regex* regex, raptor_locator* locator, const char* subject, size_t subject_len);
+char* rasqal_regex_substitute(rasqal_regex* regex, raptor_locator* locator, const char* subject, size_t subject_len, const char* replace, size_t replace_len, size_t* result_len_p);
 int rasqal_regex_match(rasqal_world* world, raptor_locator* locator, const char* pattern, const char* regex_flags, const char* subject, size_t subject_len);
+rasqal_regex_cache* rasqal_new_regex_cache(rasqal_world* world);
+void rasqal_free_regex_cache(rasqal_regex_cache* cache);
+rasqal_regex* rasqal_regex_cache_get(rasqal_regex_cache* cache, raptor_locator* locator, const char* pattern, const char* regex_flags);
 
 /* rasqal_results_compare.c */
 rasqal_results_compare* rasqal_new_results_compare(rasqal_world* world, rasqal_query_results *first_qr, const char* first_qr_label, rasqal_query_results *second_qr, const char* second_qr_label);
@@ -1939,6 +2160,7 @@ int rasqal_triples_sequence_set_origin(raptor_sequence* dest_seq, raptor_sequenc
  * @seed: used for rand_r() (if available) or srand()
  * @state: used for BSD initstate(), setstate() and random() (if available)
  * @data: internal to random algorithm
+ * @owner: evaluation context made by rasqal_new_evaluation_context() that owns this object or NULL
  *
  * A class providing a random number generator
  *
@@ -1948,6 +2170,7 @@ struct rasqal_random_s {
   unsigned int seed;
   char state[RASQAL_RANDOM_STATE_SIZE];
   void* data;
+  void* owner;
 };
 
 unsigned int rasqal_random_get_system_seed(rasqal_world *world);
@@ -101,7 +101,7 @@ rasqal_new_integer_literal(rasqal_world* world, rasqal_literal_type type,
 
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(world, rasqal_world, NULL);
 
-  l  = RASQAL_CALLOC(rasqal_literal*, 1, sizeof(*l));
+  l = rasqal_pool_alloc_literal(world);
   if(l) {
     l->valid = 1;
     l->usage = 1;
@@ -197,7 +197,7 @@ rasqal_new_typed_literal(rasqal_world* world, rasqal_literal_type type,
 
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(world, rasqal_world, NULL);
 
-  l = RASQAL_CALLOC(rasqal_literal*, 1, sizeof(*l));
+  l = rasqal_pool_alloc_literal(world);
   if(!l)
     return NULL;
 
@@ -242,7 +242,7 @@ rasqal_new_floating_literal(rasqal_world *world,
   if(type != RASQAL_LITERAL_FLOAT && type != RASQAL_LITERAL_DOUBLE)
     return NULL;
 
-  l = RASQAL_CALLOC(rasqal_literal*, 1, sizeof(*l));
+  l = rasqal_pool_alloc_literal(world);
   if(l) {
     size_t slen = 0;
     l->valid = 1;
@@ -322,7 +322,7 @@ rasqal_new_uri_literal(rasqal_world* world, raptor_uri *uri)
 
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(world, rasqal_world, NULL);
 
-  l = RASQAL_CALLOC(rasqal_literal*, 1, sizeof(*l));
+  l = rasqal_pool_alloc_literal(world);
   if(l) {
     l->valid = 1;
     l->usage = 1;
@@ -361,7 +361,7 @@ rasqal_new_pattern_literal(rasqal_world* world,
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(world, rasqal_world, NULL);
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(pattern, char*, NULL);
 
-  l = RASQAL_CALLOC(rasqal_literal*, 1, sizeof(*l));
+  l = rasqal_pool_alloc_literal(world);
   if(l) {
     l->valid = 1;
     l->usage = 1;
@@ -419,7 +419,7 @@ rasqal_new_decimal_literal_from_decimal(rasqal_world* world,
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(world, rasqal_world, NULL);
   /* string and decimal NULLness are checked below */
 
-  l = RASQAL_CALLOC(rasqal_literal*, 1, sizeof(*l));
+  l = rasqal_pool_alloc_literal(world);
   if(!l)
     return NULL;
   
@@ -543,7 +543,7 @@ rasqal_new_datetime_literal_from_datetime(rasqal_world* world,
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(world, rasqal_world, NULL);
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(dt, rasqal_xsd_datetime, NULL);
 
-  l = RASQAL_CALLOC(rasqal_literal*, 1, sizeof(*l));
+  l = rasqal_pool_alloc_literal(world);
   if(!l)
     goto failed;
   
@@ -895,7 +895,7 @@ rasqal_new_string_literal_common(rasqal_world* world,
   int native_type_promotion = (flags & 1);
   int canonicalize = (flags & 2) >> 1;
 
-  l = RASQAL_CALLOC(rasqal_literal*, 1, sizeof(*l));
+  l = rasqal_pool_alloc_literal(world);
   if(l) {
     rasqal_literal_type datatype_type = RASQAL_LITERAL_STRING;
 
@@ -1039,7 +1039,7 @@ rasqal_new_simple_literal(rasqal_world* world,
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(world, rasqal_world, NULL);
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(string, char*, NULL);
 
-  l = RASQAL_CALLOC(rasqal_literal*, 1, sizeof(*l));
+  l = rasqal_pool_alloc_literal(world);
   if(l) {
     l->valid = 1;
     l->usage = 1;
@@ -1071,7 +1071,7 @@ rasqal_new_boolean_literal(rasqal_world* world, int value)
 
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(world, rasqal_world, NULL);
 
-  l = RASQAL_CALLOC(rasqal_literal*, 1, sizeof(*l));
+  l = rasqal_pool_alloc_literal(world);
   if(l) {
     l->valid = 1;
     l->usage = 1;
@@ -1110,7 +1110,7 @@ rasqal_new_variable_literal(rasqal_world* world, rasqal_variable *variable)
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(world, rasqal_world, NULL);
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(variable, rasqal_variable, NULL);
 
-  l = RASQAL_CALLOC(rasqal_literal*, 1, sizeof(*l));
+  l = rasqal_pool_alloc_literal(world);
   if(l) {
     l->valid = 1;
     l->usage = 1;
@@ -1228,7 +1228,7 @@ rasqal_free_literal(rasqal_literal* l)
     default:
       RASQAL_FATAL2("Unknown literal type %u", l->type);
   }
-  RASQAL_FREE(rasqal_literal, l);
+  rasqal_pool_free_literal(l->world, l);
 }
 
 
@@ -3095,7 +3095,7 @@ rasqal_literal_as_node(rasqal_literal* l)
     case RASQAL_LITERAL_DATETIME:
     case RASQAL_LITERAL_UDT:
     case RASQAL_LITERAL_INTEGER_SUBTYPE:
-      new_l = RASQAL_CALLOC(rasqal_literal*, 1, sizeof(*new_l));
+      new_l = rasqal_pool_alloc_literal(l->world);
       if(new_l) {
         new_l->valid = 1;
         new_l->usage = 1;
@@ -4539,6 +4539,268 @@ rasqal_literal_array_equals(rasqal_literal** values_a,
 }
 
 
+/* FNV-1a 32 bit hash parameters */
+#define RASQAL_LITERAL_HASH_FNV_PRIME 16777619U
+
+static unsigned int
+rasqal_literal_hash_bytes(unsigned int hash, const unsigned char* p,
+                          size_t len, int fold_case)
+{
+  size_t i;
+
+  for(i = 0; i < len; i++) {
+    unsigned char c = p[i];
+    if(fold_case)
+      c = RASQAL_GOOD_CAST(unsigned char, tolower(c));
+    hash = (hash ^ c) * RASQAL_LITERAL_HASH_FNV_PRIME;
+  }
+
+  return hash;
+}
+
+
+/*
+ * rasqal_literal_rdf_term_hash:
+ * @l: literal or NULL
+ * @hash: hash to continue from such as #RASQAL_LITERAL_HASH_INIT
+ *
+ * INTERNAL - Hash a literal by its RDF term identity
+ *
+ * The hash is consistent with rasqal_literal_equals_flags() using
+ * #RASQAL_COMPARE_RDF (and so rasqal_literal_array_equals()): equal
+ * RDF terms always hash to the same value.  A NULL literal (unbound
+ * value) has a hash too.  Literals that are not RDF terms hash only
+ * by the NULL term type and never compare equal.
+ *
+ * Return value: hash value
+ */
+unsigned int
+rasqal_literal_rdf_term_hash(rasqal_literal* l, unsigned int hash)
+{
+  rasqal_literal_type type = rasqal_literal_get_rdf_term_type(l);
+  const unsigned char* str;
+  size_t len;
+
+  hash = rasqal_literal_hash_bytes(hash,
+                                   RASQAL_GOOD_CAST(const unsigned char*, &type),
+                                   sizeof(type), 0);
+
+  switch(type) {
+    case RASQAL_LITERAL_URI:
+      str = raptor_uri_as_counted_string(l->value.uri, &len);
+      hash = rasqal_literal_hash_bytes(hash, str, len, 0);
+      break;
+
+    case RASQAL_LITERAL_BLANK:
+      hash = rasqal_literal_hash_bytes(hash, l->string, l->string_len, 0);
+      break;
+
+    case RASQAL_LITERAL_STRING:
+      hash = rasqal_literal_hash_bytes(hash, l->string, l->string_len, 0);
+      /* languages compare case independently */
+      if(l->language)
+        hash = rasqal_literal_hash_bytes(hash,
+                                         RASQAL_GOOD_CAST(const unsigned char*, l->language),
+                                         strlen(l->language), 1);
+      if(l->datatype) {
+        str = raptor_uri_as_counted_string(l->datatype, &len);
+        hash = rasqal_literal_hash_bytes(hash, str, len, 0);
+      }
+      break;
+
+    case RASQAL_LITERAL_UNKNOWN:
+    case RASQAL_LITERAL_XSD_STRING:
+    case RASQAL_LITERAL_BOOLEAN:
+    case RASQAL_LITERAL_INTEGER:
+    case RASQAL_LITERAL_FLOAT:
+    case RASQAL_LITERAL_DOUBLE:
+    case RASQAL_LITERAL_DECIMAL:
+    case RASQAL_LITERAL_DATETIME:
+    case RASQAL_LITERAL_UDT:
+    case RASQAL_LITERAL_PATTERN:
+    case RASQAL_LITERAL_QNAME:
+    case RASQAL_LITERAL_VARIABLE:
+    case RASQAL_LITERAL_DATE:
+    case RASQAL_LITERAL_INTEGER_SUBTYPE:
+    default:
+      break;
+  }
+
+  return hash;
+}
+
+
+/*
+ * rasqal_literal_value_hash:
+ * @l: literal
+ * @hash_p: pointer to hash to continue from and update
+ *
+ * INTERNAL - Hash a literal consistently with rasqal_literal_equals()
+ *
+ * Literals that rasqal_literal_equals() would say are equal always
+ * hash to the same value.  Literals where the equality is not exact
+ * (floating point), needs normalizing (decimals and dates) or can be
+ * true across types (a string with a boolean) cannot be hashed and
+ * *@hash_p is left unchanged.
+ *
+ * Return value: non-0 if the literal cannot be hashed
+ */
+int
+rasqal_literal_value_hash(rasqal_literal* l, unsigned int* hash_p)
+{
+  unsigned int hash = *hash_p;
+  const unsigned char* str;
+  size_t len;
+
+  if(!l)
+    return 1;
+
+  switch(l->type) {
+    case RASQAL_LITERAL_URI:
+    case RASQAL_LITERAL_BLANK:
+      /* The same hash as an RDF term */
+      hash = rasqal_literal_rdf_term_hash(l, hash);
+      break;
+
+    case RASQAL_LITERAL_STRING:
+    case RASQAL_LITERAL_XSD_STRING:
+    case RASQAL_LITERAL_UDT:
+      /* equal only with the same type, language and datatype */
+      hash = rasqal_literal_hash_bytes(hash,
+                                       RASQAL_GOOD_CAST(const unsigned char*, &l->type),
+                                       sizeof(l->type), 0);
+      hash = rasqal_literal_hash_bytes(hash, l->string, l->string_len, 0);
+      if(l->language)
+        hash = rasqal_literal_hash_bytes(hash,
+                                         RASQAL_GOOD_CAST(const unsigned char*, l->language),
+                                         strlen(l->language), 1);
+      if(l->datatype) {
+        str = raptor_uri_as_counted_string(l->datatype, &len);
+        hash = rasqal_literal_hash_bytes(hash, str, len, 0);
+      }
+      break;
+
+    case RASQAL_LITERAL_INTEGER:
+    case RASQAL_LITERAL_INTEGER_SUBTYPE:
+      /* equal by integer value alone */
+      hash = rasqal_literal_hash_bytes(hash,
+                                       RASQAL_GOOD_CAST(const unsigned char*, &l->type),
+                                       sizeof(l->type), 0);
+      hash = rasqal_literal_hash_bytes(hash,
+                                       RASQAL_GOOD_CAST(const unsigned char*, &l->value.integer),
+                                       sizeof(l->value.integer), 0);
+      break;
+
+    case RASQAL_LITERAL_UNKNOWN:
+    case RASQAL_LITERAL_BOOLEAN:
+    case RASQAL_LITERAL_FLOAT:
+    case RASQAL_LITERAL_DOUBLE:
+    case RASQAL_LITERAL_DECIMAL:
+    case RASQAL_LITERAL_DATETIME:
+    case RASQAL_LITERAL_DATE:
+    case RASQAL_LITERAL_PATTERN:
+    case RASQAL_LITERAL_QNAME:
+    case RASQAL_LITERAL_VARIABLE:
+    default:
+      return 1;
+  }
+
+  *hash_p = hash;
+  return 0;
+}
+
+
+/*
+ * rasqal_literal_xquery_hash:
+ * @l: literal
+ * @hash_p: pointer to hash to continue from and update
+ *
+ * INTERNAL - Hash a literal consistently with XQuery value equality
+ *
+ * Literals of the same returned class that
+ * rasqal_literal_equals_flags() with #RASQAL_COMPARE_XQUERY finds
+ * equal always hash to the same value.  The classes are URIs, blank
+ * nodes, strings (simple, language tagged and xsd:string literals,
+ * which compare by lexical form and language) and integers
+ * (including integer subtypes and booleans which promote to
+ * integer).  Comparing literals across the string and integer
+ * classes is a type error, which the caller must allow for.
+ *
+ * Typed literals should already have been converted with
+ * rasqal_literal_string_to_native().  Other literals cannot be hashed
+ * and *@hash_p is left unchanged.
+ *
+ * Return value: class of the literal: #RASQAL_LITERAL_URI,
+ * #RASQAL_LITERAL_BLANK, #RASQAL_LITERAL_STRING,
+ * #RASQAL_LITERAL_INTEGER or #RASQAL_LITERAL_UNKNOWN if it cannot be
+ * hashed
+ */
+rasqal_literal_type
+rasqal_literal_xquery_hash(rasqal_literal* l, unsigned int* hash_p)
+{
+  rasqal_literal_type type;
+  unsigned int hash = *hash_p;
+
+  if(!l)
+    return RASQAL_LITERAL_UNKNOWN;
+
+  switch(l->type) {
+    case RASQAL_LITERAL_URI:
+    case RASQAL_LITERAL_BLANK:
+      type = l->type;
+      hash = rasqal_literal_rdf_term_hash(l, hash);
+      break;
+
+    case RASQAL_LITERAL_STRING:
+    case RASQAL_LITERAL_XSD_STRING:
+      /* other datatypes are not converted to native and are UDTs */
+      if(l->type == RASQAL_LITERAL_STRING && l->datatype)
+        return RASQAL_LITERAL_UNKNOWN;
+
+      /* plain and xsd:string literals are equal so omit the type */
+      type = RASQAL_LITERAL_STRING;
+      hash = rasqal_literal_hash_bytes(hash,
+                                       RASQAL_GOOD_CAST(const unsigned char*, &type),
+                                       sizeof(type), 0);
+      hash = rasqal_literal_hash_bytes(hash, l->string, l->string_len, 0);
+      if(l->language)
+        hash = rasqal_literal_hash_bytes(hash,
+                                         RASQAL_GOOD_CAST(const unsigned char*, l->language),
+                                         strlen(l->language), 1);
+      break;
+
+    case RASQAL_LITERAL_INTEGER:
+    case RASQAL_LITERAL_INTEGER_SUBTYPE:
+    case RASQAL_LITERAL_BOOLEAN:
+      /* promoted to integer and compared by value */
+      type = RASQAL_LITERAL_INTEGER;
+      hash = rasqal_literal_hash_bytes(hash,
+                                       RASQAL_GOOD_CAST(const unsigned char*, &type),
+                                       sizeof(type), 0);
+      hash = rasqal_literal_hash_bytes(hash,
+                                       RASQAL_GOOD_CAST(const unsigned char*, &l->value.integer),
+                                       sizeof(l->value.integer), 0);
+      break;
+
+    case RASQAL_LITERAL_UNKNOWN:
+    case RASQAL_LITERAL_FLOAT:
+    case RASQAL_LITERAL_DOUBLE:
+    case RASQAL_LITERAL_DECIMAL:
+    case RASQAL_LITERAL_DATETIME:
+    case RASQAL_LITERAL_DATE:
+    case RASQAL_LITERAL_UDT:
+    case RASQAL_LITERAL_PATTERN:
+    case RASQAL_LITERAL_QNAME:
+    case RASQAL_LITERAL_VARIABLE:
+    default:
+      return RASQAL_LITERAL_UNKNOWN;
+  }
+
+  *hash_p = hash;
+  return type;
+}
+
+
 /**
  * rasqal_literal_sequence_equals:
  * @values_a: first sequence of literals
@@ -4913,6 +5175,356 @@ rasqal_new_literal_from_term(rasqal_world* world, raptor_term* term)
 }
 
 
+/*
+ * rasqal_literal_write_binary_string:
+ * @string: string (or NULL)
+ * @len: length of @string
+ * @fh: FILE* to write to
+ *
+ * INTERNAL - Write a counted string for rasqal_literal_write_binary()
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_literal_write_binary_string(const unsigned char* string, size_t len,
+                                   FILE* fh)
+{
+  /* 0 for NULL else length + 1 */
+  size_t count = string ? len + 1 : 0;
+
+  if(fwrite(&count, sizeof(count), 1, fh) != 1)
+    return 1;
+
+  if(len && string && fwrite(string, 1, len, fh) != len)
+    return 1;
+
+  return 0;
+}
+
+
+/*
+ * rasqal_literal_read_binary_string:
+ * @fh: FILE* to read from
+ * @len_p: pointer to store string length (or NULL)
+ * @error_p: pointer to error flag
+ *
+ * INTERNAL - Read a counted string written by rasqal_literal_write_binary_string()
+ *
+ * Return value: new string or NULL if it was NULL or on failure
+ */
+static unsigned char*
+rasqal_literal_read_binary_string(FILE* fh, size_t* len_p, int* error_p)
+{
+  size_t count;
+  unsigned char* string;
+
+  if(fread(&count, sizeof(count), 1, fh) != 1) {
+    *error_p = 1;
+    return NULL;
+  }
+
+  if(!count)
+    return NULL;
+
+  string = RASQAL_MALLOC(unsigned char*, count);
+  if(!string) {
+    *error_p = 1;
+    return NULL;
+  }
+
+  count--;
+  if(count && fread(string, 1, count, fh) != count) {
+    RASQAL_FREE(char*, string);
+    *error_p = 1;
+    return NULL;
+  }
+  string[count] = '\0';
+
+  if(len_p)
+    *len_p = count;
+
+  return string;
+}
+
+
+/**
+ * rasqal_literal_write_binary:
+ * @l: literal (or NULL)
+ * @fh: FILE* to write to
+ *
+ * INTERNAL - Write a literal in a compact binary form
+ *
+ * The form is only meant to be read back by the same library with
+ * rasqal_new_literal_from_binary(), such as for rows spilled to a
+ * temporary file.  Integer and floating point values are written
+ * natively so that the literal read back compares the same.
+ *
+ * Return value: non-0 on failure
+ */
+int
+rasqal_literal_write_binary(rasqal_literal* l, FILE* fh)
+{
+  int header[3];
+  const unsigned char* string;
+  size_t len;
+
+  if(!l) {
+    /* unbound value */
+    header[0] = RASQAL_GOOD_CAST(int, RASQAL_LITERAL_UNKNOWN);
+    return (fwrite(header, sizeof(int), 1, fh) != 1);
+  }
+
+  if(l->type == RASQAL_LITERAL_VARIABLE || l->type == RASQAL_LITERAL_UNKNOWN)
+    return 1;
+
+  header[0] = RASQAL_GOOD_CAST(int, l->type);
+  header[1] = RASQAL_GOOD_CAST(int, l->parent_type);
+  header[2] = l->valid;
+  if(fwrite(header, sizeof(int), 3, fh) != 3)
+    return 1;
+
+  if(l->type == RASQAL_LITERAL_URI) {
+    string = RASQAL_GOOD_CAST(const unsigned char*,
+                              raptor_uri_as_counted_string(l->value.uri, &len));
+    return rasqal_literal_write_binary_string(string, len, fh);
+  }
+
+  if(rasqal_literal_write_binary_string(l->string, l->string_len, fh))
+    return 1;
+
+  string = RASQAL_GOOD_CAST(const unsigned char*, l->language);
+  if(rasqal_literal_write_binary_string(string,
+                                        string ? strlen(l->language) : 0, fh))
+    return 1;
+
+  string = NULL;
+  len = 0;
+  if(l->datatype)
+    string = RASQAL_GOOD_CAST(const unsigned char*,
+                              raptor_uri_as_counted_string(l->datatype, &len));
+  if(rasqal_literal_write_binary_string(string, len, fh))
+    return 1;
+
+  string = NULL;
+  if(l->type == RASQAL_LITERAL_STRING || l->type == RASQAL_LITERAL_PATTERN)
+    string = l->flags;
+  if(rasqal_literal_write_binary_string(string,
+                                        string ? strlen(RASQAL_GOOD_CAST(const char*, string)) : 0,
+                                        fh))
+    return 1;
+
+  switch(l->type) {
+    case RASQAL_LITERAL_BOOLEAN:
+    case RASQAL_LITERAL_INTEGER:
+    case RASQAL_LITERAL_INTEGER_SUBTYPE:
+      return (fwrite(&l->value.integer, sizeof(int), 1, fh) != 1);
+
+    case RASQAL_LITERAL_DOUBLE:
+    case RASQAL_LITERAL_FLOAT:
+      return (fwrite(&l->value.floating, sizeof(double), 1, fh) != 1);
+
+    case RASQAL_LITERAL_UNKNOWN:
+    case RASQAL_LITERAL_BLANK:
+    case RASQAL_LITERAL_URI:
+    case RASQAL_LITERAL_STRING:
+    case RASQAL_LITERAL_XSD_STRING:
+    case RASQAL_LITERAL_DECIMAL:
+    case RASQAL_LITERAL_DATETIME:
+    case RASQAL_LITERAL_UDT:
+    case RASQAL_LITERAL_PATTERN:
+    case RASQAL_LITERAL_QNAME:
+    case RASQAL_LITERAL_VARIABLE:
+    case RASQAL_LITERAL_DATE:
+    default:
+      /* value is rebuilt from the string */
+      break;
+  }
+
+  return 0;
+}
+
+
+/**
+ * rasqal_new_literal_from_binary:
+ * @world: rasqal world object
+ * @fh: FILE* to read from
+ * @error_p: pointer to error flag
+ *
+ * INTERNAL - Read a literal written by rasqal_literal_write_binary()
+ *
+ * Return value: new literal or NULL if it was NULL or on failure
+ */
+rasqal_literal*
+rasqal_new_literal_from_binary(rasqal_world* world, FILE* fh, int* error_p)
+{
+  int header[3];
+  rasqal_literal* l;
+  unsigned char* string;
+  unsigned char* language;
+  unsigned char* datatype;
+  unsigned char* flags;
+  size_t len = 0;
+  size_t datatype_len = 0;
+  int error = 0;
+
+  if(fread(header, sizeof(int), 1, fh) != 1)
+    goto failed;
+
+  if(header[0] == RASQAL_GOOD_CAST(int, RASQAL_LITERAL_UNKNOWN))
+    return NULL;
+
+  if(header[0] < 0 ||
+     header[0] > RASQAL_GOOD_CAST(int, RASQAL_LITERAL_LAST) ||
+     header[0] == RASQAL_GOOD_CAST(int, RASQAL_LITERAL_VARIABLE))
+    goto failed;
+
+  if(fread(&header[1], sizeof(int), 2, fh) != 2)
+    goto failed;
+
+  l = rasqal_pool_alloc_literal(world);
+  if(!l)
+    goto failed;
+
+  l->usage = 1;
+  l->world = world;
+  l->type = RASQAL_GOOD_CAST(rasqal_literal_type, header[0]);
+  l->parent_type = RASQAL_GOOD_CAST(rasqal_literal_type, header[1]);
+  l->valid = header[2];
+
+  string = rasqal_literal_read_binary_string(fh, &len, &error);
+  if(error)
+    goto failed_literal;
+
+  if(l->type == RASQAL_LITERAL_URI) {
+    if(string) {
+      l->value.uri = raptor_new_uri_from_counted_string(world->raptor_world_ptr,
+                                                        string, len);
+      RASQAL_FREE(char*, string);
+    }
+    if(!l->value.uri)
+      goto failed_literal;
+
+    return l;
+  }
+
+  l->string = string;
+  l->string_len = RASQAL_BAD_CAST(unsigned int, len);
+
+  language = rasqal_literal_read_binary_string(fh, NULL, &error);
+  l->language = RASQAL_GOOD_CAST(char*, language);
+  if(error)
+    goto failed_literal;
+
+  datatype = rasqal_literal_read_binary_string(fh, &datatype_len, &error);
+  if(error)
+    goto failed_literal;
+  if(datatype) {
+    l->datatype = raptor_new_uri_from_counted_string(world->raptor_world_ptr,
+                                                     datatype, datatype_len);
+    RASQAL_FREE(char*, datatype);
+    if(!l->datatype)
+      goto failed_literal;
+  }
+
+  flags = rasqal_literal_read_binary_string(fh, NULL, &error);
+  if(error)
+    goto failed_literal;
+  if(flags) {
+    if(l->type == RASQAL_LITERAL_STRING || l->type == RASQAL_LITERAL_PATTERN)
+      l->flags = flags;
+    else
+      RASQAL_FREE(char*, flags);
+  }
+
+  switch(l->type) {
+    case RASQAL_LITERAL_BOOLEAN:
+      /* static l->string for boolean */
+      if(l->string)
+        RASQAL_FREE(char*, l->string);
+      l->string = NULL;
+      if(fread(&l->value.integer, sizeof(int), 1, fh) != 1)
+        goto failed_literal;
+      l->string = l->value.integer ? rasqal_xsd_boolean_true : rasqal_xsd_boolean_false;
+      l->string_len = l->value.integer ? RASQAL_XSD_BOOLEAN_TRUE_LEN : RASQAL_XSD_BOOLEAN_FALSE_LEN;
+      break;
+
+    case RASQAL_LITERAL_INTEGER:
+    case RASQAL_LITERAL_INTEGER_SUBTYPE:
+      if(fread(&l->value.integer, sizeof(int), 1, fh) != 1)
+        goto failed_literal;
+      break;
+
+    case RASQAL_LITERAL_DOUBLE:
+    case RASQAL_LITERAL_FLOAT:
+      if(fread(&l->value.floating, sizeof(double), 1, fh) != 1)
+        goto failed_literal;
+      break;
+
+    case RASQAL_LITERAL_DECIMAL:
+      /* l->string will be owned by l->value.decimal */
+      string = RASQAL_GOOD_CAST(unsigned char*, l->string);
+      l->string = NULL;
+      if(!string)
+        goto failed_literal;
+
+      l->value.decimal = rasqal_new_xsd_decimal(world);
+      if(l->value.decimal &&
+         rasqal_xsd_decimal_set_string(l->value.decimal,
+                                       RASQAL_GOOD_CAST(const char*, string)))
+        error = 1;
+      RASQAL_FREE(char*, string);
+      if(!l->value.decimal || error)
+        goto failed_literal;
+      l->string = RASQAL_GOOD_CAST(unsigned char*, rasqal_xsd_decimal_as_counted_string(l->value.decimal, &len));
+      l->string_len = RASQAL_BAD_CAST(unsigned int, len);
+      if(!l->string)
+        goto failed_literal;
+      break;
+
+    case RASQAL_LITERAL_DATE:
+      if(!l->string)
+        goto failed_literal;
+      l->value.date = rasqal_new_xsd_date(world,
+                                          RASQAL_GOOD_CAST(const char*, l->string));
+      if(!l->value.date)
+        goto failed_literal;
+      break;
+
+    case RASQAL_LITERAL_DATETIME:
+      if(!l->string)
+        goto failed_literal;
+      l->value.datetime = rasqal_new_xsd_datetime(world,
+                                                  RASQAL_GOOD_CAST(const char*, l->string));
+      if(!l->value.datetime)
+        goto failed_literal;
+      break;
+
+    case RASQAL_LITERAL_BLANK:
+    case RASQAL_LITERAL_STRING:
+    case RASQAL_LITERAL_XSD_STRING:
+    case RASQAL_LITERAL_UDT:
+    case RASQAL_LITERAL_PATTERN:
+    case RASQAL_LITERAL_QNAME:
+      break;
+
+    case RASQAL_LITERAL_UNKNOWN:
+    case RASQAL_LITERAL_URI:
+    case RASQAL_LITERAL_VARIABLE:
+    default:
+      break;
+  }
+
+  return l;
+
+  failed_literal:
+  rasqal_free_literal(l);
+
+  failed:
+  *error_p = 1;
+  return NULL;
+}
+
+
 #endif /* not STANDALONE */
 
 
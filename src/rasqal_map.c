@@ -1,6 +1,6 @@
 /* -*- Mode: c; c-basic-offset: 2 -*-
  *
- * rasqal_map.c - Rasqal simple Key:Value Map with duplicates allowed
+ * rasqal_map.c - Rasqal balanced Key:Value Map with duplicates allowed
  *
  * Copyright (C) 2005-2010, David Beckett http://www.dajobe.org/
  * Copyright (C) 2005-2005, University of Bristol, UK http://www.bristol.ac.uk/
@@ -41,6 +41,10 @@
 #include "rasqal_internal.h"
 
 
+/* Nodes form an AVL tree: the heights of the prev and next subtrees
+ * of every node differ by at most 1 so adding rows in sorted order
+ * does not make the tree a list.
+ */
 struct rasqal_map_node_s
 {
   struct rasqal_map_s* map;
@@ -48,6 +52,8 @@ struct rasqal_map_node_s
   struct rasqal_map_node_s* next;
   void* key;
   void* value;
+  /* height of the subtree at this node; 1 for a leaf */
+  int height;
 };
 
 struct rasqal_map_s {
@@ -77,6 +83,7 @@ rasqal_new_map_node(rasqal_map* map, void *key, void *value)
   node->map = map;
   node->key = key;
   node->value = value;
+  node->height = 1;
   return node;
 }
 
@@ -172,33 +179,133 @@ rasqal_free_map(rasqal_map *map)
 }
 
 
-static int
-rasqal_map_node_add_kv(rasqal_map_node* node, void *key, void *value) 
+#define RASQAL_MAP_NODE_HEIGHT(node) ((node) ? (node)->height : 0)
+
+static void
+rasqal_map_node_update_height(rasqal_map_node* node)
+{
+  int prev_height = RASQAL_MAP_NODE_HEIGHT(node->prev);
+  int next_height = RASQAL_MAP_NODE_HEIGHT(node->next);
+
+  node->height = 1 + (prev_height > next_height ? prev_height : next_height);
+}
+
+
+/* rotate so node->prev becomes the subtree root */
+static rasqal_map_node*
+rasqal_map_node_rotate_next(rasqal_map_node* node)
+{
+  rasqal_map_node* prev = node->prev;
+
+  node->prev = prev->next;
+  prev->next = node;
+  rasqal_map_node_update_height(node);
+  rasqal_map_node_update_height(prev);
+
+  return prev;
+}
+
+
+/* rotate so node->next becomes the subtree root */
+static rasqal_map_node*
+rasqal_map_node_rotate_prev(rasqal_map_node* node)
+{
+  rasqal_map_node* next = node->next;
+
+  node->next = next->prev;
+  next->prev = node;
+  rasqal_map_node_update_height(node);
+  rasqal_map_node_update_height(next);
+
+  return next;
+}
+
+
+/*
+ * rasqal_map_node_balance:
+ * @node: subtree root with balanced subtrees that differ in height by
+ *   at most 2
+ *
+ * INTERNAL - Restore the AVL balance at a node after an add
+ *
+ * Return value: new subtree root
+ */
+static rasqal_map_node*
+rasqal_map_node_balance(rasqal_map_node* node)
 {
-  rasqal_map *map = node->map;
+  int balance;
+
+  rasqal_map_node_update_height(node);
+
+  balance = RASQAL_MAP_NODE_HEIGHT(node->prev) -
+            RASQAL_MAP_NODE_HEIGHT(node->next);
+
+  if(balance > 1) {
+    if(RASQAL_MAP_NODE_HEIGHT(node->prev->prev) <
+       RASQAL_MAP_NODE_HEIGHT(node->prev->next))
+      node->prev = rasqal_map_node_rotate_prev(node->prev);
+    return rasqal_map_node_rotate_next(node);
+  }
+
+  if(balance < -1) {
+    if(RASQAL_MAP_NODE_HEIGHT(node->next->next) <
+       RASQAL_MAP_NODE_HEIGHT(node->next->prev))
+      node->next = rasqal_map_node_rotate_next(node->next);
+    return rasqal_map_node_rotate_prev(node);
+  }
+
+  return node;
+}
+
+
+/*
+ * rasqal_map_node_add_kv:
+ * @map: map
+ * @node: subtree root (or NULL)
+ * @key: key data
+ * @value: value data (or NULL)
+ * @rc_p: pointer to store 0 on success, 1 for a duplicate, <0 on failure
+ *
+ * INTERNAL - Add a (key, value) pair to a subtree
+ *
+ * Duplicates, if allowed, are added after the existing equal keys.
+ *
+ * Return value: new subtree root
+ */
+static rasqal_map_node*
+rasqal_map_node_add_kv(rasqal_map* map, rasqal_map_node* node,
+                       void *key, void *value, int* rc_p)
+{
+  rasqal_map_node* child;
   int result;
 
+  if(!node) {
+    node = rasqal_new_map_node(map, key, value);
+    *rc_p = node ? 0 : -1;
+    return node;
+  }
+
   result = map->compare(map->compare_user_data, key, node->key);
   if(result < 0) {
-    if(node->prev)
-      return rasqal_map_node_add_kv(node->prev, key, value);
-
-    node->prev = rasqal_new_map_node(map, key, value);
-    return node->prev ? 0 : -1;
-  } else if(!result) {
-    if(!node->map->allow_duplicates) {
+    child = rasqal_map_node_add_kv(map, node->prev, key, value, rc_p);
+    if(*rc_p)
+      return node;
+    node->prev = child;
+  } else {
+    if(!result && !map->allow_duplicates) {
       /* duplicate and not allowed */
-      return 1;
+      *rc_p = 1;
+      return node;
     }
-    /* duplicate, fall through  */
-  } 
 
-  /* result > 0 */
-  if(node->next)
-    return rasqal_map_node_add_kv(node->next, key, value);
+    /* result > 0 or an allowed duplicate */
+    child = rasqal_map_node_add_kv(map, node->next, key, value, rc_p);
+    if(*rc_p)
+      return node;
+    node->next = child;
+  }
 
-  node->next = rasqal_new_map_node(map, key, value);
-  return node->next ? 0 : -1;
+  return rasqal_map_node_balance(node);
 }
 
 
@@ -248,12 +355,11 @@ rasqal_map_search(rasqal_map* map, const void* key)
 int
 rasqal_map_add_kv(rasqal_map* map, void* key, void *value)
 {
-  if(!map->root) {
-    map->root = rasqal_new_map_node(map, key, value);
-    return map->root ? 0 : -1;
-  }
-  
-  return rasqal_map_node_add_kv(map->root, key, value);
+  int rc = 0;
+
+  map->root = rasqal_map_node_add_kv(map, map->root, key, value, &rc);
+
+  return rc;
 }
 
 
@@ -0,0 +1,373 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * rasqal_pool.c - Rasqal free list pools for literals and rows
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <rasqal_config.h>
+#endif
+
+#ifdef WIN32
+#include <win32_rasqal_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#include "rasqal.h"
+#include "rasqal_internal.h"
+
+
+#ifndef STANDALONE
+
+/*
+ * Freed objects are kept on singly linked lists threaded through
+ * their own storage, so every pooled object must be at least one
+ * pointer in size.  Only the memory is recycled: reference counts and
+ * fields are reset by the allocating constructor exactly as before.
+ */
+typedef struct rasqal_pool_link_s {
+  struct rasqal_pool_link_s* next;
+} rasqal_pool_link;
+
+
+/*
+ * rasqal_pool_get:
+ * @pool: pool
+ * @size: object size in bytes
+ *
+ * INTERNAL - Take a zeroed object from a pool or allocate a new one
+ *
+ * Return value: object or NULL on failure
+ */
+static void*
+rasqal_pool_get(rasqal_pool* pool, size_t size)
+{
+  rasqal_pool_link* link = (rasqal_pool_link*)pool->free_list;
+
+  if(!link) {
+#ifdef RASQAL_POOL_STATS
+    pool->misses++;
+#endif
+    return RASQAL_CALLOC(void*, 1, size);
+  }
+
+#ifdef RASQAL_POOL_STATS
+  pool->hits++;
+#endif
+  pool->free_list = link->next;
+  pool->count--;
+
+  memset(link, '\0', size);
+  return link;
+}
+
+
+/*
+ * rasqal_pool_put:
+ * @pool: pool
+ * @object: object to release
+ *
+ * INTERNAL - Return an object to a pool or free it if the pool is full
+ */
+static void
+rasqal_pool_put(rasqal_pool* pool, void* object)
+{
+  rasqal_pool_link* link = (rasqal_pool_link*)object;
+
+  if(pool->count >= RASQAL_POOL_MAX_FREE) {
+    RASQAL_FREE(void*, object);
+    return;
+  }
+
+  link->next = (rasqal_pool_link*)pool->free_list;
+  pool->free_list = link;
+  pool->count++;
+}
+
+
+static void
+rasqal_pool_finish(rasqal_pool* pool)
+{
+  rasqal_pool_link* link = (rasqal_pool_link*)pool->free_list;
+
+  while(link) {
+    rasqal_pool_link* next = link->next;
+    RASQAL_FREE(void*, link);
+    link = next;
+  }
+
+  pool->free_list = NULL;
+  pool->count = 0;
+}
+
+
+#ifdef RASQAL_POOL_STATS
+static void
+rasqal_pool_report(rasqal_pool* pool, const char* name, int size)
+{
+  unsigned long total = pool->hits + pool->misses;
+
+  if(!total)
+    return;
+
+  if(size > 0)
+    fprintf(stderr, "rasqal pool %s[%d]: %lu allocations, %lu reused (%.1f%%)\n",
+            name, size, total, pool->hits,
+            (100.0 * (double)pool->hits) / (double)total);
+  else
+    fprintf(stderr, "rasqal pool %s: %lu allocations, %lu reused (%.1f%%)\n",
+            name, total, pool->hits,
+            (100.0 * (double)pool->hits) / (double)total);
+}
+#endif
+
+
+/**
+ * rasqal_pool_alloc_literal:
+ * @world: rasqal_world
+ *
+ * INTERNAL - Allocate zeroed storage for a #rasqal_literal
+ *
+ * Return value: literal storage or NULL on failure
+ */
+rasqal_literal*
+rasqal_pool_alloc_literal(rasqal_world* world)
+{
+  return (rasqal_literal*)rasqal_pool_get(&world->literal_pool,
+                                          sizeof(rasqal_literal));
+}
+
+
+/**
+ * rasqal_pool_free_literal:
+ * @world: rasqal_world
+ * @l: literal storage
+ *
+ * INTERNAL - Release storage of a literal whose fields are already freed
+ */
+void
+rasqal_pool_free_literal(rasqal_world* world, rasqal_literal* l)
+{
+  rasqal_pool_put(&world->literal_pool, l);
+}
+
+
+/**
+ * rasqal_pool_alloc_row:
+ * @world: rasqal_world
+ *
+ * INTERNAL - Allocate zeroed storage for a #rasqal_row
+ *
+ * Return value: row storage or NULL on failure
+ */
+rasqal_row*
+rasqal_pool_alloc_row(rasqal_world* world)
+{
+  return (rasqal_row*)rasqal_pool_get(&world->row_pool, sizeof(rasqal_row));
+}
+
+
+/**
+ * rasqal_pool_free_row:
+ * @world: rasqal_world
+ * @row: row storage
+ *
+ * INTERNAL - Release storage of a row whose fields are already freed
+ */
+void
+rasqal_pool_free_row(rasqal_world* world, rasqal_row* row)
+{
+  rasqal_pool_put(&world->row_pool, row);
+}
+
+
+/**
+ * rasqal_pool_alloc_values:
+ * @world: rasqal_world
+ * @size: number of values
+ *
+ * INTERNAL - Allocate a zeroed array of @size literal pointers
+ *
+ * Arrays wider than #RASQAL_POOL_VALUES_SIZES are not pooled.
+ *
+ * Return value: array or NULL on failure
+ */
+rasqal_literal**
+rasqal_pool_alloc_values(rasqal_world* world, int size)
+{
+  size_t bytes = sizeof(rasqal_literal*) * RASQAL_GOOD_CAST(size_t, size);
+
+  if(size > RASQAL_POOL_VALUES_SIZES || size <= 0)
+    return RASQAL_CALLOC(rasqal_literal**, 1, bytes);
+
+  return (rasqal_literal**)rasqal_pool_get(&world->values_pools[size - 1],
+                                           bytes);
+}
+
+
+/**
+ * rasqal_pool_free_values:
+ * @world: rasqal_world
+ * @values: array returned by rasqal_pool_alloc_values() (or NULL)
+ * @size: number of values the array was allocated with
+ *
+ * INTERNAL - Release an array of literal pointers
+ *
+ * The literals in the array are not freed.
+ */
+void
+rasqal_pool_free_values(rasqal_world* world, rasqal_literal** values,
+                        int size)
+{
+  if(!values)
+    return;
+
+  if(size > RASQAL_POOL_VALUES_SIZES || size <= 0) {
+    RASQAL_FREE(array, values);
+    return;
+  }
+
+  rasqal_pool_put(&world->values_pools[size - 1], values);
+}
+
+
+/**
+ * rasqal_world_finish_pools:
+ * @world: rasqal_world
+ *
+ * INTERNAL - Free all pooled storage
+ *
+ * When built with RASQAL_POOL_STATS, the pool reuse rates are
+ * reported to stderr first.
+ */
+void
+rasqal_world_finish_pools(rasqal_world* world)
+{
+  int i;
+
+#ifdef RASQAL_POOL_STATS
+  rasqal_pool_report(&world->literal_pool, "literal", 0);
+  rasqal_pool_report(&world->row_pool, "row", 0);
+  for(i = 0; i < RASQAL_POOL_VALUES_SIZES; i++)
+    rasqal_pool_report(&world->values_pools[i], "values", i + 1);
+#endif
+
+  rasqal_pool_finish(&world->literal_pool);
+  rasqal_pool_finish(&world->row_pool);
+  for(i = 0; i < RASQAL_POOL_VALUES_SIZES; i++)
+    rasqal_pool_finish(&world->values_pools[i]);
+}
+
+#endif /* not STANDALONE */
+
+
+
+#ifdef STANDALONE
+
+/* one more prototype */
+int main(int argc, char *argv[]);
+
+
+int
+main(int argc, char *argv[])
+{
+  const char *program = rasqal_basename(argv[0]);
+  rasqal_world* world;
+  rasqal_literal* l1;
+  rasqal_literal* l2;
+  rasqal_row* row;
+  rasqal_literal** first_values;
+  int failures = 0;
+  int i;
+
+  world = rasqal_new_world();
+  if(!world || rasqal_world_open(world)) {
+    fprintf(stderr, "%s: rasqal_world init failed\n", program);
+    return(1);
+  }
+
+  /* A freed literal's storage is reused by the next literal */
+  l1 = rasqal_new_integer_literal(world, RASQAL_LITERAL_INTEGER, 1);
+  rasqal_free_literal(l1);
+  l2 = rasqal_new_integer_literal(world, RASQAL_LITERAL_INTEGER, 2);
+  if(l2 != l1) {
+    fprintf(stderr, "%s: literal storage was not reused\n", program);
+    failures++;
+  }
+  if(!l2 || l2->usage != 1 || l2->value.integer != 2) {
+    fprintf(stderr, "%s: reused literal was not initialised\n", program);
+    failures++;
+  }
+
+  /* Reference counting still decides when storage is released */
+  l1 = rasqal_new_literal_from_literal(l2);
+  rasqal_free_literal(l2);
+  if(l1->usage != 1 || l1->value.integer != 2) {
+    fprintf(stderr, "%s: shared literal was released early\n", program);
+    failures++;
+  }
+  rasqal_free_literal(l1);
+
+  /* Row values arrays come back zeroed from the size class they were
+   * freed to
+   */
+  row = rasqal_new_row_for_size(world, 3);
+  if(!row) {
+    fprintf(stderr, "%s: failed to create row\n", program);
+    failures++;
+    goto tidy;
+  }
+  first_values = row->values;
+  row->values[1] = rasqal_new_boolean_literal(world, 1);
+  rasqal_free_row(row);
+
+  row = rasqal_new_row_for_size(world, 3);
+  if(!row || row->values != first_values) {
+    fprintf(stderr, "%s: row values storage was not reused\n", program);
+    failures++;
+  }
+  if(row) {
+    for(i = 0; i < row->size; i++) {
+      if(row->values[i]) {
+        fprintf(stderr, "%s: reused row value %d is not NULL\n", program, i);
+        failures++;
+      }
+    }
+
+    /* Growing a row moves it to a wider values array */
+    row->values[0] = rasqal_new_boolean_literal(world, 0);
+    if(rasqal_row_expand_size(row, RASQAL_POOL_VALUES_SIZES + 2) ||
+       !row->values[0] || row->values[RASQAL_POOL_VALUES_SIZES + 1]) {
+      fprintf(stderr, "%s: expanding row failed\n", program);
+      failures++;
+    }
+    rasqal_free_row(row);
+  }
+
+  tidy:
+  rasqal_free_world(world);
+
+  return failures;
+}
+
+#endif /* STANDALONE */
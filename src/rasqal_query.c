@@ -185,6 +185,15 @@ rasqal_free_query(rasqal_query* query)
   if(query->eval_context)
     rasqal_free_evaluation_context(query->eval_context);
 
+  if(query->algebra_node)
+    rasqal_free_algebra_node(query->algebra_node);
+
+  if(query->parameters)
+    raptor_free_sequence(query->parameters);
+
+  if(query->parameter_values)
+    raptor_free_sequence(query->parameter_values);
+
   if(query->context)
     RASQAL_FREE(rasqal_query_context, query->context);
 
@@ -203,6 +212,8 @@ rasqal_free_query(rasqal_query* query)
   if(query->describes)
     raptor_free_sequence(query->describes);
 
+  if(query->plan_triples)
+    raptor_free_sequence(query->plan_triples);
   if(query->triples)
     raptor_free_sequence(query->triples);
   if(query->optional_triples)
@@ -305,6 +316,8 @@ rasqal_query_set_feature(rasqal_query* query, rasqal_feature feature, int value)
   switch(feature) {
     case RASQAL_FEATURE_NO_NET:
     case RASQAL_FEATURE_RAND_SEED:
+    case RASQAL_FEATURE_PROFILE:
+    case RASQAL_FEATURE_SORT_MEMORY_LIMIT:
 
       if(feature == RASQAL_FEATURE_RAND_SEED)
         query->user_set_rand = 1;
@@ -370,8 +383,13 @@ rasqal_query_get_feature(rasqal_query *query, rasqal_feature feature)
   switch(feature) {
     case RASQAL_FEATURE_NO_NET:
     case RASQAL_FEATURE_RAND_SEED:
+    case RASQAL_FEATURE_PROFILE:
       result = (query->features[RASQAL_GOOD_CAST(int, feature)] != 0);
       break;
+
+    case RASQAL_FEATURE_SORT_MEMORY_LIMIT:
+      result = query->features[RASQAL_GOOD_CAST(int, feature)];
+      break;
   }
   
   return result;
@@ -464,9 +482,9 @@ rasqal_query_set_distinct(rasqal_query* query, int distinct_mode)
  * rasqal_query_get_explain:
  * @query: #rasqal_query query object
  *
- * Get the query explain results flag.
+ * Get the query explain mode.
  *
- * Return value: non-0 if the results should be explain
+ * Return value: #rasqal_query_explain_mode value; non-0 if the results should be explain
  **/
 int
 rasqal_query_get_explain(rasqal_query* query)
@@ -480,17 +498,32 @@ rasqal_query_get_explain(rasqal_query* query)
 /**
  * rasqal_query_set_explain:
  * @query: #rasqal_query query object
- * @is_explain: non-0 if explain
+ * @is_explain: #rasqal_query_explain_mode explain mode
+ *
+ * Set the query explain mode.
  *
- * Set the query explain results flag.
+ * The allowed @is_explain values are:
+ * #RASQAL_QUERY_EXPLAIN_NONE (0) to return the query results
+ * #RASQAL_QUERY_EXPLAIN_PLAN (1) to return the query plan without running it
+ * #RASQAL_QUERY_EXPLAIN_ANALYZE (2) to run the query and return the
+ * query plan with per-operator row counts, resets and times.
  *
+ * Any other non-0 value is treated as #RASQAL_QUERY_EXPLAIN_PLAN.
+ *
+ * When explaining, the query results are variable bindings of
+ * id, parent, operator, rows_in, rows_out, resets and time with one
+ * row per operator, whatever the query verb.
  **/
 void
 rasqal_query_set_explain(rasqal_query* query, int is_explain)
 {
   RASQAL_ASSERT_OBJECT_POINTER_RETURN(query, rasqal_query);
 
-  query->explain = (is_explain != 0) ? 1 : 0;
+  if(is_explain < RASQAL_QUERY_EXPLAIN_NONE ||
+     is_explain > RASQAL_QUERY_EXPLAIN_LAST)
+    is_explain = RASQAL_QUERY_EXPLAIN_PLAN;
+
+  query->explain = is_explain;
 }
 
 
@@ -889,6 +922,19 @@ rasqal_query_has_variable(rasqal_query* query, const unsigned char *name)
  * See also rasqal_query_add_variable() which adds a new binding variable
  * and must be called before this method is invoked.
  *
+ * A variable given a value is a query parameter: triple patterns
+ * match it as a constant instead of binding it and every later
+ * execution of the query starts with that value.  All other
+ * variables start each execution unbound.  Use
+ * rasqal_query_clear_parameters() to remove all the parameters.
+ *
+ * A prepared query can be executed many times with different
+ * parameter values; the query algebra built by the first execution
+ * is reused.  Changes to the query structure after the first
+ * execution other than LIMIT and OFFSET are not seen.
+ *
+ * The @value becomes owned by the query.
+ *
  * Return value: non-0 on failure
  **/
 int
@@ -897,11 +943,185 @@ rasqal_query_set_variable2(rasqal_query* query,
                            const unsigned char *name,
                            rasqal_literal* value)
 {
+  rasqal_variable* v;
+  int i;
+
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(query, rasqal_query, 1);
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(name, char*, 1);
   RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(value, rasqal_literal, 1);
 
-  return rasqal_variables_table_set(query->vars_table, type, name, value);
+  v = rasqal_variables_table_get_by_name(query->vars_table, type, name);
+  if(!v) {
+    rasqal_free_literal(value);
+    return 1;
+  }
+
+  if(!query->parameters) {
+    query->parameters = raptor_new_sequence((raptor_data_free_handler)rasqal_free_variable,
+                                            (raptor_data_print_handler)rasqal_variable_print);
+    query->parameter_values = raptor_new_sequence((raptor_data_free_handler)rasqal_free_literal,
+                                                  (raptor_data_print_handler)rasqal_literal_print);
+    if(!query->parameters || !query->parameter_values) {
+      rasqal_free_literal(value);
+      return 1;
+    }
+  }
+
+  for(i = 0; i < raptor_sequence_size(query->parameters); i++) {
+    if(raptor_sequence_get_at(query->parameters, i) == v)
+      break;
+  }
+
+  if(i < raptor_sequence_size(query->parameters)) {
+    rasqal_variable* old_v;
+    rasqal_literal* old_value;
+
+    /* replace the parameter value */
+    old_v = (rasqal_variable*)raptor_sequence_delete_at(query->parameters, i);
+    old_value = (rasqal_literal*)raptor_sequence_delete_at(query->parameter_values, i);
+    rasqal_free_variable(old_v);
+    rasqal_free_literal(old_value);
+  }
+
+  rasqal_variable_set_value(v, rasqal_new_literal_from_literal(value));
+
+  if(raptor_sequence_push(query->parameters, rasqal_new_variable_from_variable(v))) {
+    rasqal_free_literal(value);
+    return 1;
+  }
+  if(raptor_sequence_push(query->parameter_values, value)) {
+    rasqal_free_variable((rasqal_variable*)raptor_sequence_pop(query->parameters));
+    return 1;
+  }
+
+  return 0;
+}
+
+
+/*
+ * rasqal_query_variable_is_parameter:
+ * @query: #rasqal_query query object
+ * @v: variable
+ *
+ * INTERNAL - Test if a variable is a query parameter set by rasqal_query_set_variable2()
+ *
+ * Return value: non-0 if @v is a parameter
+ */
+int
+rasqal_query_variable_is_parameter(rasqal_query* query, rasqal_variable* v)
+{
+  int i;
+
+  if(!query->parameters)
+    return 0;
+
+  for(i = 0; i < raptor_sequence_size(query->parameters); i++) {
+    if(raptor_sequence_get_at(query->parameters, i) == v)
+      return 1;
+  }
+
+  return 0;
+}
+
+
+/*
+ * rasqal_query_get_parameter_value:
+ * @query: #rasqal_query query object
+ * @v: variable
+ *
+ * INTERNAL - Get the value given to a query parameter by rasqal_query_set_variable2()
+ *
+ * Return value: shared parameter value or NULL if @v is not a parameter
+ */
+rasqal_literal*
+rasqal_query_get_parameter_value(rasqal_query* query, rasqal_variable* v)
+{
+  int i;
+
+  if(!query->parameters)
+    return NULL;
+
+  for(i = 0; i < raptor_sequence_size(query->parameters); i++) {
+    if(raptor_sequence_get_at(query->parameters, i) == v)
+      return (rasqal_literal*)raptor_sequence_get_at(query->parameter_values, i);
+  }
+
+  return NULL;
+}
+
+
+/*
+ * rasqal_query_reset_variables:
+ * @query: #rasqal_query query object
+ *
+ * INTERNAL - Reset the query variables to their values before execution
+ *
+ * Unsets the values left by any earlier execution and sets the
+ * parameters to the values given by rasqal_query_set_variable2().
+ *
+ * Return value: non-0 on failure
+ */
+int
+rasqal_query_reset_variables(rasqal_query* query)
+{
+  int size;
+  int i;
+
+  size = rasqal_variables_table_get_total_variables_count(query->vars_table);
+  for(i = 0; i < size; i++) {
+    rasqal_variable* v;
+
+    v = rasqal_variables_table_get(query->vars_table, i);
+    if(v && v->value)
+      rasqal_variable_set_value(v, NULL);
+  }
+
+  if(query->parameters) {
+    for(i = 0; i < raptor_sequence_size(query->parameters); i++) {
+      rasqal_variable* v;
+      rasqal_literal* value;
+
+      v = (rasqal_variable*)raptor_sequence_get_at(query->parameters, i);
+      value = (rasqal_literal*)raptor_sequence_get_at(query->parameter_values, i);
+      rasqal_variable_set_value(v, rasqal_new_literal_from_literal(value));
+    }
+  }
+
+  return 0;
+}
+
+
+/**
+ * rasqal_query_clear_parameters:
+ * @query: #rasqal_query query object
+ *
+ * Remove all the parameters set by rasqal_query_set_variable2()
+ *
+ * The variables are unbound and start later executions unbound.
+ **/
+void
+rasqal_query_clear_parameters(rasqal_query* query)
+{
+  RASQAL_ASSERT_OBJECT_POINTER_RETURN(query, rasqal_query);
+
+  if(query->parameters) {
+    int i;
+
+    for(i = 0; i < raptor_sequence_size(query->parameters); i++) {
+      rasqal_variable* v;
+
+      v = (rasqal_variable*)raptor_sequence_get_at(query->parameters, i);
+      rasqal_variable_set_value(v, NULL);
+    }
+
+    raptor_free_sequence(query->parameters);
+    query->parameters = NULL;
+  }
+
+  if(query->parameter_values) {
+    raptor_free_sequence(query->parameter_values);
+    query->parameter_values = NULL;
+  }
 }
 
 
@@ -950,6 +1170,28 @@ rasqal_query_get_triple_sequence(rasqal_query* query)
 }
 
 
+/*
+ * rasqal_query_get_plan_triple_sequence:
+ * @query: #rasqal_query query object
+ *
+ * INTERNAL - Get the sequence of triple patterns in the order they are matched
+ *
+ * This is the sequence the query algebra, the variables use maps and
+ * the triples rowsources use.  The columns of a graph pattern are the
+ * same in both sequences but the triple patterns in a BGP may be in a
+ * different order from rasqal_query_get_triple_sequence().
+ *
+ * Return value: a #raptor_sequence of #rasqal_triple pointers.
+ */
+raptor_sequence*
+rasqal_query_get_plan_triple_sequence(rasqal_query* query)
+{
+  RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(query, rasqal_query, NULL);
+
+  return query->plan_triples ? query->plan_triples : query->triples;
+}
+
+
 /**
  * rasqal_query_get_triple:
  * @query: #rasqal_query query object
@@ -1453,7 +1695,9 @@ rasqal_query_print(rasqal_query* query, FILE *fh)
   if(distinct_mode)
     fprintf(fh, "query results distinct mode: %s\n",
             (distinct_mode == 1 ? "distinct" : "reduced"));
-  if(query->explain)
+  if(query->explain == RASQAL_QUERY_EXPLAIN_ANALYZE)
+    fputs("query results explain: analyze\n", fh);
+  else if(query->explain)
     fputs("query results explain: yes\n", fh);
 
   if(query->modifier) {
@@ -2254,6 +2498,10 @@ rasqal_query_get_result_type(rasqal_query* query)
   if(!query->prepared)
     return RASQAL_QUERY_RESULTS_UNKNOWN;
 
+  if(query->explain)
+    /* the query plan is returned as variable bindings */
+    return RASQAL_QUERY_RESULTS_BINDINGS;
+
   if(query->query_results_formatter_name)
     type = RASQAL_QUERY_RESULTS_SYNTAX;
   else
@@ -0,0 +1,781 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * rasqal_query_cache.c - Rasqal prepared query cache
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <rasqal_config.h>
+#endif
+
+#ifdef WIN32
+#include <win32_rasqal_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#include "rasqal.h"
+#include "rasqal_internal.h"
+
+
+#ifndef STANDALONE
+
+/*
+ * A cache entry holds one reference to a prepared query.  The query
+ * is idle and can be handed out when that is its only reference.
+ *
+ * The query state a caller can change through the API is saved when
+ * the query is cached and put back before each reuse.
+ */
+typedef struct {
+  /* language name, base URI and normalized query string */
+  unsigned char* key;
+  size_t key_len;
+
+  rasqal_query* query;
+
+  /* state after preparing */
+  int data_graphs_count;
+  int limit;
+  int offset;
+  int distinct;
+  int wildcard;
+  int explain;
+  int features[RASQAL_FEATURE_LAST + 1];
+  int user_set_rand;
+  int store_results;
+  void* user_data;
+} rasqal_query_cache_entry;
+
+
+static void
+rasqal_free_query_cache_entry(rasqal_query_cache_entry* entry)
+{
+  if(!entry)
+    return;
+
+  if(entry->query)
+    rasqal_free_query(entry->query);
+
+  if(entry->key)
+    RASQAL_FREE(char*, entry->key);
+
+  RASQAL_FREE(rasqal_query_cache_entry, entry);
+}
+
+
+/*
+ * rasqal_query_cache_save_state:
+ * @entry: cache entry
+ *
+ * INTERNAL - Save the state of a newly prepared query to restore on reuse
+ */
+static void
+rasqal_query_cache_save_state(rasqal_query_cache_entry* entry)
+{
+  rasqal_query* query = entry->query;
+
+  entry->data_graphs_count = raptor_sequence_size(query->data_graphs);
+  entry->limit = rasqal_query_get_limit(query);
+  entry->offset = rasqal_query_get_offset(query);
+  entry->distinct = rasqal_query_get_distinct(query);
+  entry->wildcard = rasqal_query_get_wildcard(query);
+  entry->explain = query->explain;
+  memcpy(entry->features, query->features, sizeof(entry->features));
+  entry->user_set_rand = query->user_set_rand;
+  entry->store_results = query->store_results;
+  entry->user_data = query->user_data;
+}
+
+
+/*
+ * rasqal_query_cache_restore_state:
+ * @entry: cache entry
+ *
+ * INTERNAL - Undo changes made by earlier users of a cached query
+ *
+ * Data graphs added since the query was cached are removed and the
+ * other saved fields are set back.  The DISTINCT mode and projection
+ * wildcard are built into the query algebra when the query is first
+ * executed, so once that is done they cannot be set back.
+ *
+ * Return value: non-0 if the query cannot be reused
+ */
+static int
+rasqal_query_cache_restore_state(rasqal_query_cache_entry* entry)
+{
+  rasqal_query* query = entry->query;
+
+  if(rasqal_query_get_distinct(query) != entry->distinct ||
+     rasqal_query_get_wildcard(query) != entry->wildcard) {
+    if(query->algebra_node)
+      return 1;
+
+    rasqal_query_set_distinct(query, entry->distinct);
+    rasqal_query_set_wildcard(query, entry->wildcard);
+  }
+
+  while(raptor_sequence_size(query->data_graphs) > entry->data_graphs_count) {
+    rasqal_data_graph* dg;
+
+    dg = (rasqal_data_graph*)raptor_sequence_pop(query->data_graphs);
+    rasqal_free_data_graph(dg);
+  }
+
+  rasqal_query_set_limit(query, entry->limit);
+  rasqal_query_set_offset(query, entry->offset);
+  query->explain = entry->explain;
+  memcpy(query->features, entry->features, sizeof(entry->features));
+  query->user_set_rand = entry->user_set_rand;
+  query->store_results = entry->store_results;
+  query->user_data = entry->user_data;
+
+  rasqal_query_clear_parameters(query);
+
+  return 0;
+}
+
+
+/*
+ * rasqal_query_cache_normalize:
+ * @dest: destination buffer at least strlen(@query_string) + 1 long
+ * @query_string: query string
+ *
+ * INTERNAL - Write the cache key form of a query string
+ *
+ * Comments are removed, runs of whitespace become one space and
+ * leading and trailing whitespace is dropped.  String literals and
+ * IRIs are copied unchanged so two query strings with the same
+ * normalized form always parse to the same query.
+ *
+ * Return value: length of the normalized string written to @dest
+ */
+static size_t
+rasqal_query_cache_normalize(unsigned char* dest,
+                             const unsigned char* query_string)
+{
+  const unsigned char* p = query_string;
+  unsigned char* d = dest;
+  int space = 0;
+
+  while(*p) {
+    unsigned char c = *p;
+
+    if(isspace(c)) {
+      space = 1;
+      p++;
+      continue;
+    }
+
+    if(c == '#') {
+      while(*p && *p != '\n' && *p != '\r')
+        p++;
+      space = 1;
+      continue;
+    }
+
+    if(space && d != dest)
+      *d++ = ' ';
+    space = 0;
+
+    if(c == '"' || c == '\'') {
+      int is_long = (p[1] == c && p[2] == c);
+
+      if(is_long) {
+        *d++ = *p++;
+        *d++ = *p++;
+      }
+      *d++ = *p++;
+
+      while(*p) {
+        if(*p == '\\' && p[1]) {
+          *d++ = *p++;
+          *d++ = *p++;
+          continue;
+        }
+
+        if(*p == c) {
+          if(!is_long) {
+            *d++ = *p++;
+            break;
+          }
+
+          if(p[1] == c && p[2] == c) {
+            *d++ = *p++;
+            *d++ = *p++;
+            *d++ = *p++;
+            break;
+          }
+        }
+
+        *d++ = *p++;
+      }
+      continue;
+    }
+
+    if(c == '<') {
+      const unsigned char* end;
+
+      /* an IRI has no spaces, quotes or braces; else '<' is an operator */
+      for(end = p + 1; *end && *end != '>'; end++) {
+        if(isspace(*end) || strchr("<\"'{}|^`\\", *end))
+          break;
+      }
+
+      if(*end == '>') {
+        size_t len = RASQAL_GOOD_CAST(size_t, end - p) + 1;
+
+        memcpy(d, p, len);
+        d += len;
+        p += len;
+        continue;
+      }
+    }
+
+    *d++ = *p++;
+  }
+
+  *d = '\0';
+
+  return RASQAL_GOOD_CAST(size_t, d - dest);
+}
+
+
+/*
+ * rasqal_query_cache_make_key:
+ * @factory: query language factory
+ * @query_string: query string
+ * @base_uri: base URI
+ * @len_p: pointer to store key length
+ *
+ * INTERNAL - Make the cache key for a query
+ *
+ * Return value: new key or NULL on failure
+ */
+static unsigned char*
+rasqal_query_cache_make_key(rasqal_query_language_factory* factory,
+                            const unsigned char* query_string,
+                            raptor_uri* base_uri,
+                            size_t* len_p)
+{
+  const char* name = factory->desc.names[0];
+  size_t name_len = strlen(name);
+  const unsigned char* uri_string;
+  size_t uri_len;
+  unsigned char* key;
+  unsigned char* p;
+
+  uri_string = raptor_uri_as_counted_string(base_uri, &uri_len);
+
+  key = RASQAL_MALLOC(unsigned char*, name_len + uri_len +
+                      strlen(RASQAL_GOOD_CAST(const char*, query_string)) + 3);
+  if(!key)
+    return NULL;
+
+  p = key;
+  memcpy(p, name, name_len);
+  p += name_len;
+  *p++ = '\n';
+  memcpy(p, uri_string, uri_len);
+  p += uri_len;
+  *p++ = '\n';
+  p += rasqal_query_cache_normalize(p, query_string);
+
+  *len_p = RASQAL_GOOD_CAST(size_t, p - key);
+
+  return key;
+}
+
+
+/*
+ * rasqal_query_cache_trim:
+ * @world: world
+ *
+ * INTERNAL - Remove least recently used queries until the cache fits its size
+ */
+static void
+rasqal_query_cache_trim(rasqal_world* world)
+{
+  while(raptor_sequence_size(world->query_cache) > world->query_cache_size) {
+    rasqal_query_cache_entry* entry;
+
+    entry = (rasqal_query_cache_entry*)raptor_sequence_pop(world->query_cache);
+    rasqal_free_query_cache_entry(entry);
+  }
+}
+
+
+/*
+ * rasqal_world_finish_query_cache:
+ * @world: world
+ *
+ * INTERNAL - Free the prepared query cache
+ */
+void
+rasqal_world_finish_query_cache(rasqal_world* world)
+{
+  if(world->query_cache) {
+    raptor_free_sequence(world->query_cache);
+    world->query_cache = NULL;
+  }
+}
+
+
+/**
+ * rasqal_world_set_query_cache_size:
+ * @world: world
+ * @size: maximum number of cached queries or 0 to disable the cache
+ *
+ * Set the size of the prepared query cache
+ *
+ * When the cache is enabled, rasqal_new_prepared_query() returns a
+ * cached query for a query string it has already prepared, skipping
+ * parsing and the query algebra construction.  The least recently
+ * used queries are removed when the cache is full.
+ *
+ * The cache is disabled by default.  Setting a smaller size removes
+ * queries from the cache immediately.
+ *
+ * Return value: non-0 on failure
+ */
+int
+rasqal_world_set_query_cache_size(rasqal_world* world, int size)
+{
+  RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(world, rasqal_world, 1);
+
+  if(size < 0)
+    return 1;
+
+  world->query_cache_size = size;
+
+  if(!size) {
+    rasqal_world_finish_query_cache(world);
+    return 0;
+  }
+
+  if(!world->query_cache) {
+    world->query_cache = raptor_new_sequence((raptor_data_free_handler)rasqal_free_query_cache_entry, NULL);
+    if(!world->query_cache)
+      return 1;
+  }
+
+  rasqal_query_cache_trim(world);
+
+  return 0;
+}
+
+
+/**
+ * rasqal_world_get_query_cache_stats:
+ * @world: world
+ * @hits_p: pointer to store number of cache hits (or NULL)
+ * @misses_p: pointer to store number of cache misses (or NULL)
+ * @count_p: pointer to store number of cached queries (or NULL)
+ *
+ * Get the prepared query cache statistics
+ *
+ * The hit and miss counts are of rasqal_new_prepared_query() calls
+ * made while the cache was enabled.
+ *
+ * Return value: non-0 on failure
+ */
+int
+rasqal_world_get_query_cache_stats(rasqal_world* world,
+                                   unsigned long* hits_p,
+                                   unsigned long* misses_p,
+                                   int* count_p)
+{
+  RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(world, rasqal_world, 1);
+
+  if(hits_p)
+    *hits_p = world->query_cache_hits;
+
+  if(misses_p)
+    *misses_p = world->query_cache_misses;
+
+  if(count_p)
+    *count_p = world->query_cache ? raptor_sequence_size(world->query_cache) : 0;
+
+  return 0;
+}
+
+
+/**
+ * rasqal_new_prepared_query:
+ * @world: rasqal_world object
+ * @name: the query language name (or NULL)
+ * @uri: #raptor_uri language uri (or NULL)
+ * @query_string: the query string
+ * @base_uri: base URI of query string (optional)
+ *
+ * Constructor - create a new prepared rasqal_query object.
+ *
+ * This is rasqal_new_query() followed by rasqal_query_prepare()
+ * except that when the query cache is enabled with
+ * rasqal_world_set_query_cache_size(), an unused cached query with
+ * the same language, base URI and query string is returned.  Query
+ * strings that differ only in whitespace and comments are the same.
+ *
+ * A cached query is shared with later callers once it is freed.
+ * Before it is returned from the cache again, any parameters set
+ * with rasqal_query_set_variable2() are removed and data graphs,
+ * LIMIT, OFFSET, explain mode, features, user data and stored
+ * results mode are set back to how they were after preparing.  A
+ * cached query whose DISTINCT mode or wildcard was changed after it
+ * was executed is prepared again instead.
+ *
+ * Return value: a new #rasqal_query object or NULL on failure
+ */
+rasqal_query*
+rasqal_new_prepared_query(rasqal_world* world, const char *name,
+                          const unsigned char *uri,
+                          const unsigned char *query_string,
+                          raptor_uri *base_uri)
+{
+  rasqal_query_language_factory* factory;
+  rasqal_query_cache_entry* entry = NULL;
+  rasqal_query* query = NULL;
+  unsigned char* key = NULL;
+  size_t key_len = 0;
+  int i;
+
+  RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(world, rasqal_world, NULL);
+  RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(query_string, char*, NULL);
+
+  rasqal_world_open(world);
+
+  if(base_uri)
+    base_uri = raptor_uri_copy(base_uri);
+  else {
+    /* same default base URI as rasqal_query_prepare() */
+    unsigned char *uri_string = raptor_uri_filename_to_uri_string("");
+    base_uri = raptor_new_uri(world->raptor_world_ptr, uri_string);
+    if(uri_string)
+      raptor_free_memory(uri_string);
+  }
+  if(!base_uri)
+    return NULL;
+
+  if(world->query_cache) {
+    factory = rasqal_get_query_language_factory(world, name, uri);
+    if(!factory)
+      goto tidy;
+
+    key = rasqal_query_cache_make_key(factory, query_string, base_uri,
+                                      &key_len);
+    if(!key)
+      goto tidy;
+
+    for(i = 0;
+        (entry = (rasqal_query_cache_entry*)raptor_sequence_get_at(world->query_cache, i));
+        i++) {
+      if(entry->key_len == key_len && !memcmp(entry->key, key, key_len))
+        break;
+    }
+
+    if(entry && entry->query->usage == 1 &&
+       rasqal_query_cache_restore_state(entry)) {
+      /* changed beyond repair so prepare it again below */
+      entry = (rasqal_query_cache_entry*)raptor_sequence_delete_at(world->query_cache, i);
+      rasqal_free_query_cache_entry(entry);
+      entry = NULL;
+    }
+
+    if(entry && entry->query->usage == 1) {
+      world->query_cache_hits++;
+
+      query = entry->query;
+      query->usage++;
+
+      /* most recently used first; a failed shift only drops the entry */
+      if(i) {
+        raptor_sequence_delete_at(world->query_cache, i);
+        raptor_sequence_shift(world->query_cache, entry);
+      }
+
+      goto tidy;
+    }
+
+    world->query_cache_misses++;
+  }
+
+  query = rasqal_new_query(world, name, uri);
+  if(!query)
+    goto tidy;
+
+  if(rasqal_query_prepare(query, query_string, base_uri)) {
+    rasqal_free_query(query);
+    query = NULL;
+    goto tidy;
+  }
+
+  /* A busy cached query is not replaced; this query is not cached */
+  if(!key || entry)
+    goto tidy;
+
+  entry = RASQAL_CALLOC(rasqal_query_cache_entry*, 1, sizeof(*entry));
+  if(!entry)
+    goto tidy;
+
+  entry->key = key;
+  entry->key_len = key_len;
+  key = NULL;
+  entry->query = query;
+  query->usage++;
+  rasqal_query_cache_save_state(entry);
+
+  /* on failure the entry is freed, dropping only its query reference */
+  if(!raptor_sequence_shift(world->query_cache, entry))
+    rasqal_query_cache_trim(world);
+
+  tidy:
+  if(key)
+    RASQAL_FREE(char*, key);
+
+  raptor_free_uri(base_uri);
+
+  return query;
+}
+
+
+#endif /* not STANDALONE */
+
+
+
+#ifdef STANDALONE
+
+/* one more prototype */
+int main(int argc, char *argv[]);
+
+
+#ifdef RASQAL_QUERY_SPARQL
+
+#define QUERY_1 "SELECT ?s WHERE { ?s ?p ?o }"
+#define QUERY_1_SPACED "  SELECT ?s\n  WHERE {\n    ?s ?p ?o # all\n  }\n"
+#define QUERY_2 "SELECT ?s WHERE { ?s ?p \"a  b\" }"
+#define QUERY_2_SPACED "SELECT ?s WHERE { ?s ?p \"a b\" }"
+#define QUERY_3 "SELECT ?o WHERE { <http://example.org/#s> ?p ?o }"
+#define QUERY_3_OTHER "SELECT ?o WHERE { <http://example.org/#t> ?p ?o }"
+
+
+static int
+check_stats(rasqal_world* world, const char* program, const char* label,
+            unsigned long hits, unsigned long misses, int count)
+{
+  unsigned long got_hits;
+  unsigned long got_misses;
+  int got_count;
+
+  rasqal_world_get_query_cache_stats(world, &got_hits, &got_misses,
+                                     &got_count);
+  if(got_hits != hits || got_misses != misses || got_count != count) {
+    fprintf(stderr,
+            "%s: %s: got %lu hits, %lu misses, %d queries; expected %lu hits, %lu misses, %d queries\n",
+            program, label, got_hits, got_misses, got_count,
+            hits, misses, count);
+    return 1;
+  }
+
+  return 0;
+}
+
+
+/* Add a data graph then return the number of results or <0 on failure */
+static int
+execute_with_data_graph(rasqal_world* world, rasqal_query* query,
+                        const char* data_file)
+{
+  rasqal_query_results* results;
+  rasqal_data_graph* dg;
+  unsigned char* uri_string;
+  raptor_uri* uri;
+  int count;
+
+  uri_string = raptor_uri_filename_to_uri_string(data_file);
+  uri = raptor_new_uri(world->raptor_world_ptr, uri_string);
+  raptor_free_memory(uri_string);
+  if(!uri)
+    return -1;
+
+  dg = rasqal_new_data_graph_from_uri(world, uri, /* name URI */ NULL,
+                                      RASQAL_DATA_GRAPH_BACKGROUND,
+                                      NULL, NULL, NULL);
+  raptor_free_uri(uri);
+  if(!dg || rasqal_query_add_data_graph(query, dg))
+    return -1;
+
+  results = rasqal_query_execute(query);
+  if(!results)
+    return -1;
+
+  for(count = 0; !rasqal_query_results_finished(results); count++)
+    rasqal_query_results_next(results);
+
+  rasqal_free_query_results(results);
+
+  return count;
+}
+
+#endif
+
+
+int
+main(int argc, char *argv[])
+{
+  const char *program = rasqal_basename(argv[0]);
+  rasqal_world* world = NULL;
+  int failures = 0;
+#ifdef RASQAL_QUERY_SPARQL
+  rasqal_query* query1 = NULL;
+  rasqal_query* query2 = NULL;
+  rasqal_query* query3 = NULL;
+  const char *data_file;
+  int i;
+#endif
+
+  world = rasqal_new_world();
+  if(!world || rasqal_world_open(world)) {
+    fprintf(stderr, "%s: rasqal_world init failed\n", program);
+    return(1);
+  }
+
+#ifdef RASQAL_QUERY_SPARQL
+  if(rasqal_world_set_query_cache_size(world, 2)) {
+    fprintf(stderr, "%s: failed to enable query cache\n", program);
+    failures++;
+    goto tidy;
+  }
+
+  /* first use is a miss; the same query after normalizing is a hit */
+  query1 = rasqal_new_prepared_query(world, "sparql", NULL,
+                                     (const unsigned char*)QUERY_1, NULL);
+  if(!query1) {
+    fprintf(stderr, "%s: failed to prepare query 1\n", program);
+    failures++;
+    goto tidy;
+  }
+  rasqal_free_query(query1);
+
+  query2 = rasqal_new_prepared_query(world, NULL, NULL,
+                                     (const unsigned char*)QUERY_1_SPACED,
+                                     NULL);
+  if(query2 != query1) {
+    fprintf(stderr, "%s: normalized query 1 was not found in the cache\n",
+            program);
+    failures++;
+  }
+  failures += check_stats(world, program, "query 1 hit", 1, 1, 1);
+
+  /* a cached query in use is not shared */
+  query3 = rasqal_new_prepared_query(world, "sparql", NULL,
+                                     (const unsigned char*)QUERY_1, NULL);
+  if(!query3 || query3 == query2) {
+    fprintf(stderr, "%s: query 1 in use was returned from the cache\n",
+            program);
+    failures++;
+  }
+  failures += check_stats(world, program, "query 1 in use", 1, 2, 1);
+  rasqal_free_query(query3); query3 = NULL;
+  rasqal_free_query(query2); query2 = NULL;
+
+  /* whitespace inside a string literal is significant */
+  query2 = rasqal_new_prepared_query(world, "sparql", NULL,
+                                     (const unsigned char*)QUERY_2, NULL);
+  rasqal_free_query(query2);
+  query2 = rasqal_new_prepared_query(world, "sparql", NULL,
+                                     (const unsigned char*)QUERY_2_SPACED,
+                                     NULL);
+  rasqal_free_query(query2); query2 = NULL;
+  failures += check_stats(world, program, "string literal", 1, 4, 2);
+
+  /* query 1 was least recently used so it was removed */
+  query1 = rasqal_new_prepared_query(world, "sparql", NULL,
+                                     (const unsigned char*)QUERY_1, NULL);
+  rasqal_free_query(query1); query1 = NULL;
+  query2 = rasqal_new_prepared_query(world, "sparql", NULL,
+                                     (const unsigned char*)QUERY_2_SPACED,
+                                     NULL);
+  rasqal_free_query(query2); query2 = NULL;
+  failures += check_stats(world, program, "eviction", 2, 5, 2);
+
+  /* a '#' inside an IRI is not a comment */
+  query3 = rasqal_new_prepared_query(world, "sparql", NULL,
+                                     (const unsigned char*)QUERY_3, NULL);
+  rasqal_free_query(query3);
+  query3 = rasqal_new_prepared_query(world, "sparql", NULL,
+                                     (const unsigned char*)QUERY_3_OTHER,
+                                     NULL);
+  if(!query3) {
+    fprintf(stderr, "%s: failed to prepare query 3\n", program);
+    failures++;
+  }
+  rasqal_free_query(query3); query3 = NULL;
+  failures += check_stats(world, program, "IRI", 2, 7, 2);
+
+  /* a data graph added by the last user of a cached query is removed */
+  if(!(data_file = getenv("NT_DATA_FILE")) && argc == 2)
+    data_file = argv[1];
+
+  if(data_file) {
+    query1 = NULL;
+    for(i = 0; i < 2; i++) {
+      int count;
+
+      query2 = rasqal_new_prepared_query(world, "sparql", NULL,
+                                         (const unsigned char*)QUERY_1, NULL);
+      if(!query2 || (i && query2 != query1)) {
+        fprintf(stderr, "%s: query 1 was not returned from the cache\n",
+                program);
+        failures++;
+      }
+      if(!query2)
+        break;
+
+      count = execute_with_data_graph(world, query2, data_file);
+      if(count != 1) {
+        fprintf(stderr,
+                "%s: execution %d of query 1 returned %d results, expected 1\n",
+                program, i, count);
+        failures++;
+      }
+
+      query1 = query2;
+      rasqal_free_query(query2); query2 = NULL;
+    }
+    failures += check_stats(world, program, "data graph", 3, 8, 2);
+  }
+
+  /* disabling the cache frees the cached queries */
+  rasqal_world_set_query_cache_size(world, 0);
+  failures += check_stats(world, program, "disabled",
+                          data_file ? 3 : 2, data_file ? 8 : 7, 0);
+
+  tidy:
+#endif
+
+  rasqal_free_world(world);
+
+  return failures;
+}
+
+#endif /* STANDALONE */
@@ -376,10 +376,10 @@ rasqal_query_results_execute_with_engine(rasqal_query_results* query_results,
   /* set executed flag early to enable cleanup on error */
   query_results->executed = 1;
 
-  /* ensure stored results are present if ordering or distincting are being done */
-  query_results->store_results = (store_results ||
-                                  rasqal_query_get_order_conditions_sequence(query) ||
-                                  rasqal_query_get_distinct(query));
+  /* ordering and distincting are done by the sort and distinct
+   * rowsources so their rows can be returned lazily too; store only
+   * when asked to, such as for rewinding */
+  query_results->store_results = store_results;
   
   ex_data_size = query_results->execution_factory->execution_data_size;
   if(ex_data_size > 0) {
@@ -392,6 +392,9 @@ rasqal_query_results_execute_with_engine(rasqal_query_results* query_results,
 
   /* Update the current datetime once per query execution */
   rasqal_world_reset_now(query->world);
+
+  /* Start from the parameter values, not the last execution's values */
+  rasqal_query_reset_variables(query);
   
   if(query_results->execution_factory->execute_init) {
     rasqal_engine_error execution_error = RASQAL_ENGINE_OK;
@@ -666,6 +669,10 @@ rasqal_query_check_limit_offset(rasqal_query* query,
   if(result_offset < 0)
     return -1;
 
+  /* LIMIT and OFFSET apply to the query results, not the explained plan */
+  if(query->explain)
+    return 0;
+
   limit = rasqal_query_get_limit(query);
 
   /* Ensure ASK queries never do more than one result */
@@ -1004,8 +1011,11 @@ rasqal_query_results_rewind(rasqal_query_results* query_results)
     if(query->failed)
       return 1;
     
-    limit = rasqal_query_get_limit(query);
-    offset = rasqal_query_get_offset(query);
+    /* LIMIT and OFFSET apply to the query results, not the explained plan */
+    if(!query->explain) {
+      limit = rasqal_query_get_limit(query);
+      offset = rasqal_query_get_offset(query);
+    }
   }
   
   /* reset to first result */
@@ -1040,6 +1050,48 @@ rasqal_query_results_rewind(rasqal_query_results* query_results)
 }
 
 
+/**
+ * rasqal_query_results_visit_profile:
+ * @query_results: #rasqal_query_results query_results
+ * @handler: function to call for each query operator
+ * @user_data: user data for @handler
+ *
+ * Visit the runtime counters of the operators executing the query.
+ *
+ * The operators are visited in pre-order from the root, which
+ * returns the query results, down to the triple pattern matches.
+ * The counters are those at the time of the call so this may be
+ * called while reading results as well as after.  Set the query
+ * feature #RASQAL_FEATURE_PROFILE before execution to also record
+ * times and row memory.
+ *
+ * When the query is explained with rasqal_query_set_explain(), the
+ * operator is the one returning the query plan; the query plan
+ * results contain the counters of the query itself.
+ *
+ * Return value: non-0 on failure, if the query has not been executed or if @handler returned non-0
+ **/
+int
+rasqal_query_results_visit_profile(rasqal_query_results* query_results,
+                                   rasqal_operator_profile_handler handler,
+                                   void *user_data)
+{
+  rasqal_rowsource* rowsource;
+
+  RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(query_results, rasqal_query_results, 1);
+
+  if(!query_results->executed || !query_results->execution_factory ||
+     !query_results->execution_factory->get_rowsource)
+    return 1;
+
+  rowsource = query_results->execution_factory->get_rowsource(query_results->execution_data);
+  if(!rowsource)
+    return 1;
+
+  return rasqal_rowsource_visit_profile(rowsource, handler, user_data);
+}
+
+
 /**
  * rasqal_query_results_get_bindings:
  * @query_results: #rasqal_query_results query_results
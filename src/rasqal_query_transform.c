@@ -57,6 +57,7 @@ static int rasqal_query_let_build_variables_use_map_binds(rasqal_graph_pattern*
 static int rasqal_query_select_build_variables_use_map(rasqal_query* query, unsigned short *use_map, int width, rasqal_graph_pattern* gp);
 static int rasqal_query_select_build_variables_use_map_binds(rasqal_query* query, unsigned short *use_map, int width, rasqal_graph_pattern* gp, unsigned short* vars_scope);
 static int rasqal_query_union_build_variables_use_map_binds(rasqal_query* query, unsigned short *use_map, int width, rasqal_graph_pattern* gp, unsigned short* vars_scope);
+static int rasqal_query_minus_build_variables_use_map_binds(rasqal_query* query, unsigned short *use_map, int width, rasqal_graph_pattern* gp);
 static int rasqal_query_values_build_variables_use_map_binds(rasqal_query* query, unsigned short *use_map, int width, rasqal_graph_pattern* gp, unsigned short* vars_scope);
 
 
@@ -909,6 +910,495 @@ rasqal_query_merge_graph_patterns(rasqal_query* query,
 }
 
 
+/*
+ * rasqal_query_triple_pattern_cost:
+ * @t: triple pattern
+ * @bound: array of flags indexed by variable offset; non-0 if bound
+ * @connected_p: pointer to store non-0 if a variable in @t is bound
+ *
+ * INTERNAL - Estimate how many triples match a triple pattern
+ *
+ * A part that is a constant or a bound variable is known when the
+ * pattern is matched.  An unknown subject adds 4, object 2 and
+ * predicate 1 since subjects are usually the most selective and
+ * predicates the least.
+ *
+ * Return value: cost from 0 (all parts known) to 7 (no parts known)
+ */
+static int
+rasqal_query_triple_pattern_cost(rasqal_triple* t, const char* bound,
+                                 int* connected_p)
+{
+  rasqal_literal* parts[3];
+  static const int part_costs[3] = { 4, 1, 2 };
+  int cost = 0;
+  int i;
+
+  parts[0] = t->subject;
+  parts[1] = t->predicate;
+  parts[2] = t->object;
+
+  *connected_p = 0;
+  for(i = 0; i < 3; i++) {
+    rasqal_variable* v = rasqal_literal_as_variable(parts[i]);
+
+    if(!v)
+      continue;
+
+    if(bound[v->offset])
+      *connected_p = 1;
+    else
+      cost += part_costs[i];
+  }
+
+  return cost;
+}
+
+
+/*
+ * rasqal_query_triple_pattern_estimate:
+ * @triples_source: triples source
+ * @t: triple pattern
+ * @bound: array of flags indexed by variable offset; non-0 if bound
+ * @connected_p: pointer to store non-0 if a variable in @t is bound
+ *
+ * INTERNAL - Estimate how many triples match a triple pattern from statistics
+ *
+ * The triples source counts the triples matching the constant parts
+ * of @t.  When the subject (or else the object) is a bound variable,
+ * that is divided by its number of distinct values, assuming each
+ * value matches as many triples.
+ *
+ * Return value: estimated number of triples or <0 if not available
+ */
+static long
+rasqal_query_triple_pattern_estimate(rasqal_triples_source* triples_source,
+                                     rasqal_triple* t, const char* bound,
+                                     int* connected_p)
+{
+  rasqal_variable* subject_v = rasqal_literal_as_variable(t->subject);
+  rasqal_variable* predicate_v = rasqal_literal_as_variable(t->predicate);
+  rasqal_variable* object_v = rasqal_literal_as_variable(t->object);
+  rasqal_triples_source_statistic statistic;
+  long count;
+  long distinct;
+
+  *connected_p = (subject_v && bound[subject_v->offset]) ||
+                 (predicate_v && bound[predicate_v->offset]) ||
+                 (object_v && bound[object_v->offset]);
+
+  if(rasqal_triples_source_get_statistic(triples_source,
+                                         RASQAL_TRIPLES_SOURCE_STATISTIC_TRIPLES,
+                                         t, &count, NULL))
+    return -1;
+
+  if(subject_v && bound[subject_v->offset])
+    statistic = RASQAL_TRIPLES_SOURCE_STATISTIC_DISTINCT_SUBJECTS;
+  else if(object_v && bound[object_v->offset])
+    statistic = RASQAL_TRIPLES_SOURCE_STATISTIC_DISTINCT_OBJECTS;
+  else
+    return count;
+
+  if(!rasqal_triples_source_get_statistic(triples_source, statistic, t,
+                                          &distinct, NULL) &&
+     distinct > 1)
+    count = (count + distinct - 1) / distinct;
+
+  return count;
+}
+
+
+/*
+ * rasqal_graph_pattern_mark_bound_variables:
+ * @gp: graph pattern
+ * @bound: array of flags indexed by variable offset to set
+ *
+ * INTERNAL - Mark the variables a graph pattern may bind
+ *
+ * Used to know which variables are already bound when a later BGP in
+ * the same group is matched.  FILTER and MINUS bind nothing and a
+ * sub-SELECT binds only its projected variables.
+ */
+static void
+rasqal_graph_pattern_mark_bound_variables(rasqal_graph_pattern* gp,
+                                          char* bound)
+{
+  rasqal_variable* v;
+  raptor_sequence* seq = NULL;
+  int size;
+  int i;
+
+  switch(gp->op) {
+    case RASQAL_GRAPH_PATTERN_OPERATOR_FILTER:
+    case RASQAL_GRAPH_PATTERN_OPERATOR_MINUS:
+      return;
+
+    case RASQAL_GRAPH_PATTERN_OPERATOR_SELECT:
+      if(gp->projection)
+        seq = rasqal_projection_get_variables_sequence(gp->projection);
+      break;
+
+    case RASQAL_GRAPH_PATTERN_OPERATOR_VALUES:
+      if(gp->bindings)
+        seq = gp->bindings->variables;
+      break;
+
+    case RASQAL_GRAPH_PATTERN_OPERATOR_LET:
+      if(gp->var)
+        bound[gp->var->offset] = 1;
+      break;
+
+    case RASQAL_GRAPH_PATTERN_OPERATOR_GRAPH:
+      if(gp->origin && (v = rasqal_literal_as_variable(gp->origin)))
+        bound[v->offset] = 1;
+      break;
+
+    case RASQAL_GRAPH_PATTERN_OPERATOR_BASIC:
+      for(i = gp->start_column; gp->triples && i <= gp->end_column; i++) {
+        rasqal_triple* t;
+
+        t = (rasqal_triple*)raptor_sequence_get_at(gp->triples, i);
+        if((v = rasqal_literal_as_variable(t->subject)))
+          bound[v->offset] = 1;
+        if((v = rasqal_literal_as_variable(t->predicate)))
+          bound[v->offset] = 1;
+        if((v = rasqal_literal_as_variable(t->object)))
+          bound[v->offset] = 1;
+        if(t->origin && (v = rasqal_literal_as_variable(t->origin)))
+          bound[v->offset] = 1;
+      }
+      break;
+
+    case RASQAL_GRAPH_PATTERN_OPERATOR_OPTIONAL:
+    case RASQAL_GRAPH_PATTERN_OPERATOR_UNION:
+    case RASQAL_GRAPH_PATTERN_OPERATOR_GROUP:
+    case RASQAL_GRAPH_PATTERN_OPERATOR_SERVICE:
+    case RASQAL_GRAPH_PATTERN_OPERATOR_UNKNOWN:
+      break;
+  }
+
+  if(seq) {
+    size = raptor_sequence_size(seq);
+    for(i = 0; i < size; i++) {
+      v = (rasqal_variable*)raptor_sequence_get_at(seq, i);
+      bound[v->offset] = 1;
+    }
+  }
+
+  if(gp->op == RASQAL_GRAPH_PATTERN_OPERATOR_SELECT || !gp->graph_patterns)
+    return;
+
+  size = raptor_sequence_size(gp->graph_patterns);
+  for(i = 0; i < size; i++) {
+    rasqal_graph_pattern* sgp;
+
+    sgp = (rasqal_graph_pattern*)raptor_sequence_get_at(gp->graph_patterns, i);
+    rasqal_graph_pattern_mark_bound_variables(sgp, bound);
+  }
+}
+
+
+/*
+ * rasqal_query_get_reorder_triples:
+ * @query: query
+ *
+ * INTERNAL - Get the plan triple sequence to reorder, making it if needed
+ *
+ * The first reorder copies the query triple sequence so that the query
+ * keeps the triple patterns in the order they were written in.
+ *
+ * Return value: plan triple sequence or NULL on failure
+ */
+static raptor_sequence*
+rasqal_query_get_reorder_triples(rasqal_query* query)
+{
+  raptor_sequence* seq;
+  int size;
+  int i;
+
+  if(query->plan_triples)
+    return query->plan_triples;
+
+  /* triples are owned by query->triples */
+  seq = raptor_new_sequence(NULL,
+                            (raptor_data_print_handler)rasqal_triple_print);
+  if(!seq)
+    return NULL;
+
+  size = raptor_sequence_size(query->triples);
+  for(i = 0; i < size; i++) {
+    if(raptor_sequence_push(seq, raptor_sequence_get_at(query->triples, i))) {
+      raptor_free_sequence(seq);
+      return NULL;
+    }
+  }
+
+  query->plan_triples = seq;
+  return seq;
+}
+
+
+/*
+ * rasqal_query_reorder_bgp:
+ * @query: query
+ * @gp: basic graph pattern
+ * @triples_source: triples source to estimate costs with (or NULL)
+ * @siblings: graph patterns of the group containing @gp (or NULL)
+ * @siblings_count: number of graph patterns in @siblings before @gp
+ * @modified_p: pointer to set to 1 if the order changed
+ *
+ * INTERNAL - Reorder the triple patterns in a BGP by estimated selectivity
+ *
+ * The triple patterns are matched in sequence order with nested
+ * iteration, so a pattern with few matches should come first.  The
+ * order is chosen greedily: at each step take the lowest cost triple
+ * pattern from those sharing a variable with the patterns already
+ * chosen, or from all the remaining patterns if none do, to avoid
+ * cross products.  Ties keep the current order.  Variables that the
+ * graph patterns before @gp in its group may bind count as already
+ * bound.
+ *
+ * The cost is the estimate from @triples_source statistics (see
+ * rasqal_query_triple_pattern_estimate()) if it has them for every
+ * pattern in the BGP, otherwise the structural cost from
+ * rasqal_query_triple_pattern_cost().
+ *
+ * The triple patterns are permuted in the query plan triple sequence;
+ * the query triple sequence is not changed.
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_query_reorder_bgp(rasqal_query* query, rasqal_graph_pattern* gp,
+                         rasqal_triples_source* triples_source,
+                         raptor_sequence* siblings, int siblings_count,
+                         int* modified_p)
+{
+  raptor_sequence* triples;
+  char* bound;
+  int width;
+  int column;
+  int i;
+
+  if(gp->op != RASQAL_GRAPH_PATTERN_OPERATOR_BASIC || !gp->triples ||
+     gp->triples != query->triples ||
+     gp->end_column - gp->start_column < 1)
+    return 0;
+
+  triples = rasqal_query_get_reorder_triples(query);
+  if(!triples)
+    return 1;
+
+  width = rasqal_variables_table_get_total_variables_count(query->vars_table);
+  bound = RASQAL_CALLOC(char*, RASQAL_GOOD_CAST(size_t, width + 1), sizeof(char));
+  if(!bound)
+    return 1;
+
+  for(i = 0; i < siblings_count; i++) {
+    rasqal_graph_pattern* sgp;
+
+    sgp = (rasqal_graph_pattern*)raptor_sequence_get_at(siblings, i);
+    rasqal_graph_pattern_mark_bound_variables(sgp, bound);
+  }
+
+  if(triples_source) {
+    int connected;
+
+    for(column = gp->start_column; column <= gp->end_column; column++) {
+      rasqal_triple* t;
+
+      t = (rasqal_triple*)raptor_sequence_get_at(triples, column);
+      if(rasqal_query_triple_pattern_estimate(triples_source, t, bound,
+                                              &connected) < 0) {
+        triples_source = NULL;
+        break;
+      }
+    }
+  }
+
+  for(column = gp->start_column; column <= gp->end_column; column++) {
+    int best_column = -1;
+    long best_cost = 0;
+    int best_connected = 0;
+    rasqal_triple* t;
+    rasqal_literal* parts[3];
+
+    for(i = column; i <= gp->end_column; i++) {
+      long cost;
+      int connected;
+
+      t = (rasqal_triple*)raptor_sequence_get_at(triples, i);
+      if(triples_source)
+        cost = rasqal_query_triple_pattern_estimate(triples_source, t, bound,
+                                                    &connected);
+      else
+        cost = rasqal_query_triple_pattern_cost(t, bound, &connected);
+
+      if(best_column < 0 ||
+         (connected && !best_connected) ||
+         (connected == best_connected && cost < best_cost)) {
+        best_column = i;
+        best_cost = cost;
+        best_connected = connected;
+      }
+    }
+
+    /* move the chosen triple to this column keeping the rest in order */
+    for(i = best_column; i > column; i--)
+      raptor_sequence_swap(triples, i - 1, i);
+
+    if(best_column != column)
+      *modified_p = 1;
+
+    t = (rasqal_triple*)raptor_sequence_get_at(triples, column);
+    parts[0] = t->subject;
+    parts[1] = t->predicate;
+    parts[2] = t->object;
+    for(i = 0; i < 3; i++) {
+      rasqal_variable* v = rasqal_literal_as_variable(parts[i]);
+      if(v)
+        bound[v->offset] = 1;
+    }
+  }
+
+  RASQAL_FREE(char*, bound);
+
+  return 0;
+}
+
+
+typedef struct {
+  rasqal_triples_source* triples_source;
+  int modified;
+} rasqal_query_reorder_data;
+
+
+/*
+ * rasqal_query_reorder_triple_patterns_visit:
+ * @query: query
+ * @gp: current graph pattern
+ * @data: #rasqal_query_reorder_data
+ *
+ * INTERNAL - Reorder the triple patterns of the BGPs in a graph pattern
+ *
+ * A BGP is reordered when its parent is visited so that the graph
+ * patterns before it in a group are known.  The branches of a UNION
+ * are alternatives so they do not bind variables for each other.
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_query_reorder_triple_patterns_visit(rasqal_query* query,
+                                           rasqal_graph_pattern* gp,
+                                           void* data)
+{
+  rasqal_query_reorder_data* rd = (rasqal_query_reorder_data*)data;
+  int size;
+  int i;
+
+  if(gp == query->query_graph_pattern &&
+     gp->op == RASQAL_GRAPH_PATTERN_OPERATOR_BASIC)
+    return rasqal_query_reorder_bgp(query, gp, rd->triples_source,
+                                    NULL, 0, &rd->modified);
+
+  if(!gp->graph_patterns)
+    return 0;
+
+  size = raptor_sequence_size(gp->graph_patterns);
+  for(i = 0; i < size; i++) {
+    rasqal_graph_pattern* sgp;
+    int rc;
+
+    sgp = (rasqal_graph_pattern*)raptor_sequence_get_at(gp->graph_patterns, i);
+    rc = rasqal_query_reorder_bgp(query, sgp, rd->triples_source,
+                                  gp->graph_patterns,
+                                  (gp->op == RASQAL_GRAPH_PATTERN_OPERATOR_GROUP) ? i : 0,
+                                  &rd->modified);
+    if(rc)
+      return rc;
+  }
+
+  return 0;
+}
+
+
+/**
+ * rasqal_query_reorder_triple_patterns:
+ * @query: query
+ *
+ * INTERNAL - Reorder the triple patterns in BGPs by structure
+ *
+ * Done when the query is prepared, before any data is loaded, using
+ * rasqal_query_reorder_bgp() with structural costs.
+ *
+ * The triples are permuted in the query plan triple sequence so this
+ * must be done before the variables use maps are built.
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_query_reorder_triple_patterns(rasqal_query* query)
+{
+  rasqal_query_reorder_data rd;
+
+  rd.triples_source = NULL;
+  rd.modified = 0;
+
+  return rasqal_query_graph_pattern_visit2(query,
+                                           rasqal_query_reorder_triple_patterns_visit,
+                                           &rd);
+}
+
+
+/**
+ * rasqal_query_reorder_triple_patterns_by_statistics:
+ * @query: prepared query
+ * @triples_source: triples source the query is executed against
+ *
+ * INTERNAL - Reorder the triple patterns in BGPs by triples source statistics
+ *
+ * Done at execution once the data is loaded, before the query
+ * algebra is built.  BGPs where @triples_source cannot estimate every
+ * triple pattern keep the order chosen when the query was prepared.
+ * If any order changes, the variables use maps are built again for it.
+ *
+ * Once the algebra has been built the order is fixed: its BGP nodes
+ * refer to the triple patterns by position, including the FILTER
+ * expressions pushed down into them, so the plan is left unchanged.
+ *
+ * Return value: non-0 on failure
+ */
+int
+rasqal_query_reorder_triple_patterns_by_statistics(rasqal_query* query,
+                                                   rasqal_triples_source* triples_source)
+{
+  rasqal_query_reorder_data rd;
+  int rc;
+
+  if(query->algebra_node || !query->query_graph_pattern ||
+     triples_source->version < 3 || !triples_source->get_statistic)
+    return 0;
+
+  rd.triples_source = triples_source;
+  rd.modified = 0;
+
+  rc = rasqal_query_graph_pattern_visit2(query,
+                                         rasqal_query_reorder_triple_patterns_visit,
+                                         &rd);
+  if(rc || !rd.modified)
+    return rc;
+
+#if defined(RASQAL_DEBUG) && RASQAL_DEBUG > 1
+  fprintf(DEBUG_FH, "after reorder triple patterns by statistics, query plan triples now:\n  ");
+  raptor_sequence_print(query->plan_triples, DEBUG_FH);
+  fputs("\n", DEBUG_FH);
+#endif
+
+  return rasqal_query_build_variables_use_map(query,
+                                              rasqal_query_get_projection(query));
+}
+
+
 /**
  * rasqal_query_filter_variable_scope:
  * @query: query
@@ -1358,6 +1848,17 @@ rasqal_query_prepare_common(rasqal_query *query)
     if(rc)
       goto done;
 
+    rc = rasqal_query_reorder_triple_patterns(query);
+#if defined(RASQAL_DEBUG) && RASQAL_DEBUG > 1
+    if(query->plan_triples) {
+      fputs("after reorder triple patterns, query plan triples now:\n  ", DEBUG_FH);
+      raptor_sequence_print(query->plan_triples, DEBUG_FH);
+      fputs("\n", DEBUG_FH);
+    }
+#endif
+    if(rc)
+      goto done;
+
     rc = rasqal_query_enumerate_graph_patterns(query);
     if(rc)
       goto done;
@@ -1763,11 +2264,16 @@ rasqal_query_triples_build_variables_use_map_binds(rasqal_query* query,
 {
   int start_column = gp->start_column;
   int end_column = gp->end_column;
+  raptor_sequence* triples = gp->triples;
   int col;
   int gp_offset;
   unsigned short* gp_use_map_row;
   int var_index;
 
+  /* bind in the order the triple patterns are matched */
+  if(triples == query->triples)
+    triples = rasqal_query_get_plan_triple_sequence(query);
+
   gp_offset = (gp->gp_index + RASQAL_VAR_USE_MAP_OFFSET_LAST + 1) * width;
   gp_use_map_row = &query->variables_use_map[gp_offset];
 
@@ -1777,7 +2283,7 @@ rasqal_query_triples_build_variables_use_map_binds(rasqal_query* query,
     rasqal_variable *v;
     unsigned short* triple_row = &query->triples_use_map[col * width];
     
-    t = (rasqal_triple*)raptor_sequence_get_at(gp->triples, col);
+    t = (rasqal_triple*)raptor_sequence_get_at(triples, col);
 
     if((v = rasqal_literal_as_variable(t->subject))) {
       if(!vars_scope[v->offset]) {
@@ -1949,8 +2455,13 @@ rasqal_query_graph_pattern_build_variables_use_map_binds(rasqal_query* query,
                                                              vars_scope);
       break;
 
-    case RASQAL_GRAPH_PATTERN_OPERATOR_SERVICE:
     case RASQAL_GRAPH_PATTERN_OPERATOR_MINUS:
+      rc = rasqal_query_minus_build_variables_use_map_binds(query,
+                                                            use_map, width,
+                                                            gp);
+      break;
+
+    case RASQAL_GRAPH_PATTERN_OPERATOR_SERVICE:
     case RASQAL_GRAPH_PATTERN_OPERATOR_UNKNOWN:
       break;
   }
@@ -1961,8 +2472,10 @@ rasqal_query_graph_pattern_build_variables_use_map_binds(rasqal_query* query,
   rasqal_query_dump_vars_scope(query, width, vars_scope);
 #endif
 
-  /* Bind sub-graph patterns but not sub-SELECT gp twice */
-  if(gp->op != RASQAL_GRAPH_PATTERN_OPERATOR_SELECT && gp->graph_patterns) {
+  /* Bind sub-graph patterns but not sub-SELECT gp twice nor MINUS
+   * in the outer scope */
+  if(gp->op != RASQAL_GRAPH_PATTERN_OPERATOR_SELECT &&
+     gp->op != RASQAL_GRAPH_PATTERN_OPERATOR_MINUS && gp->graph_patterns) {
     int gp_size = raptor_sequence_size(gp->graph_patterns);
     int i;
     
@@ -2703,6 +3216,60 @@ rasqal_query_select_build_variables_use_map_binds(rasqal_query* query,
 }
 
 
+/**
+ * rasqal_query_minus_build_variables_use_map_binds:
+ * @use_map: 2D array of (num. variables x num. GPs) to READ and WRITE
+ * @width: width of array (num. variables)
+ * @gp: graph pattern to use
+ *
+ * INTERNAL - Mark variables bound in a MINUS sub-graph patterns
+ *
+ * The MINUS graph pattern is evaluated on its own so starts with no
+ * scoped outer variables and its bindings do not leave it.
+ * 
+ **/
+static int
+rasqal_query_minus_build_variables_use_map_binds(rasqal_query* query,
+                                                 unsigned short *use_map,
+                                                 int width,
+                                                 rasqal_graph_pattern* gp)
+{
+  unsigned short* inner_vars_scope;
+  raptor_sequence* seq;
+  int gp_size;
+  int i;
+  int rc = 0;
+
+  seq = gp->graph_patterns;
+  gp_size = raptor_sequence_size(seq);
+  
+  inner_vars_scope = RASQAL_CALLOC(unsigned short*, RASQAL_GOOD_CAST(size_t, width),
+                                   sizeof(unsigned short));
+  if(!inner_vars_scope)
+    return 1;
+
+  for(i = 0; i < gp_size; i++) {
+    rasqal_graph_pattern *sgp;
+    
+    sgp = (rasqal_graph_pattern*)raptor_sequence_get_at(seq, i);
+
+    rc = rasqal_query_graph_pattern_build_variables_use_map_binds(query,
+                                                                  use_map,
+                                                                  width,
+                                                                  sgp,
+                                                                  inner_vars_scope);
+    if(rc)
+      goto done;
+
+  }
+  
+  done:
+  RASQAL_FREE(intarray, inner_vars_scope);
+  
+  return rc;
+}
+
+
 /**
  * rasqal_query_union_build_variables_use_map_binds:
  * @use_map: 2D array of (num. variables x num. GPs) to READ and WRITE
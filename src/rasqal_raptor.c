@@ -41,18 +41,102 @@
 #include "rasqal_internal.h"
 
 
+/*
+ * Term dictionary: every distinct RDF term loaded into the triples
+ * source is stored once as a shared #rasqal_literal and given a
+ * small integer ID (1 or larger; 0 is used for no term).  Triples
+ * are stored as tuples of term IDs so term equality is an integer
+ * compare.
+ */
+typedef struct {
+  /* array of interned terms indexed by term ID; entry 0 is unused */
+  rasqal_literal **terms;
+  /* hash of each term indexed by term ID */
+  unsigned int *hashes;
+  /* number of IDs used including the unused ID 0 */
+  int terms_count;
+  /* allocated size of the two arrays above */
+  int terms_size;
+
+  /* open addressed hash table of term IDs; 0 is an empty bucket */
+  int *buckets;
+  /* number of buckets - always a power of 2 */
+  unsigned int buckets_size;
+} rasqal_raptor_term_dictionary;
+
+
 struct rasqal_raptor_triple_s {
-  struct rasqal_raptor_triple_s *next;
-  rasqal_triple *triple;
+  /* term IDs in the term dictionary */
+  int subject;
+  int predicate;
+  int object;
+
+  /* index of the data graph in source_literals the triple was read from */
+  int origin;
+
+  /* position in load order; used to keep index ranges in source order */
+  int offset;
 };
 
 typedef struct rasqal_raptor_triple_s rasqal_raptor_triple;
 
+
+/*
+ * Permutation indexes over the loaded triples.  Each index is an
+ * array of pointers into the triples array sorted on the three
+ * triple parts in the order given by rasqal_raptor_index_parts[]
+ * so that a triple pattern with bound leading parts becomes a range
+ * lookup.
+ */
+typedef enum {
+  RASQAL_RAPTOR_INDEX_SPO,
+  RASQAL_RAPTOR_INDEX_POS,
+  RASQAL_RAPTOR_INDEX_OSP,
+  RASQAL_RAPTOR_INDEX_LAST = RASQAL_RAPTOR_INDEX_OSP
+} rasqal_raptor_index;
+
+#define RASQAL_RAPTOR_INDEX_COUNT (RASQAL_RAPTOR_INDEX_LAST + 1)
+
+
+/*
+ * Statistics for the triples with one predicate; gathered from the
+ * indexes once all triples are loaded.
+ */
+typedef struct {
+  int triples;
+  int distinct_subjects;
+  int distinct_objects;
+} rasqal_raptor_predicate_statistics;
+
+static const rasqal_triple_parts rasqal_raptor_index_parts[RASQAL_RAPTOR_INDEX_COUNT][3] = {
+  { RASQAL_TRIPLE_SUBJECT, RASQAL_TRIPLE_PREDICATE, RASQAL_TRIPLE_OBJECT },
+  { RASQAL_TRIPLE_PREDICATE, RASQAL_TRIPLE_OBJECT, RASQAL_TRIPLE_SUBJECT },
+  { RASQAL_TRIPLE_OBJECT, RASQAL_TRIPLE_SUBJECT, RASQAL_TRIPLE_PREDICATE }
+};
+
+
 typedef struct {
   rasqal_world* world;
 
-  rasqal_raptor_triple *head;
-  rasqal_raptor_triple *tail;
+  /* interned terms of all triples below */
+  rasqal_raptor_term_dictionary dictionary;
+
+  /* triples in load order */
+  rasqal_raptor_triple *triples;
+  /* number of triples used in array above */
+  int triples_count;
+  /* allocated size of array above */
+  int triples_size;
+
+  /* permutation indexes of triples_count entries each; built after load */
+  rasqal_raptor_triple **indexes[RASQAL_RAPTOR_INDEX_COUNT];
+
+  /* statistics indexed by predicate term ID; built after load */
+  rasqal_raptor_predicate_statistics *predicate_statistics;
+
+  /* number of distinct subjects and objects of all triples */
+  int distinct_subjects;
+  int distinct_objects;
 
   /* index used while reading triples into the two arrays below.
    * This is used to connect a triple to the URI literal of the source
@@ -78,6 +162,7 @@ typedef struct {
 /* prototypes */
 static int rasqal_raptor_init_triples_match(rasqal_triples_match* rtm, rasqal_triples_source *rts, void *user_data, rasqal_triple_meta *m, rasqal_triple *t);
 static int rasqal_raptor_triple_present(rasqal_triples_source *rts, void *user_data, rasqal_triple *t);
+static int rasqal_raptor_get_statistic(void *user_data, rasqal_triples_source_statistic statistic, rasqal_triple *t, long *count_p, int *exact_p);
 static void rasqal_raptor_free_triples_source(void *user_data);
 
 
@@ -95,35 +180,658 @@ raptor_statement_as_rasqal_triple(rasqal_world* world,
 }
 
 
+/*
+ * rasqal_raptor_term_compare:
+ * @l1: first RDF term literal
+ * @l2: second RDF term literal
+ *
+ * INTERNAL - Total order over RDF terms
+ *
+ * Consistent with rasqal_literal_equals_flags() using
+ * #RASQAL_COMPARE_RDF as used by rasqal_raptor_triple_match()
+ *
+ * Return value: <0, 0 or >0
+ */
+static int
+rasqal_raptor_term_compare(rasqal_literal* l1, rasqal_literal* l2)
+{
+  int error = 0;
+
+  return rasqal_literal_compare(l1, l2,
+                                RASQAL_COMPARE_RDF | RASQAL_COMPARE_URI,
+                                &error);
+}
+
+
+static void
+rasqal_raptor_term_dictionary_clear(rasqal_raptor_term_dictionary* dict)
+{
+  int i;
+
+  for(i = 1; i < dict->terms_count; i++)
+    rasqal_free_literal(dict->terms[i]);
+
+  if(dict->terms)
+    RASQAL_FREE(rasqal_literal**, dict->terms);
+  if(dict->hashes)
+    RASQAL_FREE(unsigned int*, dict->hashes);
+  if(dict->buckets)
+    RASQAL_FREE(int*, dict->buckets);
+
+  memset(dict, '\0', sizeof(*dict));
+}
+
+
+/*
+ * rasqal_raptor_term_dictionary_find_bucket:
+ * @dict: term dictionary
+ * @l: term literal
+ * @hash: hash of @l
+ *
+ * INTERNAL - Find the hash bucket holding term @l or the empty bucket for it
+ *
+ * Return value: bucket offset
+ */
+static unsigned int
+rasqal_raptor_term_dictionary_find_bucket(rasqal_raptor_term_dictionary* dict,
+                                          rasqal_literal* l,
+                                          unsigned int hash)
+{
+  unsigned int mask = dict->buckets_size - 1;
+  unsigned int bucket = hash & mask;
+
+  while(1) {
+    int id = dict->buckets[bucket];
+
+    if(!id)
+      break;
+
+    if(dict->hashes[id] == hash &&
+       !rasqal_raptor_term_compare(dict->terms[id], l))
+      break;
+
+    bucket = (bucket + 1) & mask;
+  }
+
+  return bucket;
+}
+
+
+/*
+ * rasqal_raptor_term_dictionary_lookup:
+ * @dict: term dictionary
+ * @l: term literal
+ *
+ * INTERNAL - Get the ID of an RDF term if it is in the dictionary
+ *
+ * Return value: term ID or 0 if not present
+ */
+static int
+rasqal_raptor_term_dictionary_lookup(rasqal_raptor_term_dictionary* dict,
+                                     rasqal_literal* l)
+{
+  unsigned int hash;
+  unsigned int bucket;
+
+  if(!dict->buckets_size)
+    return 0;
+
+  hash = rasqal_literal_rdf_term_hash(l, RASQAL_LITERAL_HASH_INIT);
+  bucket = rasqal_raptor_term_dictionary_find_bucket(dict, l, hash);
+
+  return dict->buckets[bucket];
+}
+
+
+static int
+rasqal_raptor_term_dictionary_grow(rasqal_raptor_term_dictionary* dict)
+{
+  int new_size = dict->terms_size ? (dict->terms_size << 1) : 256;
+  unsigned int new_buckets_size = RASQAL_GOOD_CAST(unsigned int, new_size) << 1;
+  rasqal_literal **new_terms;
+  unsigned int *new_hashes;
+  int *new_buckets;
+  int id;
+
+  new_terms = RASQAL_CALLOC(rasqal_literal**, RASQAL_GOOD_CAST(size_t, new_size),
+                            sizeof(rasqal_literal*));
+  new_hashes = RASQAL_CALLOC(unsigned int*, RASQAL_GOOD_CAST(size_t, new_size),
+                             sizeof(unsigned int));
+  new_buckets = RASQAL_CALLOC(int*, new_buckets_size, sizeof(int));
+  if(!new_terms || !new_hashes || !new_buckets) {
+    if(new_terms)
+      RASQAL_FREE(rasqal_literal**, new_terms);
+    if(new_hashes)
+      RASQAL_FREE(unsigned int*, new_hashes);
+    if(new_buckets)
+      RASQAL_FREE(int*, new_buckets);
+    return 1;
+  }
+
+  if(dict->terms) {
+    memcpy(new_terms, dict->terms,
+           RASQAL_GOOD_CAST(size_t, dict->terms_count) * sizeof(rasqal_literal*));
+    memcpy(new_hashes, dict->hashes,
+           RASQAL_GOOD_CAST(size_t, dict->terms_count) * sizeof(unsigned int));
+    RASQAL_FREE(rasqal_literal**, dict->terms);
+    RASQAL_FREE(unsigned int*, dict->hashes);
+    RASQAL_FREE(int*, dict->buckets);
+  } else
+    /* ID 0 is never used */
+    dict->terms_count = 1;
+
+  dict->terms = new_terms;
+  dict->hashes = new_hashes;
+  dict->terms_size = new_size;
+  dict->buckets = new_buckets;
+  dict->buckets_size = new_buckets_size;
+
+  /* rehash; all terms are distinct so just find an empty bucket */
+  for(id = 1; id < dict->terms_count; id++) {
+    unsigned int mask = dict->buckets_size - 1;
+    unsigned int bucket = dict->hashes[id] & mask;
+
+    while(dict->buckets[bucket])
+      bucket = (bucket + 1) & mask;
+    dict->buckets[bucket] = id;
+  }
+
+  return 0;
+}
+
+
+/*
+ * rasqal_raptor_term_dictionary_intern:
+ * @dict: term dictionary
+ * @l: term literal (ownership taken)
+ *
+ * INTERNAL - Get the ID of an RDF term adding it if not present
+ *
+ * Literal @l is freed if an equal term is already present.
+ *
+ * Return value: term ID or 0 on failure
+ */
+static int
+rasqal_raptor_term_dictionary_intern(rasqal_raptor_term_dictionary* dict,
+                                     rasqal_literal* l)
+{
+  unsigned int hash;
+  unsigned int bucket;
+  int id;
+
+  if(!l)
+    return 0;
+
+  /* keep the hash table at most half full */
+  if(dict->terms_count == dict->terms_size) {
+    if(rasqal_raptor_term_dictionary_grow(dict)) {
+      rasqal_free_literal(l);
+      return 0;
+    }
+  }
+
+  hash = rasqal_literal_rdf_term_hash(l, RASQAL_LITERAL_HASH_INIT);
+  bucket = rasqal_raptor_term_dictionary_find_bucket(dict, l, hash);
+
+  id = dict->buckets[bucket];
+  if(id) {
+    rasqal_free_literal(l);
+    return id;
+  }
+
+  id = dict->terms_count++;
+  dict->terms[id] = l;
+  dict->hashes[id] = hash;
+  dict->buckets[bucket] = id;
+
+  return id;
+}
+
+
 static void
 rasqal_raptor_statement_handler(void *user_data,
                                 raptor_statement *statement)
 {
   rasqal_raptor_triples_source_user_data* rtsc;
   rasqal_raptor_triple *triple;
+  rasqal_raptor_term_dictionary* dict;
   
   rtsc = (rasqal_raptor_triples_source_user_data*)user_data;
+  dict = &rtsc->dictionary;
+
+  if(rtsc->triples_count == rtsc->triples_size) {
+    int new_size = rtsc->triples_size ? (rtsc->triples_size << 1) : 64;
+    rasqal_raptor_triple *new_triples;
+
+    new_triples = RASQAL_MALLOC(rasqal_raptor_triple*,
+                                RASQAL_GOOD_CAST(size_t, new_size) * sizeof(rasqal_raptor_triple));
+    if(!new_triples)
+      return;
 
-  triple = RASQAL_MALLOC(rasqal_raptor_triple*, sizeof(rasqal_raptor_triple));
-  triple->next = NULL;
-  triple->triple = raptor_statement_as_rasqal_triple(rtsc->world,
-                                                     statement);
+    if(rtsc->triples) {
+      memcpy(new_triples, rtsc->triples,
+             RASQAL_GOOD_CAST(size_t, rtsc->triples_count) * sizeof(rasqal_raptor_triple));
+      RASQAL_FREE(rasqal_raptor_triple*, rtsc->triples);
+    }
+    rtsc->triples = new_triples;
+    rtsc->triples_size = new_size;
+  }
+
+  triple = &rtsc->triples[rtsc->triples_count];
 
-  /* this origin URI literal is shared amongst the triples and
-   * freed only in rasqal_raptor_free_triples_source
+  /* each distinct term is stored once and shared by all triples */
+  triple->subject = rasqal_raptor_term_dictionary_intern(dict,
+    rasqal_new_literal_from_term(rtsc->world, statement->subject));
+  triple->predicate = rasqal_raptor_term_dictionary_intern(dict,
+    rasqal_new_literal_from_term(rtsc->world, statement->predicate));
+  triple->object = rasqal_raptor_term_dictionary_intern(dict,
+    rasqal_new_literal_from_term(rtsc->world, statement->object));
+  if(!triple->subject || !triple->predicate || !triple->object)
+    return;
+
+  /* the origin URI literal is shared amongst the triples of a source
+   * and freed only in rasqal_raptor_free_triples_source
    */
-  rasqal_triple_set_origin(triple->triple, 
-                           rtsc->source_literals[rtsc->source_index]);
+  triple->origin = rtsc->source_index;
 
-  if(rtsc->tail)
-    rtsc->tail->next = triple;
-  else
-    rtsc->head = triple;
+  triple->offset = rtsc->triples_count++;
+}
 
-  rtsc->tail = triple;
+
+#define RASQAL_RAPTOR_TERM(rtsc, id) ((rtsc)->dictionary.terms[id])
+#define RASQAL_RAPTOR_ORIGIN(rtsc, triple) ((rtsc)->source_literals[(triple)->origin])
+
+
+static int
+rasqal_raptor_triple_get_part(rasqal_raptor_triple* t,
+                              rasqal_triple_parts part)
+{
+  switch(part) {
+    case RASQAL_TRIPLE_SUBJECT:
+      return t->subject;
+
+    case RASQAL_TRIPLE_PREDICATE:
+      return t->predicate;
+
+    case RASQAL_TRIPLE_OBJECT:
+      return t->object;
+
+    case RASQAL_TRIPLE_ORIGIN:
+    case RASQAL_TRIPLE_NONE:
+    case RASQAL_TRIPLE_SPO:
+    case RASQAL_TRIPLE_SPOG:
+    default:
+      return 0;
+  }
 }
 
 
+/*
+ * rasqal_raptor_index_key_compare:
+ * @index: index to use for the order of triple parts
+ * @triple: triple from the index
+ * @key: triple holding the key term IDs
+ * @key_len: number of leading index parts to compare (1-3)
+ *
+ * INTERNAL - Compare the first @key_len parts of a triple in an index order
+ *
+ * Return value: <0, 0 or >0
+ */
+static int
+rasqal_raptor_index_key_compare(rasqal_raptor_index index,
+                                rasqal_raptor_triple* triple,
+                                rasqal_raptor_triple* key,
+                                int key_len)
+{
+  int i;
+
+  for(i = 0; i < key_len; i++) {
+    rasqal_triple_parts part = rasqal_raptor_index_parts[index][i];
+    int rc;
+
+    rc = rasqal_raptor_triple_get_part(triple, part) -
+         rasqal_raptor_triple_get_part(key, part);
+    if(rc)
+      return rc;
+  }
+
+  return 0;
+}
+
+
+static int
+rasqal_raptor_index_compare(const void *a, const void *b, void *arg)
+{
+  rasqal_raptor_triple* t1 = *(rasqal_raptor_triple**)a;
+  rasqal_raptor_triple* t2 = *(rasqal_raptor_triple**)b;
+  rasqal_raptor_index index = *(rasqal_raptor_index*)arg;
+  int rc;
+
+  rc = rasqal_raptor_index_key_compare(index, t1, t2, 3);
+  if(rc)
+    return rc;
+
+  /* keep equal keys in load order */
+  return t1->offset - t2->offset;
+}
+
+
+/*
+ * rasqal_raptor_build_indexes:
+ * @rtsc: triples source context
+ *
+ * INTERNAL - Build the permutation indexes once all triples are loaded
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_raptor_build_indexes(rasqal_raptor_triples_source_user_data* rtsc)
+{
+  rasqal_raptor_index index;
+  size_t size = RASQAL_GOOD_CAST(size_t, rtsc->triples_count);
+
+  if(!size)
+    return 0;
+
+  for(index = RASQAL_RAPTOR_INDEX_SPO;
+      index <= RASQAL_RAPTOR_INDEX_LAST;
+      index = (rasqal_raptor_index)(index + 1)) {
+    rasqal_raptor_triple **array;
+    size_t i;
+#if RAPTOR_VERSION < 20015
+    raptor_sequence* seq;
+
+    seq = raptor_new_sequence(NULL, NULL);
+    if(!seq)
+      return 1;
+
+    for(i = 0; i < size; i++) {
+      if(raptor_sequence_push(seq, &rtsc->triples[i])) {
+        raptor_free_sequence(seq);
+        return 1;
+      }
+    }
+
+    array = (rasqal_raptor_triple**)rasqal_sequence_as_sorted(seq,
+                                                               rasqal_raptor_index_compare,
+                                                               &index);
+    raptor_free_sequence(seq);
+    if(!array)
+      return 1;
+#else
+    array = RASQAL_MALLOC(rasqal_raptor_triple**,
+                          size * sizeof(rasqal_raptor_triple*));
+    if(!array)
+      return 1;
+
+    for(i = 0; i < size; i++)
+      array[i] = &rtsc->triples[i];
+
+    raptor_sort_r(array, size, sizeof(rasqal_raptor_triple*),
+                  rasqal_raptor_index_compare, &index);
+#endif
+
+    rtsc->indexes[index] = array;
+  }
+
+  return 0;
+}
+
+
+/*
+ * rasqal_raptor_build_statistics:
+ * @rtsc: triples source context
+ *
+ * INTERNAL - Gather the triples source statistics from the indexes
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_raptor_build_statistics(rasqal_raptor_triples_source_user_data* rtsc)
+{
+  rasqal_raptor_predicate_statistics *stats;
+  rasqal_raptor_triple **array;
+  int i;
+
+  if(!rtsc->triples_count)
+    return 0;
+
+  stats = RASQAL_CALLOC(rasqal_raptor_predicate_statistics*,
+                        RASQAL_GOOD_CAST(size_t, rtsc->dictionary.terms_count),
+                        sizeof(*stats));
+  if(!stats)
+    return 1;
+
+  /* (P, O, S) order: triples and distinct objects per predicate */
+  array = rtsc->indexes[RASQAL_RAPTOR_INDEX_POS];
+  for(i = 0; i < rtsc->triples_count; i++) {
+    rasqal_raptor_triple *t = array[i];
+
+    stats[t->predicate].triples++;
+    if(!i || array[i - 1]->predicate != t->predicate ||
+       array[i - 1]->object != t->object)
+      stats[t->predicate].distinct_objects++;
+  }
+
+  /* (S, P, O) order: distinct subjects overall and per predicate */
+  array = rtsc->indexes[RASQAL_RAPTOR_INDEX_SPO];
+  for(i = 0; i < rtsc->triples_count; i++) {
+    rasqal_raptor_triple *t = array[i];
+
+    if(!i || array[i - 1]->subject != t->subject) {
+      rtsc->distinct_subjects++;
+      stats[t->predicate].distinct_subjects++;
+    } else if(array[i - 1]->predicate != t->predicate)
+      stats[t->predicate].distinct_subjects++;
+  }
+
+  /* (O, S, P) order: distinct objects overall */
+  array = rtsc->indexes[RASQAL_RAPTOR_INDEX_OSP];
+  for(i = 0; i < rtsc->triples_count; i++) {
+    if(!i || array[i - 1]->object != array[i]->object)
+      rtsc->distinct_objects++;
+  }
+
+  rtsc->predicate_statistics = stats;
+
+  return 0;
+}
+
+
+/*
+ * rasqal_raptor_index_range:
+ * @rtsc: triples source context
+ * @index: index to search
+ * @key: triple holding the bound key term IDs
+ * @key_len: number of bound leading index parts
+ * @start_p: pointer to store first matching offset in index
+ * @end_p: pointer to store offset after last matching entry in index
+ *
+ * INTERNAL - Find the range of an index matching the bound key parts
+ */
+static void
+rasqal_raptor_index_range(rasqal_raptor_triples_source_user_data* rtsc,
+                          rasqal_raptor_index index,
+                          rasqal_raptor_triple* key, int key_len,
+                          int* start_p, int* end_p)
+{
+  rasqal_raptor_triple **array = rtsc->indexes[index];
+  int lo;
+  int hi;
+  int start;
+
+  /* lower bound: first entry >= key */
+  lo = 0;
+  hi = rtsc->triples_count;
+  while(lo < hi) {
+    int mid = lo + ((hi - lo) >> 1);
+    if(rasqal_raptor_index_key_compare(index, array[mid], key, key_len) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  start = lo;
+
+  /* upper bound: first entry > key */
+  hi = rtsc->triples_count;
+  while(lo < hi) {
+    int mid = lo + ((hi - lo) >> 1);
+    if(rasqal_raptor_index_key_compare(index, array[mid], key, key_len) <= 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  *start_p = start;
+  *end_p = lo;
+}
+
+
+/*
+ * rasqal_raptor_choose_index:
+ * @key: triple pattern term IDs with 0 for unbound parts
+ * @key_len_p: pointer to store number of leading bound parts in the index
+ *
+ * INTERNAL - Pick the permutation index with the longest bound prefix
+ *
+ * Return value: index or <0 if no part is bound and a full scan is needed
+ */
+static int
+rasqal_raptor_choose_index(rasqal_raptor_triple* key, int* key_len_p)
+{
+  int s = (key->subject != 0);
+  int p = (key->predicate != 0);
+  int o = (key->object != 0);
+
+  if(s && p) {
+    *key_len_p = o ? 3 : 2;
+    return RASQAL_RAPTOR_INDEX_SPO;
+  }
+  if(p && o) {
+    *key_len_p = 2;
+    return RASQAL_RAPTOR_INDEX_POS;
+  }
+  if(o && s) {
+    *key_len_p = 2;
+    return RASQAL_RAPTOR_INDEX_OSP;
+  }
+
+  *key_len_p = 1;
+  if(s)
+    return RASQAL_RAPTOR_INDEX_SPO;
+  if(p)
+    return RASQAL_RAPTOR_INDEX_POS;
+  if(o)
+    return RASQAL_RAPTOR_INDEX_OSP;
+
+  *key_len_p = 0;
+  return -1;
+}
+
+
+/*
+ * rasqal_raptor_key_match:
+ * @rtsc: triples source context
+ * @triple: stored triple
+ * @key: triple pattern term IDs with 0 for unbound parts
+ * @origin: graph URI literal to match or NULL for any graph
+ * @parts: parts of the triple to match - XOR of #rasqal_triple_parts bits
+ *
+ * INTERNAL - Match a stored triple against term IDs and graph
+ *
+ * Same rules as rasqal_raptor_triple_match() with term equality
+ * as term ID equality.
+ *
+ * Return value: non-0 on match
+ */
+static int
+rasqal_raptor_key_match(rasqal_raptor_triples_source_user_data* rtsc,
+                        rasqal_raptor_triple* triple,
+                        rasqal_raptor_triple* key,
+                        rasqal_literal* origin,
+                        unsigned int parts)
+{
+  rasqal_literal* triple_origin = RASQAL_RAPTOR_ORIGIN(rtsc, triple);
+
+  if(key->subject && key->subject != triple->subject)
+    return 0;
+
+  if(key->predicate && key->predicate != triple->predicate)
+    return 0;
+
+  if(key->object && key->object != triple->object)
+    return 0;
+
+  if(parts & RASQAL_TRIPLE_ORIGIN) {
+    /* Binding a graph */
+
+    /* If expecting a graph and triple has none then no match */
+    if(!triple_origin)
+      return 0;
+
+    if(origin && origin->type == RASQAL_LITERAL_URI) {
+      if(!raptor_uri_equals(triple_origin->value.uri, origin->value.uri))
+        return 0;
+    }
+  } else {
+    /* Not binding a graph */
+
+    /* If triple has a GRAPH and there is none in the triple pattern, no match */
+    if(triple_origin)
+      return 0;
+  }
+
+  return 1;
+}
+
+
+/*
+ * rasqal_raptor_term_key:
+ * @rtsc: triples source context
+ * @l: term literal or NULL if unbound
+ * @id_p: pointer to store term ID (0 if @l is NULL)
+ *
+ * INTERNAL - Turn a bound triple pattern term into a term ID
+ *
+ * Return value: non-0 if the term is bound but not in the source
+ * so nothing can match
+ */
+static int
+rasqal_raptor_term_key(rasqal_raptor_triples_source_user_data* rtsc,
+                       rasqal_literal* l, int* id_p)
+{
+  *id_p = 0;
+  if(!l)
+    return 0;
+
+  *id_p = rasqal_raptor_term_dictionary_lookup(&rtsc->dictionary, l);
+  return (*id_p == 0);
+}
+
+
+#ifdef RASQAL_DEBUG
+static void
+rasqal_raptor_triple_print(rasqal_raptor_triples_source_user_data* rtsc,
+                           rasqal_raptor_triple* triple, FILE* fh)
+{
+  rasqal_literal* origin = RASQAL_RAPTOR_ORIGIN(rtsc, triple);
+
+  fputs("triple(", fh);
+  rasqal_literal_print(RASQAL_RAPTOR_TERM(rtsc, triple->subject), fh);
+  fputs(", ", fh);
+  rasqal_literal_print(RASQAL_RAPTOR_TERM(rtsc, triple->predicate), fh);
+  fputs(", ", fh);
+  rasqal_literal_print(RASQAL_RAPTOR_TERM(rtsc, triple->object), fh);
+  fputc(')', fh);
+  if(origin) {
+    fputs(" with origin(", fh);
+    rasqal_literal_print(origin, fh);
+    fputc(')', fh);
+  }
+}
+#endif
+
+
 static unsigned char*
 rasqal_raptor_get_genid(rasqal_world* world, const unsigned char* base,
                        int counter)
@@ -213,12 +921,13 @@ rasqal_raptor_init_triples_source_common(rasqal_world* world,
   rtsc = (rasqal_raptor_triples_source_user_data*)user_data;
 
   /* Max API version this triples source generates */
-  rts->version = 2;
+  rts->version = 3;
   
   rts->init_triples_match = rasqal_raptor_init_triples_match;
   rts->triple_present = rasqal_raptor_triple_present;
   rts->free_triples_source = rasqal_raptor_free_triples_source;
   rts->support_feature = rasqal_raptor_support_feature;
+  rts->get_statistic = rasqal_raptor_get_statistic;
 
   rtsc->world = world;
 
@@ -323,6 +1032,12 @@ rasqal_raptor_init_triples_source_common(rasqal_world* world,
       break;
   }
 
+  if(!rc)
+    rc = rasqal_raptor_build_indexes(rtsc);
+
+  if(!rc)
+    rc = rasqal_raptor_build_statistics(rtsc);
+
   return rc;
 }
 
@@ -474,41 +1189,239 @@ rasqal_raptor_triple_present(rasqal_triples_source *rts, void *user_data,
                              rasqal_triple *t) 
 {
   rasqal_raptor_triples_source_user_data* rtsc;
-  rasqal_raptor_triple *triple;
+  rasqal_raptor_triple key;
   unsigned int parts = RASQAL_TRIPLE_SPO;
+  int index;
+  int key_len;
+  int i;
+  int end;
   
   rtsc = (rasqal_raptor_triples_source_user_data*)user_data;
 
+  if(rasqal_raptor_term_key(rtsc, t->subject, &key.subject) ||
+     rasqal_raptor_term_key(rtsc, t->predicate, &key.predicate) ||
+     rasqal_raptor_term_key(rtsc, t->object, &key.object))
+    return 0;
+
   if(t->origin)
     parts = (rasqal_triple_parts)(parts | RASQAL_TRIPLE_GRAPH);
 
-  for(triple = rtsc->head; triple; triple = triple->next) {
-    if(rasqal_raptor_triple_match(rtsc->world, triple->triple, t, parts))
+  index = rasqal_raptor_choose_index(&key, &key_len);
+  if(index < 0 || !rtsc->indexes[index]) {
+    index = -1;
+    i = 0;
+    end = rtsc->triples_count;
+  } else
+    rasqal_raptor_index_range(rtsc, (rasqal_raptor_index)index, &key, key_len,
+                              &i, &end);
+
+  for(; i < end; i++) {
+    rasqal_raptor_triple *triple;
+
+    triple = (index < 0) ? &rtsc->triples[i] : rtsc->indexes[index][i];
+    if(rasqal_raptor_key_match(rtsc, triple, &key, t->origin, parts))
+      return 1;
+  }
+
+  return 0;
+}
+
+
+
+/*
+ * rasqal_raptor_count_distinct:
+ * @rtsc: triples source context
+ * @key: triple pattern term IDs with 0 for unbound parts
+ * @part: unbound part to count the distinct terms of
+ * @count_p: pointer to store count
+ *
+ * INTERNAL - Count the distinct terms of one part of the triples matching a key
+ *
+ * Exact when the gathered statistics cover the key or an index
+ * orders the matching triples by @part; otherwise the number of
+ * matching triples is returned as an upper bound.
+ *
+ * Return value: non-0 if the count is exact
+ */
+static int
+rasqal_raptor_count_distinct(rasqal_raptor_triples_source_user_data* rtsc,
+                             rasqal_raptor_triple* key,
+                             rasqal_triple_parts part,
+                             long *count_p)
+{
+  int bound_count;
+  int index;
+  int key_len;
+  int start;
+  int end;
+  int i;
+
+  if(!key->subject && !key->object) {
+    if(!key->predicate) {
+      *count_p = (part == RASQAL_TRIPLE_SUBJECT) ? rtsc->distinct_subjects :
+                                                   rtsc->distinct_objects;
       return 1;
+    }
+
+    if(part == RASQAL_TRIPLE_SUBJECT)
+      *count_p = rtsc->predicate_statistics[key->predicate].distinct_subjects;
+    else
+      *count_p = rtsc->predicate_statistics[key->predicate].distinct_objects;
+    return 1;
+  }
+
+  bound_count = (key->subject != 0) + (key->predicate != 0) +
+                (key->object != 0);
+
+  /* look for an index with the bound parts first followed by @part */
+  for(index = RASQAL_RAPTOR_INDEX_SPO;
+      index <= RASQAL_RAPTOR_INDEX_LAST;
+      index++) {
+    const rasqal_triple_parts* parts = rasqal_raptor_index_parts[index];
+
+    if(bound_count > 2 || parts[bound_count] != part)
+      continue;
+
+    for(i = 0; i < bound_count; i++) {
+      if(!rasqal_raptor_triple_get_part(key, parts[i]))
+        break;
+    }
+    if(i < bound_count)
+      continue;
+
+    rasqal_raptor_index_range(rtsc, (rasqal_raptor_index)index, key,
+                              bound_count, &start, &end);
+    *count_p = 0;
+    for(i = start; i < end; i++) {
+      rasqal_raptor_triple **array = rtsc->indexes[index];
+
+      if(i == start ||
+         rasqal_raptor_triple_get_part(array[i - 1], part) !=
+         rasqal_raptor_triple_get_part(array[i], part))
+        (*count_p)++;
+    }
+    return 1;
   }
 
+  index = rasqal_raptor_choose_index(key, &key_len);
+  rasqal_raptor_index_range(rtsc, (rasqal_raptor_index)index, key, key_len,
+                            &start, &end);
+  *count_p = end - start;
+
   return 0;
 }
 
 
+/*
+ * rasqal_raptor_get_statistic:
+ * @user_data: triples source context
+ * @statistic: statistic to get
+ * @t: triple pattern
+ * @count_p: pointer to store count
+ * @exact_p: pointer to store non-0 if the count is exact
+ *
+ * INTERNAL - Get a statistic about the triples matching a triple pattern
+ *
+ * Variables in @t match any term and all graphs are counted.
+ *
+ * Return value: 0 on success, <0 if not available
+ */
+static int
+rasqal_raptor_get_statistic(void *user_data,
+                            rasqal_triples_source_statistic statistic,
+                            rasqal_triple *t,
+                            long *count_p, int *exact_p)
+{
+  rasqal_raptor_triples_source_user_data* rtsc;
+  rasqal_raptor_triple key;
+  rasqal_literal* terms[3];
+  rasqal_triple_parts part;
+  int index;
+  int key_len;
+  int start;
+  int end;
+  int i;
+
+  rtsc = (rasqal_raptor_triples_source_user_data*)user_data;
+
+  if(statistic != RASQAL_TRIPLES_SOURCE_STATISTIC_TRIPLES &&
+     statistic != RASQAL_TRIPLES_SOURCE_STATISTIC_DISTINCT_SUBJECTS &&
+     statistic != RASQAL_TRIPLES_SOURCE_STATISTIC_DISTINCT_OBJECTS)
+    return -1;
+
+  /* variables in the pattern are unbound */
+  terms[0] = t->subject;
+  terms[1] = t->predicate;
+  terms[2] = t->object;
+  for(i = 0; i < 3; i++) {
+    if(terms[i] && terms[i]->type == RASQAL_LITERAL_VARIABLE)
+      terms[i] = NULL;
+  }
+
+  *exact_p = 1;
+  *count_p = 0;
+
+  if(!rtsc->triples_count ||
+     rasqal_raptor_term_key(rtsc, terms[0], &key.subject) ||
+     rasqal_raptor_term_key(rtsc, terms[1], &key.predicate) ||
+     rasqal_raptor_term_key(rtsc, terms[2], &key.object))
+    /* a term that is not in the source matches nothing */
+    return 0;
+
+  if(statistic == RASQAL_TRIPLES_SOURCE_STATISTIC_TRIPLES) {
+    index = rasqal_raptor_choose_index(&key, &key_len);
+    if(index < 0)
+      *count_p = rtsc->triples_count;
+    else if(!key.subject && !key.object)
+      *count_p = rtsc->predicate_statistics[key.predicate].triples;
+    else {
+      rasqal_raptor_index_range(rtsc, (rasqal_raptor_index)index, &key,
+                                key_len, &start, &end);
+      *count_p = end - start;
+    }
+    return 0;
+  }
+
+  part = (statistic == RASQAL_TRIPLES_SOURCE_STATISTIC_DISTINCT_SUBJECTS) ?
+    RASQAL_TRIPLE_SUBJECT : RASQAL_TRIPLE_OBJECT;
+
+  if(rasqal_raptor_triple_get_part(&key, part)) {
+    /* one distinct term if any triple matches */
+    index = rasqal_raptor_choose_index(&key, &key_len);
+    rasqal_raptor_index_range(rtsc, (rasqal_raptor_index)index, &key,
+                              key_len, &start, &end);
+    *count_p = (end > start) ? 1 : 0;
+    return 0;
+  }
+
+  *exact_p = rasqal_raptor_count_distinct(rtsc, &key, part, count_p);
+
+  return 0;
+}
+
 
 static void
 rasqal_raptor_free_triples_source(void *user_data)
 {
   rasqal_raptor_triples_source_user_data* rtsc;
-  rasqal_raptor_triple *cur;
   int i;
 
   rtsc = (rasqal_raptor_triples_source_user_data*)user_data;
-  cur = rtsc->head;
-  while(cur) {
-    rasqal_raptor_triple *next = cur->next;
-    rasqal_triple_set_origin(cur->triple, NULL); /* shared URI literal */
-    rasqal_free_triple(cur->triple);
-    RASQAL_FREE(rasqal_raptor_triple, cur);
-    cur = next;
+
+  for(i = 0; i < RASQAL_RAPTOR_INDEX_COUNT; i++) {
+    if(rtsc->indexes[i])
+      RASQAL_FREE(rasqal_raptor_triple**, rtsc->indexes[i]);
   }
 
+  if(rtsc->predicate_statistics)
+    RASQAL_FREE(rasqal_raptor_predicate_statistics*,
+                rtsc->predicate_statistics);
+
+  if(rtsc->triples)
+    RASQAL_FREE(rasqal_raptor_triple*, rtsc->triples);
+
+  rasqal_raptor_term_dictionary_clear(&rtsc->dictionary);
+
   for(i = 0; i < rtsc->sources_count; i++) {
     if(rtsc->source_literals[i])
       rasqal_free_literal(rtsc->source_literals[i]);
@@ -536,9 +1449,23 @@ rasqal_raptor_register_triples_source_factory(rasqal_triples_source_factory *fac
 
 
 typedef struct {
+  /* current matched triple or NULL at end */
   rasqal_raptor_triple *cur;
+
+  /* index being scanned or <0 for a full scan in load order */
+  int index;
+  /* offset of cur in the index (or triples array) */
+  int offset;
+  /* offset after the last entry of the index range */
+  int end;
+
   rasqal_raptor_triples_source_user_data* source_context;
-  rasqal_triple match;
+
+  /* term IDs to match; 0 for unbound parts */
+  rasqal_raptor_triple key;
+
+  /* graph to match or NULL */
+  rasqal_literal* origin;
 
   /* parts of the triple above to match: always (S,P,O) sometimes C */
   rasqal_triple_parts parts;
@@ -554,15 +1481,18 @@ rasqal_raptor_bind_match(struct rasqal_triples_match_s* rtm,
                          rasqal_triple_parts parts)
 {
   rasqal_raptor_triples_match_context* rtmc;
-  int error = 0;
+  rasqal_raptor_triples_source_user_data* rtsc;
+  rasqal_raptor_triple* triple;
   rasqal_triple_parts result = (rasqal_triple_parts)0;
   
   rtmc = (rasqal_raptor_triples_match_context*)rtm->user_data;
+  rtsc = rtmc->source_context;
+  triple = rtmc->cur;
 
 #ifdef RASQAL_DEBUG
-  if(rtmc->cur) {
+  if(triple) {
     RASQAL_DEBUG1("  matched statement ");
-    rasqal_triple_print(rtmc->cur->triple, stderr);
+    rasqal_raptor_triple_print(rtsc, triple, stderr);
     fputc('\n', stderr);
   } else
     RASQAL_FATAL1("  matched NO statement - BUG\n");
@@ -571,7 +1501,7 @@ rasqal_raptor_bind_match(struct rasqal_triples_match_s* rtm,
   /* set variable values from the fields of statement */
 
   if(bindings[0] && (parts & RASQAL_TRIPLE_SUBJECT)) {
-    rasqal_literal *l = rtmc->cur->triple->subject;
+    rasqal_literal *l = RASQAL_RAPTOR_TERM(rtsc, triple->subject);
     RASQAL_DEBUG1("binding subject to variable\n");
     rasqal_variable_set_value(bindings[0], rasqal_new_literal_from_literal(l));
     result = RASQAL_TRIPLE_SUBJECT;
@@ -579,16 +1509,13 @@ rasqal_raptor_bind_match(struct rasqal_triples_match_s* rtm,
 
   if(bindings[1] && (parts & RASQAL_TRIPLE_PREDICATE)) {
     if(bindings[0] == bindings[1]) {
-      if(!rasqal_literal_equals_flags(rtmc->cur->triple->subject,
-                                      rtmc->cur->triple->predicate,
-                                      RASQAL_COMPARE_RDF, &error))
-        return (rasqal_triple_parts)0;
-      if(error)
+      /* interned terms are equal only if their IDs are */
+      if(triple->subject != triple->predicate)
         return (rasqal_triple_parts)0;
       
       RASQAL_DEBUG1("subject and predicate values match\n");
     } else {
-      rasqal_literal *l = rtmc->cur->triple->predicate;
+      rasqal_literal *l = RASQAL_RAPTOR_TERM(rtsc, triple->predicate);
       RASQAL_DEBUG1("binding predicate to variable\n");
       rasqal_variable_set_value(bindings[1], rasqal_new_literal_from_literal(l));
       result = (rasqal_triple_parts)(result | RASQAL_TRIPLE_PREDICATE);
@@ -599,11 +1526,7 @@ rasqal_raptor_bind_match(struct rasqal_triples_match_s* rtm,
     int bind = 1;
     
     if(bindings[0] == bindings[2]) {
-      if(!rasqal_literal_equals_flags(rtmc->cur->triple->subject,
-                                      rtmc->cur->triple->object,
-                                      RASQAL_COMPARE_RDF, &error))
-        return (rasqal_triple_parts)0;
-      if(error)
+      if(triple->subject != triple->object)
         return (rasqal_triple_parts)0;
 
       bind = 0;
@@ -612,11 +1535,7 @@ rasqal_raptor_bind_match(struct rasqal_triples_match_s* rtm,
     if(bindings[1] == bindings[2] &&
        !(bindings[0] == bindings[1]) /* don't do this check if ?x ?x ?x */
        ) {
-      if(!rasqal_literal_equals_flags(rtmc->cur->triple->predicate,
-                                      rtmc->cur->triple->object,
-                                      RASQAL_COMPARE_RDF, &error))
-        return (rasqal_triple_parts)0;
-      if(error)
+      if(triple->predicate != triple->object)
         return (rasqal_triple_parts)0;
 
       bind = 0;
@@ -624,7 +1543,7 @@ rasqal_raptor_bind_match(struct rasqal_triples_match_s* rtm,
     }
     
     if(bind) {
-      rasqal_literal *l = rtmc->cur->triple->object;
+      rasqal_literal *l = RASQAL_RAPTOR_TERM(rtsc, triple->object);
       RASQAL_DEBUG1("binding object to variable\n");
       rasqal_variable_set_value(bindings[2], rasqal_new_literal_from_literal(l));
       result = (rasqal_triple_parts)(result | RASQAL_TRIPLE_OBJECT);
@@ -633,7 +1552,7 @@ rasqal_raptor_bind_match(struct rasqal_triples_match_s* rtm,
 
   if(bindings[3] && (parts & RASQAL_TRIPLE_ORIGIN)) {
     rasqal_literal *l;
-    l = rasqal_new_literal_from_literal(rtmc->cur->triple->origin);
+    l = rasqal_new_literal_from_literal(RASQAL_RAPTOR_ORIGIN(rtsc, triple));
     RASQAL_DEBUG1("binding origin to variable\n");
     rasqal_variable_set_value(bindings[3], l);
     result = (rasqal_triple_parts)(result | RASQAL_TRIPLE_ORIGIN);
@@ -644,6 +1563,37 @@ rasqal_raptor_bind_match(struct rasqal_triples_match_s* rtm,
 
 
 
+/*
+ * rasqal_raptor_seek_match:
+ * @rtmc: triples match context
+ * @offset: offset in the scanned range to start looking from
+ *
+ * INTERNAL - Move to the next triple at or after @offset that matches
+ *
+ * Sets rtmc->cur to NULL when there are no more matches.
+ */
+static void
+rasqal_raptor_seek_match(rasqal_raptor_triples_match_context* rtmc,
+                         int offset)
+{
+  rasqal_raptor_triples_source_user_data* rtsc = rtmc->source_context;
+
+  for(rtmc->offset = offset; rtmc->offset < rtmc->end; rtmc->offset++) {
+    if(rtmc->index < 0)
+      rtmc->cur = &rtsc->triples[rtmc->offset];
+    else
+      rtmc->cur = rtsc->indexes[rtmc->index][rtmc->offset];
+
+    if(rasqal_raptor_key_match(rtsc, rtmc->cur, &rtmc->key, rtmc->origin,
+                               rtmc->parts))
+      return;
+  }
+
+  RASQAL_DEBUG1("triple match ended\n");
+  rtmc->cur = NULL;
+}
+
+
 static void
 rasqal_raptor_next_match(struct rasqal_triples_match_s* rtm, void *user_data)
 {
@@ -651,43 +1601,7 @@ rasqal_raptor_next_match(struct rasqal_triples_match_s* rtm, void *user_data)
 
   rtmc = (rasqal_raptor_triples_match_context*)rtm->user_data;
 
-#if 0
-  if(rtmc->bind_parts & RASQAL_TRIPLE_SUBJECT) {
-    rasqal_variable* v = rasqal_literal_as_variable(rtmc->cur->triple->subject);
-    if(v)
-      rasqal_variable_set_value(v, NULL);
-  }
-  if(rtmc->bind_parts & RASQAL_TRIPLE_PREDICATE) {
-    rasqal_variable* v = rasqal_literal_as_variable(rtmc->cur->triple->predicate);
-    if(v)
-      rasqal_variable_set_value(v, NULL);
-  }
-  if(rtmc->bind_parts & RASQAL_TRIPLE_OBJECT) {
-    rasqal_variable* v = rasqal_literal_as_variable(rtmc->cur->triple->object);
-    if(v)
-      rasqal_variable_set_value(v, NULL);
-  }
-  if(rtmc->bind_parts & RASQAL_TRIPLE_ORIGIN) {
-    rasqal_variable* v = rasqal_literal_as_variable(rtmc->cur->triple->origin);
-    if(v)
-      rasqal_variable_set_value(v, NULL);
-  }
-#endif
-
-  while(rtmc->cur) {
-    rtmc->cur = rtmc->cur->next;
-#ifdef RASQAL_DEBUG
-    if(!rtmc->cur) {
-      RASQAL_DEBUG1("triple match ended when matching ");
-      rasqal_triple_print(&rtmc->match, stderr);
-      fputc('\n', stderr);
-    }
-#endif
-    if(rtmc->cur &&
-       rasqal_raptor_triple_match(rtm->world, rtmc->cur->triple, &rtmc->match,
-                                  rtmc->parts))
-      break;
-  }
+  rasqal_raptor_seek_match(rtmc, rtmc->offset + 1);
 }
 
 static int
@@ -709,17 +1623,8 @@ rasqal_raptor_finish_triples_match(struct rasqal_triples_match_s* rtm,
 
   rtmc = (rasqal_raptor_triples_match_context*)rtm->user_data;
 
-  if(rtmc->match.subject)
-    rasqal_free_literal(rtmc->match.subject);
-
-  if(rtmc->match.predicate)
-    rasqal_free_literal(rtmc->match.predicate);
-
-  if(rtmc->match.object)
-    rasqal_free_literal(rtmc->match.object);
-
-  if(rtmc->match.origin)
-    rasqal_free_literal(rtmc->match.origin);
+  if(rtmc->origin)
+    rasqal_free_literal(rtmc->origin);
 
   RASQAL_FREE(rasqal_raptor_triples_match_context, rtmc);
 }
@@ -733,6 +1638,9 @@ rasqal_raptor_init_triples_match(rasqal_triples_match* rtm,
   rasqal_raptor_triples_source_user_data* rtsc;
   rasqal_raptor_triples_match_context* rtmc;
   rasqal_variable* var;
+  rasqal_literal* l;
+  int no_match = 0;
+  int key_len;
 
   rtsc = (rasqal_raptor_triples_source_user_data*)user_data;
 
@@ -748,47 +1656,54 @@ rasqal_raptor_init_triples_match(rasqal_triples_match* rtm,
   rtm->user_data = rtmc;
 
   rtmc->source_context = rtsc;
-  rtmc->cur = rtsc->head;
+  rtmc->cur = NULL;
   
   /* Parts we bind */
   rtmc->bind_parts = m->parts;
 
   /* at least one of the triple terms is a variable and we need to
-   * do a triplesMatching() over the list of stored raptor_statements
+   * do a triplesMatching() over the stored triples.  Bound terms
+   * become term IDs; a term not in the source matches nothing.
    */
 
+  l = NULL;
   if((var = rasqal_literal_as_variable(t->subject))) {
     if(rtmc->bind_parts & RASQAL_TRIPLE_SUBJECT)
       /* we bind it so reset it */
       rasqal_variable_set_value(var, NULL);
-    else if(var->value)
-      rtmc->match.subject = rasqal_new_literal_from_literal(var->value);
+    else
+      l = var->value;
   } else
-    rtmc->match.subject = rasqal_new_literal_from_literal(t->subject);
+    l = t->subject;
+  no_match |= rasqal_raptor_term_key(rtsc, l, &rtmc->key.subject);
 
   m->bindings[0] = var;
   
 
+  l = NULL;
   if((var = rasqal_literal_as_variable(t->predicate))) {
     if(rtmc->bind_parts & RASQAL_TRIPLE_PREDICATE)
       /* we bind it so reset it */
       rasqal_variable_set_value(var, NULL);
-    else if(var->value)
-      rtmc->match.predicate = rasqal_new_literal_from_literal(var->value);
+    else
+      l = var->value;
   } else
-    rtmc->match.predicate = rasqal_new_literal_from_literal(t->predicate);
+    l = t->predicate;
+  no_match |= rasqal_raptor_term_key(rtsc, l, &rtmc->key.predicate);
 
   m->bindings[1] = var;
   
 
+  l = NULL;
   if((var = rasqal_literal_as_variable(t->object))) {
     if(rtmc->bind_parts & RASQAL_TRIPLE_OBJECT)
       /* we bind it so reset it */
       rasqal_variable_set_value(var, NULL);
-    else if(var->value)
-      rtmc->match.object = rasqal_new_literal_from_literal(var->value);
+    else
+      l = var->value;
   } else
-    rtmc->match.object = rasqal_new_literal_from_literal(t->object);
+    l = t->object;
+  no_match |= rasqal_raptor_term_key(rtsc, l, &rtmc->key.object);
 
   m->bindings[2] = var;
   
@@ -800,20 +1715,31 @@ rasqal_raptor_init_triples_match(rasqal_triples_match* rtm,
       /* we bind it so reset it */
       rasqal_variable_set_value(var, NULL);
     else if(var->value)
-        rtmc->match.origin = rasqal_new_literal_from_literal(var->value);
+        rtmc->origin = rasqal_new_literal_from_literal(var->value);
     } else
-      rtmc->match.origin = rasqal_new_literal_from_literal(t->origin);
+      rtmc->origin = rasqal_new_literal_from_literal(t->origin);
     m->bindings[3] = var;
     rtmc->parts = (rasqal_triple_parts)(rtmc->parts | RASQAL_TRIPLE_GRAPH);
   }
   
 
-  while(rtmc->cur) {
-    if(rasqal_raptor_triple_match(rtm->world, rtmc->cur->triple, &rtmc->match,
-                                  rtmc->parts))
-      break;
-    rtmc->cur = rtmc->cur->next;
-  }
+  /* use the permutation index with the longest bound prefix to
+   * restrict the scan to a range; otherwise scan in load order
+   */
+  rtmc->index = rasqal_raptor_choose_index(&rtmc->key, &key_len);
+  if(no_match) {
+    rtmc->offset = 0;
+    rtmc->end = 0;
+  } else if(rtmc->index < 0 || !rtsc->indexes[rtmc->index]) {
+    rtmc->index = -1;
+    rtmc->offset = 0;
+    rtmc->end = rtsc->triples_count;
+  } else
+    rasqal_raptor_index_range(rtsc, (rasqal_raptor_index)rtmc->index,
+                              &rtmc->key, key_len,
+                              &rtmc->offset, &rtmc->end);
+
+  rasqal_raptor_seek_match(rtmc, rtmc->offset);
   
   return 0;
 }
@@ -58,170 +58,444 @@
 #define DEBUG_FH stderr
 
 
+/*
+ * rasqal_regex:
+ *
+ * INTERNAL - A regex pattern compiled with a set of flags
+ *
+ * Created by rasqal_new_regex() so that a pattern can be compiled
+ * once and matched many times.
+ */
+struct rasqal_regex_s {
+  rasqal_world* world;
+
+  /* pattern and flags (never NULL) the regex was compiled from */
+  char* pattern;
+  char* regex_flags;
+
+#ifdef RASQAL_REGEX_PCRE2
+  pcre2_code* re_code;
+  /* match data reused by every match */
+  pcre2_match_data* md;
+#endif
+#ifdef RASQAL_REGEX_PCRE
+  pcre* re;
+  /* result of studying the pattern (JIT compiled where supported) or NULL */
+  pcre_extra* extra;
+#endif
+#ifdef RASQAL_REGEX_POSIX
+  regex_t reg;
+  int reg_compiled;
+#endif
+};
+
+
+/*
+ * rasqal_regex_cache:
+ *
+ * INTERNAL - A small cache of compiled regexes
+ *
+ * Owned by a #rasqal_evaluation_context so that REGEX() and REPLACE()
+ * compile a pattern once per query rather than once per row.  The
+ * cache is bounded; when full the oldest regex is replaced.
+ */
+#define RASQAL_REGEX_CACHE_SIZE 8
+
+struct rasqal_regex_cache_s {
+  rasqal_world* world;
+
+  rasqal_regex* regexes[RASQAL_REGEX_CACHE_SIZE];
+
+  /* index of the next entry to fill or replace */
+  int next;
+};
+
+
 #ifndef STANDALONE
 
 
 /*
- * rasqal_regex_match:
+ * rasqal_new_regex:
  * @world: world
  * @locator: locator
  * @pattern: regex pattern
- * @regex_flags: regex flags string
- * @subject: input string
- * @subject_len: input string length
- *
- * INTERNAL - Test if a string matches a regex pattern.
+ * @regex_flags: regex flags string (or NULL)
  *
- * Intended to be used for executing #RASQAL_EXPR_STR_MATCH and
- * #RASQAL_EXPR_STR_NMATCH operations (unused: formerly RDQL)
+ * INTERNAL - Constructor - compile a regex pattern
  *
- * Return value: <0 on error, 0 for no match, >0 for match
+ * Errors compiling @pattern are logged.
  *
+ * Return value: new #rasqal_regex or NULL on failure
  */
-int
-rasqal_regex_match(rasqal_world* world, raptor_locator* locator,
-                   const char* pattern,
-                   const char* regex_flags,
-                   const char* subject, size_t subject_len)
+rasqal_regex*
+rasqal_new_regex(rasqal_world* world, raptor_locator* locator,
+                 const char* pattern, const char* regex_flags)
 {
+  rasqal_regex* regex;
   int flag_i = 0; /* regex_flags contains i */
   const char *p;
+  size_t len;
 #ifdef RASQAL_REGEX_PCRE2
-  pcre2_code* re_code;
   uint32_t compile_options = 0;
   int errornumber = 0;
   PCRE2_SIZE erroroffset = 0;
 #endif
 #ifdef RASQAL_REGEX_PCRE
-  pcre* re;
   int compile_options = PCRE_UTF8;
-  int exec_options = 0;
+  int study_options = 0;
   const char *re_error = NULL;
   int erroffset = 0;
 #endif
 #ifdef RASQAL_REGEX_POSIX
-  regex_t reg;
   int compile_options = REG_EXTENDED;
-  int exec_options = 0;
+  int rc;
 #endif
-  int rc = 0;
 
-  for(p = regex_flags; p && *p; p++)
+  if(!pattern)
+    return NULL;
+
+  if(!regex_flags)
+    regex_flags = "";
+
+  regex = RASQAL_CALLOC(rasqal_regex*, 1, sizeof(*regex));
+  if(!regex)
+    return NULL;
+
+  regex->world = world;
+
+  len = strlen(pattern);
+  regex->pattern = RASQAL_MALLOC(char*, len + 1);
+  if(!regex->pattern)
+    goto failed;
+  memcpy(regex->pattern, pattern, len + 1);
+
+  len = strlen(regex_flags);
+  regex->regex_flags = RASQAL_MALLOC(char*, len + 1);
+  if(!regex->regex_flags)
+    goto failed;
+  memcpy(regex->regex_flags, regex_flags, len + 1);
+
+  for(p = regex_flags; *p; p++)
     if(*p == 'i')
       flag_i++;
-      
+
 #ifdef RASQAL_REGEX_PCRE2
   if(flag_i)
     compile_options |= PCRE2_CASELESS;
 
-  re_code = pcre2_compile(RASQAL_GOOD_CAST(PCRE2_SPTR, pattern),
-                          PCRE2_ZERO_TERMINATED,
-                          compile_options,
-                          &errornumber,
-                          &erroroffset,
-                          /* ccontext */ NULL);
-  if(!re_code) {
+  regex->re_code = pcre2_compile(RASQAL_GOOD_CAST(PCRE2_SPTR, pattern),
+                                 PCRE2_ZERO_TERMINATED,
+                                 compile_options,
+                                 &errornumber,
+                                 &erroroffset,
+                                 /* ccontext */ NULL);
+  if(!regex->re_code) {
     PCRE2_UCHAR buffer[256];
     pcre2_get_error_message(errornumber, buffer, sizeof(buffer));
     rasqal_log_error_simple(world, RAPTOR_LOG_LEVEL_ERROR, locator,
                             "Regex compile of '%s' failed at offset %d: %s",
                             pattern, (int)erroroffset, buffer);
-    rc = -1;
-  } else {
-    pcre2_match_data *md = pcre2_match_data_create(4, NULL);
-
-    rc = pcre2_match(re_code,
-                     RASQAL_GOOD_CAST(PCRE2_SPTR, subject),
-                     RASQAL_GOOD_CAST(PCRE2_SIZE, subject_len),
-                     /* startoffset */ 0,
-                     /* options */ 0,
-                     md,
-                     /* mcontext */ NULL  /* no match detail wanted */
-                     );
-    if(rc >= 0)
-      rc = 1;
-    else if(rc != PCRE2_ERROR_NOMATCH && rc != PCRE2_ERROR_NULL) {
-      rasqal_log_error_simple(world, RAPTOR_LOG_LEVEL_ERROR, locator,
-                              "Regex match failed - returned code %d", rc);
-      rc= -1;
-    } else
-      rc = 0;
-    pcre2_match_data_free(md);
+    goto failed;
   }
-  pcre2_code_free(re_code);
 
+  /* JIT is optional: when unavailable pcre2_match() interprets */
+  (void)pcre2_jit_compile(regex->re_code, PCRE2_JIT_COMPLETE);
+
+  regex->md = pcre2_match_data_create_from_pattern(regex->re_code, NULL);
+  if(!regex->md)
+    goto failed;
 #endif
 
 #ifdef RASQAL_REGEX_PCRE
   if(flag_i)
     compile_options |= PCRE_CASELESS;
-    
-  re = pcre_compile(RASQAL_GOOD_CAST(const char*, pattern), compile_options,
-                    &re_error, &erroffset, NULL);
-  if(!re) {
+
+  regex->re = pcre_compile(pattern, compile_options,
+                           &re_error, &erroffset, NULL);
+  if(!regex->re) {
     rasqal_log_error_simple(world, RAPTOR_LOG_LEVEL_ERROR, locator,
                             "Regex compile of '%s' failed - %s", pattern, re_error);
-    rc = -1;
-  } else {
-    rc = pcre_exec(re, 
-                   NULL, /* no study */
-                   subject,
-                   RASQAL_BAD_CAST(int, subject_len), /* PCRE API is an int */
-                   0 /* startoffset */,
-                   exec_options /* options */,
-                   NULL, 0 /* ovector, ovecsize - no matches wanted */
-                   );
-    if(rc >= 0)
-      rc = 1;
-    else if(rc != PCRE_ERROR_NOMATCH) {
-      rasqal_log_error_simple(world, RAPTOR_LOG_LEVEL_ERROR, locator,
-                              "Regex match failed - returned code %d", rc);
-      rc= -1;
-    } else
-      rc = 0;
+    goto failed;
   }
-  pcre_free(re);
-  
+
+#ifdef PCRE_STUDY_JIT_COMPILE
+  study_options |= PCRE_STUDY_JIT_COMPILE;
 #endif
-    
+  /* a failed study leaves extra NULL which pcre_exec() accepts */
+  regex->extra = pcre_study(regex->re, study_options, &re_error);
+#endif
+
 #ifdef RASQAL_REGEX_POSIX
+  /* compiled as given so that capture and backreference numbers are
+   * the user's; regexec() reports the whole match in pmatch[0] */
   if(flag_i)
     compile_options |= REG_ICASE;
-    
-  rc = regcomp(&reg, RASQAL_GOOD_CAST(const char*, pattern), compile_options);
+
+  rc = regcomp(&regex->reg, pattern, compile_options);
   if(rc) {
-    rasqal_log_error_simple(world, RAPTOR_LOG_LEVEL_ERROR,
-                            locator,
-                            "Regex compile of '%s' failed", pattern);
-    rc = -1;
-  } else {
-    rc = regexec(&reg, RASQAL_GOOD_CAST(const char*, subject),
-                 0, NULL, /* nmatch, regmatch_t pmatch[] - no matches wanted */
-                 exec_options /* eflags */
-                 );
-    if(!rc)
-      rc = 1;
-    else if (rc != REG_NOMATCH) {
-      rasqal_log_error_simple(world, RAPTOR_LOG_LEVEL_ERROR, locator,
-                              "Regex match failed - returned code %d", rc);
-      rc = -1;
-    } else
-      rc = 0;
+    rasqal_log_error_simple(world, RAPTOR_LOG_LEVEL_ERROR, locator,
+                            "Regex compile of '%s' failed - %d", pattern, rc);
+    goto failed;
   }
-  regfree(&reg);
+  regex->reg_compiled = 1;
 #endif
 
 #ifdef RASQAL_REGEX_NONE
   rasqal_log_warning_simple(world, RASQAL_WARNING_LEVEL_MISSING_SUPPORT, locator,
-                            "Regex support missing, cannot compare '%s' to '%s'",
-                            match_string, pattern);
-  rc = -1;
+                            "Regex support missing, cannot compile '%s'",
+                            pattern);
+  goto failed;
+#endif
+
+  return regex;
+
+  failed:
+  rasqal_free_regex(regex);
+
+  return NULL;
+}
+
+
+/*
+ * rasqal_free_regex:
+ * @regex: regex
+ *
+ * INTERNAL - Destructor - destroy a compiled regex
+ */
+void
+rasqal_free_regex(rasqal_regex* regex)
+{
+  if(!regex)
+    return;
+
+#ifdef RASQAL_REGEX_PCRE2
+  if(regex->md)
+    pcre2_match_data_free(regex->md);
+  if(regex->re_code)
+    pcre2_code_free(regex->re_code);
+#endif
+#ifdef RASQAL_REGEX_PCRE
+  if(regex->extra)
+    pcre_free_study(regex->extra);
+  if(regex->re)
+    pcre_free(regex->re);
+#endif
+#ifdef RASQAL_REGEX_POSIX
+  if(regex->reg_compiled)
+    regfree(&regex->reg);
 #endif
 
+  if(regex->pattern)
+    RASQAL_FREE(char*, regex->pattern);
+  if(regex->regex_flags)
+    RASQAL_FREE(char*, regex->regex_flags);
+
+  RASQAL_FREE(rasqal_regex, regex);
+}
+
+
+/*
+ * rasqal_regex_exec:
+ * @regex: compiled regex
+ * @locator: locator
+ * @subject: input string
+ * @subject_len: input string length
+ *
+ * INTERNAL - Test if a string matches a compiled regex
+ *
+ * Return value: <0 on error, 0 for no match, >0 for match
+ */
+int
+rasqal_regex_exec(rasqal_regex* regex, raptor_locator* locator,
+                  const char* subject, size_t subject_len)
+{
+  int rc = -1;
+
+#ifdef RASQAL_REGEX_PCRE2
+  rc = pcre2_match(regex->re_code,
+                   RASQAL_GOOD_CAST(PCRE2_SPTR, subject),
+                   RASQAL_GOOD_CAST(PCRE2_SIZE, subject_len),
+                   /* startoffset */ 0,
+                   /* options */ 0,
+                   regex->md,
+                   /* mcontext */ NULL  /* no match detail wanted */
+                   );
+  if(rc >= 0)
+    rc = 1;
+  else if(rc != PCRE2_ERROR_NOMATCH && rc != PCRE2_ERROR_NULL) {
+    rasqal_log_error_simple(regex->world, RAPTOR_LOG_LEVEL_ERROR, locator,
+                            "Regex match failed - returned code %d", rc);
+    rc= -1;
+  } else
+    rc = 0;
+#endif
+
+#ifdef RASQAL_REGEX_PCRE
+  rc = pcre_exec(regex->re,
+                 regex->extra,
+                 subject,
+                 RASQAL_BAD_CAST(int, subject_len), /* PCRE API is an int */
+                 0 /* startoffset */,
+                 0 /* options */,
+                 NULL, 0 /* ovector, ovecsize - no matches wanted */
+                 );
+  if(rc >= 0)
+    rc = 1;
+  else if(rc != PCRE_ERROR_NOMATCH) {
+    rasqal_log_error_simple(regex->world, RAPTOR_LOG_LEVEL_ERROR, locator,
+                            "Regex match failed - returned code %d", rc);
+    rc= -1;
+  } else
+    rc = 0;
+#endif
+
+#ifdef RASQAL_REGEX_POSIX
+  rc = regexec(&regex->reg, RASQAL_GOOD_CAST(const char*, subject),
+               0, NULL, /* nmatch, regmatch_t pmatch[] - no matches wanted */
+               0 /* eflags */
+               );
+  if(!rc)
+    rc = 1;
+  else if (rc != REG_NOMATCH) {
+    rasqal_log_error_simple(regex->world, RAPTOR_LOG_LEVEL_ERROR, locator,
+                            "Regex match failed - returned code %d", rc);
+    rc = -1;
+  } else
+    rc = 0;
+#endif
+
+  return rc;
+}
+
+
+/*
+ * rasqal_regex_match:
+ * @world: world
+ * @locator: locator
+ * @pattern: regex pattern
+ * @regex_flags: regex flags string
+ * @subject: input string
+ * @subject_len: input string length
+ *
+ * INTERNAL - Test if a string matches a regex pattern.
+ *
+ * Compiles @pattern for this one match; use rasqal_regex_exec()
+ * with a #rasqal_regex to match a pattern many times.
+ *
+ * Return value: <0 on error, 0 for no match, >0 for match
+ *
+ */
+int
+rasqal_regex_match(rasqal_world* world, raptor_locator* locator,
+                   const char* pattern,
+                   const char* regex_flags,
+                   const char* subject, size_t subject_len)
+{
+  rasqal_regex* regex;
+  int rc;
+
+  regex = rasqal_new_regex(world, locator, pattern, regex_flags);
+  if(!regex)
+    return -1;
+
+  rc = rasqal_regex_exec(regex, locator, subject, subject_len);
+
+  rasqal_free_regex(regex);
+
   return rc;
 }
 
 
+/*
+ * rasqal_new_regex_cache:
+ * @world: world
+ *
+ * INTERNAL - Constructor - create an empty regex cache
+ *
+ * Return value: new #rasqal_regex_cache or NULL on failure
+ */
+rasqal_regex_cache*
+rasqal_new_regex_cache(rasqal_world* world)
+{
+  rasqal_regex_cache* cache;
+
+  cache = RASQAL_CALLOC(rasqal_regex_cache*, 1, sizeof(*cache));
+  if(!cache)
+    return NULL;
+
+  cache->world = world;
+
+  return cache;
+}
+
+
+/*
+ * rasqal_free_regex_cache:
+ * @cache: regex cache
+ *
+ * INTERNAL - Destructor - destroy a regex cache and the regexes in it
+ */
+void
+rasqal_free_regex_cache(rasqal_regex_cache* cache)
+{
+  int i;
+
+  if(!cache)
+    return;
+
+  for(i = 0; i < RASQAL_REGEX_CACHE_SIZE; i++) {
+    if(cache->regexes[i])
+      rasqal_free_regex(cache->regexes[i]);
+  }
+
+  RASQAL_FREE(rasqal_regex_cache, cache);
+}
+
+
+/*
+ * rasqal_regex_cache_get:
+ * @cache: regex cache
+ * @locator: locator
+ * @pattern: regex pattern
+ * @regex_flags: regex flags string (or NULL)
+ *
+ * INTERNAL - Get a compiled regex for a pattern and flags, compiling it if not cached
+ *
+ * Return value: shared pointer to regex valid until the next call, or NULL on failure
+ */
+rasqal_regex*
+rasqal_regex_cache_get(rasqal_regex_cache* cache, raptor_locator* locator,
+                       const char* pattern, const char* regex_flags)
+{
+  rasqal_regex* regex;
+  int i;
+
+  if(!pattern)
+    return NULL;
+
+  if(!regex_flags)
+    regex_flags = "";
+
+  for(i = 0; i < RASQAL_REGEX_CACHE_SIZE; i++) {
+    regex = cache->regexes[i];
+    if(regex && !strcmp(regex->pattern, pattern) &&
+       !strcmp(regex->regex_flags, regex_flags))
+      return regex;
+  }
+
+  regex = rasqal_new_regex(cache->world, locator, pattern, regex_flags);
+  if(!regex)
+    return NULL;
+
+  if(cache->regexes[cache->next])
+    rasqal_free_regex(cache->regexes[cache->next]);
+  cache->regexes[cache->next] = regex;
+  cache->next = (cache->next + 1) % RASQAL_REGEX_CACHE_SIZE;
+
+  return regex;
+}
+
+
 #if defined(RASQAL_REGEX_PCRE) || defined(RASQAL_REGEX_POSIX)
 /*
  * rasqal_regex_get_ref_number:
@@ -263,7 +537,7 @@ rasqal_regex_get_ref_number(const char **str)
 #ifdef RASQAL_REGEX_PCRE
 static char*
 rasqal_regex_replace_pcre(rasqal_world* world, raptor_locator* locator,
-                          pcre* re, int options,
+                          pcre* re, pcre_extra* extra, int options,
                           const char *subject, size_t subject_len,
                           const char *replace, size_t replace_len,
                           size_t *result_len_p)
@@ -300,7 +574,7 @@ rasqal_regex_replace_pcre(rasqal_world* world, raptor_locator* locator,
     const char *subject_piece = subject + startoffset;
 
     stringcount = pcre_exec(re,
-                            NULL, /* no study */
+                            extra,
                             subject,
                             RASQAL_BAD_CAST(int, subject_len), /* PCRE API is an int */
                             RASQAL_BAD_CAST(int, startoffset),
@@ -523,9 +797,10 @@ rasqal_regex_replace_posix(rasqal_world* world, raptor_locator* locator,
   size_t result_len; /* used size of result */
   const char *replace_end = replace + replace_len;
 
-  capture_count = reg.re_nsub;
+  /* pmatch[0] is the whole match and pmatch[N] is capture N */
+  capture_count = reg.re_nsub + 1;
 
-  pmatch = RASQAL_CALLOC(regmatch_t*, capture_count + 1, sizeof(regmatch_t));
+  pmatch = RASQAL_CALLOC(regmatch_t*, capture_count, sizeof(regmatch_t));
   if(!pmatch)
     return NULL;
 
@@ -542,9 +817,10 @@ rasqal_regex_replace_posix(rasqal_world* world, raptor_locator* locator,
     int rc;
     const char *subject_piece = subject + startoffset;
 
+    /* only the start of the subject matches ^ */
     rc = regexec(&reg, RASQAL_GOOD_CAST(const char*, subject_piece),
                  capture_count, pmatch,
-                 options /* eflags */
+                 options | (startoffset ? REG_NOTBOL : 0) /* eflags */
                  );
 
     if(!rc) {
@@ -581,13 +857,10 @@ rasqal_regex_replace_posix(rasqal_world* world, raptor_locator* locator,
 
           ref_number = rasqal_regex_get_ref_number(&replace_p);
           if(ref_number >= 0) {
-            regmatch_t rm;
-            size_t copy_len;
-
-            rm = pmatch[ref_number];
-            copy_len = rm.rm_eo - rm.rm_so + 1;
-            if((size_t)ref_number < capture_count)
-              new_result_len += copy_len;
+            /* unset captures have rm_so -1 and add nothing */
+            if((size_t)ref_number < capture_count &&
+               pmatch[ref_number].rm_so >= 0)
+              new_result_len += RASQAL_GOOD_CAST(size_t, pmatch[ref_number].rm_eo - pmatch[ref_number].rm_so);
             continue;
           }
         }
@@ -635,13 +908,15 @@ rasqal_regex_replace_posix(rasqal_world* world, raptor_locator* locator,
 
           ref_number = rasqal_regex_get_ref_number(&replace_p);
           if(ref_number >= 0) {
-            if((size_t)ref_number < capture_count) {
+            if((size_t)ref_number < capture_count &&
+               pmatch[ref_number].rm_so >= 0) {
               regmatch_t rm;
               size_t match_len;
 
+              /* offsets are relative to subject_piece */
               rm = pmatch[ref_number];
-              match_len = rm.rm_eo - rm.rm_so + 1;
-              memcpy(result_p, subject + rm.rm_so, match_len);
+              match_len = RASQAL_GOOD_CAST(size_t, rm.rm_eo - rm.rm_so);
+              memcpy(result_p, subject_piece + rm.rm_so, match_len);
               result_p += match_len;
               result_len += match_len;
             }
@@ -709,6 +984,9 @@ rasqal_regex_replace_posix(rasqal_world* world, raptor_locator* locator,
 
   RASQAL_FREE(regmatch_t*, pmatch);
 
+  if(result_len_p)
+    *result_len_p = result_len;
+
   return result;
 
 
@@ -724,6 +1002,95 @@ rasqal_regex_replace_posix(rasqal_world* world, raptor_locator* locator,
 
 
 
+/*
+ * rasqal_regex_substitute:
+ * @regex: compiled regex
+ * @locator: locator
+ * @subject: input string
+ * @subject_len: input string length
+ * @replace: replacement string
+ * @replace_len: Length of replacement string
+ * @result_len_p: pointer to store result length (output)
+ *
+ * INTERNAL - Replace all matches of a compiled regex with a replacement with subsitution
+ *
+ * Return value: result string or NULL on failure
+ */
+char*
+rasqal_regex_substitute(rasqal_regex* regex, raptor_locator* locator,
+                        const char* subject, size_t subject_len,
+                        const char* replace, size_t replace_len,
+                        size_t* result_len_p)
+{
+  char *result_s = NULL;
+#ifdef RASQAL_REGEX_PCRE2
+  uint32_t substitute_options = PCRE2_SUBSTITUTE_LITERAL | PCRE2_SUBSTITUTE_GLOBAL;
+  size_t output_len = 0;
+  char* output_buffer = NULL;
+  int rc;
+
+  /* Calculate size of output buffer */
+  rc = pcre2_substitute(regex->re_code,
+                        RASQAL_GOOD_CAST(PCRE2_SPTR, subject),
+                        PCRE2_ZERO_TERMINATED,
+                        /* startoffset */ 0,
+                        substitute_options | PCRE2_SUBSTITUTE_OVERFLOW_LENGTH,
+                        regex->md,
+                        /* mcontext */ NULL,   /* no match detail wanted */
+                        RASQAL_GOOD_CAST(PCRE2_SPTR, replace),
+                        replace_len,
+                        /* outputbuffer */ NULL, /* forcing size calc */
+                        RASQAL_GOOD_CAST(PCRE2_SIZE*, &output_len));
+  if(rc == PCRE2_ERROR_NOMEMORY) {
+    output_buffer = RASQAL_MALLOC(char*, output_len + 1);
+
+    rc = pcre2_substitute(regex->re_code,
+                          RASQAL_GOOD_CAST(PCRE2_SPTR, subject),
+                          PCRE2_ZERO_TERMINATED,
+                          /* startoffset */ 0,
+                          substitute_options,
+                          regex->md,
+                          /* mcontext */ NULL,   /* no match detail wanted */
+                          RASQAL_GOOD_CAST(PCRE2_SPTR, replace),
+                          replace_len,
+                          RASQAL_GOOD_CAST(PCRE2_UCHAR*, output_buffer),
+                          RASQAL_GOOD_CAST(PCRE2_SIZE*, &output_len));
+  }
+  if(rc < 0) {
+    rasqal_log_error_simple(regex->world, RAPTOR_LOG_LEVEL_ERROR, locator,
+                            "Regex replace of '%s' failed with code %d",
+                            regex->pattern, rc);
+    result_s = NULL;
+    if(output_buffer)
+      RASQAL_FREE(char*, output_buffer);
+  } else {
+    result_s = output_buffer;
+    if(result_len_p)
+      *result_len_p = output_len;
+  }
+#endif
+
+#ifdef RASQAL_REGEX_PCRE
+  result_s = rasqal_regex_replace_pcre(regex->world, locator,
+                                       regex->re, regex->extra,
+                                       /* options */ 0,
+                                       subject, subject_len,
+                                       replace, replace_len,
+                                       result_len_p);
+#endif
+
+#ifdef RASQAL_REGEX_POSIX
+  result_s = rasqal_regex_replace_posix(regex->world, locator,
+                                        regex->reg, /* options */ 0,
+                                        subject, subject_len,
+                                        replace, replace_len,
+                                        result_len_p);
+#endif
+
+  return result_s;
+}
+
+
 /**
  * rasqal_regex_replace:
  * @world: world
@@ -751,156 +1118,19 @@ rasqal_regex_replace(rasqal_world* world, raptor_locator* locator,
                      const char* replace, size_t replace_len,
                      size_t* result_len_p) 
 {
-  const char *p;
-#ifdef RASQAL_REGEX_PCRE2
-  pcre2_code* re_code;
-  uint32_t compile_options = 0;
-  int errornumber = 0;
-  PCRE2_SIZE erroroffset = 0;
-#endif
-#ifdef RASQAL_REGEX_PCRE
-  pcre* re;
-  int compile_options = PCRE_UTF8;
-  int exec_options = 0;
-  const char *re_error = NULL;
-  int erroffset = 0;
-#endif
-#ifdef RASQAL_REGEX_POSIX
-  regex_t reg;
-  int compile_options = REG_EXTENDED;
-  int exec_options = 0;
-  int rc = 0;
-  size_t pattern_len;
-  char* pattern2;
-#endif
-  char *result_s = NULL;
-
-#ifdef RASQAL_REGEX_PCRE2
-  for(p = regex_flags; p && *p; p++) {
-    if(*p == 'i')
-      compile_options |= PCRE2_CASELESS;
-  }
-
-  re_code = pcre2_compile(RASQAL_GOOD_CAST(PCRE2_SPTR, pattern),
-                          PCRE2_ZERO_TERMINATED,
-                          compile_options,
-                          &errornumber,
-                          &erroroffset,
-                          /* ccontext */ NULL);
-  if(!re_code) {
-    PCRE2_UCHAR buffer[256];
-    pcre2_get_error_message(errornumber, buffer, sizeof(buffer));
-    rasqal_log_error_simple(world, RAPTOR_LOG_LEVEL_ERROR, locator,
-                            "Regex compile of '%s' failed at offset %d: %s",
-                            pattern, (int)erroroffset, buffer);
-  } else {
-    uint32_t substitute_options = PCRE2_SUBSTITUTE_LITERAL | PCRE2_SUBSTITUTE_GLOBAL;
-    size_t output_len = 0;
-    char* output_buffer = NULL;
-    int rc;
-
-    /* Calculate size of output buffer */
-    rc = pcre2_substitute(re_code,
-                          RASQAL_GOOD_CAST(PCRE2_SPTR, subject),
-                          PCRE2_ZERO_TERMINATED,
-                          /* startoffset */ 0,
-                          substitute_options | PCRE2_SUBSTITUTE_OVERFLOW_LENGTH,
-                          /* match_data */ NULL,
-                          /* mcontext */ NULL,   /* no match detail wanted */
-                          RASQAL_GOOD_CAST(PCRE2_SPTR, replace),
-                          replace_len,
-                          /* outputbuffer */ NULL, /* forcing size calc */
-                          RASQAL_GOOD_CAST(PCRE2_SIZE*, &output_len));
-    if(rc == PCRE2_ERROR_NOMEMORY) {
-      output_buffer = RASQAL_MALLOC(char*, output_len + 1);
-
-      rc = pcre2_substitute(re_code,
-                            RASQAL_GOOD_CAST(PCRE2_SPTR, subject),
-                            PCRE2_ZERO_TERMINATED,
-                            /* startoffset */ 0,
-                            substitute_options,
-                            /* match_data */ NULL,
-                            /* mcontext */ NULL,   /* no match detail wanted */
-                            RASQAL_GOOD_CAST(PCRE2_SPTR, replace),
-                            replace_len,
-                            RASQAL_GOOD_CAST(PCRE2_UCHAR*, output_buffer),
-                            RASQAL_GOOD_CAST(PCRE2_SIZE*, &output_len));
-    }
-    if(rc < 0) {
-      rasqal_log_error_simple(world, RAPTOR_LOG_LEVEL_ERROR, locator,
-                              "Regex replace of '%s' failed with code %d",
-                              pattern, rc);
-      result_s = NULL;
-      if(output_buffer)
-        RASQAL_FREE(char*, output_buffer);
-    } else {
-      result_s = output_buffer;
-      if(result_len_p)
-        *result_len_p = output_len;
-    }
-  }
-  pcre2_code_free(re_code);
-#endif
+  rasqal_regex* regex;
+  char *result_s;
 
-#ifdef RASQAL_REGEX_PCRE
-  for(p = regex_flags; p && *p; p++) {
-    if(*p == 'i')
-      exec_options |= PCRE_CASELESS;
-  }
-
-  re = pcre_compile(pattern, compile_options,
-                    &re_error, &erroffset, NULL);
-  if(!re) {
-    rasqal_log_error_simple(world, RAPTOR_LOG_LEVEL_ERROR, locator,
-                            "Regex compile of '%s' failed - %s", pattern, re_error);
-  } else
-    result_s = rasqal_regex_replace_pcre(world, locator,
-                                         re, exec_options,
-                                         subject, subject_len,
-                                         replace, replace_len,
-                                         result_len_p);
-  pcre_free(re);
-#endif
-    
-#ifdef RASQAL_REGEX_POSIX
-  /* Add an outer capture so we can always find what was matched */
-  pattern_len = strlen(pattern);
-  pattern2 = RASQAL_MALLOC(char*, pattern_len + 3);
-  if(!pattern2)
+  regex = rasqal_new_regex(world, locator, pattern, regex_flags);
+  if(!regex)
     return NULL;
 
-  pattern2[0] = '(';
-  memcpy(pattern2 + 1, pattern, pattern_len);
-  pattern2[pattern_len + 1]=')';
-  pattern2[pattern_len + 2]='\0';
-  
-  for(p = regex_flags; p && *p; p++) {
-    if(*p == 'i')
-      compile_options |= REG_ICASE;
-  }
-    
-  rc = regcomp(&reg, pattern2, compile_options);
-  if(rc) {
-    RASQAL_FREE(char*, pattern2);
-    rasqal_log_error_simple(world, RAPTOR_LOG_LEVEL_ERROR, locator,
-                            "Regex compile of '%s' failed - %d", pattern, rc);
-  } else {
-    RASQAL_FREE(char*, pattern2);
-    result_s = rasqal_regex_replace_posix(world, locator,
-                                          reg, exec_options,
-                                          subject, subject_len,
-                                          replace, replace_len,
-                                          result_len_p);
-  }
+  result_s = rasqal_regex_substitute(regex, locator,
+                                     subject, subject_len,
+                                     replace, replace_len,
+                                     result_len_p);
 
-  regfree(&reg);
-#endif
-
-#ifdef RASQAL_REGEX_NONE
-  rasqal_log_warning_simple(world, RASQAL_WARNING_LEVEL_MISSING_SUPPORT,
-                            locator,
-                            "Regex support missing, cannot replace '%s' from '%s' to '%s'", subject, pattern, replace);
-#endif
+  rasqal_free_regex(regex);
 
   return result_s;
 }
@@ -916,12 +1146,71 @@ int main(int argc, char *argv[]);
 
 #define NTESTS 1
 
+#ifndef RASQAL_REGEX_NONE
+static const struct {
+  const char* pattern;
+  const char* regex_flags;
+  const char* subject;
+  int expected;
+} exec_tests[] = {
+  { "^ab+",     NULL, "abbb",  1 },
+  { "^ab+",     "",   "ABB",   0 },
+  { "^ab+",     "i",  "ABB",   1 },
+  { "b+$",      NULL, "abc",   0 },
+  { "(a|b)c",   NULL, "xbc",   1 },
+  { "[0-9]{2}", NULL, "a1b2",  0 },
+#if !defined(RASQAL_REGEX_POSIX) || defined(__GLIBC__)
+  /* backreferences are numbered as written in the pattern */
+  { "^(a+)b\\1$", NULL, "aabaa", 1 },
+  { "^(a+)b\\1$", NULL, "aaba",  0 },
+#endif
+  { NULL,       NULL, NULL,    0 }
+};
+
+static const struct {
+  const char* pattern;
+  const char* regex_flags;
+  const char* subject;
+  const char* replace;
+  const char* expected;
+} substitute_tests[] = {
+  { "-",      NULL, "a-b-c",  "+", "a+b+c" },
+  { "B",      "i",  "abcb",   "x", "axcx" },
+  { "z",      NULL, "abc",    "x", "abc" },
+  /* ^ only matches at the start of the subject */
+  { "^a",     NULL, "aaa",    "x", "xaa" },
+#if defined(RASQAL_REGEX_PCRE) || defined(RASQAL_REGEX_POSIX)
+  /* PCRE2 substitutes the replacement literally */
+  { "([a-z]+)-([0-9]+)", NULL, "ab-12 cd-34", "$2:$1", "12:ab 34:cd" },
+  { "[0-9]+", NULL, "a1b22",  "<$0>", "a<1>b<22>" },
+  { "(x)?b",  NULL, "ab",     "[$1]", "a[]" },
+#endif
+  { NULL,     NULL, NULL,     NULL, NULL }
+};
+
+
+/* Return non-0 if the cache holds a regex for @pattern */
+static int
+regex_cache_has(rasqal_regex_cache* cache, const char* pattern)
+{
+  int i;
+
+  for(i = 0; i < RASQAL_REGEX_CACHE_SIZE; i++) {
+    if(cache->regexes[i] && !strcmp(cache->regexes[i]->pattern, pattern))
+      return 1;
+  }
+
+  return 0;
+}
+#endif
+
+
 int
 main(int argc, char *argv[])
 {
   rasqal_world* world;
   const char *program = rasqal_basename(argv[0]);
-#if defined(RASQAL_REGEX_PCRE) || defined(RASQAL_REGEX_PCRE2)
+#ifndef RASQAL_REGEX_NONE
   raptor_locator* locator = NULL;
   int test = 0;
 #endif
@@ -934,13 +1223,11 @@ main(int argc, char *argv[])
     goto tidy;
   }
     
-#if defined(RASQAL_REGEX_POSIX) || defined(RASQAL_REGEX_NONE)
+#ifdef RASQAL_REGEX_NONE
     fprintf(stderr,
-            "%s: WARNING: Cannot only run regex tests with PCRE regexes\n",
+            "%s: WARNING: Cannot run regex tests without a regex library\n",
             program);
-#endif
-
-#if defined(RASQAL_REGEX_PCRE) || defined(RASQAL_REGEX_PCRE2)
+#else
   for(test = 0; test < NTESTS; test++) {
     const char* regex_flags = "";
     const char* subject = "abcd1234-^";
@@ -973,6 +1260,166 @@ main(int argc, char *argv[])
       failures++;
     }
   }
+
+  for(test = 0; exec_tests[test].pattern; test++) {
+    const char* pattern = exec_tests[test].pattern;
+    const char* subject = exec_tests[test].subject;
+    rasqal_regex* regex;
+    int rc;
+
+    regex = rasqal_new_regex(world, locator, pattern,
+                             exec_tests[test].regex_flags);
+    if(!regex) {
+      fprintf(stderr, "%s: Exec test %d failed to compile '%s'\n",
+              program, test, pattern);
+      failures++;
+      continue;
+    }
+
+    /* a compiled regex gives the same answer every time */
+    rc = rasqal_regex_exec(regex, locator, subject, strlen(subject));
+    if(rc == exec_tests[test].expected)
+      rc = rasqal_regex_exec(regex, locator, subject, strlen(subject));
+    if(rc != exec_tests[test].expected) {
+      fprintf(stderr, "%s: Exec test %d failed - '%s' on '%s' returned %d expected %d\n",
+              program, test, pattern, subject, rc, exec_tests[test].expected);
+      failures++;
+    }
+
+    rasqal_free_regex(regex);
+  }
+
+  for(test = 0; substitute_tests[test].pattern; test++) {
+    const char* pattern = substitute_tests[test].pattern;
+    const char* subject = substitute_tests[test].subject;
+    const char* replace = substitute_tests[test].replace;
+    const char* expected_result = substitute_tests[test].expected;
+    rasqal_regex* regex;
+    char* result;
+    size_t result_len = 0;
+
+    regex = rasqal_new_regex(world, locator, pattern,
+                             substitute_tests[test].regex_flags);
+    if(!regex) {
+      fprintf(stderr, "%s: Substitute test %d failed to compile '%s'\n",
+              program, test, pattern);
+      failures++;
+      continue;
+    }
+
+    result = rasqal_regex_substitute(regex, locator,
+                                     subject, strlen(subject),
+                                     replace, strlen(replace),
+                                     &result_len);
+    if(!result) {
+      fprintf(stderr, "%s: Substitute test %d failed - result was NULL\n",
+              program, test);
+      failures++;
+    } else {
+      if(strcmp(result, expected_result) ||
+         result_len != strlen(expected_result)) {
+        fprintf(stderr, "%s: Substitute test %d failed - '%s' on '%s' with '%s' expected '%s' but got '%s' (length %d)\n",
+                program, test, pattern, subject, replace, expected_result,
+                result, RASQAL_GOOD_CAST(int, result_len));
+        failures++;
+      }
+      RASQAL_FREE(char*, result);
+    }
+
+    rasqal_free_regex(regex);
+  }
+
+  if(1) {
+    rasqal_regex_cache* cache;
+    rasqal_regex* regex1;
+    rasqal_regex* regex2;
+    rasqal_regex* regex3;
+    char pattern[8];
+    int i;
+
+    cache = rasqal_new_regex_cache(world);
+    if(!cache) {
+      fprintf(stderr, "%s: Failed to create regex cache\n", program);
+      failures++;
+      goto tidy;
+    }
+
+    /* NULL and "" flags are the same key; "i" is another */
+    regex1 = rasqal_regex_cache_get(cache, locator, "^ab+", NULL);
+    regex2 = rasqal_regex_cache_get(cache, locator, "^ab+", "");
+    regex3 = rasqal_regex_cache_get(cache, locator, "^ab+", "i");
+
+    if(!regex1 || regex1 != regex2 || !regex3 || regex3 == regex1) {
+      fprintf(stderr, "%s: Regex cache did not return the cached regexes\n",
+              program);
+      failures++;
+    } else if(rasqal_regex_exec(regex1, locator, "ABB", 3) != 0 ||
+              rasqal_regex_exec(regex3, locator, "ABB", 3) != 1) {
+      fprintf(stderr, "%s: Cached regexes matched wrongly\n", program);
+      failures++;
+    }
+
+    if(rasqal_regex_cache_get(cache, locator, "(", NULL) ||
+       regex_cache_has(cache, "(")) {
+      fprintf(stderr, "%s: Regex cache kept a pattern that did not compile\n",
+              program);
+      failures++;
+    }
+
+    rasqal_free_regex_cache(cache);
+
+    /* Fill the cache then check the oldest entry is replaced first,
+     * even after a hit */
+    cache = rasqal_new_regex_cache(world);
+    if(!cache) {
+      fprintf(stderr, "%s: Failed to create regex cache\n", program);
+      failures++;
+      goto tidy;
+    }
+
+    for(i = 0; i <= RASQAL_REGEX_CACHE_SIZE; i++) {
+      snprintf(pattern, sizeof(pattern), "a%d", i);
+
+      if(i == RASQAL_REGEX_CACHE_SIZE) {
+        /* full: a hit on a0 does not add or reorder entries */
+        regex1 = cache->regexes[0];
+        if(rasqal_regex_cache_get(cache, locator, "a0", NULL) != regex1 ||
+           cache->next != 0) {
+          fprintf(stderr, "%s: Regex cache hit on a full cache changed it\n",
+                  program);
+          failures++;
+        }
+      }
+
+      if(!rasqal_regex_cache_get(cache, locator, pattern, NULL)) {
+        fprintf(stderr, "%s: Regex cache failed to compile '%s'\n", program,
+                pattern);
+        failures++;
+      }
+    }
+
+    /* a8 replaced a0; a0 now replaces a1 */
+    if(regex_cache_has(cache, "a0") || !regex_cache_has(cache, "a8")) {
+      fprintf(stderr, "%s: Regex cache did not replace its oldest entry a0\n",
+              program);
+      failures++;
+    }
+    rasqal_regex_cache_get(cache, locator, "a0", NULL);
+    if(regex_cache_has(cache, "a1") || !regex_cache_has(cache, "a0")) {
+      fprintf(stderr, "%s: Regex cache did not replace its oldest entry a1\n",
+              program);
+      failures++;
+    }
+    for(i = 2; i <= RASQAL_REGEX_CACHE_SIZE; i++) {
+      snprintf(pattern, sizeof(pattern), "a%d", i);
+      if(!regex_cache_has(cache, pattern)) {
+        fprintf(stderr, "%s: Regex cache lost entry '%s'\n", program, pattern);
+        failures++;
+      }
+    }
+
+    rasqal_free_regex_cache(cache);
+  }
 #endif
 
   tidy:
@@ -48,17 +48,17 @@ rasqal_new_row_common(rasqal_world* world, int size, int order_size)
 {
   rasqal_row* row;
   
-  row = RASQAL_CALLOC(rasqal_row*, 1, sizeof(*row));
+  row = rasqal_pool_alloc_row(world);
   if(!row)
     return NULL;
 
   row->usage = 1;
+  row->world = world;
   row->size = size;
   row->order_size = order_size;
 
   if(row->size > 0) {
-    row->values = RASQAL_CALLOC(rasqal_literal**, RASQAL_GOOD_CAST(size_t, row->size),
-                                sizeof(rasqal_literal*));
+    row->values = rasqal_pool_alloc_values(world, row->size);
     if(!row->values) {
       rasqal_free_row(row);
       return NULL;
@@ -66,8 +66,7 @@ rasqal_new_row_common(rasqal_world* world, int size, int order_size)
   }
 
   if(row->order_size > 0) {
-    row->order_values = RASQAL_CALLOC(rasqal_literal**, RASQAL_GOOD_CAST(size_t, row->order_size),
-                                      sizeof(rasqal_literal*));
+    row->order_values = rasqal_pool_alloc_values(world, row->order_size);
     if(!row->order_values) {
       rasqal_free_row(row);
       return NULL;
@@ -157,7 +156,7 @@ rasqal_new_row_from_row_deep(rasqal_row* row)
 {
   rasqal_row* new_row;
 
-  new_row = rasqal_new_row_common(row->rowsource->world, row->size, row->order_size);
+  new_row = rasqal_new_row_common(row->world, row->size, row->order_size);
   if(row->values) {
     int i;
     for(i = 0; i < row->size; i++)
@@ -193,7 +192,7 @@ rasqal_free_row(rasqal_row* row)
       if(row->values[i])
         rasqal_free_literal(row->values[i]);
     }
-    RASQAL_FREE(array, row->values);
+    rasqal_pool_free_values(row->world, row->values, row->size);
   }
   if(row->order_values) {
     int i; 
@@ -201,13 +200,15 @@ rasqal_free_row(rasqal_row* row)
       if(row->order_values[i])
         rasqal_free_literal(row->order_values[i]);
     }
-    RASQAL_FREE(array, row->order_values);
+    rasqal_pool_free_values(row->world, row->order_values, row->order_size);
   }
+  if(row->order_keys)
+    RASQAL_FREE(rasqal_order_key*, row->order_keys);
 
   if(row->rowsource)
     rasqal_free_rowsource(row->rowsource);
 
-  RASQAL_FREE(rasqal_row, row);
+  rasqal_pool_free_row(row->world, row);
 }
 
 
@@ -545,6 +546,39 @@ rasqal_new_row_sequence(rasqal_world* world,
 }
 
 
+/**
+ * rasqal_new_row_sequence_rowsource:
+ * @world: world object ot use
+ * @query: query object to use
+ * @row_data: row data
+ * @vars_count: number of variables in row
+ *
+ * INTERNAL - Make a rowsource returning a table of rows
+ *
+ * The rows are made by rasqal_new_row_sequence() from @row_data with
+ * variables defined in the @query variables table.
+ *
+ * Return value: new rowsource or NULL on failure
+ */
+rasqal_rowsource*
+rasqal_new_row_sequence_rowsource(rasqal_world* world, rasqal_query* query,
+                                  const char* const row_data[],
+                                  int vars_count)
+{
+  raptor_sequence* seq;
+  raptor_sequence* vars_seq = NULL;
+
+  seq = rasqal_new_row_sequence(world, query->vars_table, row_data,
+                                vars_count, &vars_seq);
+  if(!seq)
+    return NULL;
+
+  /* vars_seq and seq become owned by the rowsource */
+  return rasqal_new_rowsequence_rowsource(world, query, query->vars_table,
+                                          seq, vars_seq);
+}
+
+
 /**
  * rasqal_row_to_nodes:
  * @row: Result row
@@ -614,8 +648,7 @@ rasqal_row_set_order_size(rasqal_row *row, int order_size)
 {
   row->order_size = order_size;
   if(row->order_size > 0) {
-    row->order_values = RASQAL_CALLOC(rasqal_literal**, RASQAL_GOOD_CAST(size_t, row->order_size),
-                                      sizeof(rasqal_literal*));
+    row->order_values = rasqal_pool_alloc_values(row->world, row->order_size);
     if(!row->order_values) {
       row->order_size = -1;
       return 1;
@@ -644,11 +677,12 @@ rasqal_row_expand_size(rasqal_row *row, int size)
   if(row->size > size)
     return 1;
   
-  nvalues = RASQAL_CALLOC(rasqal_literal**, RASQAL_GOOD_CAST(size_t, size), sizeof(rasqal_literal*));
+  nvalues = rasqal_pool_alloc_values(row->world, size);
   if(!nvalues)
     return 1;
-  memcpy(nvalues, row->values, RASQAL_GOOD_CAST(size_t, sizeof(rasqal_literal*) * RASQAL_GOOD_CAST(size_t, row->size)));
-  RASQAL_FREE(array, row->values);
+  if(row->values)
+    memcpy(nvalues, row->values, RASQAL_GOOD_CAST(size_t, sizeof(rasqal_literal*) * RASQAL_GOOD_CAST(size_t, row->size)));
+  rasqal_pool_free_values(row->world, row->values, row->size);
   row->values = nvalues;
   
   row->size = size;
@@ -657,6 +691,89 @@ rasqal_row_expand_size(rasqal_row *row, int size)
 
 
 
+/**
+ * rasqal_row_write_binary:
+ * @row: Result row
+ * @fh: FILE* to write to
+ *
+ * INTERNAL - Write a row and its order values in a compact binary form
+ *
+ * See rasqal_literal_write_binary().
+ *
+ * Return value: non-0 on failure
+ */
+int
+rasqal_row_write_binary(rasqal_row* row, FILE* fh)
+{
+  int header[4];
+  int i;
+
+  header[0] = row->size;
+  header[1] = row->order_size;
+  header[2] = row->offset;
+  header[3] = row->group_id;
+  if(fwrite(header, sizeof(int), 4, fh) != 4)
+    return 1;
+
+  for(i = 0; i < row->size; i++) {
+    if(rasqal_literal_write_binary(row->values[i], fh))
+      return 1;
+  }
+
+  for(i = 0; i < row->order_size; i++) {
+    if(rasqal_literal_write_binary(row->order_values[i], fh))
+      return 1;
+  }
+
+  return 0;
+}
+
+
+/**
+ * rasqal_new_row_from_binary:
+ * @rowsource: rowsource to associate with the row
+ * @fh: FILE* to read from
+ *
+ * INTERNAL - Read a row written by rasqal_row_write_binary()
+ *
+ * Return value: new row or NULL on failure
+ */
+rasqal_row*
+rasqal_new_row_from_binary(rasqal_rowsource* rowsource, FILE* fh)
+{
+  int header[4];
+  rasqal_row* row;
+  int error = 0;
+  int i;
+
+  if(fread(header, sizeof(int), 4, fh) != 4)
+    return NULL;
+
+  row = rasqal_new_row_common(rowsource->world, header[0], header[1]);
+  if(!row)
+    return NULL;
+
+  row->rowsource = rasqal_new_rowsource_from_rowsource(rowsource);
+  row->offset = header[2];
+  row->group_id = header[3];
+
+  for(i = 0; !error && i < row->size; i++)
+    row->values[i] = rasqal_new_literal_from_binary(row->world, fh, &error);
+
+  for(i = 0; !error && i < row->order_size; i++)
+    row->order_values[i] = rasqal_new_literal_from_binary(row->world, fh,
+                                                          &error);
+
+  if(error) {
+    rasqal_free_row(row);
+    return NULL;
+  }
+
+  return row;
+}
+
+
+
 /**
  * rasqal_row_bind_variables:
  * @row: Result row
@@ -46,6 +46,30 @@
 
 static void rasqal_rowsource_print_header(rasqal_rowsource* rowsource, FILE* fh);
 
+#ifndef HAVE_GETTIMEOFDAY
+#define gettimeofday(x,y) rasqal_gettimeofday(x,y)
+#endif
+
+
+/*
+ * rasqal_rowsource_get_time:
+ *
+ * INTERNAL - Get the current wall clock time in seconds for profiling
+ *
+ * Return value: time in seconds or 0.0 on failure
+ */
+static double
+rasqal_rowsource_get_time(void)
+{
+  struct timeval tv;
+
+  if(gettimeofday(&tv, NULL))
+    return 0.0;
+
+  return (double)tv.tv_sec + ((double)tv.tv_usec / 1000000.0);
+}
+
+
 /**
  * rasqal_new_rowsource_from_handler:
  * @query: query object
@@ -275,8 +299,20 @@ rasqal_rowsource_read_row(rasqal_rowsource *rowsource)
       return NULL;
 
     if(rowsource->handler->read_row) {
+      double start_time = 0.0;
+
+      if(rowsource->flags & RASQAL_ROWSOURCE_FLAGS_PROFILE)
+        start_time = rasqal_rowsource_get_time();
+
       row = rowsource->handler->read_row(rowsource, rowsource->user_data);
       /* row is owned by us */
+      rowsource->calls++;
+
+      if(rowsource->flags & RASQAL_ROWSOURCE_FLAGS_PROFILE)
+        rowsource->elapsed += rasqal_rowsource_get_time() - start_time;
+
+      if(row)
+        rowsource->rows_produced++;
 
       if(row && rowsource->flags & RASQAL_ROWSOURCE_FLAGS_SAVE_ROWS) {
         if(!rowsource->rows_sequence) {
@@ -286,6 +322,7 @@ rasqal_rowsource_read_row(rasqal_rowsource *rowsource)
         }
         /* copy to save it away */
         row = rasqal_new_row_from_row(row);
+        rasqal_rowsource_hold_row(rowsource, row);
         raptor_sequence_push(rowsource->rows_sequence, row);
       }
     } else {
@@ -392,7 +429,20 @@ rasqal_rowsource_read_all_rows(rasqal_rowsource *rowsource)
     return NULL;
 
   if(rowsource->handler->read_all_rows) {
+    double start_time = 0.0;
+
+    if(rowsource->flags & RASQAL_ROWSOURCE_FLAGS_PROFILE)
+      start_time = rasqal_rowsource_get_time();
+
     seq = rowsource->handler->read_all_rows(rowsource, rowsource->user_data);
+    rowsource->calls++;
+
+    if(rowsource->flags & RASQAL_ROWSOURCE_FLAGS_PROFILE)
+      rowsource->elapsed += rasqal_rowsource_get_time() - start_time;
+
+    if(seq)
+      rowsource->rows_produced += raptor_sequence_size(seq);
+
     if(!seq) {
       seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_row,
                                 (raptor_data_print_handler)rasqal_row_print);
@@ -442,6 +492,7 @@ rasqal_rowsource_read_all_rows(rasqal_rowsource *rowsource)
                   raptor_sequence_size(new_seq));
     rowsource->rows_sequence = new_seq;
     rowsource->flags |= RASQAL_ROWSOURCE_FLAGS_SAVED_ROWS;
+    rasqal_rowsource_hold_rows(rowsource, new_seq);
   }
   
   RASQAL_DEBUG4("%s rowsource %p returning a sequence of %d rows\n",
@@ -630,6 +681,8 @@ rasqal_rowsource_reset(rasqal_rowsource* rowsource)
 {
   rowsource->finished = 0;
   rowsource->count = 0;
+  rowsource->resets++;
+  rowsource->held_bytes = 0;
 
   if(rowsource->handler->reset)
     return rowsource->handler->reset(rowsource, rowsource->user_data);
@@ -763,6 +816,171 @@ rasqal_rowsource_set_requirements(rasqal_rowsource* rowsource, unsigned int flag
 }
 
 
+static int
+rasqal_rowsource_visitor_set_profile(rasqal_rowsource* rowsource,
+                                     void *user_data)
+{
+  int profile = *(int*)user_data;
+
+  if(profile)
+    rowsource->flags |= RASQAL_ROWSOURCE_FLAGS_PROFILE;
+  else
+    rowsource->flags &= ~RASQAL_ROWSOURCE_FLAGS_PROFILE;
+
+  return 0;
+}
+
+
+/**
+ * rasqal_rowsource_set_profile:
+ * @rowsource: rasqal rowsource
+ * @profile: non-0 to record time spent in each rowsource
+ *
+ * INTERNAL - Enable or disable timing of a rowsource and all its inner rowsources
+ *
+ * Row counts and resets are always recorded; timing is optional
+ * since it costs two clock calls per row.
+ *
+ * Return value: non-0 on failure
+ */
+int
+rasqal_rowsource_set_profile(rasqal_rowsource* rowsource, int profile)
+{
+  return rasqal_rowsource_visit(rowsource,
+                                rasqal_rowsource_visitor_set_profile,
+                                &profile);
+}
+
+
+/**
+ * rasqal_rowsource_hold_row:
+ * @rowsource: rasqal rowsource
+ * @row: row being kept by the rowsource
+ *
+ * INTERNAL - Record that a rowsource is keeping a row in memory
+ *
+ * Used by rowsources that store their input such as sort, distinct
+ * and hash join.  The row size is estimated from the row structure
+ * and value arrays; the literal values are shared and not counted.
+ * Does nothing unless the rowsource is being profiled.
+ */
+void
+rasqal_rowsource_hold_row(rasqal_rowsource* rowsource, rasqal_row* row)
+{
+  size_t size;
+
+  if(!row || !(rowsource->flags & RASQAL_ROWSOURCE_FLAGS_PROFILE))
+    return;
+
+  size = RASQAL_GOOD_CAST(size_t, row->size);
+  if(row->order_size > 0)
+    size += RASQAL_GOOD_CAST(size_t, row->order_size);
+
+  rowsource->held_bytes += sizeof(*row) + size * sizeof(rasqal_literal*);
+  if(rowsource->held_bytes > rowsource->held_bytes_peak)
+    rowsource->held_bytes_peak = rowsource->held_bytes;
+}
+
+
+/**
+ * rasqal_rowsource_hold_rows:
+ * @rowsource: rasqal rowsource
+ * @seq: sequence of #rasqal_row being kept by the rowsource (or NULL)
+ *
+ * INTERNAL - Record that a rowsource is keeping a sequence of rows in memory
+ *
+ * See rasqal_rowsource_hold_row().
+ */
+void
+rasqal_rowsource_hold_rows(rasqal_rowsource* rowsource, raptor_sequence* seq)
+{
+  int i;
+  rasqal_row* row;
+
+  if(!seq || !(rowsource->flags & RASQAL_ROWSOURCE_FLAGS_PROFILE))
+    return;
+
+  for(i = 0; (row = (rasqal_row*)raptor_sequence_get_at(seq, i)); i++)
+    rasqal_rowsource_hold_row(rowsource, row);
+}
+
+
+static int
+rasqal_rowsource_visit_profile_internal(rasqal_rowsource* rowsource,
+                                        rasqal_operator_profile_handler handler,
+                                        void* user_data,
+                                        int parent, int depth, int* next_id_p)
+{
+  rasqal_operator_profile profile;
+  rasqal_rowsource* inner_rs;
+  int offset;
+  int rc;
+
+  memset(&profile, '\0', sizeof(profile));
+  profile.id = (*next_id_p)++;
+  profile.parent = parent;
+  profile.depth = depth;
+  profile.name = rowsource->handler->name;
+  profile.rows = rowsource->rows_produced;
+  profile.calls = rowsource->calls;
+  profile.resets = rowsource->resets;
+  profile.time = rowsource->elapsed;
+  profile.self_time = rowsource->elapsed;
+  profile.rows_bytes = rowsource->held_bytes_peak;
+
+  for(offset = 0;
+      (inner_rs = rasqal_rowsource_get_inner_rowsource(rowsource, offset));
+      offset++) {
+    profile.rows_in += inner_rs->rows_produced;
+    profile.self_time -= inner_rs->elapsed;
+  }
+  /* inner rowsources may be read outside this one, such as when set up */
+  if(profile.self_time < 0.0)
+    profile.self_time = 0.0;
+
+  rc = handler(user_data, &profile);
+  if(rc)
+    return rc;
+
+  for(offset = 0;
+      (inner_rs = rasqal_rowsource_get_inner_rowsource(rowsource, offset));
+      offset++) {
+    rc = rasqal_rowsource_visit_profile_internal(inner_rs, handler, user_data,
+                                                 profile.id, depth + 1,
+                                                 next_id_p);
+    if(rc)
+      return rc;
+  }
+
+  return 0;
+}
+
+
+/**
+ * rasqal_rowsource_visit_profile:
+ * @rowsource: rasqal rowsource
+ * @handler: function to call with the counters of each rowsource
+ * @user_data: user data for @handler
+ *
+ * INTERNAL - Visit the runtime counters of a rowsource tree in pre-order
+ *
+ * Return value: non-0 on failure or if @handler returned non-0
+ */
+int
+rasqal_rowsource_visit_profile(rasqal_rowsource* rowsource,
+                               rasqal_operator_profile_handler handler,
+                               void* user_data)
+{
+  int next_id = 0;
+
+  if(!rowsource || !handler)
+    return 1;
+
+  return rasqal_rowsource_visit_profile_internal(rowsource, handler, user_data,
+                                                 -1, 0, &next_id);
+}
+
+
 int
 rasqal_rowsource_request_grouping(rasqal_rowsource* rowsource)
 {
@@ -128,9 +128,53 @@ typedef struct
 
   /* step into current group */
   int step_count;
+
+  /* GROUP BY expressions when grouping and aggregating in one pass
+   * (NULL when the input rowsource is already grouped) */
+  raptor_sequence* group_exprs_seq;
+
+  /* non-0 if the input has been grouped and aggregated */
+  int processed;
+
+  /* comparison flags for group keys, as the groupby rowsource uses */
+  int compare_flags;
+
+  /* avltree of groups ordered by key.
+   * the tree nodes are #rasqal_aggregation_group objects
+   */
+  raptor_avltree* groups;
+
+  /* iterator over @groups for returning result rows */
+  raptor_avltree_iterator* groups_iterator;
 } rasqal_aggregation_rowsource_context;
 
 
+/*
+ * rasqal_aggregation_group:
+ *
+ * INTERNAL - accumulated state of one group when aggregating in one pass
+ *
+ * Holds everything needed to generate the result row of a group so
+ * the input rows can be freed as soon as they have been stepped over.
+ */
+typedef struct
+{
+  rasqal_aggregation_rowsource_context* con;
+
+  /* group key: sequence of #rasqal_literal from the GROUP BY
+   * expressions (NULL for the group made when there is no input) */
+  raptor_sequence* literals;
+
+  /* values of the first row of the group to copy through
+   * (array of size input_values_count) */
+  rasqal_literal** input_values;
+
+  /* aggregation function execution user data per aggregate expression
+   * (array of size expr_count) */
+  void** agg_user_data;
+} rasqal_aggregation_group;
+
+
 /*
  * rasqal_builtin_agg_expression_execute:
  *
@@ -407,6 +451,360 @@ rasqal_builtin_agg_expression_execute_result(void* user_data)
 
 
 
+static void
+rasqal_aggregation_group_clear(rasqal_aggregation_group* group)
+{
+  rasqal_aggregation_rowsource_context* con = group->con;
+  int i;
+
+  if(group->literals) {
+    raptor_free_sequence(group->literals);
+    group->literals = NULL;
+  }
+
+  if(group->input_values) {
+    for(i = 0; i < con->input_values_count; i++) {
+      if(group->input_values[i])
+        rasqal_free_literal(group->input_values[i]);
+    }
+    RASQAL_FREE(rasqal_literal**, group->input_values);
+    group->input_values = NULL;
+  }
+
+  if(group->agg_user_data) {
+    for(i = 0; i < con->expr_count; i++) {
+      if(group->agg_user_data[i])
+        rasqal_builtin_agg_expression_execute_finish(group->agg_user_data[i]);
+    }
+    RASQAL_FREE(void**, group->agg_user_data);
+    group->agg_user_data = NULL;
+  }
+}
+
+
+static void
+rasqal_free_aggregation_group(rasqal_aggregation_group* group)
+{
+  if(!group)
+    return;
+
+  rasqal_aggregation_group_clear(group);
+  RASQAL_FREE(rasqal_aggregation_group, group);
+}
+
+
+/*
+ * rasqal_aggregation_group_compare:
+ * @a: first group
+ * @b: second group
+ *
+ * INTERNAL - compare group keys as rasqal_groupby_rowsource_process() does
+ *
+ * Keys are compared as values with the flags the groupby rowsource
+ * uses, so rows are grouped the same way (1 and 1.0 are one group)
+ * and groups are returned in the same order whichever rowsource the
+ * engine picks.
+ *
+ * Return value: <0, 0 or >1 comparison
+ */
+static int
+rasqal_aggregation_group_compare(const void *a, const void *b)
+{
+  rasqal_aggregation_group* group_a = (rasqal_aggregation_group*)a;
+  rasqal_aggregation_group* group_b = (rasqal_aggregation_group*)b;
+
+  return rasqal_literal_sequence_compare(group_a->con->compare_flags,
+                                         group_a->literals, group_b->literals);
+}
+
+
+static void
+rasqal_aggregation_rowsource_free_groups(rasqal_aggregation_rowsource_context* con)
+{
+  if(con->groups_iterator) {
+    raptor_free_avltree_iterator(con->groups_iterator);
+    con->groups_iterator = NULL;
+  }
+
+  if(con->groups) {
+    raptor_free_avltree(con->groups);
+    con->groups = NULL;
+  }
+}
+
+
+/*
+ * rasqal_aggregation_rowsource_get_group:
+ * @rowsource: aggregation rowsource
+ * @con: aggregation rowsource context
+ * @literals: group key (or NULL)
+ * @row: row to take the copied through values from for a new group (or NULL)
+ *
+ * INTERNAL - Find the group for a key, creating it if it is new
+ *
+ * Keys are compared with rasqal_aggregation_group_compare().
+ * @literals becomes owned by this function.
+ *
+ * Return value: group or NULL on failure
+ */
+static rasqal_aggregation_group*
+rasqal_aggregation_rowsource_get_group(rasqal_rowsource* rowsource,
+                                       rasqal_aggregation_rowsource_context* con,
+                                       raptor_sequence* literals,
+                                       rasqal_row* row)
+{
+  rasqal_aggregation_group key;
+  rasqal_aggregation_group* group;
+  int i;
+
+  memset(&key, '\0', sizeof(key));
+  key.con = con;
+  key.literals = literals;
+
+  group = (rasqal_aggregation_group*)raptor_avltree_search(con->groups, &key);
+  if(group) {
+    if(literals)
+      raptor_free_sequence(literals);
+    return group;
+  }
+
+  /* New Group */
+  group = RASQAL_CALLOC(rasqal_aggregation_group*, 1, sizeof(*group));
+  if(!group) {
+    if(literals)
+      raptor_free_sequence(literals);
+    return NULL;
+  }
+
+  group->con = con;
+  /* group now owns literals */
+  group->literals = literals;
+
+#ifdef RASQAL_DEBUG
+  RASQAL_DEBUG2("Aggregation starting group %d",
+                raptor_avltree_size(con->groups));
+  fputc('\n', DEBUG_FH);
+#endif
+
+  if(con->input_values_count) {
+    group->input_values = RASQAL_CALLOC(rasqal_literal**,
+                                        RASQAL_GOOD_CAST(size_t, con->input_values_count),
+                                        sizeof(rasqal_literal*));
+    if(!group->input_values)
+      goto failed;
+
+    /* copy first value row from input rowsource */
+    if(row) {
+      for(i = 0; i < con->input_values_count; i++)
+        group->input_values[i] = rasqal_new_literal_from_literal(row->values[i]);
+    }
+  }
+
+  group->agg_user_data = RASQAL_CALLOC(void**,
+                                       RASQAL_GOOD_CAST(size_t, con->expr_count),
+                                       sizeof(void*));
+  if(!group->agg_user_data)
+    goto failed;
+
+  for(i = 0; i < con->expr_count; i++) {
+    group->agg_user_data[i] = rasqal_builtin_agg_expression_execute_init(rowsource->world,
+                                                                         con->expr_data[i].expr);
+    if(!group->agg_user_data[i])
+      goto failed;
+  }
+
+  /* after this, group is owned by con->groups */
+  if(raptor_avltree_add(con->groups, group) < 0)
+    return NULL;
+
+  return group;
+
+  failed:
+  rasqal_free_aggregation_group(group);
+  return NULL;
+}
+
+
+/*
+ * rasqal_aggregation_rowsource_stream_process:
+ * @rowsource: aggregation rowsource
+ * @con: aggregation rowsource context
+ *
+ * INTERNAL - Group and aggregate all input rows in one pass
+ *
+ * Each input row is stepped into the aggregate state of its group and
+ * then freed so only one row per group (the copied through values) is
+ * kept rather than the whole input.
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_aggregation_rowsource_stream_process(rasqal_rowsource* rowsource,
+                                            rasqal_aggregation_rowsource_context* con)
+{
+  if(con->processed)
+    return 0;
+
+  con->processed = 1;
+
+  con->groups = raptor_new_avltree(rasqal_aggregation_group_compare,
+                                   (raptor_data_free_handler)rasqal_free_aggregation_group,
+                                   /* flags */ 0);
+  if(!con->groups)
+    return 1;
+
+  while(1) {
+    rasqal_row* row;
+    raptor_sequence* literal_seq;
+    rasqal_aggregation_group* group;
+    int error = 0;
+    int i;
+
+    row = rasqal_rowsource_read_row(con->rowsource);
+    if(!row)
+      break;
+
+    /* Bind the values in the input row to the variables in the table */
+    rasqal_row_bind_variables(row, rowsource->query->vars_table);
+
+    literal_seq = rasqal_expression_sequence_evaluate(rowsource->query,
+                                                      con->group_exprs_seq,
+                                                      /* ignore_errors */ 0,
+                                                      /* error_p */ NULL);
+    if(!literal_seq) {
+      /* row is not in any group, as for rasqal_groupby_rowsource_process() */
+      rasqal_free_row(row);
+      continue;
+    }
+
+    group = rasqal_aggregation_rowsource_get_group(rowsource, con, literal_seq,
+                                                   row);
+    if(!group) {
+      rasqal_free_row(row);
+      return 1;
+    }
+
+    for(i = 0; i < con->expr_count; i++) {
+      rasqal_agg_expr_data* expr_data = &con->expr_data[i];
+      raptor_sequence* seq;
+
+      /* SPARQL Aggregation uses ListEvalE() to evaluate - ignoring
+       * errors and filtering out expressions that fail
+       */
+      seq = rasqal_expression_sequence_evaluate(rowsource->query,
+                                                expr_data->exprs_seq,
+                                                /* ignore_errors */ 1,
+                                                &error);
+      if(error) {
+        error = 0;
+        continue;
+      }
+
+      if(rasqal_builtin_agg_expression_execute_step(group->agg_user_data[i],
+                                                    seq)) {
+        RASQAL_DEBUG2("Aggregation expr %d returned error\n", i);
+      }
+
+      raptor_free_sequence(seq);
+    }
+
+    rasqal_free_row(row);
+  }
+
+  /* no input rows gives one group with an empty key */
+  if(!raptor_avltree_size(con->groups)) {
+    if(!rasqal_aggregation_rowsource_get_group(rowsource, con, NULL, NULL))
+      return 1;
+  }
+
+#ifdef RASQAL_DEBUG
+  RASQAL_DEBUG2("Aggregation found %d groups\n",
+                raptor_avltree_size(con->groups));
+#endif
+
+  /* groups are returned in key order */
+  con->groups_iterator = raptor_new_avltree_iterator(con->groups, NULL, NULL,
+                                                     1);
+  if(!con->groups_iterator)
+    return 1;
+
+  return 0;
+}
+
+
+static rasqal_row*
+rasqal_aggregation_rowsource_stream_read_row(rasqal_rowsource* rowsource,
+                                             void *user_data)
+{
+  rasqal_aggregation_rowsource_context* con;
+  rasqal_aggregation_group* group;
+  rasqal_row* row;
+  int offset = 0;
+  int i;
+
+  con = (rasqal_aggregation_rowsource_context*)user_data;
+
+  if(con->finished)
+    return NULL;
+
+  group = NULL;
+  if(!rasqal_aggregation_rowsource_stream_process(rowsource, con))
+    group = (rasqal_aggregation_group*)raptor_avltree_iterator_get(con->groups_iterator);
+
+  if(!group) {
+    con->finished = 1;
+    rasqal_aggregation_rowsource_free_groups(con);
+    return NULL;
+  }
+
+  row = rasqal_new_row(rowsource);
+  if(!row)
+    goto tidy;
+
+  /* Copy scalar results through */
+  for(i = 0; i < con->input_values_count; i++) {
+    rasqal_row_set_value_at(row, offset,
+                            group->input_values ? group->input_values[i] : NULL);
+    offset++;
+  }
+
+  /* Set aggregate results */
+  for(i = 0; i < con->expr_count; i++) {
+    rasqal_literal* result;
+    rasqal_variable* v;
+
+    result = rasqal_builtin_agg_expression_execute_result(group->agg_user_data[i]);
+
+#ifdef RASQAL_DEBUG
+    RASQAL_DEBUG2("Aggregation %d ending group with result: ", i);
+    rasqal_literal_print(result, DEBUG_FH);
+    fputc('\n', DEBUG_FH);
+#endif
+
+    v = rasqal_rowsource_get_variable_by_offset(rowsource, offset);
+    result = rasqal_new_literal_from_literal(result);
+    /* it is OK to bind to NULL */
+    rasqal_variable_set_value(v, result);
+
+    rasqal_row_set_value_at(row, offset, result);
+
+    if(result)
+      rasqal_free_literal(result);
+
+    offset++;
+  }
+
+  row->offset = con->offset++;
+
+  tidy:
+  /* the group state is no longer needed */
+  rasqal_aggregation_group_clear(group);
+  raptor_avltree_iterator_next(con->groups_iterator);
+
+  return row;
+}
+
+
 static int
 rasqal_aggregation_rowsource_init(rasqal_rowsource* rowsource, void *user_data)
 {
@@ -422,7 +820,9 @@ rasqal_aggregation_rowsource_init(rasqal_rowsource* rowsource, void *user_data)
   con->offset = 0;
   con->step_count = 0;
   
-  if(rasqal_rowsource_request_grouping(con->rowsource))
+  /* when aggregating in one pass, the input is grouped here */
+  if(!con->group_exprs_seq &&
+     rasqal_rowsource_request_grouping(con->rowsource))
     return 1;
   
   return 0;
@@ -474,6 +874,11 @@ rasqal_aggregation_rowsource_finish(rasqal_rowsource* rowsource,
   if(con->input_values)
     raptor_free_sequence(con->input_values);
 
+  rasqal_aggregation_rowsource_free_groups(con);
+
+  if(con->group_exprs_seq)
+    raptor_free_sequence(con->group_exprs_seq);
+
   RASQAL_FREE(rasqal_aggregation_rowsource_context, con);
 
   return 0;
@@ -789,6 +1194,30 @@ static const rasqal_rowsource_handler rasqal_aggregation_rowsource_handler = {
 };
 
 
+static const rasqal_rowsource_handler rasqal_streaming_aggregation_rowsource_handler = {
+  /* .version = */ 1,
+  "streaming aggregation",
+  /* .init = */ rasqal_aggregation_rowsource_init,
+  /* .finish = */ rasqal_aggregation_rowsource_finish,
+  /* .ensure_variables = */ rasqal_aggregation_rowsource_ensure_variables,
+  /* .read_row = */ rasqal_aggregation_rowsource_stream_read_row,
+  /* .read_all_rows = */ NULL,
+  /* .reset = */ NULL,
+  /* .set_requirements = */ NULL,
+  /* .get_inner_rowsource = */ rasqal_aggregation_rowsource_get_inner_rowsource,
+  /* .set_origin = */ NULL,
+};
+
+
+static rasqal_rowsource*
+rasqal_new_aggregation_rowsource_common(rasqal_world *world,
+                                        rasqal_query* query,
+                                        rasqal_rowsource* rowsource,
+                                        raptor_sequence* group_exprs_seq,
+                                        raptor_sequence* exprs_seq,
+                                        raptor_sequence* vars_seq);
+
+
 /**
  * rasqal_new_aggregation_rowsource:
  * @world: world
@@ -828,6 +1257,111 @@ rasqal_new_aggregation_rowsource(rasqal_world *world, rasqal_query* query,
                                  rasqal_rowsource* rowsource,
                                  raptor_sequence* exprs_seq,
                                  raptor_sequence* vars_seq)
+{
+  return rasqal_new_aggregation_rowsource_common(world, query, rowsource,
+                                                 NULL, exprs_seq, vars_seq);
+}
+
+
+/**
+ * rasqal_aggregation_expressions_can_stream:
+ * @exprs_seq: sequence of aggregate #rasqal_expression
+ *
+ * INTERNAL - Check if aggregate expressions can be computed in one pass
+ *
+ * The built-in aggregates can be stepped one row at a time into a
+ * fixed size state.  DISTINCT aggregates need the set of values seen
+ * in the group and extension aggregate functions are left to the
+ * grouped path.
+ *
+ * Return value: non-0 if rasqal_new_streaming_aggregation_rowsource() can be used
+ */
+int
+rasqal_aggregation_expressions_can_stream(raptor_sequence* exprs_seq)
+{
+  rasqal_expression* expr;
+  int i;
+
+  if(!exprs_seq)
+    return 0;
+
+  for(i = 0; (expr = (rasqal_expression*)raptor_sequence_get_at(exprs_seq, i)); i++) {
+    if(expr->flags & RASQAL_EXPR_FLAG_DISTINCT)
+      return 0;
+
+    switch(expr->op) {
+      case RASQAL_EXPR_COUNT:
+      case RASQAL_EXPR_SUM:
+      case RASQAL_EXPR_AVG:
+      case RASQAL_EXPR_MIN:
+      case RASQAL_EXPR_MAX:
+      case RASQAL_EXPR_SAMPLE:
+      case RASQAL_EXPR_GROUP_CONCAT:
+        break;
+
+      default:
+        return 0;
+    }
+  }
+
+  return 1;
+}
+
+
+/**
+ * rasqal_new_streaming_aggregation_rowsource:
+ * @world: world
+ * @query: query
+ * @rowsource: input (ungrouped) rowsource
+ * @group_exprs_seq: sequence of GROUP BY #rasqal_expression
+ * @exprs_seq: sequence of #rasqal_expression
+ * @vars_seq: sequence of #rasqal_variable to bind in output rows
+ *
+ * INTERNAL - Create a new rowsource that groups and aggregates in one pass
+ *
+ * Equivalent to a rasqal_new_aggregation_rowsource() over a
+ * rasqal_new_groupby_rowsource() but input rows are stepped into
+ * per-group aggregate state as they are read, rather than all being
+ * stored until the input ends.  The groups are kept in a tree on the
+ * group key compared as the groupby rowsource does, so rows are
+ * grouped and the groups returned in the same order.
+ *
+ * The aggregate expressions must pass
+ * rasqal_aggregation_expressions_can_stream().
+ *
+ * The @rowsource becomes owned by the new rowsource.  The
+ * @group_exprs_seq, @exprs_seq and @vars_seq are not.
+ *
+ * Return value: new rowsource or NULL on failure
+ */
+rasqal_rowsource*
+rasqal_new_streaming_aggregation_rowsource(rasqal_world *world,
+                                           rasqal_query* query,
+                                           rasqal_rowsource* rowsource,
+                                           raptor_sequence* group_exprs_seq,
+                                           raptor_sequence* exprs_seq,
+                                           raptor_sequence* vars_seq)
+{
+  if(!group_exprs_seq || !raptor_sequence_size(group_exprs_seq) ||
+     !rasqal_aggregation_expressions_can_stream(exprs_seq)) {
+    if(rowsource)
+      rasqal_free_rowsource(rowsource);
+    return NULL;
+  }
+
+  return rasqal_new_aggregation_rowsource_common(world, query, rowsource,
+                                                 group_exprs_seq,
+                                                 exprs_seq, vars_seq);
+}
+
+
+static rasqal_rowsource*
+rasqal_new_aggregation_rowsource_common(rasqal_world *world,
+                                        rasqal_query* query,
+                                        rasqal_rowsource* rowsource,
+                                        raptor_sequence* group_exprs_seq,
+                                        raptor_sequence* exprs_seq,
+                                        raptor_sequence* vars_seq)
 {
   rasqal_aggregation_rowsource_context* con = NULL;
   int flags = 0;
@@ -853,8 +1387,17 @@ rasqal_new_aggregation_rowsource(rasqal_world *world, rasqal_query* query,
 
   con->rowsource = rowsource;
 
+  /* as rasqal_groupby_rowsource_init() */
+  con->compare_flags = RASQAL_COMPARE_URI;
+
   con->exprs_seq = exprs_seq;
   con->vars_seq = vars_seq;
+
+  if(group_exprs_seq) {
+    con->group_exprs_seq = rasqal_expression_copy_expression_sequence(group_exprs_seq);
+    if(!con->group_exprs_seq)
+      goto fail;
+  }
   
   /* allocate per-expr data */
   con->expr_count = size;
@@ -891,7 +1434,9 @@ rasqal_new_aggregation_rowsource(rasqal_world *world, rasqal_query* query,
   
   return rasqal_new_rowsource_from_handler(world, query,
                                            con,
-                                           &rasqal_aggregation_rowsource_handler,
+                                           (con->group_exprs_seq ?
+                                            &rasqal_streaming_aggregation_rowsource_handler :
+                                            &rasqal_aggregation_rowsource_handler),
                                            query->vars_table,
                                            flags);
 
@@ -957,6 +1502,9 @@ static const int test4_output_rows[] =
 /* GROUP_CONCAT(?z) GROUP BY ?x result */
 static const char* const test5_output_rows[] =
 { "3 4", "6", };
+/* COUNT(?v) GROUP BY ?k result for numeric_group_keys */
+static const int test_numeric_group_counts[] =
+{ 3, 2, };
 
 
 /* Input Group IDs expected */
@@ -1070,6 +1618,317 @@ make_test_expr(rasqal_world* world,
 }
 
 
+/* Group keys equal as values but different as RDF terms */
+typedef struct {
+  rasqal_literal_type type;
+  const char* lexical;
+  const char* language;
+} group_key_data;
+
+static const group_key_data numeric_group_keys[] = {
+  { RASQAL_LITERAL_INTEGER, "2",   NULL },
+  { RASQAL_LITERAL_DECIMAL, "1.0", NULL },
+  { RASQAL_LITERAL_INTEGER, "01",  NULL },
+  { RASQAL_LITERAL_INTEGER, "1",   NULL },
+  { RASQAL_LITERAL_INTEGER, "2",   NULL },
+  { RASQAL_LITERAL_UNKNOWN, NULL,  NULL }
+};
+
+static const group_key_data string_group_keys[] = {
+  { RASQAL_LITERAL_STRING,  "b",   NULL },
+  { RASQAL_LITERAL_STRING,  "a",   "en" },
+  { RASQAL_LITERAL_STRING,  "a",   NULL },
+  { RASQAL_LITERAL_STRING,  "b",   NULL },
+  { RASQAL_LITERAL_STRING,  "a",   "en" },
+  { RASQAL_LITERAL_UNKNOWN, NULL,  NULL }
+};
+
+static const struct {
+  const group_key_data* keys;
+  /* COUNT(?v) of each group in output order or NULL to only compare
+   * with the GROUP BY rowsource */
+  const int* counts;
+  int counts_count;
+} group_key_tests[] = {
+  /* 1, 1.0 and "01"^^xsd:integer are one group, ordered before 2 */
+  { numeric_group_keys, test_numeric_group_counts, 2 },
+  { string_group_keys,  NULL,                      0 },
+  { NULL,               NULL,                      0 }
+};
+
+
+static rasqal_literal*
+make_group_key_literal(rasqal_world* world, const group_key_data* key)
+{
+  size_t len;
+  unsigned char* lexical;
+  char* language = NULL;
+
+  if(key->type != RASQAL_LITERAL_STRING)
+    return rasqal_new_typed_literal(world, key->type,
+                                    RASQAL_GOOD_CAST(const unsigned char*, key->lexical));
+
+  len = strlen(key->lexical);
+  lexical = RASQAL_MALLOC(unsigned char*, len + 1);
+  if(!lexical)
+    return NULL;
+  memcpy(lexical, key->lexical, len + 1);
+
+  if(key->language) {
+    len = strlen(key->language);
+    language = RASQAL_MALLOC(char*, len + 1);
+    if(!language) {
+      RASQAL_FREE(char*, lexical);
+      return NULL;
+    }
+    memcpy(language, key->language, len + 1);
+  }
+
+  return rasqal_new_string_literal(world, lexical, language, NULL, NULL);
+}
+
+
+static rasqal_expression*
+make_variable_expression(rasqal_world* world, rasqal_variable* v)
+{
+  rasqal_literal* l;
+
+  l = rasqal_new_variable_literal(world, rasqal_new_variable_from_variable(v));
+  if(!l)
+    return NULL;
+
+  return rasqal_new_literal_expression(world, l);
+}
+
+
+/*
+ * Return the rows of SELECT ?k (COUNT(?v) AS ?count) ... GROUP BY ?k
+ * over rows (?k, 1) made from @keys, either with the GROUP BY
+ * rowsource then aggregation or with streaming aggregation.
+ */
+static raptor_sequence*
+group_key_aggregate(rasqal_world* world, rasqal_query* query,
+                    const group_key_data* keys, int streaming)
+{
+  rasqal_variables_table* vt = query->vars_table;
+  rasqal_variable* k_var;
+  rasqal_variable* v_var;
+  rasqal_variable* count_var = NULL;
+  raptor_sequence* row_seq = NULL;
+  raptor_sequence* vars_seq = NULL;
+  raptor_sequence* group_exprs_seq = NULL;
+  raptor_sequence* exprs_seq = NULL;
+  rasqal_rowsource* input_rs = NULL;
+  rasqal_rowsource* rowsource = NULL;
+  rasqal_expression* e;
+  raptor_sequence* seq = NULL;
+  int i;
+
+  k_var = rasqal_variables_table_add2(vt, RASQAL_VARIABLE_TYPE_NORMAL,
+                                      RASQAL_GOOD_CAST(const unsigned char*, "k"),
+                                      1, NULL);
+  v_var = rasqal_variables_table_add2(vt, RASQAL_VARIABLE_TYPE_NORMAL,
+                                      RASQAL_GOOD_CAST(const unsigned char*, "v"),
+                                      1, NULL);
+  count_var = rasqal_variables_table_add2(vt, RASQAL_VARIABLE_TYPE_ANONYMOUS,
+                                          RASQAL_GOOD_CAST(const unsigned char*, "count"),
+                                          5, NULL);
+  row_seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_row,
+                                (raptor_data_print_handler)rasqal_row_print);
+  vars_seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_variable,
+                                 (raptor_data_print_handler)rasqal_variable_print);
+  if(!k_var || !v_var || !count_var || !row_seq || !vars_seq) {
+    if(k_var)
+      rasqal_free_variable(k_var);
+    if(v_var)
+      rasqal_free_variable(v_var);
+    goto tidy;
+  }
+  /* k_var and v_var are now owned by vars_seq */
+  raptor_sequence_push(vars_seq, k_var);
+  raptor_sequence_push(vars_seq, v_var);
+
+  for(i = 0; keys[i].lexical; i++) {
+    rasqal_row* row = rasqal_new_row_for_size(world, 2);
+
+    if(!row)
+      goto tidy;
+    raptor_sequence_push(row_seq, row);
+    row->offset = i;
+    row->values[0] = make_group_key_literal(world, &keys[i]);
+    row->values[1] = rasqal_new_integer_literal(world, RASQAL_LITERAL_INTEGER,
+                                                1);
+    if(!row->values[0] || !row->values[1])
+      goto tidy;
+  }
+
+  input_rs = rasqal_new_rowsequence_rowsource(world, query, vt,
+                                              row_seq, vars_seq);
+  /* vars_seq and row_seq are now owned by input_rs */
+  vars_seq = row_seq = NULL;
+  if(!input_rs)
+    goto tidy;
+
+  group_exprs_seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_expression,
+                                        (raptor_data_print_handler)rasqal_expression_print);
+  exprs_seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_expression,
+                                  (raptor_data_print_handler)rasqal_expression_print);
+  vars_seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_variable,
+                                 (raptor_data_print_handler)rasqal_variable_print);
+  if(!group_exprs_seq || !exprs_seq || !vars_seq)
+    goto tidy;
+
+  e = make_variable_expression(world, k_var);
+  if(!e)
+    goto tidy;
+  raptor_sequence_push(group_exprs_seq, e);
+
+  e = make_variable_expression(world, v_var);
+  if(e)
+    e = rasqal_new_aggregate_function_expression(world, RASQAL_EXPR_COUNT, e,
+                                                 /* params */ NULL,
+                                                 /* flags */ 0);
+  if(!e)
+    goto tidy;
+  raptor_sequence_push(exprs_seq, e);
+  raptor_sequence_push(vars_seq, count_var);
+  /* count_var is now owned by vars_seq */
+  count_var = NULL;
+
+  if(streaming) {
+    rowsource = rasqal_new_streaming_aggregation_rowsource(world, query,
+                                                           input_rs,
+                                                           group_exprs_seq,
+                                                           exprs_seq, vars_seq);
+    /* input_rs is now owned by rowsource */
+    input_rs = NULL;
+    raptor_free_sequence(group_exprs_seq);
+  } else {
+    rasqal_rowsource* groupby_rs;
+
+    groupby_rs = rasqal_new_groupby_rowsource(world, query, input_rs,
+                                              group_exprs_seq);
+    /* input_rs and group_exprs_seq are now owned by groupby_rs */
+    input_rs = NULL;
+    if(groupby_rs)
+      rowsource = rasqal_new_aggregation_rowsource(world, query, groupby_rs,
+                                                   exprs_seq, vars_seq);
+  }
+  group_exprs_seq = NULL;
+  /* agg rowsource made copies */
+  raptor_free_sequence(exprs_seq); exprs_seq = NULL;
+  raptor_free_sequence(vars_seq); vars_seq = NULL;
+
+  if(rowsource)
+    seq = rasqal_rowsource_read_all_rows(rowsource);
+
+  tidy:
+  if(count_var)
+    rasqal_free_variable(count_var);
+  if(rowsource)
+    rasqal_free_rowsource(rowsource);
+  if(input_rs)
+    rasqal_free_rowsource(input_rs);
+  if(group_exprs_seq)
+    raptor_free_sequence(group_exprs_seq);
+  if(exprs_seq)
+    raptor_free_sequence(exprs_seq);
+  if(vars_seq)
+    raptor_free_sequence(vars_seq);
+  if(row_seq)
+    raptor_free_sequence(row_seq);
+
+  return seq;
+}
+
+
+/* Return the number of failures grouping keys that compare equal */
+static int
+test_group_keys(const char* program, rasqal_world* world, rasqal_query* query)
+{
+  int failures = 0;
+  int test_id;
+
+  for(test_id = 0; group_key_tests[test_id].keys; test_id++) {
+    const int* counts = group_key_tests[test_id].counts;
+    raptor_sequence* groupby_seq;
+    raptor_sequence* streaming_seq;
+    int count;
+    int i;
+
+    groupby_seq = group_key_aggregate(world, query,
+                                      group_key_tests[test_id].keys, 0);
+    streaming_seq = group_key_aggregate(world, query,
+                                        group_key_tests[test_id].keys, 1);
+    if(!groupby_seq || !streaming_seq) {
+      fprintf(stderr, "%s: group key test %d failed to aggregate\n",
+              program, test_id);
+      failures++;
+      goto next;
+    }
+
+    count = raptor_sequence_size(groupby_seq);
+    if(counts && count != group_key_tests[test_id].counts_count) {
+      fprintf(stderr,
+              "%s: group key test %d GROUP BY returned %d groups, expected %d\n",
+              program, test_id, count, group_key_tests[test_id].counts_count);
+      failures++;
+      goto next;
+    }
+    if(raptor_sequence_size(streaming_seq) != count) {
+      fprintf(stderr,
+              "%s: group key test %d streaming aggregation returned %d groups, expected %d\n",
+              program, test_id, raptor_sequence_size(streaming_seq), count);
+      failures++;
+      goto next;
+    }
+
+    /* Rows are ?k ?v ?count with ?k ?v from the first row of a group */
+    for(i = 0; i < count; i++) {
+      rasqal_row* groupby_row;
+      rasqal_row* streaming_row;
+      int groupby_count;
+      int streaming_count;
+
+      groupby_row = (rasqal_row*)raptor_sequence_get_at(groupby_seq, i);
+      streaming_row = (rasqal_row*)raptor_sequence_get_at(streaming_seq, i);
+
+      if(!rasqal_literal_same_term(groupby_row->values[0],
+                                   streaming_row->values[0])) {
+        fprintf(stderr,
+                "%s: group key test %d group #%d streaming aggregation key is %s expected %s\n",
+                program, test_id, i,
+                rasqal_literal_as_string(streaming_row->values[0]),
+                rasqal_literal_as_string(groupby_row->values[0]));
+        failures++;
+        break;
+      }
+
+      groupby_count = rasqal_literal_as_integer(groupby_row->values[2], NULL);
+      streaming_count = rasqal_literal_as_integer(streaming_row->values[2],
+                                                  NULL);
+      if(streaming_count != groupby_count ||
+         (counts && groupby_count != counts[i])) {
+        fprintf(stderr,
+                "%s: group key test %d group #%d counts are %d and %d expected %d\n",
+                program, test_id, i, groupby_count, streaming_count,
+                counts ? counts[i] : groupby_count);
+        failures++;
+        break;
+      }
+    }
+
+    next:
+    if(groupby_seq)
+      raptor_free_sequence(groupby_seq);
+    if(streaming_seq)
+      raptor_free_sequence(streaming_seq);
+  }
+
+  return failures;
+}
+
+
 int
 main(int argc, char *argv[]) 
 {
@@ -1084,7 +1943,9 @@ main(int argc, char *argv[])
   rasqal_rowsource *input_rs = NULL;
   raptor_sequence* vars_seq = NULL;
   raptor_sequence* exprs_seq = NULL;
+  raptor_sequence* group_exprs_seq = NULL;
   int test_id;
+  int run;
 
   world = rasqal_new_world();
   if(!world || rasqal_world_open(world)) {
@@ -1096,7 +1957,11 @@ main(int argc, char *argv[])
 
   vt = query->vars_table;
   
-  for(test_id = 0; test_id < AGGREGATION_TESTS_COUNT; test_id++) {
+  /* Run each test over the grouped input and then with streaming
+   * aggregation doing the GROUP BY ?x */
+  for(run = 0, test_id = 0; run < (AGGREGATION_TESTS_COUNT * 2);
+      run++, test_id = run % AGGREGATION_TESTS_COUNT) {
+    int streaming_group = (run >= AGGREGATION_TESTS_COUNT);
     int input_vars_count = test_data[test_id].input_vars;
     int output_rows_count = test_data[test_id].output_rows;
     int output_vars_count = test_data[test_id].output_vars;
@@ -1200,8 +2065,37 @@ main(int argc, char *argv[])
     /* output_var is now owned by vars_seq */
     output_var = NULL;
 
-    rowsource = rasqal_new_aggregation_rowsource(world, query, input_rs,
-                                                 exprs_seq, vars_seq);
+    if(streaming_group) {
+      rasqal_variable* v;
+      rasqal_literal *l = NULL;
+      rasqal_expression* e = NULL;
+
+      group_exprs_seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_expression,
+                                            (raptor_data_print_handler)rasqal_expression_print);
+
+      v = rasqal_variables_table_get_by_name(vt, RASQAL_VARIABLE_TYPE_NORMAL,
+                                             RASQAL_GOOD_CAST(const unsigned char*, "x"));
+      if(v) {
+        v = rasqal_new_variable_from_variable(v);
+        l = rasqal_new_variable_literal(world, v);
+      }
+      if(l)
+        e = rasqal_new_literal_expression(world, l);
+      if(!group_exprs_seq || !e) {
+        fprintf(stderr, "%s: failed to create GROUP BY ?x expression\n",
+                program);
+        failures++;
+        goto tidy;
+      }
+      raptor_sequence_push(group_exprs_seq, e);
+
+      rowsource = rasqal_new_streaming_aggregation_rowsource(world, query, input_rs,
+                                                             group_exprs_seq,
+                                                             exprs_seq, vars_seq);
+      raptor_free_sequence(group_exprs_seq); group_exprs_seq = NULL;
+    } else
+      rowsource = rasqal_new_aggregation_rowsource(world, query, input_rs,
+                                                   exprs_seq, vars_seq);
     /* input_rs is now owned by rowsource */
     input_rs = NULL;
     /* these are no longer needed; agg rowsource made copies */
@@ -1390,6 +2284,8 @@ main(int argc, char *argv[])
       raptor_free_sequence(expr_args_seq);
     expr_args_seq = NULL;
   }
+
+  failures += test_group_keys(program, world, query);
   
   
   tidy:
@@ -1397,6 +2293,8 @@ main(int argc, char *argv[])
     raptor_free_sequence(exprs_seq);
   if(vars_seq)
     raptor_free_sequence(vars_seq);
+  if(group_exprs_seq)
+    raptor_free_sequence(group_exprs_seq);
   if(expr_args_seq)
     raptor_free_sequence(expr_args_seq);
   if(rowsource)
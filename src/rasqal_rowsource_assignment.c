@@ -52,6 +52,9 @@ typedef struct
   /* assignment expression */
   rasqal_expression *expr;
 
+  /* compiled assignment expression or NULL to interpret expr */
+  rasqal_expression_program* program;
+
   /* offset into results for current row */
   int offset;
   
@@ -61,6 +64,11 @@ typedef struct
 static int
 rasqal_assignment_rowsource_init(rasqal_rowsource* rowsource, void *user_data)
 {
+  rasqal_assignment_rowsource_context *con;
+  con = (rasqal_assignment_rowsource_context*)user_data;
+
+  con->program = rasqal_new_expression_program(rowsource->world, con->expr);
+
   return 0;
 }
 
@@ -85,6 +93,9 @@ rasqal_assignment_rowsource_finish(rasqal_rowsource* rowsource, void *user_data)
   rasqal_assignment_rowsource_context *con;
   con = (rasqal_assignment_rowsource_context*)user_data;
 
+  if(con->program)
+    rasqal_free_expression_program(con->program);
+
   if(con->expr)
     rasqal_free_expression(con->expr);
 
@@ -109,8 +120,12 @@ rasqal_assignment_rowsource_read_row(rasqal_rowsource* rowsource, void *user_dat
     return NULL;
   
   RASQAL_DEBUG1("evaluating assignment expression\n");
-  result = rasqal_expression_evaluate2(con->expr, query->eval_context,
-                                       &error);
+  if(con->program)
+    result = rasqal_expression_program_evaluate(con->program,
+                                                query->eval_context, &error);
+  else
+    result = rasqal_expression_evaluate2(con->expr, query->eval_context,
+                                         &error);
 #ifdef RASQAL_DEBUG
   RASQAL_DEBUG2("assignment %s expression result: ", con->var->name);
   if(error)
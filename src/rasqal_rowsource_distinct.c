@@ -43,14 +43,24 @@
 
 #define DEBUG_FH stderr
 
+#ifndef STANDALONE
 
 typedef struct 
 {
   /* inner rowsource to distinct */
   rasqal_rowsource *rowsource;
 
-  /* map for distincting row values */
-  rasqal_map* map;
+  /* hash set of the distinct rows returned so far: the rows (shared
+   * with the returned rows), their hashes and hash chains */
+  rasqal_row** rows;
+  unsigned int* hashes;
+  int* next;
+  int rows_count;
+  int rows_size;
+
+  /* hash table of chain heads (index into rows or -1) */
+  int* buckets;
+  unsigned int buckets_mask;
 
   /* offset into results for current row */
   int offset;
@@ -58,19 +68,190 @@ typedef struct
 } rasqal_distinct_rowsource_context;
 
 
+static void
+rasqal_distinct_rowsource_free_set(rasqal_distinct_rowsource_context *con)
+{
+  int i;
+
+  if(con->rows) {
+    for(i = 0; i < con->rows_count; i++)
+      rasqal_free_row(con->rows[i]);
+    RASQAL_FREE(rasqal_row**, con->rows);
+    con->rows = NULL;
+  }
+  con->rows_count = 0;
+  con->rows_size = 0;
+
+  if(con->hashes) {
+    RASQAL_FREE(intarray, con->hashes);
+    con->hashes = NULL;
+  }
+
+  if(con->next) {
+    RASQAL_FREE(intarray, con->next);
+    con->next = NULL;
+  }
+
+  if(con->buckets) {
+    RASQAL_FREE(intarray, con->buckets);
+    con->buckets = NULL;
+  }
+  con->buckets_mask = 0;
+}
+
+
 static int
 rasqal_distinct_rowsource_init_common(rasqal_rowsource* rowsource, void *user_data)
 {
-  rasqal_query *query = rowsource->query;
   rasqal_distinct_rowsource_context *con;
 
   con = (rasqal_distinct_rowsource_context*)user_data;
   
   con->offset = 0;
 
-  con->map = rasqal_engine_new_rowsort_map(1, query->compare_flags, NULL);
-  if(!con->map)
+  return 0;
+}
+
+
+/*
+ * rasqal_distinct_row_hash:
+ * @row: row
+ *
+ * INTERNAL - Hash the values of a row by RDF term identity
+ *
+ * Rows that rasqal_literal_array_equals() finds equal have the same
+ * hash.
+ *
+ * Return value: hash
+ */
+static unsigned int
+rasqal_distinct_row_hash(rasqal_row* row)
+{
+  unsigned int hash = RASQAL_LITERAL_HASH_INIT;
+  int i;
+
+  for(i = 0; i < row->size; i++)
+    hash = rasqal_literal_rdf_term_hash(row->values[i], hash);
+
+  return hash;
+}
+
+
+/*
+ * rasqal_distinct_rowsource_grow:
+ * @con: distinct rowsource context
+ *
+ * INTERNAL - Double the size of the hash set and rehash the rows
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_distinct_rowsource_grow(rasqal_distinct_rowsource_context *con)
+{
+  int new_size = con->rows_size ? (con->rows_size << 1) : 64;
+  size_t size = RASQAL_GOOD_CAST(size_t, new_size);
+  rasqal_row** rows;
+  unsigned int* hashes;
+  int* next;
+  int* buckets;
+  int i;
+
+  rows = RASQAL_CALLOC(rasqal_row**, size, sizeof(rasqal_row*));
+  hashes = RASQAL_CALLOC(unsigned int*, size, sizeof(unsigned int));
+  next = RASQAL_CALLOC(int*, size, sizeof(int));
+  /* as many buckets as rows */
+  buckets = RASQAL_MALLOC(int*, size * sizeof(int));
+  if(!rows || !hashes || !next || !buckets) {
+    if(rows)
+      RASQAL_FREE(rasqal_row**, rows);
+    if(hashes)
+      RASQAL_FREE(intarray, hashes);
+    if(next)
+      RASQAL_FREE(intarray, next);
+    if(buckets)
+      RASQAL_FREE(intarray, buckets);
     return 1;
+  }
+
+  if(con->rows_count) {
+    size_t count = RASQAL_GOOD_CAST(size_t, con->rows_count);
+
+    memcpy(rows, con->rows, count * sizeof(rasqal_row*));
+    memcpy(hashes, con->hashes, count * sizeof(unsigned int));
+  }
+
+  if(con->rows)
+    RASQAL_FREE(rasqal_row**, con->rows);
+  if(con->hashes)
+    RASQAL_FREE(intarray, con->hashes);
+  if(con->next)
+    RASQAL_FREE(intarray, con->next);
+  if(con->buckets)
+    RASQAL_FREE(intarray, con->buckets);
+
+  con->rows = rows;
+  con->hashes = hashes;
+  con->next = next;
+  con->buckets = buckets;
+  con->rows_size = new_size;
+  con->buckets_mask = RASQAL_GOOD_CAST(unsigned int, new_size - 1);
+
+  for(i = 0; i < new_size; i++)
+    con->buckets[i] = -1;
+
+  for(i = 0; i < con->rows_count; i++) {
+    unsigned int bucket = con->hashes[i] & con->buckets_mask;
+
+    con->next[i] = con->buckets[bucket];
+    con->buckets[bucket] = i;
+  }
+
+  return 0;
+}
+
+
+/*
+ * rasqal_distinct_rowsource_add_row:
+ * @con: distinct rowsource context
+ * @row: row
+ *
+ * INTERNAL - Add a row to the set of distinct rows if it is not there
+ *
+ * The set keeps a reference to @row if it is added.
+ *
+ * Return value: 0 if added, 1 if a duplicate, <0 on failure
+ */
+static int
+rasqal_distinct_rowsource_add_row(rasqal_distinct_rowsource_context *con,
+                                  rasqal_row* row)
+{
+  unsigned int hash;
+  unsigned int bucket;
+  int i;
+
+  hash = rasqal_distinct_row_hash(row);
+
+  if(con->buckets) {
+    for(i = con->buckets[hash & con->buckets_mask]; i >= 0; i = con->next[i]) {
+      rasqal_row* seen = con->rows[i];
+
+      if(con->hashes[i] == hash && seen->size == row->size &&
+         rasqal_literal_array_equals(seen->values, row->values, row->size))
+        return 1;
+    }
+  }
+
+  if(con->rows_count == con->rows_size) {
+    if(rasqal_distinct_rowsource_grow(con))
+      return -1;
+  }
+
+  i = con->rows_count++;
+  bucket = hash & con->buckets_mask;
+  con->rows[i] = rasqal_new_row_from_row(row);
+  con->hashes[i] = hash;
+  con->next[i] = con->buckets[bucket];
+  con->buckets[bucket] = i;
 
   return 0;
 }
@@ -115,8 +296,7 @@ rasqal_distinct_rowsource_finish(rasqal_rowsource* rowsource, void *user_data)
   if(con->rowsource)
     rasqal_free_rowsource(con->rowsource);
   
-  if(con->map)
-    rasqal_free_map(con->map);
+  rasqal_distinct_rowsource_free_set(con);
 
   RASQAL_FREE(rasqal_distinct_rowsource_context, con);
 
@@ -139,17 +319,24 @@ rasqal_distinct_rowsource_read_row(rasqal_rowsource* rowsource, void *user_data)
     if(!row)
       break;
 
-    result = rasqal_engine_rowsort_map_add_row(con->map, row);
+    result = rasqal_distinct_rowsource_add_row(con, row);
     RASQAL_DEBUG2("row is %s\n", result ? "not distinct" : "distinct");
 
-    if(!result)
+    if(!result) {
       /* row was distinct (not a duplicate) so return it */
+      rasqal_rowsource_hold_row(rowsource, row);
+      break;
+    }
+
+    rasqal_free_row(row);
+    row = NULL;
+    if(result < 0)
       break;
   }
 
   if(row) {
-    row = rasqal_new_row_from_row_deep(row);
-    rasqal_row_set_rowsource(row, rowsource);
+    /* the row is shared with the set and passed on as the slice
+     * rowsource does, so only change fields the set does not use */
     row->offset = con->offset++;
   }
   
@@ -165,8 +352,7 @@ rasqal_distinct_rowsource_reset(rasqal_rowsource* rowsource, void *user_data)
 
   con = (rasqal_distinct_rowsource_context*)user_data;
 
-  if(con->map)
-    rasqal_free_map(con->map);
+  rasqal_distinct_rowsource_free_set(con);
 
   rc = rasqal_distinct_rowsource_init_common(rowsource, user_data);
   if(rc)
@@ -212,6 +398,10 @@ static const rasqal_rowsource_handler rasqal_distinct_rowsource_handler = {
  *
  * INTERNAL - create a new DISTINCT rowsoruce
  *
+ * Rows are returned as they are read, skipping any row with the same
+ * values as an earlier row.  The rows returned so far are kept in a
+ * hash set keyed on the RDF term identity of their values.
+ *
  * The @rowsource becomes owned by the new rowsource
  *
  * Return value: new rowsource or NULL on failure
@@ -244,3 +434,189 @@ rasqal_new_distinct_rowsource(rasqal_world *world,
     rasqal_free_rowsource(rowsource);
   return NULL;
 }
+
+
+#endif /* not STANDALONE */
+
+
+
+#ifdef STANDALONE
+
+/* one more prototype */
+int main(int argc, char *argv[]);
+
+
+/* 2 duplicate rows, rows that differ only in an unbound value and a
+ * repeated row with both values unbound */
+const char* const distinct_1_data_2x7_rows[] =
+{
+  /* 2 variable names and 7 rows */
+  "a",   NULL, "b",   NULL,
+  /* row 1 data */
+  "foo", NULL, "red", NULL,
+  /* row 2 data */
+  "bar", NULL, "red", NULL,
+  /* row 3 data */
+  "foo", NULL, "red", NULL,
+  /* row 4 data */
+  "foo", NULL, NULL,  NULL,
+  /* row 5 data */
+  NULL,  NULL, NULL,  NULL,
+  /* row 6 data */
+  NULL,  NULL, NULL,  NULL,
+  /* row 7 data */
+  "bar", NULL, "red", NULL,
+  /* end of data */
+  NULL, NULL, NULL, NULL
+};
+
+#define DISTINCT_1_EXPECTED_COUNT 4
+static const int distinct_1_expected_rows[DISTINCT_1_EXPECTED_COUNT] = {
+  0, 1, 3, 4
+};
+
+
+/* enough rows with repeated values to grow the hash set */
+#define DISTINCT_2_ROWS_COUNT 500
+#define DISTINCT_2_VALUES_COUNT 150
+
+
+static int
+check_distinct(const char* program, rasqal_world* world, rasqal_query* query,
+               const char* const data[], int vars_count, int expected_count,
+               raptor_sequence** seq_p)
+{
+  rasqal_rowsource *input_rs;
+  rasqal_rowsource *rowsource;
+  raptor_sequence* seq;
+  int failures = 0;
+  int count;
+
+  input_rs = rasqal_new_row_sequence_rowsource(world, query, data, vars_count);
+  if(!input_rs) {
+    fprintf(stderr, "%s: failed to create rowsequence rowsource\n", program);
+    return 1;
+  }
+
+  rowsource = rasqal_new_distinct_rowsource(world, query, input_rs);
+  /* input_rs is now owned by rowsource */
+  if(!rowsource) {
+    fprintf(stderr, "%s: failed to create distinct rowsource\n", program);
+    return 1;
+  }
+
+  seq = rasqal_rowsource_read_all_rows(rowsource);
+  count = seq ? raptor_sequence_size(seq) : -1;
+  if(count != expected_count) {
+    fprintf(stderr,
+            "%s: read_rows returned %d rows for a distinct rowsource, expected %d\n",
+            program, count, expected_count);
+    failures++;
+    goto tidy;
+  }
+
+#ifdef RASQAL_DEBUG
+  rasqal_rowsource_print_row_sequence(rowsource, seq, DEBUG_FH);
+#endif
+
+  /* A reset must give the same rows again */
+  rasqal_rowsource_reset(rowsource);
+  *seq_p = rasqal_rowsource_read_all_rows(rowsource);
+  count = *seq_p ? raptor_sequence_size(*seq_p) : -1;
+  if(count != expected_count) {
+    fprintf(stderr,
+            "%s: read_rows after reset returned %d rows for a distinct rowsource, expected %d\n",
+            program, count, expected_count);
+    failures++;
+  }
+
+  tidy:
+  if(seq)
+    raptor_free_sequence(seq);
+  rasqal_free_rowsource(rowsource);
+
+  return failures;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+  const char *program = rasqal_basename(argv[0]);
+  rasqal_world* world = NULL;
+  rasqal_query* query = NULL;
+  raptor_sequence* seq = NULL;
+  const char** data = NULL;
+  char* values = NULL;
+  int failures = 0;
+  int i;
+
+  world = rasqal_new_world();
+  if(!world || rasqal_world_open(world)) {
+    fprintf(stderr, "%s: rasqal_world init failed\n", program);
+    return(1);
+  }
+
+  query = rasqal_new_query(world, "sparql", NULL);
+
+  /* Test 1: duplicates including unbound values */
+  failures += check_distinct(program, world, query, distinct_1_data_2x7_rows,
+                             2, DISTINCT_1_EXPECTED_COUNT, &seq);
+  if(failures)
+    goto tidy;
+
+  /* rows are returned in input order */
+  for(i = 0; i < DISTINCT_1_EXPECTED_COUNT; i++) {
+    rasqal_row* row = (rasqal_row*)raptor_sequence_get_at(seq, i);
+    int data_row = distinct_1_expected_rows[i];
+    const char* expected_a = distinct_1_data_2x7_rows[(data_row + 1) * 4];
+    rasqal_literal* a = row->values[0];
+
+    if((!a != !expected_a) ||
+       (a && strcmp(RASQAL_GOOD_CAST(const char*, a->string), expected_a))) {
+      fprintf(stderr, "%s: distinct row #%d has a value %s, expected %s\n",
+              program, i,
+              (a ? RASQAL_GOOD_CAST(const char*, a->string) : "NULL"),
+              (expected_a ? expected_a : "NULL"));
+      failures++;
+      goto tidy;
+    }
+  }
+  raptor_free_sequence(seq); seq = NULL;
+
+  /* Test 2: many rows with repeated values */
+  data = RASQAL_CALLOC(const char**, (DISTINCT_2_ROWS_COUNT + 2) * 2,
+                       sizeof(char*));
+  values = RASQAL_CALLOC(char*, DISTINCT_2_VALUES_COUNT, 4);
+  if(!data || !values) {
+    fprintf(stderr, "%s: failed to create test data\n", program);
+    failures++;
+    goto tidy;
+  }
+
+  for(i = 0; i < DISTINCT_2_VALUES_COUNT; i++)
+    sprintf(&values[i * 4], "%d", i);
+
+  data[0] = "x";
+  for(i = 0; i < DISTINCT_2_ROWS_COUNT; i++)
+    data[(i + 1) * 2] = &values[((i * 7) % DISTINCT_2_VALUES_COUNT) * 4];
+
+  failures += check_distinct(program, world, query, data, 1,
+                             DISTINCT_2_VALUES_COUNT, &seq);
+
+  tidy:
+  if(seq)
+    raptor_free_sequence(seq);
+  if(data)
+    RASQAL_FREE(char**, data);
+  if(values)
+    RASQAL_FREE(char*, values);
+  if(query)
+    rasqal_free_query(query);
+  if(world)
+    rasqal_free_world(world);
+
+  return failures;
+}
+
+#endif /* STANDALONE */
@@ -52,6 +52,9 @@ typedef struct
   /* FILTER expression */
   rasqal_expression* expr;
 
+  /* compiled FILTER expression or NULL to interpret expr */
+  rasqal_expression_program* program;
+
   /* offset into results for current row */
   int offset;
   
@@ -61,6 +64,12 @@ typedef struct
 static int
 rasqal_filter_rowsource_init(rasqal_rowsource* rowsource, void *user_data)
 {
+  rasqal_filter_rowsource_context* con;
+
+  con = (rasqal_filter_rowsource_context*)user_data;
+
+  con->program = rasqal_new_expression_program(rowsource->world, con->expr);
+
   return 0;
 }
 
@@ -93,6 +102,9 @@ rasqal_filter_rowsource_finish(rasqal_rowsource* rowsource, void *user_data)
   if(con->rowsource)
     rasqal_free_rowsource(con->rowsource);
   
+  if(con->program)
+    rasqal_free_expression_program(con->program);
+
   if(con->expr)
     rasqal_free_expression(con->expr);
 
@@ -120,28 +132,42 @@ rasqal_filter_rowsource_read_row(rasqal_rowsource* rowsource, void *user_data)
     if(!row)
       break;
 
-    result = rasqal_expression_evaluate2(con->expr, query->eval_context,
-                                         &error);
+    if(con->program) {
+      bresult = rasqal_expression_program_evaluate_boolean(con->program,
+                                                           query->eval_context,
+                                                           &error);
 #ifdef RASQAL_DEBUG
-    RASQAL_DEBUG1("filter expression result: ");
-    if(error)
-      fputs("type error", DEBUG_FH);
-    else
-      rasqal_literal_print(result, DEBUG_FH);
-    fputc('\n', DEBUG_FH);
+      if(error)
+        RASQAL_DEBUG1("filter expression returned error\n");
+      else
+        RASQAL_DEBUG2("filter boolean expression result: %d\n", bresult);
 #endif
-    if(error) {
-      bresult = 0;
+      if(error)
+        bresult = 0;
     } else {
-      error = 0;
-      bresult = rasqal_literal_as_boolean(result, &error);
+      result = rasqal_expression_evaluate2(con->expr, query->eval_context,
+                                           &error);
 #ifdef RASQAL_DEBUG
+      RASQAL_DEBUG1("filter expression result: ");
       if(error)
-        RASQAL_DEBUG1("filter boolean expression returned error\n");
+        fputs("type error", DEBUG_FH);
       else
-        RASQAL_DEBUG2("filter boolean expression result: %d\n", bresult);
+        rasqal_literal_print(result, DEBUG_FH);
+      fputc('\n', DEBUG_FH);
+#endif
+      if(error) {
+        bresult = 0;
+      } else {
+        error = 0;
+        bresult = rasqal_literal_as_boolean(result, &error);
+#ifdef RASQAL_DEBUG
+        if(error)
+          RASQAL_DEBUG1("filter boolean expression returned error\n");
+        else
+          RASQAL_DEBUG2("filter boolean expression result: %d\n", bresult);
 #endif
-      rasqal_free_literal(result);
+        rasqal_free_literal(result);
+      }
     }
     if(bresult)
       /* Constraint succeeded so end */
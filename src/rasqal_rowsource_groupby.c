@@ -325,6 +325,7 @@ rasqal_groupby_rowsource_process(rasqal_rowsource* rowsource,
       
       row->group_id = node->group_id;
 
+      rasqal_rowsource_hold_row(rowsource, row);
       /* after this, node owns the row */
       raptor_sequence_push(node->rows, row);
 
@@ -0,0 +1,1231 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * rasqal_rowsource_hashjoin.c - Rasqal hash join rowsource class
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#include <rasqal_config.h>
+#endif
+
+#ifdef WIN32
+#include <win32_rasqal_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#include <raptor.h>
+
+#include "rasqal.h"
+#include "rasqal_internal.h"
+
+
+#define DEBUG_FH stderr
+
+#ifndef STANDALONE
+
+typedef enum {
+  HJS_BUILD,
+  HJS_PROBE,
+  HJS_FINISHED
+} rasqal_hashjoin_state;
+
+typedef struct
+{
+  rasqal_rowsource* left;
+
+  rasqal_rowsource* right;
+
+  /* array to map right variables into output rows */
+  int* right_map;
+
+  rasqal_hashjoin_state state;
+
+  int failed;
+
+  /* row offset for read_row() */
+  int offset;
+
+  /* row join type */
+  rasqal_join_type join_type;
+
+  /* join expression */
+  rasqal_expression *expr;
+
+  /* join expression constant boolean value or < 0 if not valid */
+  int constant_join_condition;
+
+  /* map for checking compatibility of rows */
+  rasqal_row_compatible* rc_map;
+
+  /* shared variables: count and offsets into left and right rows */
+  int keys_count;
+  int* left_keys;
+  int* right_keys;
+
+  /* non-0 if the table is built from the left rows and probed with
+   * the right rows */
+  int build_left;
+
+  /* build side rows (owned) with their key hashes and hash chains */
+  raptor_sequence* build_rows;
+  int build_rows_count;
+  unsigned int* build_hashes;
+  int* build_next;
+
+  /* hash table of chain heads (index into build_rows or -1) */
+  int* buckets;
+  unsigned int buckets_mask;
+
+  /* build rows with an unbound or unhashable key; these are tried
+   * with every probe row */
+  int* wildcards;
+  int wildcards_count;
+
+  /* probe side rows already read while choosing the build side */
+  raptor_sequence* probe_rows;
+  int probe_rows_offset;
+
+  /* current probe row and the candidate build rows left to try */
+  rasqal_row* probe_row;
+  unsigned int probe_hash;
+  int probe_wildcard;
+  int chain;
+  int candidate;
+
+  /* number of build rows joined with the current probe row */
+  int probe_rows_joined_count;
+} rasqal_hashjoin_rowsource_context;
+
+
+/*
+ * rasqal_hashjoin_row_hash:
+ * @row: row
+ * @keys: offsets of the shared variables in @row
+ * @keys_count: number of shared variables
+ * @hash_p: pointer to store hash
+ *
+ * INTERNAL - Hash the shared variable values of a row
+ *
+ * Return value: non-0 if the row has an unbound or unhashable value
+ * and must be compared with every row on the other side
+ */
+static int
+rasqal_hashjoin_row_hash(rasqal_row* row, int* keys, int keys_count,
+                         unsigned int* hash_p)
+{
+  unsigned int hash = RASQAL_LITERAL_HASH_INIT;
+  int i;
+
+  for(i = 0; i < keys_count; i++) {
+    if(rasqal_literal_value_hash(row->values[keys[i]], &hash))
+      return 1;
+  }
+
+  *hash_p = hash;
+  return 0;
+}
+
+
+/*
+ * rasqal_hashjoin_rows_share_bound:
+ * @con: hashjoin context
+ * @left_row: left row
+ * @right_row: right row
+ *
+ * INTERNAL - Check if two rows bind any shared variable in both
+ *
+ * Return value: non-0 if a shared variable is bound in both rows
+ */
+static int
+rasqal_hashjoin_rows_share_bound(rasqal_hashjoin_rowsource_context* con,
+                                 rasqal_row* left_row, rasqal_row* right_row)
+{
+  int i;
+
+  for(i = 0; i < con->keys_count; i++) {
+    if(left_row->values[con->left_keys[i]] &&
+       right_row->values[con->right_keys[i]])
+      return 1;
+  }
+
+  return 0;
+}
+
+
+/*
+ * rasqal_hashjoin_rowsource_evaluate_expr:
+ * @query: query
+ * @expr: join expression
+ *
+ * INTERNAL - Evaluate a join expression as a boolean
+ *
+ * Return value: boolean value; 0 on error
+ */
+static int
+rasqal_hashjoin_rowsource_evaluate_expr(rasqal_query* query,
+                                        rasqal_expression* expr)
+{
+  rasqal_literal* result;
+  int bresult;
+  int error = 0;
+
+  result = rasqal_expression_evaluate2(expr, query->eval_context, &error);
+#ifdef RASQAL_DEBUG
+  RASQAL_DEBUG1("hashjoin expression result: ");
+  if(error)
+    fputs("type error", DEBUG_FH);
+  else
+    rasqal_literal_print(result, DEBUG_FH);
+  fputc('\n', DEBUG_FH);
+#endif
+
+  if(error)
+    return 0;
+
+  bresult = rasqal_literal_as_boolean(result, &error);
+  rasqal_free_literal(result);
+
+  return error ? 0 : bresult;
+}
+
+
+static int
+rasqal_hashjoin_rowsource_init(rasqal_rowsource* rowsource, void *user_data)
+{
+  rasqal_hashjoin_rowsource_context* con;
+  int i;
+
+  con = (rasqal_hashjoin_rowsource_context*)user_data;
+
+  con->failed = 0;
+  con->state = HJS_BUILD;
+  con->constant_join_condition = -1;
+
+  /* If join condition is a constant - optimize it away */
+  if(con->expr && rasqal_expression_is_constant(con->expr)) {
+    con->constant_join_condition =
+      rasqal_hashjoin_rowsource_evaluate_expr(rowsource->query, con->expr);
+    rasqal_free_expression(con->expr); con->expr = NULL;
+
+    if(!con->constant_join_condition &&
+       con->join_type == RASQAL_JOIN_TYPE_NATURAL)
+      /* Constraint is always false so row source is finished */
+      con->state = HJS_FINISHED;
+    /* for a LEFT JOIN every left row is returned alone */
+  }
+
+  con->rc_map = rasqal_new_row_compatible(con->left->vars_table,
+                                          con->left, con->right);
+  if(!con->rc_map)
+    return -1;
+
+#ifdef RASQAL_DEBUG
+  RASQAL_DEBUG2("rowsource %p ", rowsource);
+  rasqal_print_row_compatible(stderr, con->rc_map);
+#endif
+
+  con->keys_count = 0;
+  if(con->rc_map->variables_in_both_rows_count) {
+    size_t size = RASQAL_GOOD_CAST(size_t, con->rc_map->variables_in_both_rows_count);
+
+    con->left_keys = RASQAL_CALLOC(int*, size, sizeof(int));
+    con->right_keys = RASQAL_CALLOC(int*, size, sizeof(int));
+    if(!con->left_keys || !con->right_keys)
+      return -1;
+  }
+
+  for(i = 0; i < con->rc_map->variables_count; i++) {
+    int offset1 = con->rc_map->defined_in_map[i<<1];
+    int offset2 = con->rc_map->defined_in_map[1 + (i<<1)];
+
+    if(offset1 >= 0 && offset2 >= 0) {
+      con->left_keys[con->keys_count] = offset1;
+      con->right_keys[con->keys_count] = offset2;
+      con->keys_count++;
+    }
+  }
+
+  return 0;
+}
+
+
+static void
+rasqal_hashjoin_rowsource_free_table(rasqal_hashjoin_rowsource_context* con)
+{
+  if(con->probe_row) {
+    rasqal_free_row(con->probe_row);
+    con->probe_row = NULL;
+  }
+
+  if(con->probe_rows) {
+    raptor_free_sequence(con->probe_rows);
+    con->probe_rows = NULL;
+  }
+  con->probe_rows_offset = 0;
+
+  if(con->build_rows) {
+    raptor_free_sequence(con->build_rows);
+    con->build_rows = NULL;
+  }
+  con->build_rows_count = 0;
+
+  if(con->build_hashes) {
+    RASQAL_FREE(intarray, con->build_hashes);
+    con->build_hashes = NULL;
+  }
+
+  if(con->build_next) {
+    RASQAL_FREE(intarray, con->build_next);
+    con->build_next = NULL;
+  }
+
+  if(con->buckets) {
+    RASQAL_FREE(intarray, con->buckets);
+    con->buckets = NULL;
+  }
+  con->buckets_mask = 0;
+
+  if(con->wildcards) {
+    RASQAL_FREE(intarray, con->wildcards);
+    con->wildcards = NULL;
+  }
+  con->wildcards_count = 0;
+}
+
+
+static int
+rasqal_hashjoin_rowsource_finish(rasqal_rowsource* rowsource, void *user_data)
+{
+  rasqal_hashjoin_rowsource_context* con;
+  con = (rasqal_hashjoin_rowsource_context*)user_data;
+
+  rasqal_hashjoin_rowsource_free_table(con);
+
+  if(con->left)
+    rasqal_free_rowsource(con->left);
+
+  if(con->right)
+    rasqal_free_rowsource(con->right);
+
+  if(con->right_map)
+    RASQAL_FREE(int, con->right_map);
+
+  if(con->expr)
+    rasqal_free_expression(con->expr);
+
+  if(con->rc_map)
+    rasqal_free_row_compatible(con->rc_map);
+
+  if(con->left_keys)
+    RASQAL_FREE(intarray, con->left_keys);
+
+  if(con->right_keys)
+    RASQAL_FREE(intarray, con->right_keys);
+
+  RASQAL_FREE(rasqal_hashjoin_rowsource_context, con);
+
+  return 0;
+}
+
+
+static int
+rasqal_hashjoin_rowsource_ensure_variables(rasqal_rowsource* rowsource,
+                                           void *user_data)
+{
+  rasqal_hashjoin_rowsource_context* con;
+  int map_size;
+  int i;
+
+  con = (rasqal_hashjoin_rowsource_context*)user_data;
+
+  if(rasqal_rowsource_ensure_variables(con->left))
+    return 1;
+
+  if(rasqal_rowsource_ensure_variables(con->right))
+    return 1;
+
+  rowsource->size = 0;
+
+  /* copy in variables from left rowsource */
+  if(rasqal_rowsource_copy_variables(rowsource, con->left))
+    return 1;
+
+  /* MINUS only returns left rows */
+  if(con->join_type == RASQAL_JOIN_TYPE_MINUS)
+    return 0;
+
+  map_size = rasqal_rowsource_get_size(con->right);
+  con->right_map = RASQAL_MALLOC(int*, RASQAL_GOOD_CAST(size_t,
+                                                        sizeof(int) * RASQAL_GOOD_CAST(size_t, map_size)));
+  if(!con->right_map)
+    return 1;
+
+  /* add any new variables not already seen from right rowsource */
+  for(i = 0; i < map_size; i++) {
+    rasqal_variable* v;
+    int offset;
+
+    v = rasqal_rowsource_get_variable_by_offset(con->right, i);
+    if(!v)
+      break;
+    offset = rasqal_rowsource_add_variable(rowsource, v);
+    if(offset < 0)
+      return 1;
+
+    con->right_map[i] = offset;
+  }
+
+  return 0;
+}
+
+
+/*
+ * rasqal_hashjoin_rowsource_build:
+ * @con: hashjoin context
+ *
+ * INTERNAL - Read the inputs and build the hash table on the smaller
+ *
+ * For a natural join, both inputs are read a row at a time,
+ * alternately, until one of them ends; that one becomes the build
+ * side.  The rows already read from the other side are kept and
+ * probed first, before the rest of that side is streamed.
+ *
+ * For a left join and minus, the table is always built from the
+ * right input and the left input is streamed.  A minus with no shared
+ * variables removes nothing so the right input is not read.
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_hashjoin_rowsource_build(rasqal_hashjoin_rowsource_context* con)
+{
+  raptor_sequence* left_rows;
+  raptor_sequence* right_rows;
+  int left_done = 0;
+  int right_done = 0;
+  int* keys;
+  unsigned int size;
+  int i;
+
+  left_rows = raptor_new_sequence((raptor_data_free_handler)rasqal_free_row,
+                                  (raptor_data_print_handler)rasqal_row_print);
+  right_rows = raptor_new_sequence((raptor_data_free_handler)rasqal_free_row,
+                                   (raptor_data_print_handler)rasqal_row_print);
+  if(!left_rows || !right_rows)
+    goto fail;
+
+  if(con->join_type == RASQAL_JOIN_TYPE_MINUS) {
+    int right_size = rasqal_rowsource_get_size(con->right);
+    rasqal_literal** saved_values = NULL;
+
+    if(con->keys_count) {
+      /* reading the right side binds its variables; put back the
+       * values they had, such as outer bindings, afterwards */
+      saved_values = RASQAL_CALLOC(rasqal_literal**,
+                                   RASQAL_GOOD_CAST(size_t, right_size),
+                                   sizeof(rasqal_literal*));
+      if(!saved_values)
+        goto fail;
+
+      for(i = 0; i < right_size; i++) {
+        rasqal_variable* v;
+
+        v = rasqal_rowsource_get_variable_by_offset(con->right, i);
+        saved_values[i] = rasqal_new_literal_from_literal(v->value);
+      }
+    }
+
+    while(con->keys_count && !right_done) {
+      rasqal_row* row;
+
+      row = rasqal_rowsource_read_row(con->right);
+      if(!row)
+        right_done = 1;
+      else if(raptor_sequence_push(right_rows, row))
+        break;
+    }
+
+    if(saved_values) {
+      for(i = 0; i < right_size; i++) {
+        rasqal_variable* v;
+
+        v = rasqal_rowsource_get_variable_by_offset(con->right, i);
+        /* takes ownership of the saved value */
+        rasqal_variable_set_value(v, saved_values[i]);
+      }
+      RASQAL_FREE(rasqal_literal**, saved_values);
+    }
+
+    if(con->keys_count && !right_done)
+      goto fail;
+
+    con->build_left = 0;
+  } else if(con->join_type == RASQAL_JOIN_TYPE_LEFT) {
+    /* Every left row is returned so always build on the right.  If
+     * the join condition is always false, no right row can join */
+    while(con->constant_join_condition && !right_done) {
+      rasqal_row* row;
+
+      row = rasqal_rowsource_read_row(con->right);
+      if(!row)
+        right_done = 1;
+      else if(raptor_sequence_push(right_rows, row))
+        goto fail;
+    }
+
+    con->build_left = 0;
+  } else {
+    while(!left_done && !right_done) {
+      rasqal_row* row;
+
+      row = rasqal_rowsource_read_row(con->left);
+      if(!row)
+        left_done = 1;
+      else if(raptor_sequence_push(left_rows, row))
+        goto fail;
+
+      row = rasqal_rowsource_read_row(con->right);
+      if(!row)
+        right_done = 1;
+      else if(raptor_sequence_push(right_rows, row))
+        goto fail;
+    }
+
+    if(left_done && right_done)
+      con->build_left = (raptor_sequence_size(left_rows) <
+                         raptor_sequence_size(right_rows));
+    else
+      con->build_left = left_done;
+  }
+
+  if(con->build_left) {
+    con->build_rows = left_rows;
+    con->probe_rows = right_rows;
+    keys = con->left_keys;
+  } else {
+    con->build_rows = right_rows;
+    con->probe_rows = left_rows;
+    keys = con->right_keys;
+  }
+  left_rows = right_rows = NULL;
+  con->probe_rows_offset = 0;
+
+  con->build_rows_count = raptor_sequence_size(con->build_rows);
+
+  RASQAL_DEBUG4("hashjoin built on %s with %d rows, probe has %d rows read\n",
+                (con->build_left ? "left" : "right"), con->build_rows_count,
+                raptor_sequence_size(con->probe_rows));
+
+  for(size = 8; size < RASQAL_GOOD_CAST(unsigned int, con->build_rows_count);
+      size <<= 1)
+    ;
+  con->buckets_mask = size - 1;
+
+  con->buckets = RASQAL_MALLOC(int*, size * sizeof(int));
+  if(!con->buckets)
+    return 1;
+  for(i = 0; i < RASQAL_GOOD_CAST(int, size); i++)
+    con->buckets[i] = -1;
+
+  if(!con->build_rows_count)
+    return 0;
+
+  size = RASQAL_GOOD_CAST(unsigned int, con->build_rows_count);
+  con->build_hashes = RASQAL_CALLOC(unsigned int*, size, sizeof(unsigned int));
+  con->build_next = RASQAL_CALLOC(int*, size, sizeof(int));
+  con->wildcards = RASQAL_CALLOC(int*, size, sizeof(int));
+  if(!con->build_hashes || !con->build_next || !con->wildcards)
+    return 1;
+
+  /* insert in reverse so that each chain is in build row order */
+  for(i = con->build_rows_count - 1; i >= 0; i--) {
+    rasqal_row* row;
+    unsigned int hash;
+    unsigned int bucket;
+
+    row = (rasqal_row*)raptor_sequence_get_at(con->build_rows, i);
+    if(rasqal_hashjoin_row_hash(row, keys, con->keys_count, &hash)) {
+      con->wildcards[con->wildcards_count++] = i;
+      continue;
+    }
+
+    bucket = hash & con->buckets_mask;
+    con->build_hashes[i] = hash;
+    con->build_next[i] = con->buckets[bucket];
+    con->buckets[bucket] = i;
+  }
+
+  return 0;
+
+  fail:
+  if(left_rows)
+    raptor_free_sequence(left_rows);
+  if(right_rows)
+    raptor_free_sequence(right_rows);
+  return 1;
+}
+
+
+static rasqal_row*
+rasqal_hashjoin_rowsource_read_probe_row(rasqal_hashjoin_rowsource_context* con)
+{
+  if(con->probe_rows) {
+    if(con->probe_rows_offset < raptor_sequence_size(con->probe_rows))
+      return (rasqal_row*)raptor_sequence_delete_at(con->probe_rows,
+                                                    con->probe_rows_offset++);
+
+    raptor_free_sequence(con->probe_rows);
+    con->probe_rows = NULL;
+  }
+
+  return rasqal_rowsource_read_row(con->build_left ? con->right : con->left);
+}
+
+
+/*
+ * rasqal_hashjoin_rowsource_next_candidate:
+ * @con: hashjoin context
+ *
+ * INTERNAL - Get the next build row that may join the current probe row
+ *
+ * A probe row with a hashable key is tried with the build rows in its
+ * hash chain with the same hash, then with the wildcard build rows.
+ * A probe row with an unbound or unhashable key is tried with every
+ * build row.
+ *
+ * Return value: build row index or < 0 when there are no more
+ */
+static int
+rasqal_hashjoin_rowsource_next_candidate(rasqal_hashjoin_rowsource_context* con)
+{
+  int i;
+
+  if(con->probe_wildcard) {
+    if(con->candidate < con->build_rows_count)
+      return con->candidate++;
+    return -1;
+  }
+
+  while(con->chain >= 0) {
+    i = con->chain;
+    con->chain = con->build_next[i];
+    if(con->build_hashes[i] == con->probe_hash)
+      return i;
+  }
+
+  if(con->candidate < con->wildcards_count)
+    return con->wildcards[con->candidate++];
+
+  return -1;
+}
+
+
+static rasqal_row*
+rasqal_hashjoin_rowsource_build_merged_row(rasqal_rowsource* rowsource,
+                                           rasqal_hashjoin_rowsource_context* con,
+                                           rasqal_row *left_row,
+                                           rasqal_row *right_row)
+{
+  rasqal_row *row;
+  int i;
+
+  row = rasqal_new_row_for_size(rowsource->world, rowsource->size);
+  if(!row)
+    return NULL;
+
+  rasqal_row_set_rowsource(row, rowsource);
+
+  for(i = 0; i < left_row->size; i++) {
+    rasqal_literal *l = left_row->values[i];
+    row->values[i] = rasqal_new_literal_from_literal(l);
+  }
+
+  if(right_row) {
+    for(i = 0; i < right_row->size; i++) {
+      rasqal_literal *l = right_row->values[i];
+      int dest_i = con->right_map[i];
+      if(!row->values[dest_i])
+        row->values[dest_i] = rasqal_new_literal_from_literal(l);
+    }
+  }
+
+#ifdef RASQAL_DEBUG
+  RASQAL_DEBUG1("merge\n  left row   : ");
+  rasqal_row_print(left_row, stderr);
+  fputs("\n  right row  : ", stderr);
+  if(right_row)
+    rasqal_row_print(right_row, stderr);
+  else
+    fputs("NONE", stderr);
+  fputs("\n  result row : ", stderr);
+  rasqal_row_print(row, stderr);
+  fputs("\n", stderr);
+#endif
+
+  return row;
+}
+
+
+static rasqal_row*
+rasqal_hashjoin_rowsource_read_row(rasqal_rowsource* rowsource,
+                                   void *user_data)
+{
+  rasqal_hashjoin_rowsource_context* con;
+  rasqal_row* row = NULL;
+
+  con = (rasqal_hashjoin_rowsource_context*)user_data;
+
+  if(con->failed || con->state == HJS_FINISHED)
+    return NULL;
+
+  if(con->state == HJS_BUILD) {
+    if(rasqal_hashjoin_rowsource_build(con)) {
+      con->failed = 1;
+      return NULL;
+    }
+
+    rasqal_rowsource_hold_rows(rowsource, con->build_rows);
+    rasqal_rowsource_hold_rows(rowsource, con->probe_rows);
+
+    con->state = HJS_PROBE;
+
+    if(!con->build_rows_count && con->join_type == RASQAL_JOIN_TYPE_NATURAL) {
+      /* nothing can join */
+      con->state = HJS_FINISHED;
+      return NULL;
+    }
+  }
+
+  while(1) {
+    rasqal_row* build_row;
+    rasqal_row* left_row;
+    rasqal_row* right_row;
+    int i;
+
+    if(!con->probe_row) {
+      con->probe_row = rasqal_hashjoin_rowsource_read_probe_row(con);
+      if(!con->probe_row) {
+        con->state = HJS_FINISHED;
+        break;
+      }
+
+      con->probe_wildcard = rasqal_hashjoin_row_hash(con->probe_row,
+                                                     (con->build_left ?
+                                                      con->right_keys :
+                                                      con->left_keys),
+                                                     con->keys_count,
+                                                     &con->probe_hash);
+      if(con->probe_wildcard)
+        con->chain = -1;
+      else
+        con->chain = con->buckets[con->probe_hash & con->buckets_mask];
+      con->candidate = 0;
+      con->probe_rows_joined_count = 0;
+    }
+
+    i = rasqal_hashjoin_rowsource_next_candidate(con);
+    if(i < 0) {
+      /* probe row finished */
+      if(con->join_type != RASQAL_JOIN_TYPE_NATURAL &&
+         !con->probe_rows_joined_count) {
+        /* LEFT JOIN - return left row alone if no right row joined;
+         * MINUS - return left row if no right row removed it */
+        row = rasqal_hashjoin_rowsource_build_merged_row(rowsource, con,
+                                                         con->probe_row, NULL);
+        if(!row)
+          con->failed = 1;
+      }
+
+      rasqal_free_row(con->probe_row);
+      con->probe_row = NULL;
+
+      if(row || con->failed)
+        break;
+
+      /* get the next one */
+      continue;
+    }
+
+    build_row = (rasqal_row*)raptor_sequence_get_at(con->build_rows, i);
+    if(con->build_left) {
+      left_row = build_row;
+      right_row = con->probe_row;
+    } else {
+      left_row = con->probe_row;
+      right_row = build_row;
+    }
+
+    if(!rasqal_row_compatible_check(con->rc_map, left_row, right_row))
+      continue;
+
+    if(con->join_type == RASQAL_JOIN_TYPE_MINUS) {
+      /* compatible rows with disjoint bound variables do not remove */
+      if(!rasqal_hashjoin_rows_share_bound(con, left_row, right_row))
+        continue;
+
+      /* left row is removed; skip the rest of its candidates */
+      rasqal_free_row(con->probe_row);
+      con->probe_row = NULL;
+      continue;
+    }
+
+    row = rasqal_hashjoin_rowsource_build_merged_row(rowsource, con,
+                                                     left_row, right_row);
+    if(!row) {
+      con->failed = 1;
+      break;
+    }
+
+    if(con->expr) {
+      /* evaluate the join expression against the merged row */
+      rasqal_row_bind_variables(row, rowsource->query->vars_table);
+      if(!rasqal_hashjoin_rowsource_evaluate_expr(rowsource->query,
+                                                  con->expr)) {
+        rasqal_free_row(row);
+        row = NULL;
+        continue;
+      }
+    }
+
+    con->probe_rows_joined_count++;
+    break;
+  }
+
+  if(row) {
+    row->offset = con->offset++;
+
+    rasqal_row_bind_variables(row, rowsource->query->vars_table);
+  }
+
+  return row;
+}
+
+
+static int
+rasqal_hashjoin_rowsource_reset(rasqal_rowsource* rowsource, void *user_data)
+{
+  rasqal_hashjoin_rowsource_context* con;
+  int rc;
+
+  con = (rasqal_hashjoin_rowsource_context*)user_data;
+
+  /* the inputs may depend on outer bindings so build again */
+  rasqal_hashjoin_rowsource_free_table(con);
+
+  if(!con->constant_join_condition &&
+     con->join_type == RASQAL_JOIN_TYPE_NATURAL)
+    con->state = HJS_FINISHED;
+  else
+    con->state = HJS_BUILD;
+  con->failed = 0;
+  con->offset = 0;
+
+  rc = rasqal_rowsource_reset(con->left);
+  if(rc)
+    return rc;
+
+  return rasqal_rowsource_reset(con->right);
+}
+
+
+static rasqal_rowsource*
+rasqal_hashjoin_rowsource_get_inner_rowsource(rasqal_rowsource* rowsource,
+                                              void *user_data, int offset)
+{
+  rasqal_hashjoin_rowsource_context *con;
+  con = (rasqal_hashjoin_rowsource_context*)user_data;
+
+  if(offset == 0)
+    return con->left;
+  else if(offset == 1)
+    return con->right;
+  else
+    return NULL;
+}
+
+
+static const rasqal_rowsource_handler rasqal_hashjoin_rowsource_handler = {
+  /* .version = */ 1,
+  "hashjoin",
+  /* .init = */ rasqal_hashjoin_rowsource_init,
+  /* .finish = */ rasqal_hashjoin_rowsource_finish,
+  /* .ensure_variables = */ rasqal_hashjoin_rowsource_ensure_variables,
+  /* .read_row = */ rasqal_hashjoin_rowsource_read_row,
+  /* .read_all_rows = */ NULL,
+  /* .reset = */ rasqal_hashjoin_rowsource_reset,
+  /* .set_requirements = */ NULL,
+  /* .get_inner_rowsource = */ rasqal_hashjoin_rowsource_get_inner_rowsource,
+  /* .set_origin = */ NULL,
+};
+
+
+/**
+ * rasqal_new_hashjoin_rowsource:
+ * @world: world object
+ * @query: query object
+ * @left: input left (first) rowsource
+ * @right: input right (second) rowsource
+ * @join_type: join type
+ * @expr: join expression to filter result rows
+ *
+ * INTERNAL - create a new hash JOIN or MINUS over two rowsources
+ *
+ * Returns the same rows as rasqal_new_join_rowsource() but builds a
+ * hash table over the values of the variables shared by @left and
+ * @right and probes it with the rows of the other input.  A natural
+ * join builds on whichever input is smaller; a left join always
+ * builds on @right and evaluates @expr only for the compatible rows
+ * found in the table.  Rows with an unbound (or unhashable) shared
+ * value are checked against every row on the other side so the
+ * compatibility rules for unbound values are the same.
+ *
+ * A minus join (SPARQL MINUS, algebra Diff) builds on @right and
+ * returns the @left rows that have no compatible @right row binding a
+ * shared variable; when there are no shared variables every @left row
+ * is returned.  @expr is not used.
+ *
+ * Both inputs are read once and must not depend on each other's
+ * variable bindings; see rasqal_algebra_join_can_hash().
+ *
+ * The @left and @right rowsources become owned by the rowsource.
+ *
+ * Return value: new rowsource or NULL on failure
+ */
+rasqal_rowsource*
+rasqal_new_hashjoin_rowsource(rasqal_world *world,
+                              rasqal_query* query,
+                              rasqal_rowsource* left,
+                              rasqal_rowsource* right,
+                              rasqal_join_type join_type,
+                              rasqal_expression *expr)
+{
+  rasqal_hashjoin_rowsource_context* con;
+  int flags = 0;
+
+  if(!world || !query || !left || !right)
+    goto fail;
+
+  /* only left outer join, natural join and minus supported */
+  if(join_type != RASQAL_JOIN_TYPE_LEFT &&
+     join_type != RASQAL_JOIN_TYPE_NATURAL &&
+     join_type != RASQAL_JOIN_TYPE_MINUS)
+    goto fail;
+
+  con = RASQAL_CALLOC(rasqal_hashjoin_rowsource_context*, 1, sizeof(*con));
+  if(!con)
+    goto fail;
+
+  con->left = left;
+  con->right = right;
+  con->join_type = join_type;
+  con->expr = rasqal_new_expression_from_expression(expr);
+
+  return rasqal_new_rowsource_from_handler(world, query,
+                                           con,
+                                           &rasqal_hashjoin_rowsource_handler,
+                                           query->vars_table,
+                                           flags);
+
+  fail:
+  if(left)
+    rasqal_free_rowsource(left);
+  if(right)
+    rasqal_free_rowsource(right);
+  return NULL;
+}
+
+
+#endif /* not STANDALONE */
+
+
+
+#ifdef STANDALONE
+
+/* one more prototype */
+int main(int argc, char *argv[]);
+
+
+/* join on b; some b values are unbound as from an OPTIONAL */
+
+const char* const hashjoin_1_data_2x5_rows[] =
+{
+  /* 2 variable names and 5 rows */
+  "a",   NULL, "b",   NULL,
+  /* row 1 data */
+  "foo", NULL, "red", NULL,
+  /* row 2 data */
+  "baz", NULL, "blue", NULL,
+  /* row 3 data */
+  "bob", NULL, "green", NULL,
+  /* row 4 data */
+  "sue", NULL, NULL, NULL,
+  /* row 5 data */
+  "fay", NULL, "red", NULL,
+  /* end of data */
+  NULL, NULL, NULL, NULL
+};
+
+
+const char* const hashjoin_2_data_3x3_rows[] =
+{
+  /* 3 variable names and 3 rows */
+  "b",     NULL, "c",      NULL, "d",      NULL,
+  /* row 1 data */
+  "red",   NULL, "orange", NULL, "yellow", NULL,
+  /* row 2 data */
+  "blue",  NULL, "indigo", NULL, "violet", NULL,
+  /* row 3 data */
+  NULL,    NULL, "black",  NULL, "white",  NULL,
+  /* end of data */
+  NULL, NULL, NULL, NULL, NULL, NULL
+};
+
+
+/* join on b; all values bound */
+
+const char* const hashjoin_3_data_2x2_rows[] =
+{
+  /* 2 variable names and 2 rows */
+  "a",   NULL, "b",      NULL,
+  /* row 1 data */
+  "foo", NULL, "red",    NULL,
+  /* row 2 data */
+  "bar", NULL, "purple", NULL,
+  /* end of data */
+  NULL, NULL, NULL, NULL
+};
+
+
+const char* const hashjoin_4_data_3x2_rows[] =
+{
+  /* 3 variable names and 2 rows */
+  "b",     NULL, "c",      NULL, "d",      NULL,
+  /* row 1 data */
+  "red",   NULL, "orange", NULL, "yellow", NULL,
+  /* row 2 data */
+  "blue",  NULL, "indigo", NULL, "violet", NULL,
+  /* end of data */
+  NULL, NULL, NULL, NULL, NULL, NULL
+};
+
+
+/* shares no variable with the others */
+
+const char* const hashjoin_5_data_1x1_rows[] =
+{
+  /* 1 variable name and 1 row */
+  "e",     NULL,
+  /* row 1 data */
+  "black", NULL,
+  /* end of data */
+  NULL, NULL
+};
+
+
+typedef struct {
+  const char* const* left_data;
+  int left_vars_count;
+  const char* const* right_data;
+  int right_vars_count;
+  rasqal_join_type join_type;
+  int expected;
+  int expected_columns;
+} hashjoin_test_config_type;
+
+/*
+ * 1 x 2: red: 2 left x 1 right, blue: 1 x 1, green: 0;
+ *   unbound left b (sue) joins all 3 right rows;
+ *   unbound right b joins all 4 bound left rows.
+ *   Every left row joins so LEFT gives the same rows.
+ * 3 x 4: red joins; purple only appears alone in a LEFT join
+ *
+ * MINUS returns left columns only:
+ * 1 - 2: red and blue rows are removed; green (bob) is kept and the
+ *   unbound b row (sue) shares no bound variable so is kept.
+ * 2 - 1: red and blue are removed; the unbound b row is kept.
+ * 3 - 4: red is removed, purple kept.
+ * 1 - 5: no shared variables so nothing is removed.
+ */
+#define HASHJOIN_TESTS_COUNT 10
+const hashjoin_test_config_type hashjoin_test_config[HASHJOIN_TESTS_COUNT] = {
+  { hashjoin_1_data_2x5_rows, 2, hashjoin_2_data_3x3_rows, 3,
+    RASQAL_JOIN_TYPE_NATURAL, 2 + 1 + 3 + 4, 4 },
+  { hashjoin_2_data_3x3_rows, 3, hashjoin_1_data_2x5_rows, 2,
+    RASQAL_JOIN_TYPE_NATURAL, 2 + 1 + 3 + 4, 4 },
+  { hashjoin_1_data_2x5_rows, 2, hashjoin_2_data_3x3_rows, 3,
+    RASQAL_JOIN_TYPE_LEFT, 2 + 1 + 3 + 4, 4 },
+  { hashjoin_2_data_3x3_rows, 3, hashjoin_1_data_2x5_rows, 2,
+    RASQAL_JOIN_TYPE_LEFT, 2 + 1 + 3 + 4, 4 },
+  { hashjoin_3_data_2x2_rows, 2, hashjoin_4_data_3x2_rows, 3,
+    RASQAL_JOIN_TYPE_NATURAL, 1, 4 },
+  { hashjoin_3_data_2x2_rows, 2, hashjoin_4_data_3x2_rows, 3,
+    RASQAL_JOIN_TYPE_LEFT, 2, 4 },
+  { hashjoin_1_data_2x5_rows, 2, hashjoin_2_data_3x3_rows, 3,
+    RASQAL_JOIN_TYPE_MINUS, 2, 2 },
+  { hashjoin_2_data_3x3_rows, 3, hashjoin_1_data_2x5_rows, 2,
+    RASQAL_JOIN_TYPE_MINUS, 1, 3 },
+  { hashjoin_3_data_2x2_rows, 2, hashjoin_4_data_3x2_rows, 3,
+    RASQAL_JOIN_TYPE_MINUS, 1, 2 },
+  { hashjoin_1_data_2x5_rows, 2, hashjoin_5_data_1x1_rows, 1,
+    RASQAL_JOIN_TYPE_MINUS, 5, 2 }
+};
+
+
+/* joins are on variable 'b'; the result has left then right variables */
+const char* const hashjoin_result_vars[] = { "a" , "b" , "c", "d" };
+
+
+int
+main(int argc, char *argv[])
+{
+  const char *program = rasqal_basename(argv[0]);
+  rasqal_rowsource *rowsource = NULL;
+  rasqal_rowsource *left_rs = NULL;
+  rasqal_rowsource *right_rs = NULL;
+  rasqal_world* world = NULL;
+  rasqal_query* query = NULL;
+  raptor_sequence* seq = NULL;
+  int failures = 0;
+  int count;
+  int size;
+  int i;
+  int test_count;
+
+  world = rasqal_new_world(); rasqal_world_open(world);
+
+  query = rasqal_new_query(world, "sparql", NULL);
+
+  for(test_count = 0; test_count < HASHJOIN_TESTS_COUNT; test_count++) {
+    const hashjoin_test_config_type* t = &hashjoin_test_config[test_count];
+    int expected_count = t->expected;
+
+    fprintf(stderr, "%s: test #%d  join type %d\n", program, test_count,
+            RASQAL_GOOD_CAST(int, t->join_type));
+
+    left_rs = rasqal_new_row_sequence_rowsource(world, query, t->left_data,
+                                                t->left_vars_count);
+    right_rs = rasqal_new_row_sequence_rowsource(world, query, t->right_data,
+                                                 t->right_vars_count);
+    if(!left_rs || !right_rs) {
+      fprintf(stderr, "%s: failed to create input rowsources\n", program);
+      failures++;
+      goto tidy;
+    }
+
+    rowsource = rasqal_new_hashjoin_rowsource(world, query, left_rs, right_rs,
+                                              t->join_type, NULL);
+    /* left_rs and right_rs are now owned by rowsource */
+    left_rs = right_rs = NULL;
+    if(!rowsource) {
+      fprintf(stderr, "%s: failed to create hashjoin rowsource\n", program);
+      failures++;
+      goto tidy;
+    }
+
+    seq = rasqal_rowsource_read_all_rows(rowsource);
+    if(!seq) {
+      fprintf(stderr,
+              "%s: read_rows returned a NULL seq for a hashjoin rowsource\n",
+              program);
+      failures++;
+      goto tidy;
+    }
+    count = raptor_sequence_size(seq);
+    if(count != expected_count) {
+      fprintf(stderr,
+              "%s: read_rows returned %d rows for a hashjoin rowsource, expected %d\n",
+              program, count, expected_count);
+      failures++;
+      goto tidy;
+    }
+
+    size = rasqal_rowsource_get_size(rowsource);
+    if(size != t->expected_columns) {
+      fprintf(stderr,
+              "%s: read_rows returned %d columns (variables) for a hashjoin rowsource, expected %d\n",
+              program, size, t->expected_columns);
+      failures++;
+      goto tidy;
+    }
+
+    /* columns are in left then right order: check when left is a, b */
+    if(t->left_vars_count == 2) {
+      for(i = 0; i < t->expected_columns; i++) {
+        rasqal_variable* v;
+        const char *expected_name = hashjoin_result_vars[i];
+
+        v = rasqal_rowsource_get_variable_by_offset(rowsource, i);
+        if(!v || strcmp(RASQAL_GOOD_CAST(const char*, v->name),
+                        expected_name)) {
+          fprintf(stderr,
+                  "%s: read_rows returned column (variable) #%d %s but expected %s\n",
+                  program, i, (v ? RASQAL_GOOD_CAST(const char*, v->name) : "NULL"),
+                  expected_name);
+          failures++;
+          goto tidy;
+        }
+      }
+    }
+
+#ifdef RASQAL_DEBUG
+    rasqal_rowsource_print_row_sequence(rowsource, seq, DEBUG_FH);
+#endif
+
+    raptor_free_sequence(seq); seq = NULL;
+
+    /* A reset must give the same rows again */
+    rasqal_rowsource_reset(rowsource);
+    seq = rasqal_rowsource_read_all_rows(rowsource);
+    count = seq ? raptor_sequence_size(seq) : -1;
+    if(count != expected_count) {
+      fprintf(stderr,
+              "%s: read_rows after reset returned %d rows for a hashjoin rowsource, expected %d\n",
+              program, count, expected_count);
+      failures++;
+      goto tidy;
+    }
+
+    raptor_free_sequence(seq); seq = NULL;
+    rasqal_free_rowsource(rowsource); rowsource = NULL;
+
+    /* end test_count loop */
+  }
+
+  tidy:
+  if(seq)
+    raptor_free_sequence(seq);
+  if(left_rs)
+    rasqal_free_rowsource(left_rs);
+  if(right_rs)
+    rasqal_free_rowsource(right_rs);
+  if(rowsource)
+    rasqal_free_rowsource(rowsource);
+  if(query)
+    rasqal_free_query(query);
+  if(world)
+    rasqal_free_world(world);
+
+  return failures;
+}
+
+#endif /* STANDALONE */
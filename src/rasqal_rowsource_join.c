@@ -61,9 +61,14 @@ typedef struct
   /* current left row */
   rasqal_row *left_row;
   
-  /* array to map right variables into output rows */
+  /* array to map right variables into output rows; for MINUS the
+   * offsets of right variables in left rows or -1 */
   int* right_map;
 
+  /* MINUS: values of the right variables before the right rowsource
+   * is read, restored after */
+  rasqal_literal** saved_values;
+
   /* 0 = reading from left rs, 1 = reading from right rs, 2 = finished */
   rasqal_join_state state;
 
@@ -184,6 +189,9 @@ rasqal_join_rowsource_finish(rasqal_rowsource* rowsource, void *user_data)
   
   if(con->right_map)
     RASQAL_FREE(int, con->right_map);
+
+  if(con->saved_values)
+    RASQAL_FREE(rasqal_literal**, con->saved_values);
   
   if(con->expr)
     rasqal_free_expression(con->expr);
@@ -224,6 +232,25 @@ rasqal_join_rowsource_ensure_variables(rasqal_rowsource* rowsource,
   /* copy in variables from left rowsource */
   if(rasqal_rowsource_copy_variables(rowsource, con->left))
     return 1;
+
+  /* MINUS only returns left rows */
+  if(con->join_type == RASQAL_JOIN_TYPE_MINUS) {
+    con->saved_values = RASQAL_CALLOC(rasqal_literal**,
+                                      RASQAL_GOOD_CAST(size_t, map_size ? map_size : 1),
+                                      sizeof(rasqal_literal*));
+    if(!con->saved_values)
+      return 1;
+
+    for(i = 0; i < map_size; i++) {
+      rasqal_variable* v;
+
+      v = rasqal_rowsource_get_variable_by_offset(con->right, i);
+      con->right_map[i] = rasqal_rowsource_get_variable_offset_by_name(con->left,
+                                                                       v->name);
+    }
+
+    return 0;
+  }
   
   /* add any new variables not already seen from right rowsource */
   for(i = 0; i < map_size; i++) {
@@ -299,6 +326,115 @@ rasqal_join_rowsource_build_merged_row(rasqal_rowsource* rowsource,
 }
 
 
+/*
+ * rasqal_join_rowsource_minus_removes:
+ * @con: join rowsource context
+ *
+ * INTERNAL - Check if a right row removes the current left row from a MINUS
+ *
+ * The right rowsource is read again for each left row so that a left
+ * rowsource evaluated with outer bindings is compared with them: a
+ * right variable that is not a left column is compared with the
+ * value it had before the right rowsource was read.  Reading the
+ * right rowsource binds its own variables; their values before it was
+ * read are restored afterwards.
+ *
+ * Return value: non-0 if the left row is removed
+ */
+static int
+rasqal_join_rowsource_minus_removes(rasqal_join_rowsource_context* con)
+{
+  int size = rasqal_rowsource_get_size(con->right);
+  int removed = 0;
+  int i;
+
+  for(i = 0; i < size; i++) {
+    rasqal_variable* v = rasqal_rowsource_get_variable_by_offset(con->right, i);
+
+    con->saved_values[i] = rasqal_new_literal_from_literal(v->value);
+  }
+
+  rasqal_rowsource_reset(con->right);
+
+  while(!removed) {
+    rasqal_row* right_row;
+    int shared = 0;
+    int compatible = 1;
+
+    right_row = rasqal_rowsource_read_row(con->right);
+    if(!right_row)
+      break;
+
+    for(i = 0; i < right_row->size && compatible; i++) {
+      rasqal_literal* right_value = right_row->values[i];
+      rasqal_literal* left_value;
+
+      if(con->right_map[i] >= 0)
+        left_value = con->left_row->values[con->right_map[i]];
+      else
+        left_value = con->saved_values[i];
+
+      /* compatible rows with disjoint bound variables do not remove */
+      if(!left_value || !right_value)
+        continue;
+
+      shared++;
+      if(!rasqal_literal_equals(left_value, right_value))
+        compatible = 0;
+    }
+
+    rasqal_free_row(right_row);
+
+    removed = (compatible && shared);
+  }
+
+  for(i = 0; i < size; i++) {
+    rasqal_variable* v = rasqal_rowsource_get_variable_by_offset(con->right, i);
+
+    /* takes ownership of the saved value */
+    rasqal_variable_set_value(v, con->saved_values[i]);
+    con->saved_values[i] = NULL;
+  }
+
+  RASQAL_DEBUG2("minus left row removed: %s\n", removed ? "YES" : "NO");
+
+  return removed;
+}
+
+
+static rasqal_row*
+rasqal_join_rowsource_read_minus_row(rasqal_rowsource* rowsource,
+                                     rasqal_join_rowsource_context* con)
+{
+  rasqal_row* row = NULL;
+
+  while(1) {
+    if(con->left_row)
+      rasqal_free_row(con->left_row);
+
+    con->left_row = rasqal_rowsource_read_row(con->left);
+    if(!con->left_row) {
+      con->state = JS_FINISHED;
+      return NULL;
+    }
+
+    if(!rasqal_join_rowsource_minus_removes(con)) {
+      row = rasqal_join_rowsource_build_merged_row(rowsource, con, NULL);
+      break;
+    }
+  }
+
+  if(row) {
+    rasqal_row_set_rowsource(row, rowsource);
+    row->offset = con->offset++;
+
+    rasqal_row_bind_variables(row, rowsource->query->vars_table);
+  }
+
+  return row;
+}
+
+
 static rasqal_row*
 rasqal_join_rowsource_read_row(rasqal_rowsource* rowsource, void *user_data)
 {
@@ -311,6 +447,9 @@ rasqal_join_rowsource_read_row(rasqal_rowsource* rowsource, void *user_data)
   if(con->failed || con->state == JS_FINISHED)
     return NULL;
 
+  if(con->join_type == RASQAL_JOIN_TYPE_MINUS)
+    return rasqal_join_rowsource_read_minus_row(rowsource, con);
+
   while(1) {
     rasqal_row *right_row;
     int bresult = 1;
@@ -562,6 +701,11 @@ static const rasqal_rowsource_handler rasqal_join_rowsource_handler = {
  *
  * INTERNAL - create a new JOIN over two rowsources
  *
+ * A minus join (SPARQL MINUS, algebra Diff) reads @right again for
+ * every left row and returns the left rows no right row removes.
+ * Unlike the hash minus, this can be used when @left is evaluated
+ * with bindings from outside it.
+ *
  * This uses the number of variables in @vt to set the rowsource size
  * (order size is always 0) and then checks that all the rows in the
  * sequence are the same.  If not, construction fails and NULL is
@@ -585,9 +729,10 @@ rasqal_new_join_rowsource(rasqal_world *world,
   if(!world || !query || !left || !right)
     goto fail;
 
-  /* only left outer join and cross join supported */
+  /* only left outer join, cross join and minus supported */
   if(join_type != RASQAL_JOIN_TYPE_LEFT &&
-     join_type != RASQAL_JOIN_TYPE_NATURAL)
+     join_type != RASQAL_JOIN_TYPE_NATURAL &&
+     join_type != RASQAL_JOIN_TYPE_MINUS)
     goto fail;
   
   con = RASQAL_CALLOC(rasqal_join_rowsource_context*, 1, sizeof(*con));
@@ -57,6 +57,12 @@ typedef struct
   /* variables projection array: [output row var index]=input row var index */
   int* projection;
 
+  /* compiled expressions array: [output row var index]=program or NULL */
+  rasqal_expression_program** programs;
+
+  /* size of projection and programs arrays */
+  int projection_size;
+
 } rasqal_project_rowsource_context;
 
 
@@ -89,6 +95,13 @@ rasqal_project_rowsource_ensure_variables(rasqal_rowsource* rowsource,
   if(!con->projection)
     return 1;
   
+  con->programs = RASQAL_CALLOC(rasqal_expression_program**,
+                                RASQAL_GOOD_CAST(size_t, size),
+                                sizeof(rasqal_expression_program*));
+  if(!con->programs)
+    return 1;
+  con->projection_size = size;
+
   for(i = 0; i < size; i++) {
     rasqal_variable* v;
     int offset;
@@ -106,6 +119,10 @@ rasqal_project_rowsource_ensure_variables(rasqal_rowsource* rowsource,
 
     rasqal_rowsource_add_variable(rowsource, v);
     con->projection[i] = offset;
+
+    if(offset < 0 && v->expression)
+      con->programs[i] = rasqal_new_expression_program(rowsource->world,
+                                                       v->expression);
   }
 
   return 0;
@@ -127,6 +144,16 @@ rasqal_project_rowsource_finish(rasqal_rowsource* rowsource, void *user_data)
   if(con->projection)
     RASQAL_FREE(int*, con->projection);
   
+  if(con->programs) {
+    int i;
+
+    for(i = 0; i < con->projection_size; i++) {
+      if(con->programs[i])
+        rasqal_free_expression_program(con->programs[i]);
+    }
+    RASQAL_FREE(rasqal_expression_program**, con->programs);
+  }
+
   RASQAL_FREE(rasqal_project_rowsource_context, con);
 
   return 0;
@@ -168,9 +195,14 @@ rasqal_project_rowsource_read_row(rasqal_rowsource* rowsource, void *user_data)
           if(v->value)
             rasqal_free_literal(v->value);
           
-          v->value = rasqal_expression_evaluate2(v->expression,
-                                                 query->eval_context,
-                                                 &error);
+          if(con->programs[i])
+            v->value = rasqal_expression_program_evaluate(con->programs[i],
+                                                          query->eval_context,
+                                                          &error);
+          else
+            v->value = rasqal_expression_evaluate2(v->expression,
+                                                   query->eval_context,
+                                                   &error);
           if(error) {
             /* FIXME: Errors are ignored - check this */
 #if 0
@@ -179,6 +211,14 @@ rasqal_project_rowsource_read_row(rasqal_rowsource* rowsource, void *user_data)
           } else
             nrow->values[i] = rasqal_new_literal_from_literal(v->value);
 
+        } else if(v) {
+          rasqal_literal* value;
+
+          /* a parameter is matched in the patterns but not bound by
+           * them so give it the value set on the query */
+          value = rasqal_query_get_parameter_value(query, v);
+          if(value)
+            nrow->values[i] = rasqal_new_literal_from_literal(value);
         }
       }
     }
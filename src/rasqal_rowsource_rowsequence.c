@@ -299,6 +299,16 @@ const char* const test_3_rows[] =
 };
   
 
+static int
+rowsequence_test_copy_profile(void *user_data,
+                              rasqal_operator_profile* profile)
+{
+  memcpy(user_data, profile, sizeof(*profile));
+
+  return 0;
+}
+
+
 /* one more prototype */
 int main(int argc, char *argv[]);
 
@@ -317,6 +327,7 @@ main(int argc, char *argv[])
   int rows_count;
   int i;
   raptor_sequence* vars_seq = NULL;
+  rasqal_operator_profile profile;
   
   world = rasqal_new_world();
   if(!world || rasqal_world_open(world)) {
@@ -457,6 +468,32 @@ main(int argc, char *argv[])
     failures++;
     goto tidy;
   }
+
+  /* read the rows again after a reset: rows read in both passes are
+   * counted as are the calls including the ones that returned no row */
+  rasqal_rowsource_reset(rowsource);
+  seq = rasqal_rowsource_read_all_rows(rowsource);
+  if(seq) {
+    raptor_free_sequence(seq); seq = NULL;
+  }
+
+  if(rasqal_rowsource_visit_profile(rowsource, rowsequence_test_copy_profile,
+                                    &profile)) {
+    fprintf(stderr, "%s: visit_profile failed for a %d-row sequence rowsource\n",
+            program, rows_count);
+    failures++;
+    goto tidy;
+  }
+
+  if(profile.rows != 2 * rows_count || profile.calls != rows_count + 2 ||
+     profile.resets != 1 || profile.id != 0 || profile.parent != -1) {
+    fprintf(stderr,
+            "%s: profile returned rows %ld calls %ld resets %ld for a %d-row sequence rowsource, expected %d, %d, 1\n",
+            program, profile.rows, profile.calls, profile.resets,
+            rows_count, 2 * rows_count, rows_count + 2);
+    failures++;
+    goto tidy;
+  }
   
   rasqal_free_rowsource(rowsource); rowsource = NULL;
   rasqal_free_variables_table(vt); vt = NULL;
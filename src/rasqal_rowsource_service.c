@@ -224,6 +224,55 @@ rasqal_new_service_rowsource(rasqal_world *world, rasqal_query* query,
 }
 
 
+/**
+ * rasqal_new_service_rowsource_from_service:
+ * @world: world object
+ * @query: query object
+ * @svc: service object
+ * @rs_flags: service rowsource flags
+ *
+ * INTERNAL - create a new rowsource that takes rows from a service object
+ *
+ * Used for a service whose request was started with
+ * rasqal_service_start() before the rowsource was needed.  @svc
+ * becomes owned by the rowsource, even on failure.
+ *
+ * Return value: new rowsource or NULL on failure
+ */
+rasqal_rowsource*
+rasqal_new_service_rowsource_from_service(rasqal_world *world,
+                                          rasqal_query* query,
+                                          rasqal_service* svc,
+                                          unsigned int rs_flags)
+{
+  rasqal_service_rowsource_context* con;
+  int flags = 0;
+
+  if(!world || !svc)
+    goto fail;
+
+  con = RASQAL_CALLOC(rasqal_service_rowsource_context*, 1, sizeof(*con));
+  if(!con)
+    goto fail;
+
+  con->svc = svc;
+  con->query = query;
+  con->flags = rs_flags;
+
+  return rasqal_new_rowsource_from_handler(world, query,
+                                           con,
+                                           &rasqal_service_rowsource_handler,
+                                           query->vars_table,
+                                           flags);
+
+  fail:
+  if(svc)
+    rasqal_free_service(svc);
+
+  return NULL;
+}
+
+
 #endif /* not STANDALONE */
 
 
@@ -44,6 +44,23 @@
 #define DEBUG_FH stderr
 
 
+/*
+ * A sorted run of rows, either spilled to a temporary file or the
+ * rows left in memory when the input ended.
+ */
+typedef struct
+{
+  /* temporary file or NULL once all its rows are read */
+  FILE* fh;
+
+  /* number of rows still to be read from fh or < 0 for the rows in memory */
+  int remaining;
+
+  /* next row of the run in order or NULL when the run is done */
+  rasqal_row* row;
+} rasqal_sort_run;
+
+
 typedef struct 
 {
   /* inner rowsource to sort */
@@ -55,14 +72,36 @@ typedef struct
   /* number of order conditions in order_seq */
   int order_size;
 
+  /* compiled order conditions array (or NULL) */
+  rasqal_expression_program** programs;
+
   /* distinct flag */
   int distinct;
 
-  /* map for sorting */
+  /* number of rows needed from the start of the order or < 0 for all */
+  int limit;
+
+  /* map for finding duplicate rows when distinct */
   rasqal_map* map;
 
   /* sequence of rows (owned here) */
   raptor_sequence* seq;
+
+  /* estimated bytes of rows to keep in seq before spilling them as a
+   * sorted run to a temporary file or 0 for no limit */
+  size_t memory_limit;
+
+  /* estimated bytes of rows in seq */
+  size_t memory_used;
+
+  /* array of sorted runs when rows were spilled (or NULL) */
+  rasqal_sort_run* runs;
+  int runs_count;
+  int runs_capacity;
+
+  /* min-heap of the runs that have rows, by their next row */
+  rasqal_sort_run** merge_heap;
+  int merge_size;
 } rasqal_sort_rowsource_context;
 
 
@@ -83,10 +122,25 @@ rasqal_sort_rowsource_init(rasqal_rowsource* rowsource, void *user_data)
   
   con->map = NULL;
 
-  if(con->order_size > 0 ) {
-    /* make a row:NULL map in order to sort or do distinct
-     * FIXME: should DISTINCT be separate? 
-     */
+  if(con->order_size > 0) {
+    int i;
+
+    con->programs = RASQAL_CALLOC(rasqal_expression_program**,
+                                  RASQAL_GOOD_CAST(size_t, con->order_size),
+                                  sizeof(rasqal_expression_program*));
+    if(!con->programs)
+      return 1;
+
+    for(i = 0; i < con->order_size; i++) {
+      rasqal_expression* e;
+
+      e = (rasqal_expression*)raptor_sequence_get_at(con->order_seq, i);
+      con->programs[i] = rasqal_new_expression_program(rowsource->world, e);
+    }
+  }
+
+  if(con->order_size > 0 && con->distinct) {
+    /* make a row:NULL map to remove duplicates before sorting */
     con->map = rasqal_engine_new_rowsort_map(con->distinct,
                                              query->compare_flags,
                                              con->order_seq);
@@ -96,10 +150,494 @@ rasqal_sort_rowsource_init(rasqal_rowsource* rowsource, void *user_data)
   
   con->seq = NULL;
 
+  /* a distinct sort keeps all rows in the map so it cannot spill and
+   * a sort with a limit keeps only that many rows anyway */
+  con->memory_limit = 0;
+  if(con->order_size > 0 && !con->map && con->limit < 0) {
+    int limit_kb;
+
+    limit_kb = query->features[RASQAL_GOOD_CAST(int, RASQAL_FEATURE_SORT_MEMORY_LIMIT)];
+    if(limit_kb > 0)
+      con->memory_limit = RASQAL_GOOD_CAST(size_t, limit_kb) * 1024;
+  }
+
+  return 0;
+}
+
+
+/*
+ * rasqal_sort_rowsource_heap_sift_down:
+ * @heap: array of rows in max-heap order
+ * @heap_size: number of rows in @heap
+ * @i: index of row to move down
+ * @con: sort rowsource context
+ * @compare_flags: comparison flags
+ *
+ * INTERNAL - Restore the max-heap order below @i
+ */
+static void
+rasqal_sort_rowsource_heap_sift_down(rasqal_row** heap, int heap_size, int i,
+                                     rasqal_sort_rowsource_context* con,
+                                     int compare_flags)
+{
+  while(1) {
+    int largest = i;
+    int child = (i << 1) + 1;
+    rasqal_row* tmp;
+
+    if(child < heap_size &&
+       rasqal_engine_rowsort_compare_rows(heap[child], heap[largest],
+                                          con->order_seq, compare_flags) > 0)
+      largest = child;
+
+    child++;
+    if(child < heap_size &&
+       rasqal_engine_rowsort_compare_rows(heap[child], heap[largest],
+                                          con->order_seq, compare_flags) > 0)
+      largest = child;
+
+    if(largest == i)
+      break;
+
+    tmp = heap[i]; heap[i] = heap[largest]; heap[largest] = tmp;
+    i = largest;
+  }
+}
+
+
+/*
+ * rasqal_sort_rowsource_process_limit:
+ * @rowsource: sort rowsource
+ * @con: sort rowsource context
+ *
+ * INTERNAL - Sort keeping only the first con->limit rows in order
+ *
+ * The best rows seen so far are kept in a max-heap with the last row
+ * in order at the top; a new row replaces it if it sorts before it.
+ * This takes O(limit) memory and O(N log limit) time rather than
+ * sorting all N rows.  Equal rows keep their input order since a
+ * later row never replaces an equal earlier one.
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_sort_rowsource_process_limit(rasqal_rowsource* rowsource,
+                                    rasqal_sort_rowsource_context* con)
+{
+  int compare_flags = rowsource->query->compare_flags;
+  rasqal_row** heap = NULL;
+  int heap_size = 0;
+  int heap_capacity = 0;
+  int offset = 0;
+  int rc = 0;
+  int i;
+
+  /* LIMIT 0 needs no rows */
+  while(con->limit > 0) {
+    rasqal_row* row;
+
+    row = rasqal_rowsource_read_row(con->rowsource);
+    if(!row)
+      break;
+
+    if(rasqal_row_set_order_size(row, con->order_size)) {
+      rasqal_free_row(row);
+      rc = 1;
+      goto tidy;
+    }
+
+    rasqal_engine_rowsort_calculate_order_values(rowsource->query, con->order_seq, con->programs, row);
+
+    row->offset = offset++;
+
+    if(heap_size < con->limit) {
+      if(heap_size == heap_capacity) {
+        rasqal_row** new_heap;
+        int new_capacity = heap_capacity ? (heap_capacity << 1) : 16;
+
+        if(new_capacity > con->limit || new_capacity < 0)
+          new_capacity = con->limit;
+
+        new_heap = RASQAL_CALLOC(rasqal_row**,
+                                 RASQAL_GOOD_CAST(size_t, new_capacity),
+                                 sizeof(rasqal_row*));
+        if(!new_heap) {
+          rasqal_free_row(row);
+          rc = 1;
+          goto tidy;
+        }
+        if(heap) {
+          memcpy(new_heap, heap,
+                 RASQAL_GOOD_CAST(size_t, heap_size) * sizeof(rasqal_row*));
+          RASQAL_FREE(rasqal_row**, heap);
+        }
+        heap = new_heap;
+        heap_capacity = new_capacity;
+      }
+
+      /* add at the bottom and move up */
+      i = heap_size++;
+      heap[i] = row;
+      while(i > 0) {
+        int parent = (i - 1) >> 1;
+        rasqal_row* tmp;
+
+        if(rasqal_engine_rowsort_compare_rows(heap[i], heap[parent],
+                                              con->order_seq,
+                                              compare_flags) <= 0)
+          break;
+
+        tmp = heap[i]; heap[i] = heap[parent]; heap[parent] = tmp;
+        i = parent;
+      }
+    } else if(rasqal_engine_rowsort_compare_rows(row, heap[0], con->order_seq,
+                                                 compare_flags) < 0) {
+      /* replace the last row in order */
+      rasqal_free_row(heap[0]);
+      heap[0] = row;
+      rasqal_sort_rowsource_heap_sift_down(heap, heap_size, 0, con,
+                                           compare_flags);
+    } else
+      rasqal_free_row(row);
+  }
+
+  RASQAL_DEBUG3("sort kept %d rows of %d\n", heap_size, offset);
+
+  /* heapsort: move the largest row to the end until all are in order */
+  for(i = heap_size - 1; i > 0; i--) {
+    rasqal_row* tmp;
+
+    tmp = heap[0]; heap[0] = heap[i]; heap[i] = tmp;
+    rasqal_sort_rowsource_heap_sift_down(heap, i, 0, con, compare_flags);
+  }
+
+  for(i = 0; i < heap_size; i++) {
+    rasqal_row* row = heap[i];
+
+    /* after this, row is owned by seq */
+    heap[i] = NULL;
+    if(raptor_sequence_push(con->seq, row)) {
+      rc = 1;
+      break;
+    }
+  }
+
+  tidy:
+  if(heap) {
+    for(i = 0; i < heap_size; i++) {
+      if(heap[i])
+        rasqal_free_row(heap[i]);
+    }
+    RASQAL_FREE(rasqal_row**, heap);
+  }
+
+  return rc;
+}
+
+
+/*
+ * rasqal_sort_rowsource_row_bytes:
+ * @row: row with order values
+ *
+ * INTERNAL - Estimate the memory used by a row for the sort memory limit
+ *
+ * Literals shared between rows are counted for each row.
+ *
+ * Return value: size in bytes
+ */
+static size_t
+rasqal_sort_rowsource_row_bytes(rasqal_row* row)
+{
+  size_t bytes = sizeof(*row);
+  int i;
+
+  for(i = 0; i < row->size; i++) {
+    rasqal_literal* l = row->values[i];
+
+    bytes += sizeof(l);
+    if(l)
+      bytes += sizeof(*l) + l->string_len;
+  }
+
+  for(i = 0; i < row->order_size; i++) {
+    rasqal_literal* l = row->order_values[i];
+
+    bytes += sizeof(l);
+    if(l)
+      bytes += sizeof(*l) + l->string_len;
+
+    if(row->order_keys)
+      bytes += sizeof(row->order_keys[i]) + row->order_keys[i].len;
+  }
+
+  return bytes;
+}
+
+
+/*
+ * rasqal_sort_rowsource_add_run:
+ * @con: sort rowsource context
+ * @fh: temporary file or NULL for the rows in memory
+ * @remaining: number of rows in @fh or < 0 for the rows in memory
+ *
+ * INTERNAL - Add a sorted run
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_sort_rowsource_add_run(rasqal_sort_rowsource_context* con, FILE* fh,
+                              int remaining)
+{
+  rasqal_sort_run* run;
+
+  if(con->runs_count == con->runs_capacity) {
+    rasqal_sort_run* new_runs;
+    int new_capacity = con->runs_capacity ? (con->runs_capacity << 1) : 8;
+
+    new_runs = RASQAL_CALLOC(rasqal_sort_run*,
+                             RASQAL_GOOD_CAST(size_t, new_capacity),
+                             sizeof(rasqal_sort_run));
+    if(!new_runs)
+      return 1;
+    if(con->runs) {
+      memcpy(new_runs, con->runs,
+             RASQAL_GOOD_CAST(size_t, con->runs_count) * sizeof(rasqal_sort_run));
+      RASQAL_FREE(rasqal_sort_run*, con->runs);
+    }
+    con->runs = new_runs;
+    con->runs_capacity = new_capacity;
+  }
+
+  run = &con->runs[con->runs_count++];
+  run->fh = fh;
+  run->remaining = remaining;
+  run->row = NULL;
+
   return 0;
 }
 
 
+/*
+ * rasqal_sort_rowsource_spill:
+ * @rowsource: sort rowsource
+ * @con: sort rowsource context
+ *
+ * INTERNAL - Sort the rows in memory and move them to a temporary file
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_sort_rowsource_spill(rasqal_rowsource* rowsource,
+                            rasqal_sort_rowsource_context* con)
+{
+  FILE* fh;
+  rasqal_row* row;
+  int count = 0;
+
+  con->seq = rasqal_engine_rowsort_sort_sequence(rowsource->world,
+                                                 con->seq, con->order_seq,
+                                                 rowsource->query->compare_flags);
+  if(!con->seq)
+    return 1;
+
+  /* removed automatically when closed */
+  fh = tmpfile();
+  if(!fh)
+    return 1;
+
+  if(rasqal_sort_rowsource_add_run(con, fh, 0)) {
+    fclose(fh);
+    return 1;
+  }
+
+  while((row = (rasqal_row*)raptor_sequence_unshift(con->seq))) {
+    int rc = rasqal_row_write_binary(row, fh);
+
+    rasqal_free_row(row);
+    if(rc)
+      return 1;
+    count++;
+  }
+
+  if(fflush(fh) || fseek(fh, 0L, SEEK_SET))
+    return 1;
+
+  con->runs[con->runs_count - 1].remaining = count;
+  RASQAL_DEBUG3("sort spilled run %d of %d rows\n", con->runs_count, count);
+
+  con->memory_used = 0;
+
+  return 0;
+}
+
+
+/*
+ * rasqal_sort_rowsource_run_next:
+ * @con: sort rowsource context
+ * @run: run
+ * @compare_flags: comparison flags
+ *
+ * INTERNAL - Read the next row of a run into run->row
+ *
+ * A temporary file is closed as soon as all its rows are read.
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_sort_rowsource_run_next(rasqal_sort_rowsource_context* con,
+                               rasqal_sort_run* run, int compare_flags)
+{
+  if(run->remaining < 0) {
+    run->row = (rasqal_row*)raptor_sequence_unshift(con->seq);
+    return 0;
+  }
+
+  run->row = NULL;
+  if(run->remaining > 0) {
+    run->row = rasqal_new_row_from_binary(con->rowsource, run->fh);
+    if(!run->row)
+      return 1;
+    /* sort keys are not written to runs */
+    rasqal_engine_rowsort_calculate_order_keys(run->row, compare_flags);
+    run->remaining--;
+  }
+
+  if(!run->remaining && run->fh) {
+    fclose(run->fh);
+    run->fh = NULL;
+  }
+
+  return 0;
+}
+
+
+/*
+ * rasqal_sort_rowsource_merge_sift_down:
+ * @con: sort rowsource context
+ * @i: index of run to move down
+ * @compare_flags: comparison flags
+ *
+ * INTERNAL - Restore the min-heap order of the merge heap below @i
+ */
+static void
+rasqal_sort_rowsource_merge_sift_down(rasqal_sort_rowsource_context* con,
+                                      int i, int compare_flags)
+{
+  rasqal_sort_run** heap = con->merge_heap;
+
+  while(1) {
+    int smallest = i;
+    int child = (i << 1) + 1;
+    rasqal_sort_run* tmp;
+
+    if(child < con->merge_size &&
+       rasqal_engine_rowsort_compare_rows(heap[child]->row,
+                                          heap[smallest]->row,
+                                          con->order_seq, compare_flags) < 0)
+      smallest = child;
+
+    child++;
+    if(child < con->merge_size &&
+       rasqal_engine_rowsort_compare_rows(heap[child]->row,
+                                          heap[smallest]->row,
+                                          con->order_seq, compare_flags) < 0)
+      smallest = child;
+
+    if(smallest == i)
+      break;
+
+    tmp = heap[i]; heap[i] = heap[smallest]; heap[smallest] = tmp;
+    i = smallest;
+  }
+}
+
+
+/*
+ * rasqal_sort_rowsource_start_merge:
+ * @rowsource: sort rowsource
+ * @con: sort rowsource context
+ *
+ * INTERNAL - Start merging the spilled runs with the sorted rows in memory
+ *
+ * Return value: non-0 on failure
+ */
+static int
+rasqal_sort_rowsource_start_merge(rasqal_rowsource* rowsource,
+                                  rasqal_sort_rowsource_context* con)
+{
+  int compare_flags = rowsource->query->compare_flags;
+  int i;
+
+  if(rasqal_sort_rowsource_add_run(con, NULL, -1))
+    return 1;
+
+  con->merge_heap = RASQAL_CALLOC(rasqal_sort_run**,
+                                  RASQAL_GOOD_CAST(size_t, con->runs_count),
+                                  sizeof(rasqal_sort_run*));
+  if(!con->merge_heap)
+    return 1;
+
+  for(i = 0; i < con->runs_count; i++) {
+    rasqal_sort_run* run = &con->runs[i];
+
+    if(rasqal_sort_rowsource_run_next(con, run, compare_flags))
+      return 1;
+    if(run->row)
+      con->merge_heap[con->merge_size++] = run;
+  }
+
+  for(i = (con->merge_size >> 1) - 1; i >= 0; i--)
+    rasqal_sort_rowsource_merge_sift_down(con, i, compare_flags);
+
+  return 0;
+}
+
+
+/*
+ * rasqal_sort_rowsource_merge_row:
+ * @rowsource: sort rowsource
+ * @con: sort rowsource context
+ *
+ * INTERNAL - Get the next row in order from the merged runs
+ *
+ * Rows compare by order values and then by the input offset which is
+ * kept in the spilled rows, so the merged order is the same as
+ * sorting all rows in memory.
+ *
+ * Return value: row or NULL when finished or on failure
+ */
+static rasqal_row*
+rasqal_sort_rowsource_merge_row(rasqal_rowsource* rowsource,
+                                rasqal_sort_rowsource_context* con)
+{
+  rasqal_sort_run* run;
+  rasqal_row* row;
+
+  if(!con->merge_size)
+    return NULL;
+
+  run = con->merge_heap[0];
+  row = run->row;
+
+  if(rasqal_sort_rowsource_run_next(con, run,
+                                    rowsource->query->compare_flags)) {
+    rasqal_free_row(row);
+    /* stop merging */
+    con->merge_size = 0;
+    return NULL;
+  }
+
+  if(!run->row)
+    con->merge_heap[0] = con->merge_heap[--con->merge_size];
+
+  if(con->merge_size > 1)
+    rasqal_sort_rowsource_merge_sift_down(con, 0,
+                                          rowsource->query->compare_flags);
+
+  return row;
+}
+
+
 static int
 rasqal_sort_rowsource_process(rasqal_rowsource* rowsource,
                               rasqal_sort_rowsource_context* con)
@@ -115,6 +653,14 @@ rasqal_sort_rowsource_process(rasqal_rowsource* rowsource,
   if(!con->seq)
     return 1;
   
+  if(con->limit >= 0) {
+    if(rasqal_sort_rowsource_process_limit(rowsource, con))
+      return 1;
+
+    rasqal_rowsource_hold_rows(rowsource, con->seq);
+    return 0;
+  }
+
   while(1) {
     rasqal_row* row;
 
@@ -127,24 +673,55 @@ rasqal_sort_rowsource_process(rasqal_rowsource* rowsource,
       return 1;
     }
 
-    rasqal_engine_rowsort_calculate_order_values(rowsource->query, con->order_seq, row);
+    rasqal_engine_rowsort_calculate_order_values(rowsource->query, con->order_seq, con->programs, row);
 
     row->offset = offset;
 
-    /* after this, row is owned by map */
-    if(!rasqal_engine_rowsort_map_add_row(con->map, row))
-      offset++;
+    if(con->map) {
+      /* after this, row is owned by map */
+      if(rasqal_engine_rowsort_map_add_row(con->map, row))
+        /* duplicate */
+        continue;
+
+      row = rasqal_new_row_from_row(row);
+    }
+
+    /* after this, row is owned by seq */
+    if(raptor_sequence_push(con->seq, row))
+      return 1;
+
+    offset++;
+
+    if(con->memory_limit) {
+      con->memory_used += rasqal_sort_rowsource_row_bytes(row);
+      if(con->memory_used > con->memory_limit &&
+         rasqal_sort_rowsource_spill(rowsource, con))
+        return 1;
+    }
   }
   
+  if(con->map) {
+    rasqal_free_map(con->map); con->map = NULL;
+  }
+
+  /* sort all rows at once */
+  con->seq = rasqal_engine_rowsort_sort_sequence(rowsource->world,
+                                                 con->seq, con->order_seq,
+                                                 rowsource->query->compare_flags);
+  if(!con->seq)
+    return 1;
+
 #ifdef RASQAL_DEBUG
   fputs("resulting ", DEBUG_FH);
-  rasqal_map_print(con->map, DEBUG_FH);
+  raptor_sequence_print(con->seq, DEBUG_FH);
   fputs("\n", DEBUG_FH);
 #endif
-  
-  /* do sort/distinct: walk map in order, adding rows to sequence */
-  rasqal_engine_rowsort_map_to_sequence(con->map, con->seq);
-  rasqal_free_map(con->map); con->map = NULL;
+
+  rasqal_rowsource_hold_rows(rowsource, con->seq);
+
+  /* rows in memory are the last run to merge */
+  if(con->runs_count)
+    return rasqal_sort_rowsource_start_merge(rowsource, con);
 
   return 0;
 }
@@ -182,12 +759,60 @@ rasqal_sort_rowsource_finish(rasqal_rowsource* rowsource, void *user_data)
   if(con->seq)
     raptor_free_sequence(con->seq);
 
+  if(con->runs) {
+    int i;
+
+    for(i = 0; i < con->runs_count; i++) {
+      if(con->runs[i].row)
+        rasqal_free_row(con->runs[i].row);
+      if(con->runs[i].fh)
+        fclose(con->runs[i].fh);
+    }
+    RASQAL_FREE(rasqal_sort_run*, con->runs);
+  }
+
+  if(con->merge_heap)
+    RASQAL_FREE(rasqal_sort_run**, con->merge_heap);
+
+  if(con->programs) {
+    int i;
+
+    for(i = 0; i < con->order_size; i++) {
+      if(con->programs[i])
+        rasqal_free_expression_program(con->programs[i]);
+    }
+    RASQAL_FREE(rasqal_expression_program**, con->programs);
+  }
+
   RASQAL_FREE(rasqal_sort_rowsource_context, con);
 
   return 0;
 }
 
 
+static rasqal_row*
+rasqal_sort_rowsource_read_row(rasqal_rowsource* rowsource, void *user_data)
+{
+  rasqal_sort_rowsource_context *con;
+
+  con = (rasqal_sort_rowsource_context*)user_data;
+
+  /* if there were no ordering conditions, pass it all on to inner rowsource */
+  if(con->order_size <= 0)
+    return rasqal_rowsource_read_row(con->rowsource);
+
+  /* need to sort */
+  if(rasqal_sort_rowsource_process(rowsource, con))
+    return NULL;
+
+  if(con->runs)
+    return rasqal_sort_rowsource_merge_row(rowsource, con);
+
+  /* after this, row is owned by caller */
+  return (rasqal_row*)raptor_sequence_unshift(con->seq);
+}
+
+
 static raptor_sequence*
 rasqal_sort_rowsource_read_all_rows(rasqal_rowsource* rowsource,
                                     void *user_data)
@@ -206,6 +831,20 @@ rasqal_sort_rowsource_read_all_rows(rasqal_rowsource* rowsource,
   if(rasqal_sort_rowsource_process(rowsource, con))
     return NULL;
 
+  if(con->runs) {
+    rasqal_row* row;
+
+    seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_row,
+                              (raptor_data_print_handler)rasqal_row_print);
+    while(seq && (row = rasqal_sort_rowsource_merge_row(rowsource, con))) {
+      if(raptor_sequence_push(seq, row)) {
+        raptor_free_sequence(seq);
+        seq = NULL;
+      }
+    }
+    return seq;
+  }
+
   if(con->seq) {
     /* pass ownership of seq back to caller */
     seq = con->seq;
@@ -235,7 +874,7 @@ static const rasqal_rowsource_handler rasqal_sort_rowsource_handler = {
   /* .init =             */ rasqal_sort_rowsource_init,
   /* .finish =           */ rasqal_sort_rowsource_finish,
   /* .ensure_variables = */ rasqal_sort_rowsource_ensure_variables,
-  /* .read_row =         */ NULL,
+  /* .read_row =         */ rasqal_sort_rowsource_read_row,
   /* .read_all_rows =    */ rasqal_sort_rowsource_read_all_rows,
   /* .reset =            */ NULL,
   /* .set_requirements = */ NULL,
@@ -251,9 +890,19 @@ static const rasqal_rowsource_handler rasqal_sort_rowsource_handler = {
  * @rowsource: input rowsource
  * @order_seq: order sequence (shared, may be NULL)
  * @distinct: distinct flag
+ * @limit: number of rows needed from the start of the order or < 0 for all
  *
  * INTERNAL - create a SORT over rows from input rowsource
  *
+ * When @limit is given, such as for ORDER BY under LIMIT and OFFSET,
+ * only that many rows are kept while sorting and the rest are
+ * discarded as they are read.  @limit is ignored for a distinct sort
+ * since duplicates are only found when all rows are kept.
+ *
+ * Otherwise, when the query feature #RASQAL_FEATURE_SORT_MEMORY_LIMIT
+ * is set and the rows held exceed it, they are sorted and written to
+ * a temporary file and the sorted runs are merged when read.
+ *
  * The @rowsource becomes owned by the new rowsource.
  *
  * Return value: new rowsource or NULL on failure
@@ -263,7 +912,8 @@ rasqal_new_sort_rowsource(rasqal_world *world,
                           rasqal_query *query,
                           rasqal_rowsource *rowsource,
                           raptor_sequence* order_seq,
-                          int distinct)
+                          int distinct,
+                          int limit)
 {
   rasqal_sort_rowsource_context *con;
   int flags = 0;
@@ -278,6 +928,7 @@ rasqal_new_sort_rowsource(rasqal_world *world,
   con->rowsource = rowsource;
   con->order_seq = order_seq;
   con->distinct = distinct;
+  con->limit = distinct ? -1 : limit;
 
   return rasqal_new_rowsource_from_handler(world, query,
                                            con,
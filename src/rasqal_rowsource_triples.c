@@ -75,6 +75,13 @@ typedef struct
   
   /* GRAPH origin to use */
   rasqal_literal *origin;
+
+  /* array of FILTER expressions, one per triple pattern, evaluated when
+   * that triple pattern matches (or NULL) */
+  rasqal_expression** column_exprs;
+
+  /* compiled column_exprs; a NULL program is interpreted */
+  rasqal_expression_program** column_programs;
 } rasqal_triples_rowsource_context;
 
 
@@ -122,16 +129,20 @@ rasqal_triples_rowsource_init(rasqal_rowsource* rowsource, void *user_data)
 
     t = (rasqal_triple*)raptor_sequence_get_at(con->triples, column);
     
+    /* query parameters are matched with their value, not bound */
     if((v = rasqal_literal_as_variable(t->subject)) &&
-       rasqal_query_variable_bound_in_triple(query, v, column) & RASQAL_TRIPLE_SUBJECT)
+       rasqal_query_variable_bound_in_triple(query, v, column) & RASQAL_TRIPLE_SUBJECT &&
+       !rasqal_query_variable_is_parameter(query, v))
       m->parts = (rasqal_triple_parts)(m->parts | RASQAL_TRIPLE_SUBJECT);
     
     if((v = rasqal_literal_as_variable(t->predicate)) &&
-       rasqal_query_variable_bound_in_triple(query, v, column) & RASQAL_TRIPLE_PREDICATE)
+       rasqal_query_variable_bound_in_triple(query, v, column) & RASQAL_TRIPLE_PREDICATE &&
+       !rasqal_query_variable_is_parameter(query, v))
       m->parts = (rasqal_triple_parts)(m->parts | RASQAL_TRIPLE_PREDICATE);
     
     if((v = rasqal_literal_as_variable(t->object)) &&
-       rasqal_query_variable_bound_in_triple(query, v, column) & RASQAL_TRIPLE_OBJECT)
+       rasqal_query_variable_bound_in_triple(query, v, column) & RASQAL_TRIPLE_OBJECT &&
+       !rasqal_query_variable_is_parameter(query, v))
       m->parts = (rasqal_triple_parts)(m->parts | RASQAL_TRIPLE_OBJECT);
 
     RASQAL_DEBUG4("triple pattern column %d has parts %s (%u)\n", column,
@@ -177,12 +188,66 @@ rasqal_triples_rowsource_finish(rasqal_rowsource* rowsource, void *user_data)
   if(con->origin)
     rasqal_free_literal(con->origin);
 
+  if(con->column_exprs) {
+    for(i = 0; i < con->triples_count; i++) {
+      if(con->column_exprs[i])
+        rasqal_free_expression(con->column_exprs[i]);
+    }
+    RASQAL_FREE(rasqal_expression**, con->column_exprs);
+  }
+
+  if(con->column_programs) {
+    for(i = 0; i < con->triples_count; i++) {
+      if(con->column_programs[i])
+        rasqal_free_expression_program(con->column_programs[i]);
+    }
+    RASQAL_FREE(rasqal_expression_program**, con->column_programs);
+  }
+
   RASQAL_FREE(rasqal_triples_rowsource_context, con);
 
   return 0;
 }
 
 
+/*
+ * rasqal_triples_rowsource_filter:
+ * @query: query
+ * @expr: filter expression
+ * @program: compiled @expr (or NULL)
+ *
+ * INTERNAL - Evaluate a filter expression on the current variable bindings
+ *
+ * Return value: non-0 if the filter is true; 0 if false or an error
+ */
+static int
+rasqal_triples_rowsource_filter(rasqal_query* query, rasqal_expression* expr,
+                                rasqal_expression_program* program)
+{
+  rasqal_literal* result;
+  int bresult;
+  int error = 0;
+
+  if(program) {
+    bresult = rasqal_expression_program_evaluate_boolean(program,
+                                                         query->eval_context,
+                                                         &error);
+    return error ? 0 : bresult;
+  }
+
+  result = rasqal_expression_evaluate2(expr, query->eval_context, &error);
+  if(error)
+    return 0;
+
+  bresult = rasqal_literal_as_boolean(result, &error);
+  rasqal_free_literal(result);
+  if(error)
+    return 0;
+
+  return bresult;
+}
+
+
 static rasqal_engine_error
 rasqal_triples_rowsource_get_next_row(rasqal_rowsource* rowsource, 
                                       rasqal_triples_rowsource_context *con)
@@ -243,6 +308,17 @@ rasqal_triples_rowsource_get_next_row(rasqal_rowsource* rowsource,
       RASQAL_DEBUG2("Nothing to bind_match for column %d\n", con->column);
     }
 
+    if(con->column_exprs && con->column_exprs[con->column - con->start_column]) {
+      int index = con->column - con->start_column;
+
+      if(!rasqal_triples_rowsource_filter(query, con->column_exprs[index],
+                                          con->column_programs[index])) {
+        RASQAL_DEBUG2("filter rejected match for column %d\n", con->column);
+        rasqal_triples_match_next_match(m->triples_match);
+        continue;
+      }
+    }
+
     rasqal_triples_match_next_match(m->triples_match);
     
     if(con->column == con->end_column)
@@ -386,7 +462,7 @@ static const rasqal_rowsource_handler rasqal_triples_rowsource_handler = {
  * @triples: shared triples sequence
  * @start_column: start column in triples sequence
  * @end_column: end column in triples sequence
- * @bound_in: array marking the triples that bind a variable
+ * @column_exprs: array of filter expressions per triple pattern (or NULL)
  *
  * INTERNAL - create a new triples rowsource
  *
@@ -397,7 +473,8 @@ rasqal_new_triples_rowsource(rasqal_world *world,
                              rasqal_query *query,
                              rasqal_triples_source* triples_source,
                              raptor_sequence* triples,
-                             int start_column, int end_column)
+                             int start_column, int end_column,
+                             rasqal_expression** column_exprs)
 {
   rasqal_triples_rowsource_context *con;
   int flags = 0;
@@ -427,6 +504,28 @@ rasqal_new_triples_rowsource(rasqal_world *world,
     return NULL;
   }
 
+  if(column_exprs) {
+    int i;
+
+    con->column_exprs = RASQAL_CALLOC(rasqal_expression**,
+                                      RASQAL_GOOD_CAST(size_t, con->triples_count),
+                                      sizeof(rasqal_expression*));
+    con->column_programs = RASQAL_CALLOC(rasqal_expression_program**,
+                                         RASQAL_GOOD_CAST(size_t, con->triples_count),
+                                         sizeof(rasqal_expression_program*));
+    if(!con->column_exprs || !con->column_programs) {
+      rasqal_triples_rowsource_finish(NULL, con);
+      return NULL;
+    }
+
+    for(i = 0; i < con->triples_count; i++) {
+      if(column_exprs[i]) {
+        con->column_exprs[i] = rasqal_new_expression_from_expression(column_exprs[i]);
+        con->column_programs[i] = rasqal_new_expression_program(world, column_exprs[i]);
+      }
+    }
+  }
+
   return rasqal_new_rowsource_from_handler(world, query,
                                            con,
                                            &rasqal_triples_rowsource_handler,
@@ -537,7 +636,8 @@ main(int argc, char *argv[])
   triples_source = rasqal_new_triples_source(query);
   
   rowsource = rasqal_new_triples_rowsource(world, query, triples_source,
-                                           triples, start_column, end_column);
+                                           triples, start_column, end_column,
+                                           NULL);
   if(!rowsource) {
     fprintf(stderr, "%s: failed to create triples rowsource\n", program);
     failures++;
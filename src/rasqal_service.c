@@ -38,6 +38,9 @@
 #include <unistd.h>
 #endif
 #include <stdarg.h>
+#ifdef RASQAL_THREADS_POSIX
+#include <pthread.h>
+#endif
 
 #include "rasqal.h"
 #include "rasqal_internal.h"
@@ -46,6 +49,12 @@
 #define DEFAULT_FORMAT_LEN 30
 
 
+#ifdef RASQAL_THREADS_POSIX
+typedef struct rasqal_service_fetch_s rasqal_service_fetch;
+
+static void rasqal_free_service_fetch(rasqal_service_fetch* fetch);
+#endif
+
 struct rasqal_service_s
 {
   rasqal_world* world;
@@ -67,6 +76,11 @@ struct rasqal_service_s
   raptor_stringbuffer* sb;
   char* content_type;
 
+#ifdef RASQAL_THREADS_POSIX
+  /* background fetch started by rasqal_service_start() (or NULL) */
+  rasqal_service_fetch* fetch;
+#endif
+
   int usage;
 };
 
@@ -192,6 +206,11 @@ rasqal_free_service(rasqal_service* svc)
   
   rasqal_service_set_www(svc, NULL);
 
+#ifdef RASQAL_THREADS_POSIX
+  if(svc->fetch)
+    rasqal_free_service_fetch(svc->fetch);
+#endif
+
   RASQAL_FREE(rasqal_service, svc);
 }
 
@@ -298,60 +317,21 @@ rasqal_service_content_type_handler(raptor_www* www, void* userdata,
 }
 
 
-/**
- * rasqal_service_execute_as_rowsource:
+/*
+ * rasqal_service_get_retrieval_uri_string:
  * @svc: rasqal service
  *
- * INTERNAL - Execute a rasqal sparql protocol service to a rowsurce
+ * INTERNAL - Make the URI string to retrieve for a service
  *
- * Return value: query results or NULL on failure
+ * Return value: new URI string or NULL on failure
  */
-rasqal_rowsource*
-rasqal_service_execute_as_rowsource(rasqal_service* svc,
-                                    rasqal_variables_table* vars_table)
+static unsigned char*
+rasqal_service_get_retrieval_uri_string(rasqal_service* svc)
 {
-  raptor_iostream* read_iostr = NULL;
-  raptor_uri* read_base_uri = NULL;
-  rasqal_query_results_formatter* read_formatter = NULL;
-  raptor_uri* retrieval_uri = NULL;
-  raptor_stringbuffer* uri_sb = NULL;
-  size_t len;
+  raptor_stringbuffer* uri_sb;
   unsigned char* str;
-  raptor_world* raptor_world_ptr = rasqal_world_get_raptor(svc->world);
-  rasqal_rowsource* rowsource = NULL;
-  
-  if(!svc->www) {
-    svc->www = raptor_new_www(raptor_world_ptr);
-
-    if(!svc->www) {
-      rasqal_log_error_simple(svc->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
-                              "Failed to create WWW");
-      goto error;
-    }
-  }
-    
-  svc->started = 0;
-  svc->final_uri = NULL;
-  svc->sb = raptor_new_stringbuffer();
-  svc->content_type = NULL;
-
-#if RASQAL_RAPTOR_VERSION < 20016
-  if(svc->format)
-    raptor_www_set_http_accept(svc->www, svc->format);
-  else
-    raptor_www_set_http_accept(svc->www, DEFAULT_FORMAT);
-#else
-  if(svc->format)
-    raptor_www_set_http_accept2(svc->www, svc->format, svc->format_len);
-  else
-    raptor_www_set_http_accept2(svc->www, DEFAULT_FORMAT, DEFAULT_FORMAT_LEN);
-#endif
-
-  raptor_www_set_write_bytes_handler(svc->www,
-                                     rasqal_service_write_bytes, svc);
-  raptor_www_set_content_type_handler(svc->www,
-                                      rasqal_service_content_type_handler, svc);
-
+  unsigned char* uri_string;
+  size_t len;
 
   /* Construct a URI to retrieve following SPARQL protocol HTTP
    *  binding from concatenation of
@@ -368,7 +348,7 @@ rasqal_service_execute_as_rowsource(rasqal_service* svc,
   if(!uri_sb) {
     rasqal_log_error_simple(svc->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
                             "Failed to create stringbuffer");
-    goto error;
+    return NULL;
   }
 
   str = raptor_uri_as_counted_string(svc->service_uri, &len);
@@ -430,17 +410,782 @@ rasqal_service_execute_as_rowsource(rasqal_service* svc,
   
 
   str = raptor_stringbuffer_as_string(uri_sb);
+  len = raptor_stringbuffer_length(uri_sb);
+  uri_string = RASQAL_MALLOC(unsigned char*, len + 1);
+  if(uri_string)
+    memcpy(uri_string, str, len + 1);
+  raptor_free_stringbuffer(uri_sb);
+
+  return uri_string;
+}
+
+
+/*
+ * rasqal_service_read_rowsource:
+ * @svc: rasqal service
+ * @read_iostr: iostream of the response content
+ * @read_base_uri: base URI of the response content
+ * @content_type: response content type (or NULL)
+ * @vars_table: variables table
+ *
+ * INTERNAL - Decode a service response to a rowsource
+ *
+ * Takes ownership of @read_iostr.
+ *
+ * Return value: rowsource or NULL on failure
+ */
+static rasqal_rowsource*
+rasqal_service_read_rowsource(rasqal_service* svc,
+                              raptor_iostream* read_iostr,
+                              raptor_uri* read_base_uri,
+                              const char* content_type,
+                              rasqal_variables_table* vars_table)
+{
+  rasqal_query_results_formatter* read_formatter;
+  rasqal_rowsource* rowsource;
+
+  read_formatter = rasqal_new_query_results_formatter(svc->world,
+                                                      /* format name */ NULL,
+                                                      content_type,
+                                                      /* format URI */ NULL);
+  if(!read_formatter) {
+    rasqal_log_error_simple(svc->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
+                            "Failed to find query results reader for content type %s returned from %s",
+                            content_type,
+                            raptor_uri_as_string(read_base_uri));
+    raptor_free_iostream(read_iostr);
+    return NULL;
+  }
+
+  /* Takes ownership of read_iostr with flags = 1 */
+  rowsource = rasqal_query_results_formatter_get_read_rowsource(svc->world,
+                                                                read_iostr,
+                                                                read_formatter,
+                                                                vars_table,
+                                                                read_base_uri,
+                                                                /* flags */ 1);
+  if(!rowsource)
+    rasqal_log_error_simple(svc->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
+                            "Failed to decode %s query results data returned from %s",
+                            content_type,
+                            raptor_uri_as_string(read_base_uri));
+
+  rasqal_free_query_results_formatter(read_formatter);
+
+  return rowsource;
+}
+
+
+#ifdef RASQAL_THREADS_POSIX
+
+/* unread response bytes above which the fetch thread waits for the
+ * reader */
+#define RASQAL_SERVICE_FETCH_HIGH_WATER (256 * 1024)
+
+/*
+ * The background fetch threads of a world.  A fetch that is freed
+ * before its request ends is left to its thread to free; the world
+ * waits for those threads since they use its WWW initialisation.
+ */
+struct rasqal_service_fetches_s
+{
+  pthread_mutex_t mutex;
+
+  /* signalled when a fetch thread ends */
+  pthread_cond_t cond;
+
+  int running;
+};
+
+
+/*
+ * A service request fetched by a background thread.  The thread only
+ * uses its own raptor world and WWW and the response fields below,
+ * which are guarded by the mutex.  The response content is read while
+ * it arrives through an iostream that waits when the buffer is empty;
+ * the fetch thread waits when the buffer is over the high-water mark.
+ */
+struct rasqal_service_fetch_s
+{
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+
+  /* used only by the fetch thread once it is started */
+  raptor_world* raptor_world_ptr;
+  raptor_www* www;
+  unsigned char* retrieval_uri_string;
+  /* for reporting a failure seen while reading the response */
+  rasqal_world* world;
+  rasqal_service_fetches* fetches;
+
+  /* response fields */
+  char* content_type;
+  unsigned char* final_uri_string;
+  unsigned char* buffer;
+  size_t buffer_start;
+  size_t buffer_end;
+  size_t buffer_size;
+
+  /* content type and final URI are known */
+  int started;
+  /* the fetch thread has finished */
+  int finished;
+  int failed;
+  /* the response is no longer wanted */
+  int cancelled;
+  /* a failure has been reported to the reader */
+  int failure_reported;
+  /* the fetch was freed while running; the thread frees it */
+  int detached;
+  /* bytes a waiting read needs */
+  size_t read_wanted;
+};
+
+
+/*
+ * rasqal_service_fetch_destroy:
+ * @fetch: service fetch with no thread running
+ *
+ * INTERNAL - Free a service fetch
+ */
+static void
+rasqal_service_fetch_destroy(rasqal_service_fetch* fetch)
+{
+  pthread_cond_destroy(&fetch->cond);
+  pthread_mutex_destroy(&fetch->mutex);
+
+  if(fetch->www)
+    raptor_free_www(fetch->www);
+  if(fetch->raptor_world_ptr)
+    raptor_free_world(fetch->raptor_world_ptr);
+  if(fetch->retrieval_uri_string)
+    RASQAL_FREE(char*, fetch->retrieval_uri_string);
+  if(fetch->content_type)
+    RASQAL_FREE(char*, fetch->content_type);
+  if(fetch->final_uri_string)
+    RASQAL_FREE(char*, fetch->final_uri_string);
+  if(fetch->buffer)
+    RASQAL_FREE(char*, fetch->buffer);
+
+  RASQAL_FREE(rasqal_service_fetch, fetch);
+}
+
+
+static void
+rasqal_service_fetch_log_handler(void *user_data, raptor_log_message *message)
+{
+  /* errors are reported when the response is read */
+}
+
+
+static void
+rasqal_service_fetch_content_type_handler(raptor_www* www, void* userdata, 
+                                          const char* content_type)
+{
+  rasqal_service_fetch* fetch = (rasqal_service_fetch*)userdata;
+  size_t len = strlen(content_type);
+  char* p;
+
+  pthread_mutex_lock(&fetch->mutex);
+  if(fetch->content_type)
+    RASQAL_FREE(char*, fetch->content_type);
+
+  fetch->content_type = RASQAL_MALLOC(char*, len + 1);
+  if(fetch->content_type) {
+    memcpy(fetch->content_type, content_type, len + 1);
+
+    for(p = fetch->content_type; *p; p++) {
+      if(*p == ';' || *p == ' ') {
+        *p = '\0';
+        break;
+      }
+    }
+  }
+  pthread_mutex_unlock(&fetch->mutex);
+}
+
+
+static void
+rasqal_service_fetch_write_bytes(raptor_www* www,
+                                 void *userdata, const void *ptr, 
+                                 size_t size, size_t nmemb)
+{
+  rasqal_service_fetch* fetch = (rasqal_service_fetch*)userdata;
+  size_t len = size * nmemb;
+
+  pthread_mutex_lock(&fetch->mutex);
+
+  if(!fetch->started) {
+    raptor_uri* final_uri = raptor_www_get_final_uri(www);
+
+    if(final_uri) {
+      size_t uri_len;
+      unsigned char* uri_str = raptor_uri_as_counted_string(final_uri,
+                                                            &uri_len);
+
+      fetch->final_uri_string = RASQAL_MALLOC(unsigned char*, uri_len + 1);
+      if(fetch->final_uri_string)
+        memcpy(fetch->final_uri_string, uri_str, uri_len + 1);
+      raptor_free_uri(final_uri);
+    }
+    fetch->started = 1;
+  }
+
+  /* let the reader catch up unless it is waiting for more */
+  while(!fetch->cancelled && !fetch->failed &&
+        fetch->buffer_end - fetch->buffer_start >= RASQAL_SERVICE_FETCH_HIGH_WATER &&
+        fetch->buffer_end - fetch->buffer_start >= fetch->read_wanted)
+    pthread_cond_wait(&fetch->cond, &fetch->mutex);
+
+  if(fetch->cancelled || fetch->failed) {
+    pthread_mutex_unlock(&fetch->mutex);
+    raptor_www_abort(www, "Service request cancelled");
+    return;
+  }
+
+  /* move unread content to the start then grow if still too small */
+  if(fetch->buffer_end + len > fetch->buffer_size && fetch->buffer_start) {
+    memmove(fetch->buffer, fetch->buffer + fetch->buffer_start,
+            fetch->buffer_end - fetch->buffer_start);
+    fetch->buffer_end -= fetch->buffer_start;
+    fetch->buffer_start = 0;
+  }
+
+  if(fetch->buffer_end + len > fetch->buffer_size) {
+    size_t new_size = fetch->buffer_size ? fetch->buffer_size : 4096;
+    unsigned char* new_buffer;
+
+    while(new_size < fetch->buffer_end + len)
+      new_size <<= 1;
+
+    new_buffer = RASQAL_MALLOC(unsigned char*, new_size);
+    if(!new_buffer) {
+      fetch->failed = 1;
+      pthread_cond_broadcast(&fetch->cond);
+      pthread_mutex_unlock(&fetch->mutex);
+      raptor_www_abort(www, "Out of memory");
+      return;
+    }
+
+    if(fetch->buffer) {
+      memcpy(new_buffer, fetch->buffer, fetch->buffer_end);
+      RASQAL_FREE(char*, fetch->buffer);
+    }
+    fetch->buffer = new_buffer;
+    fetch->buffer_size = new_size;
+  }
+
+  memcpy(fetch->buffer + fetch->buffer_end, ptr, len);
+  fetch->buffer_end += len;
+
+  pthread_cond_broadcast(&fetch->cond);
+  pthread_mutex_unlock(&fetch->mutex);
+}
+
+
+static void*
+rasqal_service_fetch_thread(void* arg)
+{
+  rasqal_service_fetch* fetch = (rasqal_service_fetch*)arg;
+  rasqal_service_fetches* fetches = fetch->fetches;
+  raptor_uri* retrieval_uri;
+  int failed = 1;
+  int detached;
+
+  retrieval_uri = raptor_new_uri(fetch->raptor_world_ptr,
+                                 fetch->retrieval_uri_string);
+  if(retrieval_uri) {
+    failed = raptor_www_fetch(fetch->www, retrieval_uri);
+    raptor_free_uri(retrieval_uri);
+  }
+
+  pthread_mutex_lock(&fetch->mutex);
+  if(failed)
+    fetch->failed = 1;
+  fetch->started = 1;
+  fetch->finished = 1;
+  detached = fetch->detached;
+  pthread_cond_broadcast(&fetch->cond);
+  pthread_mutex_unlock(&fetch->mutex);
+
+  if(detached)
+    rasqal_service_fetch_destroy(fetch);
+
+  pthread_mutex_lock(&fetches->mutex);
+  fetches->running--;
+  pthread_cond_broadcast(&fetches->cond);
+  pthread_mutex_unlock(&fetches->mutex);
+
+  return NULL;
+}
+
+
+/*
+ * rasqal_free_service_fetch:
+ * @fetch: service fetch
+ *
+ * INTERNAL - Cancel a service fetch and free it
+ *
+ * Does not wait for a request that is still running: the transfer is
+ * aborted when it next receives content and the fetch thread then
+ * frees the fetch.
+ */
+static void
+rasqal_free_service_fetch(rasqal_service_fetch* fetch)
+{
+  pthread_t thread;
+  int finished;
+
+  pthread_mutex_lock(&fetch->mutex);
+  fetch->cancelled = 1;
+  finished = fetch->finished;
+  fetch->detached = !finished;
+  thread = fetch->thread;
+  /* wake a fetch thread waiting for the reader */
+  pthread_cond_broadcast(&fetch->cond);
+  pthread_mutex_unlock(&fetch->mutex);
+
+  if(!finished) {
+    /* the fetch may already be freed */
+    pthread_detach(thread);
+    return;
+  }
+
+  pthread_join(thread, NULL);
+
+  rasqal_service_fetch_destroy(fetch);
+}
+
+
+static void
+rasqal_service_fetch_iostream_finish(void *user_data)
+{
+  rasqal_free_service_fetch((rasqal_service_fetch*)user_data);
+}
+
+
+static int
+rasqal_service_fetch_iostream_read_bytes(void *user_data, void *ptr,
+                                         size_t size, size_t nmemb)
+{
+  rasqal_service_fetch* fetch = (rasqal_service_fetch*)user_data;
+  size_t avail;
+
+  if(!ptr || size <= 0 || !nmemb)
+    return -1;
+
+  pthread_mutex_lock(&fetch->mutex);
+
+  /* readers take a short read as the end of the content so wait for
+   * the whole request unless the transfer is over
+   */
+  if(fetch->buffer_end - fetch->buffer_start < size * nmemb) {
+    /* a request over the high-water mark still lets the fetch thread
+     * add content */
+    fetch->read_wanted = size * nmemb;
+    pthread_cond_broadcast(&fetch->cond);
+
+    while(fetch->buffer_end - fetch->buffer_start < size * nmemb &&
+          !fetch->finished && !fetch->failed)
+      pthread_cond_wait(&fetch->cond, &fetch->mutex);
+
+    fetch->read_wanted = 0;
+  }
+
+  /* a transfer that failed part way through is an error, not a short
+   * final read of a truncated response
+   */
+  if(fetch->failed) {
+    int report = !fetch->failure_reported;
+
+    fetch->failure_reported = 1;
+    pthread_mutex_unlock(&fetch->mutex);
+
+    if(report)
+      rasqal_log_error_simple(fetch->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
+                              "Failed to fetch retrieval URI %s",
+                              fetch->retrieval_uri_string);
+    return -1;
+  }
+
+  avail = (fetch->buffer_end - fetch->buffer_start) / size;
+  if(avail > nmemb)
+    avail = nmemb;
+
+  memcpy(ptr, fetch->buffer + fetch->buffer_start, avail * size);
+  fetch->buffer_start += avail * size;
+
+  /* wake a fetch thread waiting at the high-water mark */
+  pthread_cond_broadcast(&fetch->cond);
+  pthread_mutex_unlock(&fetch->mutex);
+
+  return RASQAL_BAD_CAST(int, avail);
+}
+
+
+static int
+rasqal_service_fetch_iostream_read_eof(void *user_data)
+{
+  rasqal_service_fetch* fetch = (rasqal_service_fetch*)user_data;
+  int eof;
+
+  pthread_mutex_lock(&fetch->mutex);
+  /* on failure read_bytes reports the error */
+  eof = fetch->finished && !fetch->failed &&
+        fetch->buffer_start >= fetch->buffer_end;
+  pthread_mutex_unlock(&fetch->mutex);
+
+  return eof;
+}
+
+
+static const raptor_iostream_handler rasqal_service_fetch_iostream_handler = {
+  /* .version     = */ 2,
+  /* .init        = */ NULL,
+  /* .finish      = */ rasqal_service_fetch_iostream_finish,
+  /* .write_byte  = */ NULL,
+  /* .write_bytes = */ NULL,
+  /* .write_end   = */ NULL,
+  /* .read_bytes  = */ rasqal_service_fetch_iostream_read_bytes,
+  /* .read_eof    = */ rasqal_service_fetch_iostream_read_eof
+};
+
+
+/*
+ * rasqal_service_fetch_as_rowsource:
+ * @svc: rasqal service started with rasqal_service_start()
+ * @vars_table: variables table
+ *
+ * INTERNAL - Decode the response of a background service fetch
+ *
+ * Waits for the response to start, then returns a rowsource reading
+ * the content as the fetch thread receives it.  The fetch is handed
+ * over to the rowsource.
+ *
+ * Return value: rowsource or NULL on failure
+ */
+static rasqal_rowsource*
+rasqal_service_fetch_as_rowsource(rasqal_service* svc,
+                                  rasqal_variables_table* vars_table)
+{
+  rasqal_service_fetch* fetch = svc->fetch;
+  raptor_world* raptor_world_ptr = rasqal_world_get_raptor(svc->world);
+  raptor_iostream* read_iostr;
+  raptor_uri* final_uri = NULL;
+  rasqal_rowsource* rowsource;
+  char* content_type = NULL;
+  int failed;
+
+  svc->fetch = NULL;
+
+  pthread_mutex_lock(&fetch->mutex);
+  while(!fetch->started && !fetch->failed)
+    pthread_cond_wait(&fetch->cond, &fetch->mutex);
+  failed = fetch->failed;
+  if(!failed && fetch->content_type) {
+    size_t len = strlen(fetch->content_type);
+
+    content_type = RASQAL_MALLOC(char*, len + 1);
+    if(content_type)
+      memcpy(content_type, fetch->content_type, len + 1);
+  }
+  pthread_mutex_unlock(&fetch->mutex);
+
+  if(failed) {
+    rasqal_log_error_simple(svc->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
+                            "Failed to fetch retrieval URI %s",
+                            fetch->retrieval_uri_string);
+    rasqal_free_service_fetch(fetch);
+    return NULL;
+  }
+
+  /* the fetch thread does not change this once started */
+  if(fetch->final_uri_string)
+    final_uri = raptor_new_uri(raptor_world_ptr, fetch->final_uri_string);
+
+  read_iostr = raptor_new_iostream_from_handler(raptor_world_ptr, fetch,
+                                                &rasqal_service_fetch_iostream_handler);
+  if(!read_iostr) {
+    rasqal_log_error_simple(svc->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
+                            "Failed to create iostream from service response");
+    rasqal_free_service_fetch(fetch);
+    rowsource = NULL;
+    goto tidy;
+  }
+
+  /* Takes ownership of read_iostr and so of fetch */
+  rowsource = rasqal_service_read_rowsource(svc, read_iostr,
+                                            final_uri ? final_uri : svc->service_uri,
+                                            content_type, vars_table);
+
+  tidy:
+  if(final_uri)
+    raptor_free_uri(final_uri);
+  if(content_type)
+    RASQAL_FREE(char*, content_type);
+
+  return rowsource;
+}
+
+#endif /* RASQAL_THREADS_POSIX */
+
+
+/*
+ * rasqal_service_start:
+ * @svc: rasqal service
+ *
+ * INTERNAL - Start fetching the service response in a background thread
+ *
+ * rasqal_service_execute_as_rowsource() then returns the rowsource
+ * for the response without waiting for all of it.  The fetch uses
+ * its own raptor world so that the thread shares no state with the
+ * caller; a WWW set with rasqal_service_set_www() is not used.
+ *
+ * Return value: non-0 if the fetch was not started
+ */
+int
+rasqal_service_start(rasqal_service* svc)
+{
+#ifdef RASQAL_THREADS_POSIX
+  rasqal_service_fetches* fetches = svc->world->service_fetches;
+  rasqal_service_fetch* fetch;
+
+  if(svc->fetch || svc->www)
+    return 1;
+
+  if(!fetches) {
+    fetches = RASQAL_CALLOC(rasqal_service_fetches*, 1, sizeof(*fetches));
+    if(!fetches)
+      return 1;
+
+    pthread_mutex_init(&fetches->mutex, NULL);
+    pthread_cond_init(&fetches->cond, NULL);
+    svc->world->service_fetches = fetches;
+  }
+
+  fetch = RASQAL_CALLOC(rasqal_service_fetch*, 1, sizeof(*fetch));
+  if(!fetch)
+    return 1;
+
+  fetch->retrieval_uri_string = rasqal_service_get_retrieval_uri_string(svc);
+  if(!fetch->retrieval_uri_string)
+    goto failed;
+
+  fetch->world = svc->world;
+  fetch->fetches = fetches;
+
+  /* curl and libxml are already initialised by the rasqal world */
+  fetch->raptor_world_ptr = raptor_new_world();
+  if(!fetch->raptor_world_ptr)
+    goto failed;
+  raptor_world_set_flag(fetch->raptor_world_ptr,
+                        RAPTOR_WORLD_FLAG_WWW_SKIP_INIT_FINISH, 1);
+  if(raptor_world_open(fetch->raptor_world_ptr))
+    goto failed;
+  raptor_world_set_log_handler(fetch->raptor_world_ptr, fetch,
+                               rasqal_service_fetch_log_handler);
+
+  fetch->www = raptor_new_www(fetch->raptor_world_ptr);
+  if(!fetch->www)
+    goto failed;
+
+#if RASQAL_RAPTOR_VERSION < 20016
+  if(svc->format)
+    raptor_www_set_http_accept(fetch->www, svc->format);
+  else
+    raptor_www_set_http_accept(fetch->www, DEFAULT_FORMAT);
+#else
+  if(svc->format)
+    raptor_www_set_http_accept2(fetch->www, svc->format, svc->format_len);
+  else
+    raptor_www_set_http_accept2(fetch->www, DEFAULT_FORMAT, DEFAULT_FORMAT_LEN);
+#endif
+
+  raptor_www_set_write_bytes_handler(fetch->www,
+                                     rasqal_service_fetch_write_bytes, fetch);
+  raptor_www_set_content_type_handler(fetch->www,
+                                      rasqal_service_fetch_content_type_handler,
+                                      fetch);
+
+  pthread_mutex_init(&fetch->mutex, NULL);
+  pthread_cond_init(&fetch->cond, NULL);
+
+  pthread_mutex_lock(&fetches->mutex);
+  fetches->running++;
+  pthread_mutex_unlock(&fetches->mutex);
+
+  if(pthread_create(&fetch->thread, NULL, rasqal_service_fetch_thread,
+                    fetch)) {
+    pthread_mutex_lock(&fetches->mutex);
+    fetches->running--;
+    pthread_mutex_unlock(&fetches->mutex);
+
+    pthread_cond_destroy(&fetch->cond);
+    pthread_mutex_destroy(&fetch->mutex);
+    goto failed;
+  }
+
+  svc->fetch = fetch;
+  return 0;
+
+  failed:
+  if(fetch->www)
+    raptor_free_www(fetch->www);
+  if(fetch->raptor_world_ptr)
+    raptor_free_world(fetch->raptor_world_ptr);
+  if(fetch->retrieval_uri_string)
+    RASQAL_FREE(char*, fetch->retrieval_uri_string);
+  RASQAL_FREE(rasqal_service_fetch, fetch);
+#endif
+
+  return 1;
+}
+
+
+/**
+ * rasqal_world_set_service_prefetch_size:
+ * @world: world
+ * @size: maximum number of SERVICE requests to prefetch or 0 to disable
+ *
+ * Set how many SERVICE requests of a query are fetched in the background
+ *
+ * When enabled, the SERVICE requests of a query are started together
+ * when the query is executed, up to @size of them, each fetched in
+ * its own thread.  Results are still decoded in the thread reading
+ * the query results, as the response arrives, so slow endpoints are
+ * waited on at the same time rather than one after the other.  A
+ * fetch thread stops receiving when the unread part of its response
+ * is large, until the query results are read further.
+ *
+ * Freeing the query results does not wait for requests that are
+ * still running; they are aborted when they next receive content.
+ * rasqal_free_world() waits for them to end.
+ *
+ * Prefetching is disabled (size 0) by default and does not use the
+ * world thread pool set with rasqal_world_set_thread_pool_size().
+ *
+ * Return value: non-0 on failure or if threads are not supported
+ */
+int
+rasqal_world_set_service_prefetch_size(rasqal_world* world, int size)
+{
+  RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(world, rasqal_world, 1);
+
+  if(size < 0)
+    return 1;
+
+#ifdef RASQAL_THREADS_POSIX
+  world->service_prefetch_size = size;
+  return 0;
+#else
+  return size ? 1 : 0;
+#endif
+}
+
+
+/*
+ * rasqal_world_finish_service_fetches:
+ * @world: world
+ *
+ * INTERNAL - Wait for the background SERVICE fetches of a world to end
+ */
+void
+rasqal_world_finish_service_fetches(rasqal_world* world)
+{
+#ifdef RASQAL_THREADS_POSIX
+  rasqal_service_fetches* fetches = world->service_fetches;
+
+  if(!fetches)
+    return;
+
+  pthread_mutex_lock(&fetches->mutex);
+  while(fetches->running)
+    pthread_cond_wait(&fetches->cond, &fetches->mutex);
+  pthread_mutex_unlock(&fetches->mutex);
+
+  pthread_cond_destroy(&fetches->cond);
+  pthread_mutex_destroy(&fetches->mutex);
+
+  RASQAL_FREE(rasqal_service_fetches, fetches);
+  world->service_fetches = NULL;
+#endif
+  world->service_prefetch_size = 0;
+}
+
+
+/**
+ * rasqal_service_execute_as_rowsource:
+ * @svc: rasqal service
+ *
+ * INTERNAL - Execute a rasqal sparql protocol service to a rowsurce
+ *
+ * If rasqal_service_start() started the request, the rowsource
+ * reads the response as it arrives.
+ *
+ * Return value: query results or NULL on failure
+ */
+rasqal_rowsource*
+rasqal_service_execute_as_rowsource(rasqal_service* svc,
+                                    rasqal_variables_table* vars_table)
+{
+  raptor_iostream* read_iostr = NULL;
+  raptor_uri* read_base_uri = NULL;
+  raptor_uri* retrieval_uri = NULL;
+  unsigned char* str = NULL;
+  raptor_world* raptor_world_ptr = rasqal_world_get_raptor(svc->world);
+  rasqal_rowsource* rowsource = NULL;
+  
+#ifdef RASQAL_THREADS_POSIX
+  if(svc->fetch)
+    return rasqal_service_fetch_as_rowsource(svc, vars_table);
+#endif
+
+  if(!svc->www) {
+    svc->www = raptor_new_www(raptor_world_ptr);
+
+    if(!svc->www) {
+      rasqal_log_error_simple(svc->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
+                              "Failed to create WWW");
+      goto error;
+    }
+  }
+    
+  svc->started = 0;
+  svc->final_uri = NULL;
+  svc->sb = raptor_new_stringbuffer();
+  svc->content_type = NULL;
+
+#if RASQAL_RAPTOR_VERSION < 20016
+  if(svc->format)
+    raptor_www_set_http_accept(svc->www, svc->format);
+  else
+    raptor_www_set_http_accept(svc->www, DEFAULT_FORMAT);
+#else
+  if(svc->format)
+    raptor_www_set_http_accept2(svc->www, svc->format, svc->format_len);
+  else
+    raptor_www_set_http_accept2(svc->www, DEFAULT_FORMAT, DEFAULT_FORMAT_LEN);
+#endif
+
+  raptor_www_set_write_bytes_handler(svc->www,
+                                     rasqal_service_write_bytes, svc);
+  raptor_www_set_content_type_handler(svc->www,
+                                      rasqal_service_content_type_handler, svc);
+
+
+  str = rasqal_service_get_retrieval_uri_string(svc);
+  if(!str)
+    goto error;
 
   retrieval_uri = raptor_new_uri(raptor_world_ptr, str);
   if(!retrieval_uri) {
     rasqal_log_error_simple(svc->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
                             "Failed to create retrieval URI %s",
-                            raptor_uri_as_string(retrieval_uri));
+                            str);
     goto error;
   }
 
-  raptor_free_stringbuffer(uri_sb); uri_sb = NULL;
-  
   if(raptor_www_fetch(svc->www, retrieval_uri)) {
     rasqal_log_error_simple(svc->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
                             "Failed to fetch retrieval URI %s",
@@ -459,48 +1204,19 @@ rasqal_service_execute_as_rowsource(rasqal_service* svc,
   }
     
   read_base_uri = svc->final_uri ? svc->final_uri : svc->service_uri;
-  read_formatter = rasqal_new_query_results_formatter(svc->world,
-                                                      /* format name */ NULL,
-                                                      svc->content_type,
-                                                      /* format URI */ NULL);
-  if(!read_formatter) {
-    rasqal_log_error_simple(svc->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
-                            "Failed to find query results reader for content type %s returned from %s",
-                            svc->content_type,
-                            raptor_uri_as_string(read_base_uri));
-    goto error;
-  }
 
-  /* Takes ownership of read_iostr with flags = 1 */
-  rowsource = rasqal_query_results_formatter_get_read_rowsource(svc->world,
-                                                                read_iostr,
-                                                                read_formatter,
-                                                                vars_table,
-                                                                read_base_uri,
-                                                                /* flags */ 1);
-  read_iostr = NULL;
-  if(!rowsource) {
-    rasqal_log_error_simple(svc->world, RAPTOR_LOG_LEVEL_ERROR, NULL,
-                            "Failed to decode %s query results data returned from %s",
-                            svc->content_type,
-                            raptor_uri_as_string(read_base_uri));
-    goto error;
-  }
+  /* Takes ownership of read_iostr */
+  rowsource = rasqal_service_read_rowsource(svc, read_iostr, read_base_uri,
+                                            svc->content_type, vars_table);
 
 
   error:
+  if(str)
+    RASQAL_FREE(char*, str);
+
   if(retrieval_uri)
     raptor_free_uri(retrieval_uri);
 
-  if(uri_sb)
-    raptor_free_stringbuffer(uri_sb);
-
-  if(read_formatter)
-    rasqal_free_query_results_formatter(read_formatter);
-
-  if(read_iostr)
-    raptor_free_iostream(read_iostr);
-
   if(svc->final_uri) {
     raptor_free_uri(svc->final_uri);
     svc->final_uri = NULL;
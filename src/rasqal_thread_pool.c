@@ -0,0 +1,439 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * rasqal_thread_pool.c - Rasqal world thread pool
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <rasqal_config.h>
+#endif
+
+#ifdef WIN32
+#include <win32_rasqal_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef RASQAL_THREADS_POSIX
+#include <pthread.h>
+#endif
+
+#include "rasqal.h"
+#include "rasqal_internal.h"
+
+
+#ifndef STANDALONE
+
+#ifdef RASQAL_THREADS_POSIX
+
+/*
+ * The pool runs one batch of tasks at a time.  The thread calling
+ * rasqal_thread_pool_run() takes tasks along with the workers and
+ * returns when every task in the batch has finished.
+ */
+struct rasqal_thread_pool_s {
+  pthread_mutex_t mutex;
+
+  /* signalled when a batch starts or the pool stops */
+  pthread_cond_t work_cond;
+
+  /* signalled when the last running task of a batch finishes */
+  pthread_cond_t done_cond;
+
+  pthread_t* workers;
+  int workers_count;
+
+  /* current batch */
+  rasqal_thread_task_handler handler;
+  void** tasks;
+  int tasks_count;
+  int next_task;
+  int running;
+
+  int stop;
+};
+
+
+static void*
+rasqal_thread_pool_worker(void* arg)
+{
+  rasqal_thread_pool* pool = (rasqal_thread_pool*)arg;
+
+  pthread_mutex_lock(&pool->mutex);
+  while(1) {
+    void* task;
+
+    while(!pool->stop && pool->next_task >= pool->tasks_count)
+      pthread_cond_wait(&pool->work_cond, &pool->mutex);
+
+    if(pool->stop)
+      break;
+
+    task = pool->tasks[pool->next_task++];
+    pool->running++;
+    pthread_mutex_unlock(&pool->mutex);
+
+    pool->handler(task);
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->running--;
+    if(!pool->running && pool->next_task >= pool->tasks_count)
+      pthread_cond_signal(&pool->done_cond);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+
+  return NULL;
+}
+
+
+/*
+ * rasqal_free_thread_pool:
+ * @pool: thread pool
+ *
+ * INTERNAL - Stop the worker threads and destroy a thread pool
+ */
+static void
+rasqal_free_thread_pool(rasqal_thread_pool* pool)
+{
+  int i;
+
+  if(!pool)
+    return;
+
+  pthread_mutex_lock(&pool->mutex);
+  pool->stop = 1;
+  pthread_cond_broadcast(&pool->work_cond);
+  pthread_mutex_unlock(&pool->mutex);
+
+  for(i = 0; i < pool->workers_count; i++)
+    pthread_join(pool->workers[i], NULL);
+
+  pthread_cond_destroy(&pool->done_cond);
+  pthread_cond_destroy(&pool->work_cond);
+  pthread_mutex_destroy(&pool->mutex);
+
+  if(pool->workers)
+    RASQAL_FREE(pthread_t*, pool->workers);
+
+  RASQAL_FREE(rasqal_thread_pool, pool);
+}
+
+
+/*
+ * rasqal_new_thread_pool:
+ * @size: number of threads running tasks including the caller
+ *
+ * INTERNAL - Create a thread pool with @size - 1 worker threads
+ *
+ * Return value: new pool or NULL on failure
+ */
+static rasqal_thread_pool*
+rasqal_new_thread_pool(int size)
+{
+  rasqal_thread_pool* pool;
+
+  pool = RASQAL_CALLOC(rasqal_thread_pool*, 1, sizeof(*pool));
+  if(!pool)
+    return NULL;
+
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->work_cond, NULL);
+  pthread_cond_init(&pool->done_cond, NULL);
+
+  pool->workers = RASQAL_CALLOC(pthread_t*, RASQAL_GOOD_CAST(size_t, size - 1),
+                                sizeof(pthread_t));
+  if(!pool->workers) {
+    rasqal_free_thread_pool(pool);
+    return NULL;
+  }
+
+  for(pool->workers_count = 0;
+      pool->workers_count < size - 1;
+      pool->workers_count++) {
+    if(pthread_create(&pool->workers[pool->workers_count], NULL,
+                      rasqal_thread_pool_worker, pool)) {
+      rasqal_free_thread_pool(pool);
+      return NULL;
+    }
+  }
+
+  return pool;
+}
+
+#endif /* RASQAL_THREADS_POSIX */
+
+
+/**
+ * rasqal_thread_pool_run:
+ * @world: world
+ * @handler: task handler
+ * @tasks: array of task data pointers
+ * @count: number of tasks
+ *
+ * INTERNAL - Run @handler on every task using the world thread pool
+ *
+ * Returns when all the tasks have finished.  Without a thread pool
+ * the tasks are run in order in the calling thread.  Task handlers
+ * must not use the world: its pools and other state are not
+ * thread-safe.
+ */
+void
+rasqal_thread_pool_run(rasqal_world* world, rasqal_thread_task_handler handler,
+                       void** tasks, int count)
+{
+#ifdef RASQAL_THREADS_POSIX
+  rasqal_thread_pool* pool = world->thread_pool;
+
+  if(pool && count > 1) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->handler = handler;
+    pool->tasks = tasks;
+    pool->tasks_count = count;
+    pool->next_task = 0;
+    pthread_cond_broadcast(&pool->work_cond);
+
+    while(pool->next_task < pool->tasks_count) {
+      void* task = pool->tasks[pool->next_task++];
+
+      pool->running++;
+      pthread_mutex_unlock(&pool->mutex);
+
+      handler(task);
+
+      pthread_mutex_lock(&pool->mutex);
+      pool->running--;
+    }
+
+    while(pool->running)
+      pthread_cond_wait(&pool->done_cond, &pool->mutex);
+
+    pool->handler = NULL;
+    pool->tasks = NULL;
+    pool->tasks_count = 0;
+    pool->next_task = 0;
+    pthread_mutex_unlock(&pool->mutex);
+    return;
+  }
+#endif
+
+  while(count--)
+    handler(*tasks++);
+}
+
+
+/**
+ * rasqal_world_finish_thread_pool:
+ * @world: world
+ *
+ * INTERNAL - Stop the world thread pool threads
+ */
+void
+rasqal_world_finish_thread_pool(rasqal_world* world)
+{
+#ifdef RASQAL_THREADS_POSIX
+  if(world->thread_pool) {
+    rasqal_free_thread_pool(world->thread_pool);
+    world->thread_pool = NULL;
+  }
+#endif
+  world->thread_pool_size = 1;
+}
+
+
+/**
+ * rasqal_world_set_thread_pool_size:
+ * @world: world
+ * @size: number of threads to use or 1 to use only the calling thread
+ *
+ * Set the number of threads used for parallel query work
+ *
+ * Large ORDER BY sorts are split across this many threads, the
+ * calling thread included, when every comparison can be made on the
+ * precomputed sort keys.  The sorted order is the same as with a
+ * single thread.
+ *
+ * The pool is only used for work that finishes before the call
+ * that started it returns.  SERVICE requests are not fetched on it;
+ * see rasqal_world_set_service_prefetch_size().
+ *
+ * The pool is disabled (size 1) by default.  Worker threads are
+ * started by this call and stopped when the size changes or the world
+ * is freed.
+ *
+ * Return value: non-0 on failure or if threads are not supported
+ */
+int
+rasqal_world_set_thread_pool_size(rasqal_world* world, int size)
+{
+  RASQAL_ASSERT_OBJECT_POINTER_RETURN_VALUE(world, rasqal_world, 1);
+
+  if(size < 1)
+    return 1;
+
+  rasqal_world_finish_thread_pool(world);
+
+  if(size == 1)
+    return 0;
+
+#ifdef RASQAL_THREADS_POSIX
+  world->thread_pool = rasqal_new_thread_pool(size);
+  if(!world->thread_pool)
+    return 1;
+
+  world->thread_pool_size = size;
+  return 0;
+#else
+  return 1;
+#endif
+}
+
+#endif /* not STANDALONE */
+
+
+
+#ifdef STANDALONE
+
+#define TEST_ROWS_COUNT 50000
+
+/* one more prototype */
+int main(int argc, char *argv[]);
+
+
+static raptor_sequence*
+make_rows(rasqal_world* world)
+{
+  raptor_sequence* seq;
+  int i;
+
+  seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_row,
+                            (raptor_data_print_handler)rasqal_row_print);
+  if(!seq)
+    return NULL;
+
+  for(i = 0; i < TEST_ROWS_COUNT; i++) {
+    rasqal_row* row = rasqal_new_row_for_size(world, 1);
+
+    if(!row || rasqal_row_set_order_size(row, 1)) {
+      rasqal_free_row(row);
+      raptor_free_sequence(seq);
+      return NULL;
+    }
+    row->offset = i;
+    /* plenty of equal values so the offset order matters */
+    row->order_values[0] = rasqal_new_integer_literal(world,
+                                                      RASQAL_LITERAL_INTEGER,
+                                                      (i * 7919) % 1000);
+    rasqal_engine_rowsort_calculate_order_keys(row, RASQAL_COMPARE_XQUERY);
+    raptor_sequence_push(seq, row);
+  }
+
+  return seq;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+  const char *program = rasqal_basename(argv[0]);
+  rasqal_world* world;
+  raptor_sequence* order_seq = NULL;
+  raptor_sequence* serial_seq = NULL;
+  raptor_sequence* parallel_seq = NULL;
+  rasqal_expression* e;
+  int failures = 0;
+  int i;
+
+  world = rasqal_new_world();
+  if(!world || rasqal_world_open(world)) {
+    fprintf(stderr, "%s: rasqal_world init failed\n", program);
+    return(1);
+  }
+
+  if(rasqal_world_set_thread_pool_size(world, 0) == 0) {
+    fprintf(stderr, "%s: thread pool size 0 was accepted\n", program);
+    failures++;
+  }
+
+  order_seq = raptor_new_sequence((raptor_data_free_handler)rasqal_free_expression,
+                                  (raptor_data_print_handler)rasqal_expression_print);
+  e = rasqal_new_1op_expression(world, RASQAL_EXPR_ORDER_COND_DESC,
+                                rasqal_new_literal_expression(world, rasqal_new_integer_literal(world, RASQAL_LITERAL_INTEGER, 0)));
+  raptor_sequence_push(order_seq, e);
+
+  serial_seq = rasqal_engine_rowsort_sort_sequence(world, make_rows(world),
+                                                   order_seq,
+                                                   RASQAL_COMPARE_XQUERY);
+
+  if(rasqal_world_set_thread_pool_size(world, 4)) {
+    fprintf(stderr, "%s: no thread support, sorting with one thread\n",
+            program);
+  }
+  parallel_seq = rasqal_engine_rowsort_sort_sequence(world, make_rows(world),
+                                                     order_seq,
+                                                     RASQAL_COMPARE_XQUERY);
+
+  if(!serial_seq || !parallel_seq ||
+     raptor_sequence_size(serial_seq) != TEST_ROWS_COUNT ||
+     raptor_sequence_size(parallel_seq) != TEST_ROWS_COUNT) {
+    fprintf(stderr, "%s: sorting failed\n", program);
+    failures++;
+    goto tidy;
+  }
+
+  for(i = 0; i < TEST_ROWS_COUNT; i++) {
+    rasqal_row* serial_row = (rasqal_row*)raptor_sequence_get_at(serial_seq, i);
+    rasqal_row* parallel_row = (rasqal_row*)raptor_sequence_get_at(parallel_seq, i);
+
+    if(serial_row->offset != parallel_row->offset) {
+      fprintf(stderr, "%s: row %d has offset %d, expected %d\n", program, i,
+              parallel_row->offset, serial_row->offset);
+      failures++;
+      break;
+    }
+
+    if(i > 0) {
+      rasqal_row* prev_row = (rasqal_row*)raptor_sequence_get_at(parallel_seq, i - 1);
+
+      if(prev_row->order_values[0]->value.integer <
+         parallel_row->order_values[0]->value.integer ||
+         (prev_row->order_values[0]->value.integer ==
+          parallel_row->order_values[0]->value.integer &&
+          prev_row->offset > parallel_row->offset)) {
+        fprintf(stderr, "%s: row %d is out of order\n", program, i);
+        failures++;
+        break;
+      }
+    }
+  }
+
+  tidy:
+  if(serial_seq)
+    raptor_free_sequence(serial_seq);
+  if(parallel_seq)
+    raptor_free_sequence(parallel_seq);
+  raptor_free_sequence(order_seq);
+
+  rasqal_free_world(world);
+
+  return failures;
+}
+
+#endif /* STANDALONE */
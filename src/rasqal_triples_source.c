@@ -41,6 +41,8 @@
 #include "rasqal_internal.h"
 
 
+#ifndef STANDALONE
+
 /**
  * rasqal_set_triples_source_factory:
  * @world: rasqal_world object
@@ -396,3 +398,182 @@ rasqal_triples_source_support_feature(rasqal_triples_source *rts,
 }
 
 
+/*
+ * rasqal_triples_source_get_statistic:
+ * @rts: triples source
+ * @statistic: statistic to get
+ * @t: triple pattern
+ * @count_p: pointer to store count
+ * @exact_p: pointer to store non-0 if the count is exact (or NULL)
+ *
+ * INTERNAL - Get a statistic about the triples matching a triple pattern
+ *
+ * Return value: 0 on success, <0 if not available or >0 on failure
+ */
+int
+rasqal_triples_source_get_statistic(rasqal_triples_source *rts,
+                                    rasqal_triples_source_statistic statistic,
+                                    rasqal_triple *t,
+                                    long *count_p, int *exact_p)
+{
+  int exact = 0;
+  int rc;
+
+  if(!(rts->version >= 3 && rts->get_statistic))
+    return -1;
+
+  rc = rts->get_statistic(rts->user_data, statistic, t, count_p, &exact);
+  if(!rc && exact_p)
+    *exact_p = exact;
+
+  return rc;
+}
+
+
+#endif /* not STANDALONE */
+
+
+
+#ifdef STANDALONE
+
+/* one more prototype */
+int main(int argc, char *argv[]);
+
+#define EX "http://example.org/"
+
+static const char statistics_data[] = "\
+<" EX "a> <" EX "knows> <" EX "b> .\n\
+<" EX "a> <" EX "knows> <" EX "c> .\n\
+<" EX "b> <" EX "knows> <" EX "c> .\n\
+<" EX "c> <" EX "rare> \"c\" .\n";
+
+/* the structural costs of both triple patterns are the same */
+#define STATISTICS_QUERY "\
+PREFIX ex: <" EX "> \
+SELECT * WHERE { ?x ex:knows ?y . ?y ex:rare ?z }"
+
+
+static int
+check_statistic(const char* program, rasqal_triples_source* rts,
+                rasqal_triple* t, rasqal_triples_source_statistic statistic,
+                long expected)
+{
+  long count = -1;
+  int exact = 0;
+  int rc;
+
+  rc = rasqal_triples_source_get_statistic(rts, statistic, t, &count, &exact);
+  if(rc || count != expected || !exact) {
+    fprintf(stderr,
+            "%s: statistic %d returned %d with count %ld (exact %d), expected exact count %ld\n",
+            program, RASQAL_GOOD_CAST(int, statistic), rc, count, exact,
+            expected);
+    return 1;
+  }
+
+  return 0;
+}
+
+
+int
+main(int argc, char *argv[])
+{
+  const char *program = rasqal_basename(argv[0]);
+  rasqal_world* world;
+  rasqal_query* query = NULL;
+  raptor_iostream* iostr = NULL;
+  raptor_uri* base_uri = NULL;
+  rasqal_data_graph* dg;
+  rasqal_triples_source* rts = NULL;
+  rasqal_triple* t;
+  int failures = 0;
+
+  world = rasqal_new_world();
+  if(!world || rasqal_world_open(world)) {
+    fprintf(stderr, "%s: rasqal_world init failed\n", program);
+    return(1);
+  }
+
+  query = rasqal_new_query(world, "sparql", NULL);
+  if(!query ||
+     rasqal_query_prepare(query,
+                          RASQAL_GOOD_CAST(const unsigned char*, STATISTICS_QUERY),
+                          NULL)) {
+    fprintf(stderr, "%s: failed to prepare query\n", program);
+    failures++;
+    goto tidy;
+  }
+
+  base_uri = raptor_new_uri(world->raptor_world_ptr,
+                            RASQAL_GOOD_CAST(const unsigned char*, EX));
+  iostr = raptor_new_iostream_from_string(world->raptor_world_ptr,
+                                          RASQAL_BAD_CAST(void*, statistics_data),
+                                          strlen(statistics_data));
+  dg = rasqal_new_data_graph_from_iostream(world, iostr, base_uri,
+                                           /* name URI */ NULL,
+                                           RASQAL_DATA_GRAPH_BACKGROUND,
+                                           /* format type */ NULL,
+                                           "ntriples",
+                                           /* format URI */ NULL);
+  if(!dg || rasqal_query_add_data_graph(query, dg)) {
+    fprintf(stderr, "%s: failed to add data graph\n", program);
+    failures++;
+    goto tidy;
+  }
+
+  rts = rasqal_new_triples_source(query);
+  if(!rts) {
+    fprintf(stderr, "%s: failed to create triples source\n", program);
+    failures++;
+    goto tidy;
+  }
+
+  /* (?x ex:knows ?y) */
+  t = rasqal_query_get_triple(query, 0);
+  failures += check_statistic(program, rts, t,
+                              RASQAL_TRIPLES_SOURCE_STATISTIC_TRIPLES, 3);
+  failures += check_statistic(program, rts, t,
+                              RASQAL_TRIPLES_SOURCE_STATISTIC_DISTINCT_SUBJECTS, 2);
+  failures += check_statistic(program, rts, t,
+                              RASQAL_TRIPLES_SOURCE_STATISTIC_DISTINCT_OBJECTS, 2);
+
+  /* (?y ex:rare ?z) */
+  t = rasqal_query_get_triple(query, 1);
+  failures += check_statistic(program, rts, t,
+                              RASQAL_TRIPLES_SOURCE_STATISTIC_TRIPLES, 1);
+  failures += check_statistic(program, rts, t,
+                              RASQAL_TRIPLES_SOURCE_STATISTIC_DISTINCT_SUBJECTS, 1);
+
+  /* The pattern with fewer triples is matched first */
+  if(rasqal_query_reorder_triple_patterns_by_statistics(query, rts)) {
+    fprintf(stderr, "%s: reordering triple patterns failed\n", program);
+    failures++;
+    goto tidy;
+  }
+
+  t = rasqal_query_get_triple(query, 0);
+  if(!t || !t->predicate || t->predicate->type != RASQAL_LITERAL_URI ||
+     strcmp(RASQAL_GOOD_CAST(const char*,
+                             raptor_uri_as_string(t->predicate->value.uri)),
+            EX "rare")) {
+    fprintf(stderr, "%s: triple pattern with predicate %s was not moved first\n",
+            program, EX "rare");
+    failures++;
+  }
+
+  tidy:
+  if(rts)
+    rasqal_free_triples_source(rts);
+  if(query)
+    rasqal_free_query(query);
+  if(iostr)
+    raptor_free_iostream(iostr);
+  if(base_uri)
+    raptor_free_uri(base_uri);
+
+  rasqal_free_world(world);
+
+  return failures;
+}
+
+#endif /* STANDALONE */
@@ -0,0 +1,584 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * rasqal_bgp_test.c - Rasqal RDF Query Basic Graph Pattern Order Tests
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <rasqal_config.h>
+#endif
+
+#ifdef WIN32
+#include <win32_rasqal_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#include <stdarg.h>
+
+#include "rasqal.h"
+#include "rasqal_internal.h"
+
+#ifdef RASQAL_QUERY_SPARQL
+
+#define QUERY_LANGUAGE "sparql"
+
+#define QUERY_PREFIXES "PREFIX : <http://example.org/ns#> \
+PREFIX rdf: <http://www.w3.org/1999/02/22-rdf-syntax-ns#> "
+
+#define MAX_PATTERNS 4
+
+/* BGPs over triples.ttl.  The triple patterns of a BGP are reordered
+ * by estimated selectivity so every order they are written in must
+ * give the rows of joining each pattern on its own.
+ */
+static const struct {
+  /* projected variables; results are ordered by them */
+  const char* vars;
+  const char* patterns[MAX_PATTERNS + 1];
+  const char* filter;
+  int expected_count;
+} bgp_tests[] = {
+  /* pairs of adjacent members with what points at the first */
+  { "?p ?a ?b",
+    { "?x ?p ?l", "?l rdf:first ?a", "?l rdf:rest ?r", "?r rdf:first ?b",
+      NULL },
+    NULL, 3 },
+  /* members before the last */
+  { "?a",
+    { "?l rdf:first ?a", "?l rdf:rest ?r", "?r rdf:rest rdf:nil", NULL },
+    NULL, 2 },
+  /* adjacent members */
+  { "?a ?b",
+    { "?l rdf:rest ?r", "?r rdf:first ?b", "?l rdf:first ?a", NULL },
+    NULL, 3 },
+  /* no shared variable: a cross product */
+  { "?a",
+    { "?x :list1 ?l", "?m rdf:first ?a", NULL },
+    NULL, 6 },
+  /* with a FILTER */
+  { "?p ?a",
+    { "?x ?p ?l", "?l rdf:first ?a", NULL },
+    "FILTER(?a > 20)", 4 },
+  { NULL, { NULL }, NULL, 0 }
+};
+
+/* A FILTER+BGP query executed over stats-a.nt and then again after
+ * adding stats-b.nt.  ex:p has fewer triples than ex:q in the first
+ * data and more with both.  The second execution reuses the algebra
+ * built by the first so it must keep the pattern order it was built
+ * with rather than reorder by the new statistics.
+ */
+#define STATS_QUERY "PREFIX ex: <http://example.org/> \
+SELECT ?s ?o ?n \
+WHERE { ?s ex:p ?o . ?s ex:q ?n . FILTER(isURI(?o)) } \
+ORDER BY ?s ?o"
+
+static const char* const stats_data_files[] = {
+  "stats-a.nt", "stats-b.nt"
+};
+
+static const char* const stats_a_rows[] = {
+  "http://example.org/s1 http://example.org/o1 one",
+  NULL
+};
+
+static const char* const stats_ab_rows[] = {
+  "http://example.org/s1 http://example.org/o1 one",
+  "http://example.org/s1 http://example.org/o9 one",
+  "http://example.org/s4 http://example.org/o4 four",
+  NULL
+};
+
+static const char* const* const stats_rows[] = {
+  stats_a_rows, stats_ab_rows
+};
+
+/* A BGP that the structural costs reorder to match the rdf:type
+ * pattern first.  The query must keep the order it was written in.
+ */
+#define WRITTEN_ORDER_QUERY QUERY_PREFIXES "SELECT ?s \
+WHERE { ?s ?p ?o . ?s rdf:type :Rare }"
+
+#else
+#define NO_QUERY_LANGUAGE
+#endif
+
+
+#ifdef NO_QUERY_LANGUAGE
+/*
+ * Prepare a query whose BGP is reordered and check that only the
+ * query plan triples are in the new order.  Return the number of
+ * failures.
+ */
+static int
+test_written_order(rasqal_world* world, const char* program,
+                   raptor_uri* base_uri)
+{
+  rasqal_query* query;
+  rasqal_triple* t;
+  int failures = 0;
+
+  query = rasqal_new_query(world, QUERY_LANGUAGE, NULL);
+  if(!query) {
+    fprintf(stderr, "%s: creating query in language %s FAILED\n", program,
+            QUERY_LANGUAGE);
+    return 1;
+  }
+
+  printf("%s: preparing written order query\n", program);
+  if(rasqal_query_prepare(query, (const unsigned char*)WRITTEN_ORDER_QUERY,
+                          base_uri)) {
+    fprintf(stderr, "%s: %s query prepare '%s' FAILED\n", program,
+            QUERY_LANGUAGE, WRITTEN_ORDER_QUERY);
+    failures++;
+    goto tidy;
+  }
+
+  t = rasqal_query_get_triple(query, 0);
+  if(!t || !rasqal_literal_as_variable(t->predicate)) {
+    printf("%s: written order query FAILED - query triple 0 is not the first written triple pattern\n",
+           program);
+    failures++;
+  }
+
+  t = (rasqal_triple*)raptor_sequence_get_at(rasqal_query_get_plan_triple_sequence(query), 0);
+  if(!t || rasqal_literal_as_variable(t->predicate)) {
+    printf("%s: written order query FAILED - plan triple 0 is not the rdf:type triple pattern\n",
+           program);
+    failures++;
+  }
+
+  tidy:
+  rasqal_free_query(query);
+
+  return failures;
+}
+
+
+int
+main(int argc, char **argv) {
+  const char *program=rasqal_basename(argv[0]);
+  fprintf(stderr, "%s: No supported query language available, skipping test\n", program);
+  return(0);
+}
+#else
+
+static void
+free_row_string(char* row_string)
+{
+  RASQAL_FREE(char*, row_string);
+}
+
+
+/* Return the rows of results as a sequence of strings or NULL on failure */
+static raptor_sequence*
+read_rows(rasqal_query_results *results)
+{
+  raptor_sequence *rows;
+
+  rows = raptor_new_sequence((raptor_data_free_handler)free_row_string, NULL);
+  while(rows && !rasqal_query_results_finished(results)) {
+    raptor_stringbuffer* sb;
+    char* row_string = NULL;
+    int count = rasqal_query_results_get_bindings_count(results);
+    int i;
+
+    sb = raptor_new_stringbuffer();
+    for(i = 0; sb && i < count; i++) {
+      rasqal_literal* value = rasqal_query_results_get_binding_value(results,
+                                                                     i);
+      const unsigned char* str = NULL;
+
+      if(value)
+        str = rasqal_literal_as_string(value);
+      if(i)
+        raptor_stringbuffer_append_counted_string(sb,
+                                                  (const unsigned char*)" ",
+                                                  1, 1);
+      raptor_stringbuffer_append_string(sb, str ? str :
+                                        (const unsigned char*)"-", 1);
+    }
+
+    if(sb) {
+      size_t len = raptor_stringbuffer_length(sb);
+
+      row_string = RASQAL_MALLOC(char*, len + 1);
+      if(row_string) {
+        if(len)
+          memcpy(row_string, raptor_stringbuffer_as_string(sb), len);
+        row_string[len] = '\0';
+      }
+      raptor_free_stringbuffer(sb);
+    }
+
+    if(!row_string || raptor_sequence_push(rows, row_string)) {
+      raptor_free_sequence(rows);
+      rows = NULL;
+      break;
+    }
+
+    rasqal_query_results_next(results);
+  }
+
+  return rows;
+}
+
+
+/* Return the result rows as a sequence of strings or NULL on failure */
+static raptor_sequence*
+run_query(rasqal_world* world, const char* program, raptor_uri* base_uri,
+          const char* query_string)
+{
+  rasqal_query *query;
+  rasqal_query_results *results;
+  raptor_sequence *rows = NULL;
+
+  query = rasqal_new_query(world, QUERY_LANGUAGE, NULL);
+  if(!query) {
+    fprintf(stderr, "%s: creating query in language %s FAILED\n", program,
+            QUERY_LANGUAGE);
+    return NULL;
+  }
+
+  if(rasqal_query_prepare(query, (const unsigned char*)query_string,
+                          base_uri)) {
+    fprintf(stderr, "%s: %s query prepare '%s' FAILED\n", program,
+            QUERY_LANGUAGE, query_string);
+    goto tidy;
+  }
+
+  results = rasqal_query_execute(query);
+  if(!results) {
+    fprintf(stderr, "%s: query '%s' execution FAILED\n", program,
+            query_string);
+    goto tidy;
+  }
+
+  rows = read_rows(results);
+
+  rasqal_free_query_results(results);
+
+  tidy:
+  rasqal_free_query(query);
+
+  return rows;
+}
+
+
+/* Return non-0 if the rows are not the same */
+static int
+compare_rows(const char* program, int test_i, const char* label,
+             raptor_sequence* rows, raptor_sequence* expected_rows)
+{
+  int count = raptor_sequence_size(expected_rows);
+  int i;
+
+  if(raptor_sequence_size(rows) != count) {
+    printf("%s: test %d %s FAILED returning %d results, expected %d\n",
+           program, test_i, label, raptor_sequence_size(rows), count);
+    return 1;
+  }
+
+  for(i = 0; i < count; i++) {
+    const char* got = (const char*)raptor_sequence_get_at(rows, i);
+    const char* expected = (const char*)raptor_sequence_get_at(expected_rows,
+                                                               i);
+
+    if(strcmp(got, expected)) {
+      printf("%s: test %d %s result %d FAILED returning '%s', expected '%s'\n",
+             program, test_i, label, i, got, expected);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+
+/* Step @order to the next permutation; return 0 after the last one */
+static int
+next_permutation(int* order, int size)
+{
+  int i;
+  int j;
+  int tmp;
+
+  for(i = size - 2; i >= 0 && order[i] > order[i + 1]; i--)
+    ;
+  if(i < 0)
+    return 0;
+
+  for(j = size - 1; order[j] < order[i]; j--)
+    ;
+  tmp = order[i]; order[i] = order[j]; order[j] = tmp;
+
+  /* reverse the tail after i */
+  for(i++, j = size - 1; i < j; i++, j--) {
+    tmp = order[i]; order[i] = order[j]; order[j] = tmp;
+  }
+
+  return 1;
+}
+
+
+/*
+ * Execute one prepared query twice with more data the second time so
+ * that the triples source statistics would give another pattern
+ * order.  Return the number of failures.
+ */
+static int
+test_statistics_reorder(rasqal_world* world, const char* program,
+                        raptor_uri* base_uri, const char* data_dir)
+{
+  rasqal_query* query;
+  int failures = 0;
+  int step;
+
+  query = rasqal_new_query(world, QUERY_LANGUAGE, NULL);
+  if(!query) {
+    fprintf(stderr, "%s: creating query in language %s FAILED\n", program,
+            QUERY_LANGUAGE);
+    return 1;
+  }
+
+  if(rasqal_query_prepare(query, (const unsigned char*)STATS_QUERY,
+                          base_uri)) {
+    fprintf(stderr, "%s: %s query prepare '%s' FAILED\n", program,
+            QUERY_LANGUAGE, STATS_QUERY);
+    failures++;
+    goto tidy;
+  }
+
+  for(step = 0; step < 2; step++) {
+    const char* const* expected_rows = stats_rows[step];
+    size_t uri_len = strlen(data_dir) + 16;
+    unsigned char* uri_string;
+    raptor_uri* data_uri;
+    rasqal_data_graph* dg = NULL;
+    rasqal_query_results* results;
+    raptor_sequence* rows = NULL;
+    int i;
+
+    uri_string = RASQAL_MALLOC(unsigned char*, uri_len);
+    if(!uri_string) {
+      failures++;
+      break;
+    }
+    snprintf((char*)uri_string, uri_len, "%s/%s", data_dir,
+             stats_data_files[step]);
+    data_uri = raptor_new_uri(world->raptor_world_ptr, uri_string);
+    RASQAL_FREE(char*, uri_string);
+    if(data_uri) {
+      dg = rasqal_new_data_graph_from_uri(world, data_uri,
+                                          /* name URI */ NULL,
+                                          RASQAL_DATA_GRAPH_BACKGROUND,
+                                          NULL, NULL, NULL);
+      raptor_free_uri(data_uri);
+    }
+    if(!dg || rasqal_query_add_data_graph(query, dg)) {
+      fprintf(stderr, "%s: adding data graph %s FAILED\n", program,
+              stats_data_files[step]);
+      failures++;
+      break;
+    }
+
+    printf("%s: executing statistics query with %d data graphs\n", program,
+           step + 1);
+    results = rasqal_query_execute(query);
+    if(results) {
+      rows = read_rows(results);
+      rasqal_free_query_results(results);
+    }
+    if(!rows) {
+      fprintf(stderr, "%s: statistics query execution %d FAILED\n", program,
+              step + 1);
+      failures++;
+      continue;
+    }
+
+    for(i = 0; expected_rows[i]; i++)
+      ;
+    if(raptor_sequence_size(rows) != i) {
+      printf("%s: statistics query execution %d FAILED returning %d results, expected %d\n",
+             program, step + 1, raptor_sequence_size(rows), i);
+      failures++;
+    } else {
+      for(i = 0; expected_rows[i]; i++) {
+        const char* got = (const char*)raptor_sequence_get_at(rows, i);
+
+        if(strcmp(got, expected_rows[i])) {
+          printf("%s: statistics query execution %d result %d FAILED returning '%s', expected '%s'\n",
+                 program, step + 1, i, got, expected_rows[i]);
+          failures++;
+          break;
+        }
+      }
+    }
+
+    raptor_free_sequence(rows);
+  }
+
+  tidy:
+  rasqal_free_query(query);
+
+  return failures;
+}
+
+
+int
+main(int argc, char **argv) {
+  const char *program=rasqal_basename(argv[0]);
+  raptor_uri *base_uri;
+  unsigned char *uri_string;
+  unsigned char *data_dir_string;
+  char *dataset;
+  size_t dataset_len;
+  int failures=0;
+  int test_i;
+  rasqal_world *world;
+
+  if(argc != 2) {
+    fprintf(stderr, "USAGE: %s <path to data directory>\n", program);
+    return(1);
+  }
+
+  world=rasqal_new_world();
+  if(!world || rasqal_world_open(world)) {
+    fprintf(stderr, "%s: rasqal_world init failed\n", program);
+    return(1);
+  }
+
+  uri_string=raptor_uri_filename_to_uri_string("");
+  base_uri = raptor_new_uri(world->raptor_world_ptr, uri_string);
+  raptor_free_memory(uri_string);
+
+  data_dir_string=raptor_uri_filename_to_uri_string(argv[1]);
+  dataset_len = strlen((const char*)data_dir_string) + 32;
+  dataset = RASQAL_MALLOC(char*, dataset_len);
+  snprintf(dataset, dataset_len, "FROM <%s/triples.ttl>",
+           (const char*)data_dir_string);
+
+  for(test_i = 0; bgp_tests[test_i].vars; test_i++) {
+    const char* vars = bgp_tests[test_i].vars;
+    const char* filter = bgp_tests[test_i].filter;
+    raptor_stringbuffer* sb;
+    raptor_sequence* expected_rows;
+    int order[MAX_PATTERNS];
+    int size;
+    int i;
+
+    for(size = 0; bgp_tests[test_i].patterns[size]; size++)
+      order[size] = size;
+
+    /* each pattern alone in a sub-SELECT is matched on its own and
+     * the results joined */
+    sb = raptor_new_stringbuffer();
+    raptor_stringbuffer_append_string(sb, (const unsigned char*)QUERY_PREFIXES "SELECT ", 1);
+    raptor_stringbuffer_append_string(sb, (const unsigned char*)vars, 1);
+    raptor_stringbuffer_append_string(sb, (const unsigned char*)" ", 1);
+    raptor_stringbuffer_append_string(sb, (const unsigned char*)dataset, 1);
+    raptor_stringbuffer_append_string(sb, (const unsigned char*)" WHERE { ", 1);
+    for(i = 0; i < size; i++) {
+      raptor_stringbuffer_append_string(sb, (const unsigned char*)"{ SELECT * WHERE { ", 1);
+      raptor_stringbuffer_append_string(sb, (const unsigned char*)bgp_tests[test_i].patterns[i], 1);
+      raptor_stringbuffer_append_string(sb, (const unsigned char*)" } } ", 1);
+    }
+    if(filter)
+      raptor_stringbuffer_append_string(sb, (const unsigned char*)filter, 1);
+    raptor_stringbuffer_append_string(sb, (const unsigned char*)" } ORDER BY ", 1);
+    raptor_stringbuffer_append_string(sb, (const unsigned char*)vars, 1);
+
+    printf("%s: executing test %d joining single patterns\n", program, test_i);
+    expected_rows = run_query(world, program, base_uri,
+                              (const char*)raptor_stringbuffer_as_string(sb));
+    raptor_free_stringbuffer(sb);
+    if(!expected_rows) {
+      failures++;
+      continue;
+    }
+
+    if(raptor_sequence_size(expected_rows) != bgp_tests[test_i].expected_count) {
+      printf("%s: test %d FAILED returning %d results, expected %d\n",
+             program, test_i, raptor_sequence_size(expected_rows),
+             bgp_tests[test_i].expected_count);
+      failures++;
+    }
+
+    /* the same patterns as one BGP in every order */
+    do {
+      char label[32];
+      raptor_sequence* rows;
+
+      sb = raptor_new_stringbuffer();
+      raptor_stringbuffer_append_string(sb, (const unsigned char*)QUERY_PREFIXES "SELECT ", 1);
+      raptor_stringbuffer_append_string(sb, (const unsigned char*)vars, 1);
+      raptor_stringbuffer_append_string(sb, (const unsigned char*)" ", 1);
+      raptor_stringbuffer_append_string(sb, (const unsigned char*)dataset, 1);
+      raptor_stringbuffer_append_string(sb, (const unsigned char*)" WHERE { ", 1);
+      for(i = 0; i < size; i++) {
+        raptor_stringbuffer_append_string(sb, (const unsigned char*)bgp_tests[test_i].patterns[order[i]], 1);
+        raptor_stringbuffer_append_string(sb, (const unsigned char*)" . ", 1);
+      }
+      if(filter)
+        raptor_stringbuffer_append_string(sb, (const unsigned char*)filter, 1);
+      raptor_stringbuffer_append_string(sb, (const unsigned char*)" } ORDER BY ", 1);
+      raptor_stringbuffer_append_string(sb, (const unsigned char*)vars, 1);
+
+      for(i = 0; i < size; i++)
+        label[i] = RASQAL_GOOD_CAST(char, '0' + order[i]);
+      label[size] = '\0';
+
+      printf("%s: executing test %d with patterns in order %s\n", program,
+             test_i, label);
+      rows = run_query(world, program, base_uri,
+                       (const char*)raptor_stringbuffer_as_string(sb));
+      raptor_free_stringbuffer(sb);
+      if(!rows) {
+        failures++;
+        continue;
+      }
+
+      if(compare_rows(program, test_i, label, rows, expected_rows))
+        failures++;
+
+      raptor_free_sequence(rows);
+    } while(next_permutation(order, size));
+
+    raptor_free_sequence(expected_rows);
+  }
+
+  failures += test_statistics_reorder(world, program, base_uri,
+                                      (const char*)data_dir_string);
+
+  failures += test_written_order(world, program, base_uri);
+
+  RASQAL_FREE(char*, dataset);
+  raptor_free_memory(data_dir_string);
+
+  raptor_free_uri(base_uri);
+
+  rasqal_free_world(world);
+
+  return failures;
+}
+
+#endif
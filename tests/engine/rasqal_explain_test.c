@@ -0,0 +1,236 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * rasqal_explain_test.c - Rasqal RDF Query EXPLAIN Tests
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <rasqal_config.h>
+#endif
+
+#ifdef WIN32
+#include <win32_rasqal_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#include <stdarg.h>
+
+#include "rasqal.h"
+#include "rasqal_internal.h"
+
+#ifdef RASQAL_QUERY_SPARQL
+
+#define QUERY_LANGUAGE "sparql"
+
+#define EXPLAIN_QUERY_FORMAT "\
+PREFIX ex: <http://ex.example.org#> \n\
+SELECT $zoo \n\
+FROM <%s/%s> \n\
+WHERE { \n\
+  $zoo ex:hasAnimal $animal \n\
+}"
+
+#define ANIMALS_COUNT 26
+
+/* operators at the root of the plan and reading the data */
+#define ROOT_OPERATOR "project"
+#define TRIPLES_OPERATOR "triple pattern"
+
+#else
+#define NO_QUERY_LANGUAGE
+#endif
+
+
+#ifdef NO_QUERY_LANGUAGE
+int
+main(int argc, char **argv) {
+  const char *program=rasqal_basename(argv[0]);
+  fprintf(stderr, "%s: No supported query language available, skipping test\n", program);
+  return(0);
+}
+#else
+
+static int
+get_integer_binding(rasqal_query_results *results, const char* name)
+{
+  rasqal_literal *value;
+  int error = 0;
+  int i;
+
+  value = rasqal_query_results_get_binding_value_by_name(results,
+                                                         (const unsigned char*)name);
+  if(!value)
+    return -1;
+
+  i = rasqal_literal_as_integer(value, &error);
+  return error ? -1 : i;
+}
+
+
+/* Return the number of failures */
+static int
+check_explain(rasqal_world* world, const char* program, const char* data_dir,
+              raptor_uri* base_uri, int explain)
+{
+  static const char* animals="animals.nt";
+  const char* mode = (explain == RASQAL_QUERY_EXPLAIN_ANALYZE) ? "ANALYZE" : "PLAN";
+  rasqal_query *query;
+  rasqal_query_results *results;
+  unsigned char *data_dir_string;
+  unsigned char *query_string;
+  size_t qs_len;
+  int failures = 0;
+  int rows = 0;
+  int seen_root = 0;
+  int seen_triples = 0;
+
+  data_dir_string=raptor_uri_filename_to_uri_string(data_dir);
+  qs_len = strlen((const char*)data_dir_string) + strlen(animals) + strlen(EXPLAIN_QUERY_FORMAT);
+  query_string = RASQAL_MALLOC(unsigned char*, qs_len + 1);
+  snprintf((char*)query_string, qs_len, EXPLAIN_QUERY_FORMAT, data_dir_string,
+           animals);
+  raptor_free_memory(data_dir_string);
+
+  query=rasqal_new_query(world, QUERY_LANGUAGE, NULL);
+  if(!query) {
+    fprintf(stderr, "%s: creating query in language %s FAILED\n", program,
+            QUERY_LANGUAGE);
+    RASQAL_FREE(char*, query_string);
+    return 1;
+  }
+
+  rasqal_query_set_explain(query, explain);
+
+  printf("%s: preparing %s query for EXPLAIN %s\n", program, QUERY_LANGUAGE,
+         mode);
+  if(rasqal_query_prepare(query, query_string, base_uri)) {
+    fprintf(stderr, "%s: %s query prepare '%s' FAILED\n", program,
+            QUERY_LANGUAGE, query_string);
+    RASQAL_FREE(char*, query_string);
+    rasqal_free_query(query);
+    return 1;
+  }
+  RASQAL_FREE(char*, query_string);
+
+  results=rasqal_query_execute(query);
+  if(!results) {
+    fprintf(stderr, "%s: EXPLAIN %s query execution FAILED\n", program, mode);
+    rasqal_free_query(query);
+    return 1;
+  }
+
+  while(!rasqal_query_results_finished(results)) {
+    rasqal_literal *value;
+    const char* operator_name = NULL;
+    int rows_out;
+
+    value = rasqal_query_results_get_binding_value_by_name(results,
+                                                           (const unsigned char*)"operator");
+    if(value)
+      operator_name = (const char*)rasqal_literal_as_string(value);
+    rows_out = get_integer_binding(results, "rows_out");
+
+    if(!operator_name) {
+      printf("%s: EXPLAIN %s row %d FAILED with no operator\n", program, mode,
+             rows);
+      failures++;
+    } else {
+      int is_root = !rasqal_query_results_get_binding_value_by_name(results,
+                                                                    (const unsigned char*)"parent");
+      int is_triples = !strcmp(operator_name, TRIPLES_OPERATOR);
+
+      if(is_root) {
+        if(strcmp(operator_name, ROOT_OPERATOR)) {
+          printf("%s: EXPLAIN %s root operator is '%s', expected '%s'\n",
+                 program, mode, operator_name, ROOT_OPERATOR);
+          failures++;
+        }
+        seen_root++;
+      }
+      if(is_triples)
+        seen_triples++;
+
+      if(explain == RASQAL_QUERY_EXPLAIN_ANALYZE) {
+        if((is_root || is_triples) && rows_out != ANIMALS_COUNT) {
+          printf("%s: EXPLAIN ANALYZE operator '%s' FAILED returning %d rows, expected %d\n",
+                 program, operator_name, rows_out, ANIMALS_COUNT);
+          failures++;
+        }
+      } else if(rows_out >= 0) {
+        printf("%s: EXPLAIN PLAN operator '%s' FAILED with a row count\n",
+               program, operator_name);
+        failures++;
+      }
+    }
+
+    rows++;
+    rasqal_query_results_next(results);
+  }
+  rasqal_free_query_results(results);
+  rasqal_free_query(query);
+
+  if(seen_root != 1 || !seen_triples) {
+    printf("%s: EXPLAIN %s FAILED returning %d root and %d '%s' operators in %d rows\n",
+           program, mode, seen_root, seen_triples, TRIPLES_OPERATOR, rows);
+    failures++;
+  }
+
+  return failures;
+}
+
+
+int
+main(int argc, char **argv) {
+  const char *program=rasqal_basename(argv[0]);
+  raptor_uri *base_uri;
+  unsigned char *uri_string;
+  int failures=0;
+  rasqal_world *world;
+
+  if(argc != 2) {
+    fprintf(stderr, "USAGE: %s <path to data directory>\n", program);
+    return(1);
+  }
+
+  world=rasqal_new_world();
+  if(!world || rasqal_world_open(world)) {
+    fprintf(stderr, "%s: rasqal_world init failed\n", program);
+    return(1);
+  }
+
+  uri_string=raptor_uri_filename_to_uri_string("");
+  base_uri = raptor_new_uri(world->raptor_world_ptr, uri_string);
+  raptor_free_memory(uri_string);
+
+  failures += check_explain(world, program, argv[1], base_uri,
+                            RASQAL_QUERY_EXPLAIN_PLAN);
+  failures += check_explain(world, program, argv[1], base_uri,
+                            RASQAL_QUERY_EXPLAIN_ANALYZE);
+
+  raptor_free_uri(base_uri);
+
+  rasqal_free_world(world);
+
+  return failures;
+}
+
+#endif
@@ -56,6 +56,17 @@ WHERE { \n\
   $zoo ex:hasAnimal $animal \n\
 } ORDER BY $animal LIMIT %d OFFSET %d"
 
+#define SPILL_QUERY_FORMAT "\
+PREFIX ex: <http://ex.example.org#> \n\
+SELECT $animal \n\
+FROM <%s/%s> \n\
+WHERE { \n\
+  $zoo ex:hasAnimal $animal \n\
+} ORDER BY DESC($zoo) $animal"
+
+/* in kilobytes; small enough that the 26 rows are sorted in several runs */
+#define SPILL_SORT_MEMORY_LIMIT 1
+
 #else
 #define NO_QUERY_LANGUAGE
 #endif
@@ -107,6 +118,7 @@ main(int argc, char **argv) {
     int limit=9-3*i;
     int offset=0+3*i;
     size_t qs_len;
+    int store_results;
 
     if(i == 4) {
       limit = 8;
@@ -142,8 +154,12 @@ main(int argc, char **argv) {
 
     RASQAL_FREE(char*, query_string);
 
-    printf("%s: executing query %d limit %d offset %d\n", program, i,
-           limit, offset);
+    /* odd queries store the results, even ones return them lazily */
+    store_results = (i % 2);
+    rasqal_query_set_store_results(query, store_results);
+
+    printf("%s: executing query %d limit %d offset %d%s\n", program, i,
+           limit, offset, store_results ? " stored" : "");
     results=rasqal_query_execute(query);
     if(!results) {
       fprintf(stderr, "%s: query execution %d FAILED\n", program, i);
@@ -166,6 +182,25 @@ main(int argc, char **argv) {
       rasqal_query_results_next(results);
       count++;
     }
+
+    /* only stored results can be read again */
+    if(rasqal_query_results_rewind(results) != !store_results) {
+      printf("%s: query %d rewind FAILED with results %s\n", program, i,
+             store_results ? "stored" : "not stored");
+      failures++;
+    } else if(store_results && limit > 0) {
+      rasqal_literal *value;
+
+      value = rasqal_query_results_get_binding_value_by_name(results,
+                                                             (const unsigned char*)"animal");
+      if(!value ||
+         strcmp((const char*)rasqal_literal_as_string(value),
+                animalsList[offset])) {
+        printf("%s: query %d first result after rewind FAILED\n", program, i);
+        failures++;
+      }
+    }
+
     if(results)
       rasqal_free_query_results(results);
 
@@ -180,6 +215,78 @@ main(int argc, char **argv) {
 
     printf("%s: query %d OK\n", program, i);
   }
+
+
+  /* Sort all rows spilling sorted runs to temporary files */
+  if(1) {
+    rasqal_query *query = NULL;
+    rasqal_query_results *results = NULL;
+    unsigned char *data_dir_string;
+    unsigned char *query_string;
+    int count;
+    size_t qs_len;
+
+    data_dir_string=raptor_uri_filename_to_uri_string(argv[1]);
+    qs_len = strlen((const char*)data_dir_string) + strlen(animals) + strlen(SPILL_QUERY_FORMAT);
+    query_string = RASQAL_MALLOC(unsigned char*, qs_len + 1);
+    snprintf((char*)query_string, qs_len, SPILL_QUERY_FORMAT, data_dir_string,
+             animals);
+    raptor_free_memory(data_dir_string);
+
+    query=rasqal_new_query(world, query_language_name, NULL);
+    if(!query) {
+      fprintf(stderr, "%s: creating spill query in language %s FAILED\n", 
+              program, query_language_name);
+      return(1);
+    }
+
+    rasqal_query_set_feature(query, RASQAL_FEATURE_SORT_MEMORY_LIMIT,
+                             SPILL_SORT_MEMORY_LIMIT);
+
+    printf("%s: preparing %s spill query\n", program, query_language_name);
+    if(rasqal_query_prepare(query, query_string, base_uri)) {
+      fprintf(stderr, "%s: %s spill query prepare '%s' FAILED\n", program, 
+              query_language_name, query_string);
+      return(1);
+    }
+
+    RASQAL_FREE(char*, query_string);
+
+    printf("%s: executing spill query with sort memory limit %dK\n", program,
+           SPILL_SORT_MEMORY_LIMIT);
+    results=rasqal_query_execute(query);
+    if(!results) {
+      fprintf(stderr, "%s: spill query execution FAILED\n", program);
+      return(1);
+    }
+
+    count=0;
+    while(!rasqal_query_results_finished(results)) {
+      const unsigned char *name=(const unsigned char *)"animal";
+      rasqal_literal *value=rasqal_query_results_get_binding_value_by_name(results, name);
+      const char *answer=animalsList[count];
+
+      if(!answer || !value ||
+         strcmp((const char*)rasqal_literal_as_string(value), answer)) {
+        printf("spill result %d FAILED: %s=", count, (char*)name);
+        rasqal_literal_print(value, stdout);
+        printf(" expected value '%s'\n", answer ? answer : "(none)");
+        failures++;
+        break;
+      }
+      rasqal_query_results_next(results);
+      count++;
+    }
+    rasqal_free_query_results(results);
+
+    if(count != 26) {
+      printf("%s: spill query execution FAILED returning %d results, expected %d\n", 
+             program, count, 26);
+      failures++;
+    }
+
+    rasqal_free_query(query);
+  }
   
   raptor_free_uri(base_uri);
 
@@ -0,0 +1,547 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * rasqal_prepared_test.c - Rasqal RDF Query Prepared Query Tests
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <rasqal_config.h>
+#endif
+
+#ifdef WIN32
+#include <win32_rasqal_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#include <stdarg.h>
+
+#include "rasqal.h"
+#include "rasqal_internal.h"
+
+#ifdef RASQAL_QUERY_SPARQL
+
+#define QUERY_LANGUAGE "sparql"
+
+/* ?animal is a parameter given a value before each execution */
+#define PARAMETER_QUERY_FORMAT "\
+PREFIX ex: <http://ex.example.org#> \n\
+SELECT $zoo \n\
+FROM <%s/%s> \n\
+WHERE { \n\
+  $zoo ex:hasAnimal $animal \n\
+}"
+
+/* as above with the ?animal parameter also returned in each row */
+#define PROJECTED_PARAMETER_QUERY_FORMAT "\
+PREFIX ex: <http://ex.example.org#> \n\
+SELECT $zoo $animal \n\
+FROM <%s/%s> \n\
+WHERE { \n\
+  $zoo ex:hasAnimal $animal \n\
+}"
+
+#define COUNT_QUERY_FORMAT "\
+PREFIX ex: <http://ex.example.org#> \n\
+SELECT (COUNT($animal) AS $count) \n\
+FROM <%s/%s> \n\
+WHERE { \n\
+  $zoo ex:hasAnimal $animal \n\
+}"
+
+#define ZOO_URI "http://zoo.example.org/"
+
+#define ANIMALS_COUNT 26
+
+/* parameter value and expected number of results */
+static const struct {
+  const char* animal;
+  int count;
+} parameter_tests[] = {
+  { "cow", 1 },
+  { "unicorn", 0 },
+  { "tiger", 1 },
+  { NULL, 0 }
+};
+
+/* A FILTER with a multi-pattern BGP.  ex:p has fewer triples than
+ * ex:q in stats-a.nt and more in stats-b.nt so the statistics order
+ * the patterns differently for each graph.
+ */
+#define CACHED_QUERY "\
+PREFIX ex: <http://example.org/> \n\
+SELECT ?s ?o ?n \n\
+WHERE { ?s ex:p ?o . ?s ex:q ?n . FILTER(isURI(?o)) } \n\
+ORDER BY ?s ?o"
+
+/* data graph used by each execution of the cached query */
+static const char* const cached_data_files[] = {
+  "stats-a.nt", "stats-b.nt", "stats-a.nt", NULL
+};
+
+#else
+#define NO_QUERY_LANGUAGE
+#endif
+
+
+#ifdef NO_QUERY_LANGUAGE
+int
+main(int argc, char **argv) {
+  const char *program=rasqal_basename(argv[0]);
+  fprintf(stderr, "%s: No supported query language available, skipping test\n", program);
+  return(0);
+}
+#else
+
+static rasqal_query*
+prepare_query(rasqal_world* world, const char* program,
+              const char* query_format, const char* data_dir,
+              raptor_uri* base_uri)
+{
+  static const char* animals="animals.nt";
+  rasqal_query *query;
+  unsigned char *data_dir_string;
+  unsigned char *query_string;
+  size_t qs_len;
+  int rc;
+
+  data_dir_string=raptor_uri_filename_to_uri_string(data_dir);
+  qs_len = strlen((const char*)data_dir_string) + strlen(animals) + strlen(query_format);
+  query_string = RASQAL_MALLOC(unsigned char*, qs_len + 1);
+  PRAGMA_IGNORE_WARNING_FORMAT_NONLITERAL_START
+  snprintf((char*)query_string, qs_len, query_format, data_dir_string, animals);
+  PRAGMA_IGNORE_WARNING_END
+  raptor_free_memory(data_dir_string);
+
+  query=rasqal_new_query(world, QUERY_LANGUAGE, NULL);
+  if(!query) {
+    fprintf(stderr, "%s: creating query in language %s FAILED\n", program,
+            QUERY_LANGUAGE);
+    RASQAL_FREE(char*, query_string);
+    return NULL;
+  }
+
+  rc = rasqal_query_prepare(query, query_string, base_uri);
+  if(rc)
+    fprintf(stderr, "%s: %s query prepare '%s' FAILED\n", program,
+            QUERY_LANGUAGE, query_string);
+  RASQAL_FREE(char*, query_string);
+
+  if(rc) {
+    rasqal_free_query(query);
+    return NULL;
+  }
+
+  return query;
+}
+
+
+static rasqal_literal*
+make_string_literal(rasqal_world* world, const char* string)
+{
+  size_t len = strlen(string);
+  unsigned char* value;
+
+  value = RASQAL_MALLOC(unsigned char*, len + 1);
+  if(!value)
+    return NULL;
+  memcpy(value, string, len + 1);
+
+  return rasqal_new_string_literal(world, value, NULL, NULL, NULL);
+}
+
+
+static void
+free_row_string(char* row_string)
+{
+  RASQAL_FREE(char*, row_string);
+}
+
+
+/*
+ * Add the data graph @data_file in @data_dir to @query, execute it
+ * and return the result rows as a sequence of strings or NULL on
+ * failure.
+ */
+static raptor_sequence*
+execute_with_data_graph(rasqal_world* world, rasqal_query* query,
+                        const char* data_dir, const char* data_file)
+{
+  unsigned char *data_dir_string;
+  unsigned char *uri_string;
+  size_t uri_len;
+  raptor_uri *uri;
+  rasqal_data_graph *dg = NULL;
+  rasqal_query_results *results;
+  raptor_sequence *rows;
+
+  data_dir_string = raptor_uri_filename_to_uri_string(data_dir);
+  uri_len = strlen((const char*)data_dir_string) + strlen(data_file) + 2;
+  uri_string = RASQAL_MALLOC(unsigned char*, uri_len);
+  if(!uri_string) {
+    raptor_free_memory(data_dir_string);
+    return NULL;
+  }
+  snprintf((char*)uri_string, uri_len, "%s/%s", data_dir_string, data_file);
+  raptor_free_memory(data_dir_string);
+
+  uri = raptor_new_uri(world->raptor_world_ptr, uri_string);
+  RASQAL_FREE(char*, uri_string);
+  if(uri) {
+    dg = rasqal_new_data_graph_from_uri(world, uri, /* name URI */ NULL,
+                                        RASQAL_DATA_GRAPH_BACKGROUND,
+                                        NULL, NULL, NULL);
+    raptor_free_uri(uri);
+  }
+  if(!dg || rasqal_query_add_data_graph(query, dg))
+    return NULL;
+
+  results = rasqal_query_execute(query);
+  if(!results)
+    return NULL;
+
+  rows = raptor_new_sequence((raptor_data_free_handler)free_row_string, NULL);
+  while(rows && !rasqal_query_results_finished(results)) {
+    raptor_stringbuffer* sb;
+    char* row_string = NULL;
+    int count = rasqal_query_results_get_bindings_count(results);
+    int i;
+
+    sb = raptor_new_stringbuffer();
+    for(i = 0; sb && i < count; i++) {
+      rasqal_literal* value = rasqal_query_results_get_binding_value(results,
+                                                                     i);
+      const unsigned char* str = NULL;
+
+      if(value)
+        str = rasqal_literal_as_string(value);
+      if(i)
+        raptor_stringbuffer_append_counted_string(sb,
+                                                  (const unsigned char*)" ",
+                                                  1, 1);
+      raptor_stringbuffer_append_string(sb, str ? str :
+                                        (const unsigned char*)"-", 1);
+    }
+
+    if(sb) {
+      size_t len = raptor_stringbuffer_length(sb);
+
+      row_string = RASQAL_MALLOC(char*, len + 1);
+      if(row_string) {
+        if(len)
+          memcpy(row_string, raptor_stringbuffer_as_string(sb), len);
+        row_string[len] = '\0';
+      }
+      raptor_free_stringbuffer(sb);
+    }
+
+    if(!row_string || raptor_sequence_push(rows, row_string)) {
+      raptor_free_sequence(rows);
+      rows = NULL;
+      break;
+    }
+
+    rasqal_query_results_next(results);
+  }
+
+  rasqal_free_query_results(results);
+
+  return rows;
+}
+
+
+/*
+ * Execute a query from the world query cache over a different data
+ * graph each time and check it returns the same rows as the query
+ * prepared afresh.  The cache hits reuse the algebra built for the
+ * first graph, whose statistics gave another triple pattern order.
+ * Return the number of failures.
+ */
+static int
+test_cached_query(rasqal_world* world, const char* program,
+                  const char* data_dir, raptor_uri* base_uri)
+{
+  rasqal_query* cached_query = NULL;
+  int failures = 0;
+  int i;
+
+  if(rasqal_world_set_query_cache_size(world, 1)) {
+    fprintf(stderr, "%s: enabling the query cache FAILED\n", program);
+    return 1;
+  }
+
+  for(i = 0; cached_data_files[i]; i++) {
+    const char* data_file = cached_data_files[i];
+    rasqal_query* query;
+    rasqal_query* fresh_query;
+    raptor_sequence* rows = NULL;
+    raptor_sequence* fresh_rows = NULL;
+    int j;
+
+    printf("%s: executing cached query %d with data graph %s\n", program,
+           i, data_file);
+    query = rasqal_new_prepared_query(world, QUERY_LANGUAGE, NULL,
+                                      (const unsigned char*)CACHED_QUERY,
+                                      base_uri);
+    if(!query) {
+      fprintf(stderr, "%s: preparing cached query %d FAILED\n", program, i);
+      failures++;
+      break;
+    }
+    if(i && query != cached_query) {
+      fprintf(stderr, "%s: cached query %d was not a cache hit\n", program,
+              i);
+      failures++;
+    }
+    cached_query = query;
+
+    rows = execute_with_data_graph(world, query, data_dir, data_file);
+    rasqal_free_query(query);
+
+    fresh_query = rasqal_new_query(world, QUERY_LANGUAGE, NULL);
+    if(fresh_query &&
+       !rasqal_query_prepare(fresh_query, (const unsigned char*)CACHED_QUERY,
+                             base_uri))
+      fresh_rows = execute_with_data_graph(world, fresh_query, data_dir,
+                                           data_file);
+    if(fresh_query)
+      rasqal_free_query(fresh_query);
+
+    if(!rows || !fresh_rows) {
+      fprintf(stderr, "%s: cached query %d execution FAILED\n", program, i);
+      failures++;
+    } else if(!raptor_sequence_size(fresh_rows) ||
+              raptor_sequence_size(rows) != raptor_sequence_size(fresh_rows)) {
+      printf("%s: cached query %d FAILED returning %d results, expected %d\n",
+             program, i, raptor_sequence_size(rows),
+             raptor_sequence_size(fresh_rows));
+      failures++;
+    } else {
+      for(j = 0; j < raptor_sequence_size(rows); j++) {
+        const char* got = (const char*)raptor_sequence_get_at(rows, j);
+        const char* expected;
+
+        expected = (const char*)raptor_sequence_get_at(fresh_rows, j);
+        if(strcmp(got, expected)) {
+          printf("%s: cached query %d result %d FAILED returning '%s', expected '%s'\n",
+                 program, i, j, got, expected);
+          failures++;
+          break;
+        }
+      }
+    }
+
+    if(rows)
+      raptor_free_sequence(rows);
+    if(fresh_rows)
+      raptor_free_sequence(fresh_rows);
+  }
+
+  rasqal_world_set_query_cache_size(world, 0);
+
+  return failures;
+}
+
+
+int
+main(int argc, char **argv) {
+  const char *program=rasqal_basename(argv[0]);
+  raptor_uri *base_uri;
+  unsigned char *uri_string;
+  int failures=0;
+  int i;
+  rasqal_world *world;
+  rasqal_query *query = NULL;
+
+  if(argc != 2) {
+    fprintf(stderr, "USAGE: %s <path to data directory>\n", program);
+    return(1);
+  }
+
+  world=rasqal_new_world();
+  if(!world || rasqal_world_open(world)) {
+    fprintf(stderr, "%s: rasqal_world init failed\n", program);
+    return(1);
+  }
+
+  uri_string=raptor_uri_filename_to_uri_string("");
+  base_uri = raptor_new_uri(world->raptor_world_ptr, uri_string);
+  raptor_free_memory(uri_string);
+
+
+  /* Prepare once then execute with a different parameter each time */
+  printf("%s: preparing %s parameter query\n", program, QUERY_LANGUAGE);
+  query = prepare_query(world, program, PARAMETER_QUERY_FORMAT, argv[1],
+                        base_uri);
+  if(!query)
+    return(1);
+
+  for(i = 0; parameter_tests[i].animal; i++) {
+    const char* animal = parameter_tests[i].animal;
+    rasqal_query_results *results;
+    int count;
+
+    printf("%s: executing parameter query %d with animal '%s'\n", program, i,
+           animal);
+    if(rasqal_query_set_variable2(query, RASQAL_VARIABLE_TYPE_NORMAL,
+                                  (const unsigned char*)"animal",
+                                  make_string_literal(world, animal))) {
+      fprintf(stderr, "%s: setting parameter %d FAILED\n", program, i);
+      return(1);
+    }
+
+    results=rasqal_query_execute(query);
+    if(!results) {
+      fprintf(stderr, "%s: query execution %d FAILED\n", program, i);
+      return(1);
+    }
+
+    count=0;
+    while(!rasqal_query_results_finished(results)) {
+      const unsigned char *name=(const unsigned char *)"zoo";
+      rasqal_literal *value=rasqal_query_results_get_binding_value_by_name(results, name);
+
+      if(!value ||
+         strcmp((const char*)rasqal_literal_as_string(value), ZOO_URI)) {
+        printf("%s: result %d of query %d FAILED: %s=", program, count, i,
+               (char*)name);
+        rasqal_literal_print(value, stdout);
+        printf(" expected value '%s'\n", ZOO_URI);
+        failures++;
+      }
+      rasqal_query_results_next(results);
+      count++;
+    }
+    rasqal_free_query_results(results);
+
+    if(count != parameter_tests[i].count) {
+      printf("%s: query execution %d FAILED returning %d results, expected %d\n",
+             program, i, count, parameter_tests[i].count);
+      failures++;
+    }
+  }
+
+  rasqal_free_query(query);
+
+
+  /* A projected parameter is returned with the value it was given */
+  printf("%s: preparing %s projected parameter query\n", program,
+         QUERY_LANGUAGE);
+  query = prepare_query(world, program, PROJECTED_PARAMETER_QUERY_FORMAT,
+                        argv[1], base_uri);
+  if(!query)
+    return(1);
+
+  for(i = 0; parameter_tests[i].animal; i++) {
+    const char* animal = parameter_tests[i].animal;
+    rasqal_query_results *results;
+    int count;
+
+    printf("%s: executing projected parameter query %d with animal '%s'\n",
+           program, i, animal);
+    if(rasqal_query_set_variable2(query, RASQAL_VARIABLE_TYPE_NORMAL,
+                                  (const unsigned char*)"animal",
+                                  make_string_literal(world, animal))) {
+      fprintf(stderr, "%s: setting parameter %d FAILED\n", program, i);
+      return(1);
+    }
+
+    results=rasqal_query_execute(query);
+    if(!results) {
+      fprintf(stderr, "%s: projected query execution %d FAILED\n", program,
+              i);
+      return(1);
+    }
+
+    count=0;
+    while(!rasqal_query_results_finished(results)) {
+      const unsigned char *name=(const unsigned char *)"animal";
+      rasqal_literal *value=rasqal_query_results_get_binding_value_by_name(results, name);
+
+      if(!value ||
+         strcmp((const char*)rasqal_literal_as_string(value), animal)) {
+        printf("%s: result %d of projected query %d FAILED: %s=", program,
+               count, i, (char*)name);
+        rasqal_literal_print(value, stdout);
+        printf(" expected value '%s'\n", animal);
+        failures++;
+      }
+      rasqal_query_results_next(results);
+      count++;
+    }
+    rasqal_free_query_results(results);
+
+    if(count != parameter_tests[i].count) {
+      printf("%s: projected query execution %d FAILED returning %d results, expected %d\n",
+             program, i, count, parameter_tests[i].count);
+      failures++;
+    }
+  }
+
+  rasqal_free_query(query);
+
+
+  /* An aggregate query gives the same answer every execution */
+  printf("%s: preparing %s count query\n", program, QUERY_LANGUAGE);
+  query = prepare_query(world, program, COUNT_QUERY_FORMAT, argv[1],
+                        base_uri);
+  if(!query)
+    return(1);
+
+  for(i = 0; i < 2; i++) {
+    rasqal_query_results *results;
+    rasqal_literal *value;
+    int error = 0;
+    int count = -1;
+
+    printf("%s: executing count query %d\n", program, i);
+    results=rasqal_query_execute(query);
+    if(!results) {
+      fprintf(stderr, "%s: count query execution %d FAILED\n", program, i);
+      return(1);
+    }
+
+    value = rasqal_query_results_get_binding_value_by_name(results,
+                                                           (const unsigned char*)"count");
+    if(value)
+      count = rasqal_literal_as_integer(value, &error);
+    if(error || count != ANIMALS_COUNT) {
+      printf("%s: count query execution %d FAILED returning %d, expected %d\n",
+             program, i, count, ANIMALS_COUNT);
+      failures++;
+    }
+
+    rasqal_free_query_results(results);
+  }
+
+  rasqal_free_query(query);
+
+
+  failures += test_cached_query(world, program, argv[1], base_uri);
+
+  raptor_free_uri(base_uri);
+
+  rasqal_free_world(world);
+
+  return failures;
+}
+
+#endif
@@ -0,0 +1,489 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * rasqal_service_test.c - Rasqal RDF Query SERVICE Concurrency Tests
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <rasqal_config.h>
+#endif
+
+#ifdef WIN32
+#include <win32_rasqal_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#include <stdarg.h>
+
+#include "rasqal.h"
+#include "rasqal_internal.h"
+
+#if defined(RASQAL_QUERY_SPARQL) && defined(RASQAL_THREADS_POSIX)
+
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define QUERY_LANGUAGE "sparql"
+
+/* Two SERVICE requests that do not depend on each other */
+#define SERVICE_QUERY_FORMAT "\
+SELECT ?x \n\
+WHERE { \n\
+  { SERVICE <http://127.0.0.1:%d/a> { ?x ?p ?o } } \n\
+  UNION \n\
+  { SERVICE <http://127.0.0.1:%d/b> { ?x ?p ?o } } \n\
+}"
+
+#define SERVICES_COUNT 2
+
+/* each response is delayed so that concurrent requests overlap */
+#define RESPONSE_DELAY_USEC 300000
+
+/* A SERVICE whose response stops after the first result */
+#define SLOW_SERVICE_QUERY_FORMAT "\
+SELECT ?x \n\
+WHERE { \n\
+  SERVICE <http://127.0.0.1:%d/slow> { ?x ?p ?o } \n\
+} \n\
+LIMIT 1"
+
+/* longest time the rest of the slow response is held back */
+#define SLOW_RESPONSE_TIMEOUT_SECS 10
+
+/* more than the result readers ask for at once */
+#define SLOW_RESPONSE_PADDING_LEN 32768
+
+static const char service_response[] = "\
+HTTP/1.0 200 OK\r\n\
+Content-Type: application/sparql-results+xml\r\n\
+Connection: close\r\n\
+\r\n\
+<?xml version=\"1.0\"?>\n\
+<sparql xmlns=\"http://www.w3.org/2005/sparql-results#\">\n\
+  <head><variable name=\"x\"/></head>\n\
+  <results>\n\
+    <result><binding name=\"x\"><uri>http://example.org/x</uri></binding></result>\n\
+  </results>\n\
+</sparql>\n";
+
+/* the slow response is this, a comment padding it out and the end */
+static const char slow_response_start[] = "\
+HTTP/1.0 200 OK\r\n\
+Content-Type: application/sparql-results+xml\r\n\
+Connection: close\r\n\
+\r\n\
+<?xml version=\"1.0\"?>\n\
+<sparql xmlns=\"http://www.w3.org/2005/sparql-results#\">\n\
+  <head><variable name=\"x\"/></head>\n\
+  <results>\n\
+    <result><binding name=\"x\"><uri>http://example.org/x</uri></binding></result>\n\
+<!-- ";
+
+static const char slow_response_end[] = " -->\n\
+    <result><binding name=\"x\"><uri>http://example.org/y</uri></binding></result>\n\
+  </results>\n\
+</sparql>\n";
+
+#else
+#define NO_QUERY_LANGUAGE
+#endif
+
+
+#ifdef NO_QUERY_LANGUAGE
+int
+main(int argc, char **argv) {
+  const char *program=rasqal_basename(argv[0]);
+  fprintf(stderr, "%s: No supported query language or threads available, skipping test\n", program);
+  return(0);
+}
+#else
+
+/* Stand-in SPARQL endpoint counting how many requests it serves at once */
+static int listen_fd = -1;
+static pthread_mutex_t server_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int active_requests = 0;
+static int peak_requests = 0;
+
+/* signalled by the test to let the slow response end */
+static pthread_cond_t slow_cond = PTHREAD_COND_INITIALIZER;
+static int slow_released = 0;
+static int slow_finished = 0;
+
+
+static void
+serve_slow_request(int fd)
+{
+  char padding[1024];
+  struct timespec deadline;
+  int i;
+
+  memset(padding, ' ', sizeof(padding));
+
+  if(write(fd, slow_response_start, sizeof(slow_response_start) - 1) < 0)
+    perror("write");
+  for(i = 0; i < SLOW_RESPONSE_PADDING_LEN / RASQAL_GOOD_CAST(int, sizeof(padding)); i++) {
+    if(write(fd, padding, sizeof(padding)) < 0)
+      perror("write");
+  }
+
+  deadline.tv_sec = time(NULL) + SLOW_RESPONSE_TIMEOUT_SECS;
+  deadline.tv_nsec = 0;
+
+  pthread_mutex_lock(&server_mutex);
+  while(!slow_released) {
+    if(pthread_cond_timedwait(&slow_cond, &server_mutex, &deadline))
+      break;
+  }
+  pthread_mutex_unlock(&server_mutex);
+
+  /* fails once the client has gone */
+  if(write(fd, slow_response_end, sizeof(slow_response_end) - 1) < 0)
+    perror("write");
+  close(fd);
+
+  pthread_mutex_lock(&server_mutex);
+  slow_finished = 1;
+  pthread_mutex_unlock(&server_mutex);
+}
+
+
+static void*
+serve_request(void* arg)
+{
+  int fd = *(int*)arg;
+  char buffer[4096];
+  size_t len = 0;
+
+  free(arg);
+
+  /* read the request headers */
+  while(len < sizeof(buffer) - 1) {
+    ssize_t n = read(fd, buffer + len, sizeof(buffer) - 1 - len);
+    if(n <= 0)
+      break;
+    len += RASQAL_GOOD_CAST(size_t, n);
+    buffer[len] = '\0';
+    if(strstr(buffer, "\r\n\r\n"))
+      break;
+  }
+
+  if(!strncmp(buffer, "GET /slow", 9)) {
+    serve_slow_request(fd);
+    return NULL;
+  }
+
+  pthread_mutex_lock(&server_mutex);
+  if(++active_requests > peak_requests)
+    peak_requests = active_requests;
+  pthread_mutex_unlock(&server_mutex);
+
+  usleep(RESPONSE_DELAY_USEC);
+
+  pthread_mutex_lock(&server_mutex);
+  active_requests--;
+  pthread_mutex_unlock(&server_mutex);
+
+  if(write(fd, service_response, sizeof(service_response) - 1) < 0)
+    perror("write");
+  close(fd);
+
+  return NULL;
+}
+
+
+static void*
+serve(void* arg)
+{
+  (void)arg;
+
+  while(1) {
+    pthread_t thread;
+    int* fd = (int*)malloc(sizeof(int));
+
+    if(!fd)
+      break;
+
+    *fd = accept(listen_fd, NULL, NULL);
+    if(*fd < 0) {
+      free(fd);
+      break;
+    }
+
+    if(pthread_create(&thread, NULL, serve_request, fd)) {
+      close(*fd);
+      free(fd);
+      continue;
+    }
+    pthread_detach(thread);
+  }
+
+  return NULL;
+}
+
+
+static int
+start_server(void)
+{
+  struct sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+  pthread_t thread;
+
+  listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if(listen_fd < 0)
+    return -1;
+
+  memset(&addr, '\0', sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+
+  if(bind(listen_fd, (struct sockaddr*)&addr, addr_len) ||
+     listen(listen_fd, 8) ||
+     getsockname(listen_fd, (struct sockaddr*)&addr, &addr_len))
+    return -1;
+
+  if(pthread_create(&thread, NULL, serve, NULL))
+    return -1;
+  pthread_detach(thread);
+
+  return ntohs(addr.sin_port);
+}
+
+
+/* Return the number of results or <0 on failure */
+static int
+run_query(rasqal_world* world, const char* program, int port)
+{
+  rasqal_query *query;
+  rasqal_query_results *results;
+  char query_string[512];
+  int count;
+
+  snprintf(query_string, sizeof(query_string), SERVICE_QUERY_FORMAT,
+           port, port);
+
+  query = rasqal_new_query(world, QUERY_LANGUAGE, NULL);
+  if(!query) {
+    fprintf(stderr, "%s: creating query in language %s FAILED\n", program,
+            QUERY_LANGUAGE);
+    return -1;
+  }
+
+  if(rasqal_query_prepare(query, (const unsigned char*)query_string, NULL)) {
+    fprintf(stderr, "%s: %s query prepare '%s' FAILED\n", program,
+            QUERY_LANGUAGE, query_string);
+    rasqal_free_query(query);
+    return -1;
+  }
+
+  results = rasqal_query_execute(query);
+  if(!results) {
+    rasqal_free_query(query);
+    return -1;
+  }
+
+  count = 0;
+  while(!rasqal_query_results_finished(results)) {
+    count++;
+    rasqal_query_results_next(results);
+  }
+
+  rasqal_free_query_results(results);
+  rasqal_free_query(query);
+
+  return count;
+}
+
+
+/* Return non-0 if freeing the results waited for the rest of the
+ * slow response
+ */
+static int
+run_slow_query(rasqal_world* world, const char* program, int port)
+{
+  rasqal_query *query;
+  rasqal_query_results *results;
+  char query_string[512];
+  int failures = 0;
+
+  snprintf(query_string, sizeof(query_string), SLOW_SERVICE_QUERY_FORMAT,
+           port);
+
+  query = rasqal_new_query(world, QUERY_LANGUAGE, NULL);
+  if(!query) {
+    fprintf(stderr, "%s: creating query in language %s FAILED\n", program,
+            QUERY_LANGUAGE);
+    return 1;
+  }
+
+  if(rasqal_query_prepare(query, (const unsigned char*)query_string, NULL)) {
+    fprintf(stderr, "%s: %s query prepare '%s' FAILED\n", program,
+            QUERY_LANGUAGE, query_string);
+    rasqal_free_query(query);
+    return 1;
+  }
+
+  results = rasqal_query_execute(query);
+  if(!results) {
+    printf("%s: slow query execution FAILED\n", program);
+    rasqal_free_query(query);
+    return 1;
+  }
+
+  /* read the first result only; the rest of the response is unread */
+  if(rasqal_query_results_finished(results)) {
+    printf("%s: slow query execution FAILED returning no results\n",
+           program);
+    failures++;
+  }
+
+  rasqal_free_query_results(results);
+  rasqal_free_query(query);
+
+  pthread_mutex_lock(&server_mutex);
+  if(slow_finished) {
+    printf("%s: freeing results FAILED waiting for the service response to end\n",
+           program);
+    failures++;
+  }
+  slow_released = 1;
+  pthread_cond_broadcast(&slow_cond);
+  pthread_mutex_unlock(&server_mutex);
+
+  return failures;
+}
+
+
+int
+main(int argc, char **argv) {
+  const char *program=rasqal_basename(argv[0]);
+  rasqal_world *world;
+  int port;
+  int count;
+  int failures=0;
+
+  if(argc != 2) {
+    fprintf(stderr, "USAGE: %s <path to data directory>\n", program);
+    return(1);
+  }
+
+  world=rasqal_new_world();
+  if(!world || rasqal_world_open(world)) {
+    fprintf(stderr, "%s: rasqal_world init failed\n", program);
+    return(1);
+  }
+
+  port = start_server();
+  if(port < 0) {
+    fprintf(stderr, "%s: Cannot listen on a local port, skipping test\n",
+            program);
+    rasqal_free_world(world);
+    return(0);
+  }
+
+  /* Without a thread pool the requests are made one after the other */
+  printf("%s: executing %d SERVICE requests serially\n", program,
+         SERVICES_COUNT);
+  count = run_query(world, program, port);
+  if(count != SERVICES_COUNT) {
+    fprintf(stderr, "%s: SERVICE requests are not supported, skipping test\n",
+            program);
+    rasqal_free_world(world);
+    return(0);
+  }
+
+  pthread_mutex_lock(&server_mutex);
+  if(peak_requests != 1) {
+    printf("%s: serial execution FAILED making %d requests at once, expected 1\n",
+           program, peak_requests);
+    failures++;
+  }
+  peak_requests = 0;
+  pthread_mutex_unlock(&server_mutex);
+
+  /* A thread pool alone does not start them in the background */
+  if(rasqal_world_set_thread_pool_size(world, 4)) {
+    fprintf(stderr, "%s: setting thread pool size FAILED\n", program);
+    rasqal_free_world(world);
+    return(1);
+  }
+
+  printf("%s: executing %d SERVICE requests with a thread pool\n", program,
+         SERVICES_COUNT);
+  count = run_query(world, program, port);
+  if(count != SERVICES_COUNT) {
+    printf("%s: thread pool execution FAILED returning %d results, expected %d\n",
+           program, count, SERVICES_COUNT);
+    failures++;
+  }
+
+  pthread_mutex_lock(&server_mutex);
+  if(peak_requests != 1) {
+    printf("%s: thread pool execution FAILED making %d requests at once, expected 1\n",
+           program, peak_requests);
+    failures++;
+  }
+  peak_requests = 0;
+  pthread_mutex_unlock(&server_mutex);
+
+  /* With prefetching they are started together at execution */
+  if(rasqal_world_set_service_prefetch_size(world, SERVICES_COUNT)) {
+    fprintf(stderr, "%s: setting service prefetch size FAILED\n", program);
+    rasqal_free_world(world);
+    return(1);
+  }
+
+  printf("%s: executing %d SERVICE requests concurrently\n", program,
+         SERVICES_COUNT);
+  count = run_query(world, program, port);
+  if(count != SERVICES_COUNT) {
+    printf("%s: concurrent execution FAILED returning %d results, expected %d\n",
+           program, count, SERVICES_COUNT);
+    failures++;
+  }
+
+  pthread_mutex_lock(&server_mutex);
+  if(peak_requests != SERVICES_COUNT) {
+    printf("%s: concurrent execution FAILED making %d requests at once, expected %d\n",
+           program, peak_requests, SERVICES_COUNT);
+    failures++;
+  }
+  pthread_mutex_unlock(&server_mutex);
+
+  /* Freeing results does not wait for an unread response to end */
+  printf("%s: freeing results of a SERVICE request still running\n",
+         program);
+  failures += run_slow_query(world, program, port);
+
+  close(listen_fd);
+
+  rasqal_free_world(world);
+
+  return failures;
+}
+
+#endif
@@ -0,0 +1,313 @@
+/* -*- Mode: c; c-basic-offset: 2 -*-
+ *
+ * rasqal_topk_test.c - Rasqal RDF Query ORDER BY with LIMIT Tests
+ *
+ * This package is Free Software and part of Redland http://librdf.org/
+ *
+ * It is licensed under the following three licenses as alternatives:
+ *   1. GNU Lesser General Public License (LGPL) V2.1 or any newer version
+ *   2. GNU General Public License (GPL) V2 or any newer version
+ *   3. Apache License, V2.0 or any newer version
+ *
+ * You may not use this file except in compliance with at least one of
+ * the above three licenses.
+ *
+ * See LICENSE.html or LICENSE.txt at the top of this package for the
+ * complete terms and further detail along with the license texts for
+ * the licenses in COPYING.LIB, COPYING and LICENSE-2.0.txt respectively.
+ *
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <rasqal_config.h>
+#endif
+
+#ifdef WIN32
+#include <win32_rasqal_config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#include <stdarg.h>
+
+#include "rasqal.h"
+#include "rasqal_internal.h"
+
+#ifdef RASQAL_QUERY_SPARQL
+
+#define QUERY_LANGUAGE "sparql"
+
+/* Formats taking the dataset then the LIMIT and OFFSET, if any.  Run
+ * without LIMIT and OFFSET the whole order is sorted, giving the rows
+ * the sliced query must return.
+ */
+static const char* const topk_queries[] = {
+  /* all rows ordered by a value */
+  "SELECT ?o %s WHERE { ?s ?p ?o } ORDER BY ?o %s",
+  /* many ties that must stay in the input order */
+  "SELECT ?o %s WHERE { ?s ?p ?o } ORDER BY DESC(STRLEN(?o)) %s",
+  /* several conditions */
+  "SELECT ?s ?o %s WHERE { ?s ?p ?o } ORDER BY ?s DESC(?o) %s",
+  /* duplicates removed after ordering */
+  "SELECT DISTINCT ?p %s WHERE { ?s ?p ?o } ORDER BY ?p %s",
+  "SELECT DISTINCT ?o %s WHERE { ?s ?p ?o } ORDER BY DESC(STRLEN(?o)) ?o %s",
+  /* a sub-SELECT slice */
+  "SELECT ?o %s WHERE { { SELECT ?o WHERE { ?s ?p ?o } ORDER BY DESC(?o) %s } }",
+  NULL
+};
+
+#define NONE (-1)
+static const struct {
+  int limit;
+  int offset;
+} topk_slices[] = {
+  { 0,    NONE },
+  { 1,    NONE },
+  { 5,    NONE },
+  { 5,       3 },
+  { 10,     45 },
+  { 100,  NONE },
+  { 3,     100 },
+  { NONE,    5 },
+  { NONE, NONE }
+};
+
+#else
+#define NO_QUERY_LANGUAGE
+#endif
+
+
+#ifdef NO_QUERY_LANGUAGE
+int
+main(int argc, char **argv) {
+  const char *program=rasqal_basename(argv[0]);
+  fprintf(stderr, "%s: No supported query language available, skipping test\n", program);
+  return(0);
+}
+#else
+
+static void
+free_row_string(char* row_string)
+{
+  RASQAL_FREE(char*, row_string);
+}
+
+
+/* Return the result rows as a sequence of strings or NULL on failure */
+static raptor_sequence*
+run_query(rasqal_world* world, const char* program, raptor_uri* base_uri,
+          const char* query_string)
+{
+  rasqal_query *query;
+  rasqal_query_results *results;
+  raptor_sequence *rows = NULL;
+
+  query = rasqal_new_query(world, QUERY_LANGUAGE, NULL);
+  if(!query) {
+    fprintf(stderr, "%s: creating query in language %s FAILED\n", program,
+            QUERY_LANGUAGE);
+    return NULL;
+  }
+
+  if(rasqal_query_prepare(query, (const unsigned char*)query_string,
+                          base_uri)) {
+    fprintf(stderr, "%s: %s query prepare '%s' FAILED\n", program,
+            QUERY_LANGUAGE, query_string);
+    goto tidy;
+  }
+
+  results = rasqal_query_execute(query);
+  if(!results) {
+    fprintf(stderr, "%s: query '%s' execution FAILED\n", program,
+            query_string);
+    goto tidy;
+  }
+
+  rows = raptor_new_sequence((raptor_data_free_handler)free_row_string, NULL);
+  while(rows && !rasqal_query_results_finished(results)) {
+    raptor_stringbuffer* sb;
+    char* row_string = NULL;
+    int count = rasqal_query_results_get_bindings_count(results);
+    int i;
+
+    sb = raptor_new_stringbuffer();
+    for(i = 0; sb && i < count; i++) {
+      rasqal_literal* value = rasqal_query_results_get_binding_value(results,
+                                                                     i);
+      const unsigned char* str = NULL;
+
+      if(value)
+        str = rasqal_literal_as_string(value);
+      if(i)
+        raptor_stringbuffer_append_counted_string(sb,
+                                                  (const unsigned char*)" ",
+                                                  1, 1);
+      raptor_stringbuffer_append_string(sb, str ? str :
+                                        (const unsigned char*)"-", 1);
+    }
+
+    if(sb) {
+      size_t len = raptor_stringbuffer_length(sb);
+
+      row_string = RASQAL_MALLOC(char*, len + 1);
+      if(row_string) {
+        if(len)
+          memcpy(row_string, raptor_stringbuffer_as_string(sb), len);
+        row_string[len] = '\0';
+      }
+      raptor_free_stringbuffer(sb);
+    }
+
+    if(!row_string || raptor_sequence_push(rows, row_string)) {
+      raptor_free_sequence(rows);
+      rows = NULL;
+      break;
+    }
+
+    rasqal_query_results_next(results);
+  }
+
+  rasqal_free_query_results(results);
+
+  tidy:
+  rasqal_free_query(query);
+
+  return rows;
+}
+
+
+int
+main(int argc, char **argv) {
+  const char *program=rasqal_basename(argv[0]);
+  raptor_uri *base_uri;
+  unsigned char *uri_string;
+  unsigned char *data_dir_string;
+  char *dataset;
+  size_t dataset_len;
+  int failures=0;
+  int query_i;
+  rasqal_world *world;
+
+  if(argc != 2) {
+    fprintf(stderr, "USAGE: %s <path to data directory>\n", program);
+    return(1);
+  }
+
+  world=rasqal_new_world();
+  if(!world || rasqal_world_open(world)) {
+    fprintf(stderr, "%s: rasqal_world init failed\n", program);
+    return(1);
+  }
+
+  uri_string=raptor_uri_filename_to_uri_string("");
+  base_uri = raptor_new_uri(world->raptor_world_ptr, uri_string);
+  raptor_free_memory(uri_string);
+
+  /* 52 rows: 26 single letters then 26 animal names */
+  data_dir_string=raptor_uri_filename_to_uri_string(argv[1]);
+  dataset_len = (2 * strlen((const char*)data_dir_string)) + 64;
+  dataset = RASQAL_MALLOC(char*, dataset_len);
+  snprintf(dataset, dataset_len, "FROM <%s/letters.nt> FROM <%s/animals.nt>",
+           (const char*)data_dir_string, (const char*)data_dir_string);
+  raptor_free_memory(data_dir_string);
+
+  for(query_i = 0; topk_queries[query_i]; query_i++) {
+    const char* query_format = topk_queries[query_i];
+    size_t qs_len = strlen(query_format) + dataset_len + 64;
+    char* query_string;
+    raptor_sequence* all_rows;
+    int all_count;
+    int slice_i;
+
+    query_string = RASQAL_MALLOC(char*, qs_len);
+    PRAGMA_IGNORE_WARNING_FORMAT_NONLITERAL_START
+    snprintf(query_string, qs_len, query_format, dataset, "");
+    PRAGMA_IGNORE_WARNING_END
+
+    printf("%s: executing query %d with no LIMIT\n", program, query_i);
+    all_rows = run_query(world, program, base_uri, query_string);
+    if(!all_rows) {
+      RASQAL_FREE(char*, query_string);
+      failures++;
+      continue;
+    }
+    all_count = raptor_sequence_size(all_rows);
+
+    for(slice_i = 0;
+        topk_slices[slice_i].limit != NONE || topk_slices[slice_i].offset != NONE;
+        slice_i++) {
+      int limit = topk_slices[slice_i].limit;
+      int offset = topk_slices[slice_i].offset;
+      char slice[64];
+      raptor_sequence* rows;
+      int start;
+      int expected_count;
+      int i;
+
+      *slice = '\0';
+      if(limit != NONE)
+        snprintf(slice, sizeof(slice), "LIMIT %d", limit);
+      if(offset != NONE)
+        snprintf(slice + strlen(slice), sizeof(slice) - strlen(slice),
+                 " OFFSET %d", offset);
+
+      PRAGMA_IGNORE_WARNING_FORMAT_NONLITERAL_START
+      snprintf(query_string, qs_len, query_format, dataset, slice);
+      PRAGMA_IGNORE_WARNING_END
+
+      printf("%s: executing query %d with %s\n", program, query_i, slice);
+      rows = run_query(world, program, base_uri, query_string);
+      if(!rows) {
+        failures++;
+        continue;
+      }
+
+      /* the slice of the fully sorted rows */
+      start = (offset == NONE) ? 0 : offset;
+      if(start > all_count)
+        start = all_count;
+      expected_count = all_count - start;
+      if(limit != NONE && limit < expected_count)
+        expected_count = limit;
+
+      if(raptor_sequence_size(rows) != expected_count) {
+        printf("%s: query %d with %s FAILED returning %d results, expected %d\n",
+               program, query_i, slice, raptor_sequence_size(rows),
+               expected_count);
+        failures++;
+      } else {
+        for(i = 0; i < expected_count; i++) {
+          const char* got = (const char*)raptor_sequence_get_at(rows, i);
+          const char* expected;
+
+          expected = (const char*)raptor_sequence_get_at(all_rows, start + i);
+          if(strcmp(got, expected)) {
+            printf("%s: query %d with %s result %d FAILED returning '%s', expected '%s'\n",
+                   program, query_i, slice, i, got, expected);
+            failures++;
+            break;
+          }
+        }
+      }
+
+      raptor_free_sequence(rows);
+    }
+
+    raptor_free_sequence(all_rows);
+    RASQAL_FREE(char*, query_string);
+  }
+
+  RASQAL_FREE(char*, dataset);
+
+  raptor_free_uri(base_uri);
+
+  rasqal_free_world(world);
+
+  return failures;
+}
+
+#endif
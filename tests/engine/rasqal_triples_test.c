@@ -46,7 +46,7 @@
 /*
 DAWG basic/list-4.rql test flattened to show triple patterns not
 just collections but triples, bnode renamed to be more readable.
-The triple patterns are not reordered so execution should be identical.
+The triple patterns may be reordered but the answer is the same.
 
 Expected answer is 1 row:
 {